@@ -0,0 +1,203 @@
+#include <formula/checker.h>
+
+#include <formula/bytecode.h>
+#include <formula/parser.h>
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace formula
+{
+
+namespace
+{
+
+// Adds the problems of entry to problems, offset by offset.
+void check_entry(const Entry &entry, std::string_view text, std::size_t offset, std::vector<Problem> &problems)
+{
+    for (const Diagnostic &diagnostic : entry.diagnostics)
+    {
+        problems.push_back({offset + diagnostic.begin, offset + diagnostic.end, diagnostic.message});
+    }
+    if (!entry.diagnostics.empty())
+    {
+        return;
+    }
+    try
+    {
+        compile(entry, text);
+    }
+    catch (const std::exception &e)
+    {
+        // The compiler doesn't say where; point at the entry's name.
+        problems.push_back({offset, offset + entry.name.size(), e.what()});
+    }
+}
+
+} // namespace
+
+bool check_formulas(std::string_view text, std::vector<Problem> &problems, const std::atomic<bool> &cancel)
+{
+    for (std::size_t position = next_entry(text, 0); position < text.size();)
+    {
+        if (cancel)
+        {
+            return false;
+        }
+        const Entry entry = parse_entry(text, position);
+        position = next_entry(text, entry.end);
+        check_entry(entry, text, entry.begin, problems);
+    }
+    return !cancel;
+}
+
+BackgroundChecker::BackgroundChecker(Publish publish) :
+    m_publish(std::move(publish)),
+    m_thread([this] { work(); })
+{
+}
+
+BackgroundChecker::~BackgroundChecker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_cancel = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void BackgroundChecker::edited(std::size_t position, std::size_t removed, std::size_t inserted)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_edits = merge(m_edits, {position, removed, inserted, true});
+}
+
+unsigned BackgroundChecker::submit(std::string text)
+{
+    unsigned generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // A snapshot the worker never took is skipped, so its edits carry over to this one.
+        m_pending_change = m_has_pending ? merge(m_pending_change, m_edits) : m_edits;
+        m_edits = {};
+        m_pending = std::move(text);
+        m_has_pending = true;
+        m_cancel = true;
+        generation = ++m_generation;
+    }
+    m_wake.notify_one();
+    return generation;
+}
+
+void BackgroundChecker::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_has_pending)
+    {
+        m_edits = merge(m_pending_change, m_edits);
+    }
+    m_pending.clear();
+    m_has_pending = false;
+    m_cancel = true;
+}
+
+// The change from one text to a third, given the change from it to a second and from that to the third.
+BackgroundChecker::Change BackgroundChecker::merge(const Change &first, const Change &second)
+{
+    if (!first.valid || !second.valid)
+    {
+        return first.valid ? first : second;
+    }
+    const TextChange merged = merge_changes(
+        {first.position, first.removed, first.inserted}, {second.position, second.removed, second.inserted});
+    return {merged.position, merged.removed, merged.inserted, true};
+}
+
+void BackgroundChecker::work()
+{
+    for (;;)
+    {
+        std::string text;
+        Change change;
+        unsigned generation;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stop || m_has_pending; });
+            if (m_stop)
+            {
+                return;
+            }
+            text = std::move(m_pending);
+            change = m_pending_change;
+            m_pending_change = {};
+            m_has_pending = false;
+            m_cancel = false;
+            generation = m_generation;
+        }
+
+        reparse(text, change);
+        if (check_entries(text))
+        {
+            ++m_completed;
+            m_publish(generation, problems());
+        }
+    }
+}
+
+// Brings the entries up to date with text, marking those that were reparsed to be checked.
+void BackgroundChecker::reparse(const std::string &text, const Change &change)
+{
+    if (!m_parsed || !change.valid)
+    {
+        m_file.parse(text);
+        m_checks.assign(m_file.entries().size(), {});
+        m_parsed = true;
+        return;
+    }
+    const FormulaFile::Range range = m_file.update(text, change.position, change.removed, change.inserted);
+    const auto first = m_checks.begin() + static_cast<std::ptrdiff_t>(range.first);
+    m_checks.insert(m_checks.erase(first, first + static_cast<std::ptrdiff_t>(range.replaced)), range.count,
+        EntryCheck{});
+}
+
+// Checks the entries not yet checked, giving up when cancelled.  Those left are checked the next time.
+bool BackgroundChecker::check_entries(const std::string &text)
+{
+    const std::vector<Entry> &entries = m_file.entries();
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        EntryCheck &check = m_checks[i];
+        if (check.checked)
+        {
+            continue;
+        }
+        if (m_cancel)
+        {
+            return false;
+        }
+        check.problems.clear();
+        check_entry(entries[i], text, 0, check.problems);
+        check.checked = true;
+        ++m_checked_entries;
+    }
+    return !m_cancel;
+}
+
+std::vector<Problem> BackgroundChecker::problems() const
+{
+    std::vector<Problem> result;
+    const std::vector<Entry> &entries = m_file.entries();
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        for (const Problem &problem : m_checks[i].problems)
+        {
+            result.push_back({entries[i].begin + problem.begin, entries[i].begin + problem.end, problem.message});
+        }
+    }
+    return result;
+}
+
+} // namespace formula
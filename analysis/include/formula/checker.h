@@ -0,0 +1,113 @@
+#pragma once
+
+#include <formula/parser.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace formula
+{
+
+struct Problem
+{
+    std::size_t begin{}; // the document range the problem is about
+    std::size_t end{};
+    std::string message;
+};
+
+// Parses every entry of a formula file and compiles those that parse cleanly, so
+// that problems only the compiler finds, such as unknown functions, are reported
+// too.  Gives up and returns false as soon as cancel is set; problems then holds
+// those of the entries checked so far.
+bool check_formulas(std::string_view text, std::vector<Problem> &problems, const std::atomic<bool> &cancel);
+
+// Checks snapshots of a document on a thread of its own.
+//
+// Submitting a snapshot cancels the check in progress, which stops at the next
+// entry boundary, and snapshots submitted while a check is running replace one
+// another, so only the latest is checked.  Results are published from the worker
+// thread along with the generation that submit returned for their snapshot.
+//
+// The worker keeps the entries of the last snapshot it took in a FormulaFile.  The
+// edits reported between snapshots are merged into one changed range, so only the
+// entries it touches are reparsed and compiled again; the problems of the others are
+// kept.  A snapshot submitted with no edits reported since the last one is checked
+// afresh.
+class BackgroundChecker
+{
+public:
+    using Publish = std::function<void(unsigned generation, std::vector<Problem> problems)>;
+
+    explicit BackgroundChecker(Publish publish);
+    BackgroundChecker(const BackgroundChecker &) = delete;
+    BackgroundChecker &operator=(const BackgroundChecker &) = delete;
+    ~BackgroundChecker();
+
+    // removed bytes at position were replaced by inserted bytes since the last snapshot.
+    void edited(std::size_t position, std::size_t removed, std::size_t inserted);
+
+    unsigned submit(std::string text);
+
+    // Abandons the check in progress and any snapshot waiting for one.
+    void cancel();
+
+    // The number of checks that ran to completion and were published.
+    unsigned completed() const
+    {
+        return m_completed;
+    }
+    // The number of entries compiled, counting each time one is checked again.
+    std::size_t checked_entries() const
+    {
+        return m_checked_entries;
+    }
+
+private:
+    // The bytes [position, position + removed) of one text became inserted bytes in the next.
+    struct Change
+    {
+        std::size_t position{};
+        std::size_t removed{};
+        std::size_t inserted{};
+        bool valid{};
+    };
+
+    struct EntryCheck
+    {
+        bool checked{};
+        std::vector<Problem> problems; // from the start of the entry
+    };
+
+    static Change merge(const Change &first, const Change &second);
+    void work();
+    void reparse(const std::string &text, const Change &change);
+    bool check_entries(const std::string &text);
+    std::vector<Problem> problems() const;
+
+    Publish m_publish;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::string m_pending;
+    bool m_has_pending{};
+    Change m_pending_change; // from the text the worker last took to m_pending
+    Change m_edits;          // since the last snapshot submitted
+    bool m_stop{};
+    unsigned m_generation{};
+    std::atomic<bool> m_cancel{};
+    std::atomic<unsigned> m_completed{};
+    std::atomic<std::size_t> m_checked_entries{};
+    // Used by the worker alone.
+    FormulaFile m_file;
+    bool m_parsed{};
+    std::vector<EntryCheck> m_checks; // one for each entry of m_file
+    std::thread m_thread;
+};
+
+} // namespace formula
@@ -0,0 +1,37 @@
+#!/bin/bash
+# Render every formula in a directory and report the slow ones.
+set -euo pipefail
+
+limit=${1:-10}
+out_dir="${OUT_DIR:-./renders}"
+mkdir -p "$out_dir"
+
+declare -A seconds
+for file in formulas/*.frm; do
+    name=$(basename "$file" .frm)
+    start=$(date +%s.%N)
+    if ! ./formula-export --format html "$file" > "$out_dir/$name.html" 2>/dev/null; then
+        echo "failed: $name" >&2
+        continue
+    fi
+    end=$(date +%s.%N)
+    seconds[$name]=$(echo "$end - $start" | bc)
+done
+
+count=0
+for name in "${!seconds[@]}"; do
+    printf '%s %s\n' "${seconds[$name]}" "$name"
+done | sort -rn | while read -r time name; do
+    (( count++ )) || true
+    if [[ $count -gt $limit ]]; then
+        break
+    fi
+    case $name in
+        test_*) echo "  $name: ${time}s (test)";;
+        *)      echo "  $name: ${time}s";;
+    esac
+done
+
+cat <<END
+Rendered ${#seconds[@]} formulas into $out_dir
+END
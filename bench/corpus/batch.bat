@@ -0,0 +1,35 @@
+@echo off
+rem Builds the example in a fresh directory and runs the tests.
+setlocal enabledelayedexpansion
+
+set BUILD_DIR=%~dp0build
+set CONFIG=RelWithDebInfo
+if not "%1"=="" set CONFIG=%1
+
+if exist "%BUILD_DIR%" (
+    echo Removing %BUILD_DIR%
+    rmdir /s /q "%BUILD_DIR%"
+)
+
+cmake -S "%~dp0." -B "%BUILD_DIR%" -G "Visual Studio 17 2022" -A x64
+if errorlevel 1 goto :failed
+
+cmake --build "%BUILD_DIR%" --config %CONFIG% --parallel
+if errorlevel 1 goto :failed
+
+pushd "%BUILD_DIR%"
+ctest -C %CONFIG% --output-on-failure
+set RESULT=!errorlevel!
+popd
+
+for %%f in ("%BUILD_DIR%\%CONFIG%\*.exe") do (
+    echo Built %%~nxf
+)
+
+if !RESULT! neq 0 goto :failed
+echo Done.
+exit /b 0
+
+:failed
+echo Build failed with error %errorlevel%. 1>&2
+exit /b 1
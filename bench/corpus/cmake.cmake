@@ -0,0 +1,34 @@
+cmake_minimum_required(VERSION 3.22)
+
+# Everything is built from one project so the lexer plug-in can be copied next to each tool.
+project(scintilla-example CXX)
+
+include(cmake/cxx_standard_17.cmake)
+include(cmake/target_folder.cmake)
+
+option(BUILD_STATIC_LEXER "Link the lexer into the editor instead of loading the plug-in" OFF)
+set(FORMULA_SOURCES
+    lexer/lexer.cpp
+    lexer/runs.cpp
+    lexer/run_context.cpp
+)
+
+add_library(formula-lexer-static STATIC ${FORMULA_SOURCES})
+target_include_directories(formula-lexer-static PUBLIC lexer/include)
+
+if(BUILD_STATIC_LEXER)
+    message(STATUS "Linking the lexer statically")
+    target_compile_definitions(formula-lexer-static PUBLIC FORMULA_LEXER_STATIC)
+elseif(WIN32)
+    set(PLUGIN_SUFFIX ".dll")
+else()
+    set(PLUGIN_SUFFIX ".so")
+endif()
+
+foreach(tool scintilla-example formula-export bench-replay)
+    if(TARGET ${tool})
+        target_link_libraries(${tool} PRIVATE formula-lexer-static)
+    endif()
+endforeach()
+
+install(TARGETS formula-lexer-static DESTINATION lib)
@@ -0,0 +1,70 @@
+// A small document model used as a C++ sample.
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32) && !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#define LINE_CHUNK 256
+
+namespace sample
+{
+
+/* Lines are stored as offsets into one buffer so that
+   inserting text only moves the offsets after the edit. */
+class LineIndex
+{
+public:
+    explicit LineIndex(const std::string &text)
+    {
+        m_starts.push_back(0);
+        for (std::size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == '\n')
+            {
+                m_starts.push_back(i + 1);
+            }
+        }
+    }
+
+    std::size_t line_from_position(std::size_t pos) const
+    {
+        const auto it = std::upper_bound(m_starts.begin(), m_starts.end(), pos);
+        return static_cast<std::size_t>(it - m_starts.begin()) - 1;
+    }
+
+    void inserted(std::size_t pos, const char *text, std::size_t length)
+    {
+        const std::size_t line = line_from_position(pos);
+        for (std::size_t i = line + 1; i < m_starts.size(); ++i)
+        {
+            m_starts[i] += length;
+        }
+        std::vector<std::size_t> added;
+        added.reserve(LINE_CHUNK);
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            if (text[i] == '\n' || text[i] == '\r')
+            {
+                added.push_back(pos + i + 1);
+            }
+        }
+        m_starts.insert(m_starts.begin() + static_cast<std::ptrdiff_t>(line + 1), added.begin(), added.end());
+    }
+
+private:
+    std::vector<std::size_t> m_starts;
+};
+
+template <typename T>
+T clamp_to(T value, T low, T high)
+{
+    return value < low ? low : (high < value ? high : value);
+}
+
+const char *const GREETING = "hello, \"world\"\n";
+const char SEPARATOR = ';';
+const double RATIO = 1.5e-3 + 0x1F;
+
+} // namespace sample
@@ -0,0 +1,45 @@
+-- Colour scheme loader for an editor configuration.
+local M = {}
+
+local defaults = {
+  comment = "forest green",
+  keyword = "blue",
+  ["function"] = "red",
+  identifier = 'purple',
+}
+
+--[[ Styles are read from a table of name = colour pairs;
+     unknown names are reported and ignored. ]]
+function M.load(path)
+  local scheme = {}
+  for name, colour in pairs(defaults) do
+    scheme[name] = colour
+  end
+  local chunk, err = loadfile(path)
+  if not chunk then
+    return nil, err
+  end
+  local ok, user = pcall(chunk)
+  if ok and type(user) == "table" then
+    for name, colour in pairs(user) do
+      if defaults[name] ~= nil then
+        scheme[name] = colour
+      else
+        io.stderr:write(string.format("unknown style %q\n", name))
+      end
+    end
+  end
+  return scheme
+end
+
+function M.apply(editor, scheme)
+  local index = 1
+  while index <= #editor.styles do
+    local style = editor.styles[index]
+    editor:set_colour(style, scheme[style] or "black")
+    index = index + 1
+  end
+  return index - 1
+end
+
+return M
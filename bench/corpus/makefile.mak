@@ -0,0 +1,31 @@
+# Builds the example without CMake for quick experiments.
+CXX ?= g++
+CXXFLAGS += -std=c++17 -O2 -Wall -Wextra
+SCINTILLA := ../scintilla
+INCLUDES := -I$(SCINTILLA)/include -I$(SCINTILLA)/lexlib -Ilexer/include
+
+LEXLIB_SOURCES := $(wildcard $(SCINTILLA)/lexlib/*.cxx)
+LEXER_SOURCES := lexer/lexer.cpp lexer/runs.cpp lexer/run_context.cpp lexer/identifier_index.cpp
+OBJECTS := $(LEXLIB_SOURCES:.cxx=.o) $(LEXER_SOURCES:.cpp=.o)
+
+.PHONY: all clean
+
+all: formula-lexer.so
+
+formula-lexer.so: $(OBJECTS) lexer/plugin.o
+	$(CXX) -shared -o $@ $^
+
+%.o: %.cpp
+	$(CXX) $(CXXFLAGS) $(INCLUDES) -fPIC -c $< -o $@
+
+%.o: %.cxx
+	$(CXX) $(CXXFLAGS) $(INCLUDES) -fPIC -c $< -o $@
+
+ifeq ($(OS),Windows_NT)
+    RM := del /q
+else
+    RM := rm -f
+endif
+
+clean:
+	$(RM) $(OBJECTS) lexer/plugin.o formula-lexer.so
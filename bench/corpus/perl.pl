@@ -0,0 +1,48 @@
+#!/usr/bin/perl
+# Summarises an access log by status code and by path.
+use strict;
+use warnings;
+
+my %by_status;
+my %by_path;
+my $total = 0;
+
+while (my $line = <STDIN>) {
+    chomp $line;
+    next if $line =~ /^\s*$/;
+    my ($host, $time, $request, $status, $bytes) =
+        $line =~ m/^(\S+) \S+ \S+ \[([^\]]+)\] "([^"]*)" (\d{3}) (\d+|-)/
+        or do { warn "unparsed: $line\n"; next };
+    my (undef, $path) = split ' ', $request;
+    $path //= '/';
+    $path =~ s/\?.*$//;
+    $by_status{$status}++;
+    $by_path{$path}{count}++;
+    $by_path{$path}{bytes} += $bytes eq '-' ? 0 : $bytes;
+    $total++;
+}
+
+printf "%d requests\n", $total;
+foreach my $status (sort keys %by_status) {
+    printf "  %s %6d (%.1f%%)\n", $status, $by_status{$status}, 100 * $by_status{$status} / ($total || 1);
+}
+
+my @busiest = (sort { $by_path{$b}{count} <=> $by_path{$a}{count} } keys %by_path)[0 .. 9];
+print "\nBusiest paths:\n";
+for my $path (grep { defined } @busiest) {
+    print join("\t", $by_path{$path}{count}, $by_path{$path}{bytes}, $path), "\n";
+}
+
+sub human_size {
+    my ($bytes) = @_;
+    my @units = qw(B KB MB GB);
+    my $unit = 0;
+    while ($bytes >= 1024 && $unit < $#units) {
+        $bytes /= 1024;
+        $unit++;
+    }
+    return sprintf('%.1f %s', $bytes, $units[$unit]);
+}
+
+__END__
+Everything after __END__ is data, not code.
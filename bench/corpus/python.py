@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""Summarise replay logs written by the example editor."""
+
+import collections
+import sys
+
+
+class Session:
+    '''Counts the edits and lexer calls in one session.'''
+
+    def __init__(self, path):
+        self.path = path
+        self.counts = collections.Counter()
+        self.lexed = 0
+
+    def read(self):
+        with open(self.path, 'rb') as log:
+            header = log.readline().decode('ascii').strip()
+            if header != "formula-edit-session 1":
+                raise ValueError(f"{self.path}: not a session log")
+            for line in log:
+                kind, *fields = line.split()
+                self.counts[kind.decode()] += 1
+                if kind == b'lex':
+                    self.lexed += int(fields[1])
+        return self
+
+    @property
+    def edits(self):
+        return self.counts['insert'] + self.counts['delete']
+
+
+def ratio(session):
+    # Bytes relexed per edit; zero when nothing was edited.
+    return session.lexed / session.edits if session.edits else 0.0
+
+
+def main(paths):
+    sessions = [Session(path).read() for path in paths]
+    for session in sorted(sessions, key=ratio, reverse=True):
+        print("%-40s %8d edits %10.1f bytes/edit" % (session.path, session.edits, ratio(session)))
+    return 0 if sessions else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
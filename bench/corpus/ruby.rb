@@ -0,0 +1,50 @@
+# A tiny task runner: tasks declare prerequisites and run once each.
+require 'set'
+
+module Tasks
+  class CycleError < StandardError; end
+
+  class Task
+    attr_reader :name, :prerequisites
+
+    def initialize(name, prerequisites = [], &action)
+      @name = name.to_sym
+      @prerequisites = prerequisites.map(&:to_sym)
+      @action = action
+    end
+
+    def run(context)
+      @action&.call(context)
+    end
+  end
+
+  class Runner
+    def initialize
+      @tasks = {}
+    end
+
+    def task(name, depends: [], &block)
+      @tasks[name.to_sym] = Task.new(name, Array(depends), &block)
+    end
+
+    def run(name, context = {}, done = Set.new, visiting = Set.new)
+      name = name.to_sym
+      return if done.include?(name)
+      raise CycleError, "cycle through #{name}" if visiting.include?(name)
+
+      task = @tasks.fetch(name) { raise ArgumentError, "no task named '#{name}'" }
+      visiting << name
+      task.prerequisites.each { |prerequisite| run(prerequisite, context, done, visiting) }
+      visiting.delete(name)
+      puts "==> #{name}"
+      task.run(context)
+      done << name
+    end
+  end
+end
+
+runner = Tasks::Runner.new
+runner.task(:configure) { |c| c[:build_dir] = 'build' }
+runner.task(:compile, depends: :configure) { |c| puts "compiling into #{c[:build_dir]}" }
+runner.task(:test, depends: %i[compile]) { puts 'running tests' }
+runner.run(:test) if __FILE__ == $PROGRAM_NAME
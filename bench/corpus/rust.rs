@@ -0,0 +1,60 @@
+//! A fixed-capacity ring buffer of log lines.
+use std::collections::VecDeque;
+use std::fmt;
+
+/// Keeps the most recent `capacity` lines, dropping the oldest.
+#[derive(Debug, Clone)]
+pub struct RingLog {
+    lines: VecDeque<String>,
+    capacity: usize,
+    dropped: u64,
+}
+
+impl RingLog {
+    pub fn new(capacity: usize) -> Self {
+        assert!(capacity > 0, "capacity must be positive");
+        RingLog { lines: VecDeque::with_capacity(capacity), capacity, dropped: 0 }
+    }
+
+    pub fn push(&mut self, line: impl Into<String>) {
+        if self.lines.len() == self.capacity {
+            self.lines.pop_front();
+            self.dropped += 1;
+        }
+        self.lines.push_back(line.into());
+    }
+
+    /// Lines containing `needle`, newest first.
+    pub fn search<'a>(&'a self, needle: &'a str) -> impl Iterator<Item = &'a str> + 'a {
+        self.lines.iter().rev().filter(move |line| line.contains(needle)).map(String::as_str)
+    }
+}
+
+impl fmt::Display for RingLog {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        if self.dropped > 0 {
+            writeln!(f, "... {} earlier lines dropped", self.dropped)?;
+        }
+        for line in &self.lines {
+            writeln!(f, "{}", line)?;
+        }
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn keeps_the_newest_lines() {
+        let mut log = RingLog::new(2);
+        for i in 0..5 {
+            log.push(format!("line {}", i));
+        }
+        let found: Vec<_> = log.search("line").collect();
+        assert_eq!(found, vec!["line 4", "line 3"]);
+        let _raw = r#"a "raw" string"#;
+        let _byte = b'x';
+    }
+}
@@ -0,0 +1,34 @@
+-- Formula usage statistics.
+CREATE TABLE formula (
+    id INTEGER PRIMARY KEY,
+    name VARCHAR(64) NOT NULL UNIQUE,
+    source TEXT NOT NULL,
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+);
+
+CREATE TABLE render (
+    id INTEGER PRIMARY KEY,
+    formula_id INTEGER NOT NULL REFERENCES formula (id),
+    width INTEGER NOT NULL,
+    height INTEGER NOT NULL,
+    seconds REAL
+);
+
+/* The slowest formulas by average render time per megapixel. */
+SELECT f.name,
+       COUNT(r.id) AS renders,
+       AVG(r.seconds * 1000000.0 / (r.width * r.height)) AS seconds_per_megapixel
+FROM formula f
+JOIN render r ON r.formula_id = f.id
+WHERE r.seconds IS NOT NULL
+  AND f.name NOT LIKE 'test%'
+GROUP BY f.name
+HAVING COUNT(r.id) > 10
+ORDER BY seconds_per_megapixel DESC
+LIMIT 20;
+
+UPDATE formula
+SET source = REPLACE(source, 'cosxx', 'cos')
+WHERE id IN (SELECT formula_id FROM render WHERE seconds > 60);
+
+DELETE FROM render WHERE formula_id NOT IN (SELECT id FROM formula);
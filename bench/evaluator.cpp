@@ -0,0 +1,346 @@
+#include <formula/evaluator.h>
+#include <formula/parser.h>
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using Complex = std::complex<double>;
+
+// Each measurement keeps the fastest of this many runs.
+constexpr int RUNS{3};
+
+// The parameters every formula is run with: a Julia constant for p1 and a bailout for p2.
+constexpr Complex P1{-0.745, 0.113};
+constexpr Complex P2{4.0, 0.0};
+
+struct Options
+{
+    std::string file{FORMULA_CORPUS_DIR "/id-formula.frm"};
+    int size{256};
+    int max_iterations{256};
+    std::vector<std::string> formulas;
+};
+
+struct Result
+{
+    std::string formula;
+    double scalar_rate{};
+    double batch_rate{};
+    std::size_t mismatches{};
+};
+
+// The straightforward way to run a formula: walk its tree once per pixel and
+// iteration, one complex value at a time.  Variables are resolved to slots up
+// front so that the comparison is with a reasonable interpreter, not a naive one.
+class TreeInterpreter
+{
+public:
+    TreeInterpreter(const formula::Entry &entry, std::string_view text);
+
+    int evaluate(Complex pixel, int max_iterations);
+
+private:
+    void block(formula::NodeId id);
+    void statement(formula::NodeId id);
+    Complex value(formula::NodeId id);
+
+    const formula::Entry &m_entry;
+    std::vector<int> m_slots;
+    std::vector<formula::Opcode> m_calls;
+    std::vector<Complex> m_values;
+};
+
+TreeInterpreter::TreeInterpreter(const formula::Entry &entry, std::string_view text) :
+    m_entry(entry),
+    m_slots(entry.nodes.size(), -1),
+    m_calls(entry.nodes.size())
+{
+    std::vector<std::string> names(std::begin(formula::PREDEFINED_VARIABLES), std::end(formula::PREDEFINED_VARIABLES));
+    const formula::CompileOptions options;
+    for (formula::NodeId id = 0; id < entry.nodes.size(); ++id)
+    {
+        std::string name{entry.text(text, id)};
+        std::transform(name.begin(), name.end(), name.begin(),
+            [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+        if (entry.node(id).kind == formula::NodeKind::IDENTIFIER)
+        {
+            const auto it = std::find(names.begin(), names.end(), name);
+            m_slots[id] = static_cast<int>(it - names.begin());
+            if (it == names.end())
+            {
+                names.push_back(name);
+            }
+        }
+        else if (entry.node(id).kind == formula::NodeKind::CALL)
+        {
+            name.erase(name.find('('));
+            name.erase(name.find_last_not_of(" \t") + 1);
+            const bool bound = name.size() == 3 && name.compare(0, 2, "fn") == 0;
+            m_calls[id] = formula::function_opcode(bound ? options.functions[name[2] - '1'] : name);
+        }
+    }
+    m_values.resize(names.size());
+}
+
+int TreeInterpreter::evaluate(Complex pixel, int max_iterations)
+{
+    std::fill(m_values.begin(), m_values.end(), Complex{});
+    m_values[formula::PIXEL_REGISTER] = pixel;
+    m_values[formula::PARAMETER_REGISTER] = P1;
+    m_values[formula::PARAMETER_REGISTER + 1] = P2;
+    m_values[formula::PI_REGISTER] = 3.14159265358979323846;
+    m_values[formula::E_REGISTER] = 2.71828182845904523536;
+    m_values[formula::MAXIT_REGISTER] = max_iterations;
+    block(m_entry.init);
+    for (int iteration = 1; iteration <= max_iterations; ++iteration)
+    {
+        block(m_entry.iteration);
+        if (value(m_entry.bailout).real() == 0.0)
+        {
+            return iteration;
+        }
+    }
+    return max_iterations;
+}
+
+void TreeInterpreter::block(formula::NodeId id)
+{
+    if (id == formula::NO_NODE)
+    {
+        return;
+    }
+    for (formula::NodeId child = m_entry.node(id).first_child; child != formula::NO_NODE;
+         child = m_entry.node(child).next_sibling)
+    {
+        statement(child);
+    }
+}
+
+void TreeInterpreter::statement(formula::NodeId id)
+{
+    if (m_entry.node(id).kind != formula::NodeKind::IF)
+    {
+        value(id);
+        return;
+    }
+    const formula::NodeId condition = m_entry.node(id).first_child;
+    const formula::NodeId then_block = m_entry.node(condition).next_sibling;
+    if (value(condition).real() != 0.0)
+    {
+        block(then_block);
+        return;
+    }
+    for (formula::NodeId clause = m_entry.node(then_block).next_sibling; clause != formula::NO_NODE;
+         clause = m_entry.node(clause).next_sibling)
+    {
+        const formula::NodeId body = m_entry.node(clause).first_child;
+        if (m_entry.node(clause).kind == formula::NodeKind::ELSE)
+        {
+            block(body);
+            return;
+        }
+        if (value(body).real() != 0.0)
+        {
+            block(m_entry.node(body).next_sibling);
+            return;
+        }
+    }
+}
+
+Complex TreeInterpreter::value(formula::NodeId id)
+{
+    const formula::Node &node = m_entry.node(id);
+    switch (node.kind)
+    {
+    case formula::NodeKind::NUMBER:
+        return m_entry.numbers[node.value];
+    case formula::NodeKind::IDENTIFIER:
+        return m_values[m_slots[id]];
+    case formula::NodeKind::ASSIGN:
+        return m_values[m_slots[node.first_child]] = value(m_entry.node(node.first_child).next_sibling);
+    case formula::NodeKind::CALL:
+        return formula::apply(m_calls[id], value(node.first_child));
+    case formula::NodeKind::MODULUS:
+        return formula::apply(formula::Opcode::MODULUS, value(node.first_child));
+    case formula::NodeKind::UNARY:
+        return -value(node.first_child);
+    case formula::NodeKind::COMPLEX:
+        return {value(node.first_child).real(), value(m_entry.node(node.first_child).next_sibling).real()};
+    case formula::NodeKind::BINARY:
+    {
+        const Complex lhs = value(node.first_child);
+        return formula::apply(
+            formula::operator_opcode(node.op), lhs, value(m_entry.node(node.first_child).next_sibling));
+    }
+    default:
+        throw std::runtime_error("Unexpected statement");
+    }
+}
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+template <typename Function>
+double best_seconds(Function function)
+{
+    double best{};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        const Clock::time_point start = Clock::now();
+        function();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        best = run == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+Result measure(const formula::Entry &entry, std::string_view text, const Options &options)
+{
+    // A square of the plane around the origin, one pixel per point.
+    const std::size_t count = static_cast<std::size_t>(options.size) * options.size;
+    std::vector<double> re(count);
+    std::vector<double> im(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        re[i] = -2.0 + 4.0 * static_cast<double>(i % options.size) / options.size;
+        im[i] = -2.0 + 4.0 * static_cast<double>(i / options.size) / options.size;
+    }
+
+    std::vector<int> scalar(count);
+    TreeInterpreter interpreter(entry, text);
+    const double scalar_seconds = best_seconds(
+        [&]
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                scalar[i] = interpreter.evaluate({re[i], im[i]}, options.max_iterations);
+            }
+        });
+
+    std::vector<int> batch(count);
+    formula::BatchEvaluator evaluator(formula::compile(entry, text));
+    evaluator.set_parameter(1, P1);
+    evaluator.set_parameter(2, P2);
+    const double batch_seconds = best_seconds(
+        [&] { evaluator.evaluate(re.data(), im.data(), count, options.max_iterations, batch.data()); });
+
+    Result result{entry.name};
+    result.scalar_rate = static_cast<double>(count) / scalar_seconds / 1e6;
+    result.batch_rate = static_cast<double>(count) / batch_seconds / 1e6;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        result.mismatches += scalar[i] != batch[i] ? 1 : 0;
+    }
+    return result;
+}
+
+std::vector<Result> run(const Options &options)
+{
+    const std::string text = read_file(options.file);
+    std::vector<Result> results;
+    for (std::size_t position = formula::next_entry(text, 0); position < text.size();)
+    {
+        const formula::Entry entry = formula::parse_entry(text, position);
+        position = formula::next_entry(text, entry.end);
+        if (!options.formulas.empty()
+            && std::find(options.formulas.begin(), options.formulas.end(), entry.name) == options.formulas.end())
+        {
+            continue;
+        }
+        std::cerr << "Measuring " << entry.name << "...\n";
+        results.push_back(measure(entry, text, options));
+    }
+    return results;
+}
+
+void report(std::ostream &out, const std::vector<Result> &results, const Options &options)
+{
+    out << "Pixels per second over " << options.size << 'x' << options.size << " pixels, at most "
+        << options.max_iterations << " iterations, best of " << RUNS << " runs; " << formula::LANES
+        << " lanes per batch\n\n";
+    out << std::left << std::setw(16) << "Formula" << std::right << std::setw(16) << "Scalar Mpix/s"
+        << std::setw(16) << "Batch Mpix/s" << std::setw(10) << "Speedup" << std::setw(12) << "Mismatches" << '\n';
+    out << std::fixed << std::setprecision(2);
+    for (const Result &result : results)
+    {
+        out << std::left << std::setw(16) << result.formula << std::right << std::setw(16) << result.scalar_rate
+            << std::setw(16) << result.batch_rate << std::setw(9) << result.batch_rate / result.scalar_rate << 'x'
+            << std::setw(12) << result.mismatches << '\n';
+    }
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-evaluator [--file <frm>] [--size <pixels>] [--iterations <count>] [formula...]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--file" || arg == "--size" || arg == "--iterations") && i + 1 < argc)
+        {
+            if (arg == "--file")
+            {
+                options.file = argv[++i];
+            }
+            else if (arg == "--size")
+            {
+                options.size = std::atoi(argv[++i]);
+            }
+            else
+            {
+                options.max_iterations = std::atoi(argv[++i]);
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            options.formulas.push_back(arg);
+        }
+    }
+    if (options.size <= 0 || options.max_iterations <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        report(std::cout, run(options), options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "bench-evaluator: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,327 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+#include <LexerModule.h>
+#include <SciLexer.h>
+
+#include <Catalogue.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Each measurement keeps the fastest of this many runs over a fresh document.
+constexpr int RUNS{3};
+
+// Lexers slower than this fraction of the median are reported as slow.
+constexpr double SLOW_FRACTION{0.1};
+
+// The language whose sample stands in for languages without one, with --fallback.
+constexpr const char *FALLBACK_CORPUS{"cpp"};
+
+struct LexerDeleter
+{
+    void operator()(ILexer *lexer) const
+    {
+        lexer->Release();
+    }
+};
+
+using LexerPtr = std::unique_ptr<ILexer, LexerDeleter>;
+
+// A language's sample, repeated to the benchmark size, and the word lists for its lexer.
+struct Corpus
+{
+    std::string name;
+    std::string text;
+    std::vector<std::string> word_lists;
+};
+
+struct Result
+{
+    std::string language;
+    std::string corpus;
+    double lex_rate{};
+    double fold_rate{};
+    // Timed over another language's sample, so not a measure of the lexer on its own language.
+    bool fallback{};
+};
+
+struct Results
+{
+    std::vector<Result> measured;
+    std::vector<std::string> skipped; // languages without a sample
+};
+
+struct Options
+{
+    std::filesystem::path corpus_dir{FORMULA_CORPUS_DIR};
+    std::size_t size{4 * 1000 * 1000};
+    bool fallback{};
+    std::vector<std::string> languages;
+};
+
+std::string read_file(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Couldn't open " + path.string());
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// Reads <language>.<ext> from the corpus directory, and <language>.keywords if present
+// with one word list per line; returns false when the language has no sample.
+bool load_corpus(const Options &options, const std::string &language, Corpus &corpus)
+{
+    std::filesystem::path sample;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(options.corpus_dir))
+    {
+        if (entry.path().stem() == language && entry.path().extension() != ".keywords")
+        {
+            sample = entry.path();
+            break;
+        }
+    }
+    if (sample.empty())
+    {
+        return false;
+    }
+
+    std::string text = read_file(sample);
+    if (text.empty() || text.back() != '\n')
+    {
+        text += '\n';
+    }
+    corpus.name = language;
+    corpus.text.clear();
+    corpus.text.reserve(options.size + text.size());
+    while (corpus.text.size() < options.size)
+    {
+        corpus.text += text;
+    }
+
+    corpus.word_lists.clear();
+    const std::filesystem::path keywords = options.corpus_dir / (language + ".keywords");
+    if (std::filesystem::exists(keywords))
+    {
+        std::istringstream lines{read_file(keywords)};
+        for (std::string line; std::getline(lines, line);)
+        {
+            corpus.word_lists.push_back(line);
+        }
+    }
+    return true;
+}
+
+double megabytes_per_second(std::size_t bytes, double seconds)
+{
+    return seconds > 0.0 ? static_cast<double>(bytes) / 1e6 / seconds : 0.0;
+}
+
+Result measure(ILexer *lexer, const std::string &language, const Corpus &corpus)
+{
+    lexer->PropertySet("fold", "1");
+    for (std::size_t i = 0; i < corpus.word_lists.size(); ++i)
+    {
+        lexer->WordListSet(static_cast<int>(i), corpus.word_lists[i].c_str());
+    }
+
+    double lex_seconds{};
+    double fold_seconds{};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        formula::MemoryDocument doc{corpus.text};
+        const Sci_Position length = doc.Length();
+        const Clock::time_point begin = Clock::now();
+        lexer->Lex(0, length, 0, &doc);
+        const Clock::time_point lexed = Clock::now();
+        lexer->Fold(0, length, 0, &doc);
+        const Clock::time_point folded = Clock::now();
+
+        const double lex = std::chrono::duration<double>(lexed - begin).count();
+        const double fold = std::chrono::duration<double>(folded - lexed).count();
+        lex_seconds = run == 0 ? lex : std::min(lex_seconds, lex);
+        fold_seconds = run == 0 ? fold : std::min(fold_seconds, fold);
+    }
+    return {language, corpus.name, megabytes_per_second(corpus.text.size(), lex_seconds),
+        megabytes_per_second(corpus.text.size(), fold_seconds), corpus.name != language};
+}
+
+bool selected(const Options &options, const std::string &language)
+{
+    return options.languages.empty() ||
+        std::find(options.languages.begin(), options.languages.end(), language) != options.languages.end();
+}
+
+// Runs the formula lexer and every lexer module in the catalogue over its own corpus.  Languages
+// without a sample are skipped, or with --fallback run over the fallback corpus instead.
+Results run(const Options &options)
+{
+    Corpus fallback;
+    if (options.fallback && !load_corpus(options, FALLBACK_CORPUS, fallback))
+    {
+        throw std::runtime_error("No " + std::string{FALLBACK_CORPUS} + " sample in " + options.corpus_dir.string());
+    }
+
+    Results results;
+    Corpus corpus;
+    const auto run_lexer = [&](ILexer *lexer, const std::string &language)
+    {
+        const bool found = load_corpus(options, language, corpus);
+        if (!found && !options.fallback)
+        {
+            results.skipped.push_back(language);
+            return;
+        }
+        std::cerr << "Measuring " << language << "...\n";
+        results.measured.push_back(measure(lexer, language, found ? corpus : fallback));
+    };
+
+    if (selected(options, formula::LEXER_NAME))
+    {
+        LexerPtr lexer{formula::create_lexer()};
+        run_lexer(lexer.get(), formula::LEXER_NAME);
+    }
+    for (int language = SCLEX_NULL; language < SCLEX_AUTOMATIC; ++language)
+    {
+        const LexerModule *module = Catalogue::Find(language);
+        if (module == nullptr || module->languageName == nullptr || !selected(options, module->languageName))
+        {
+            continue;
+        }
+        LexerPtr lexer{module->Create()};
+        run_lexer(lexer.get(), module->languageName);
+    }
+    return results;
+}
+
+double median(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return 0.0;
+    }
+    const auto middle = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+void report(std::ostream &out, Results all, std::size_t size)
+{
+    std::vector<Result> &results = all.measured;
+    std::sort(results.begin(), results.end(),
+        [](const Result &lhs, const Result &rhs) { return lhs.lex_rate > rhs.lex_rate; });
+    // Fallback rows say nothing about a lexer on its own language, so they don't set what counts as slow.
+    std::vector<double> lex_rates;
+    std::vector<double> fold_rates;
+    for (const Result &result : results)
+    {
+        if (!result.fallback)
+        {
+            lex_rates.push_back(result.lex_rate);
+            fold_rates.push_back(result.fold_rate);
+        }
+    }
+    const double slow_lex = median(lex_rates) * SLOW_FRACTION;
+    const double slow_fold = median(fold_rates) * SLOW_FRACTION;
+
+    out << "Throughput over " << static_cast<double>(size) / 1e6 << " MB per language, best of " << RUNS
+        << " runs\n\n";
+    out << std::left << std::setw(20) << "Language" << std::setw(14) << "Corpus" << std::right << std::setw(14)
+        << "Lex MB/s" << std::setw(14) << "Fold MB/s" << '\n';
+    out << std::fixed << std::setprecision(1);
+    for (const Result &result : results)
+    {
+        out << std::left << std::setw(20) << result.language << std::setw(14)
+            << (result.fallback ? result.corpus + '*' : result.corpus) << std::right << std::setw(14)
+            << result.lex_rate << std::setw(14) << result.fold_rate;
+        if (!result.fallback && (result.lex_rate < slow_lex || result.fold_rate < slow_fold))
+        {
+            out << "  slow";
+        }
+        out << '\n';
+    }
+    if (std::any_of(results.begin(), results.end(), [](const Result &result) { return result.fallback; }))
+    {
+        out << "\n* timed over the " << FALLBACK_CORPUS << " sample, as the language has none\n";
+    }
+    if (!all.skipped.empty())
+    {
+        out << '\n' << all.skipped.size() << " languages without a sample were skipped; --fallback times them over the "
+            << FALLBACK_CORPUS << " sample\n";
+    }
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-lexers [--corpus <dir>] [--size <megabytes>] [--fallback] [language...]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--corpus" || arg == "--size") && i + 1 < argc)
+        {
+            if (arg == "--corpus")
+            {
+                options.corpus_dir = argv[++i];
+            }
+            else
+            {
+                options.size = static_cast<std::size_t>(std::atof(argv[++i]) * 1e6);
+            }
+        }
+        else if (arg == "--fallback")
+        {
+            options.fallback = true;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            options.languages.push_back(arg);
+        }
+    }
+    if (options.size == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        report(std::cout, run(options), options.size);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "bench-lexers: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
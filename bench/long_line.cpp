@@ -0,0 +1,198 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Restyling from the start of the line, as Scintilla does, costs the line up to the edit, so only a few are timed.
+constexpr std::size_t LINE_START_EDITS{3};
+
+struct Options
+{
+    std::size_t size{100'000'000};
+    Sci_Position chunk{64 * 1024};
+    std::size_t edits{200};
+};
+
+struct LexerDeleter
+{
+    void operator()(ILexer *lexer) const
+    {
+        lexer->Release();
+    }
+};
+
+// A single line of formula text with no newline in it, as a generated or minified file might be.
+std::string long_line(std::size_t size)
+{
+    std::mt19937 random{1};
+    std::string text;
+    text.reserve(size + 64);
+    text += "Long (XAXIS) { ";
+    while (text.size() < size)
+    {
+        const unsigned int pick = random() % 8;
+        text += "z = sin(alpha" + std::to_string(random() % 1000) + ") + ";
+        text += pick == 0 ? "if (|z| > 4) " : pick == 1 ? "endif " : pick == 2 ? "(beta * 3.5) " : "c ";
+    }
+    text.resize(size);
+    return text;
+}
+
+double seconds_since(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+template <typename T>
+void print_distribution(std::ostream &out, const char *label, std::vector<T> values, const char *unit)
+{
+    std::sort(values.begin(), values.end());
+    out << std::left << std::setw(34) << label << std::right;
+    static const std::pair<const char *, double> points[]{{"p50", 0.5}, {"p99", 0.99}, {"max", 1.0}};
+    const char *separator = "";
+    for (const auto &[name, fraction] : points)
+    {
+        const auto rank = static_cast<std::size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+        out << separator << name << ' ' << values[rank] << unit;
+        separator = "  ";
+    }
+    out << '\n';
+}
+
+void run(std::ostream &out, const Options &options)
+{
+    std::unique_ptr<ILexer, LexerDeleter> lexer{formula::create_lexer()};
+    formula::MemoryDocument doc{long_line(options.size)};
+    out << std::fixed << std::setprecision(1);
+    out << "One line of " << doc.Length() / 1e6 << " MB, styled " << options.chunk << " bytes at a time\n";
+
+    // Styling the whole line a chunk at a time: the rate should hold steady from the first tenth to the last.
+    std::vector<double> chunk_micros;
+    std::vector<double> tenth_rates;
+    double total{};
+    double tenth_start{};
+    Sci_Position next_tenth{doc.Length() / 10};
+    while (doc.end_styled() < doc.Length())
+    {
+        const Clock::time_point begin = Clock::now();
+        doc.colourise_from_end_styled(lexer.get(), doc.end_styled() + options.chunk);
+        const double seconds = seconds_since(begin);
+        chunk_micros.push_back(seconds * 1e6);
+        total += seconds;
+        if (doc.end_styled() >= next_tenth || doc.end_styled() == doc.Length())
+        {
+            tenth_rates.push_back(static_cast<double>(doc.Length()) / 10 / 1e6 / (total - tenth_start));
+            tenth_start = total;
+            next_tenth += doc.Length() / 10;
+        }
+    }
+    out << std::left << std::setw(34) << "Initial styling:" << total * 1e3 << " ms, "
+        << static_cast<double>(doc.Length()) / 1e6 / total << " MB/s\n";
+    out << std::setw(34) << "Rate by tenth of the line:";
+    for (const double rate : tenth_rates)
+    {
+        out << ' ' << rate;
+    }
+    out << " MB/s\n";
+    print_distribution(out, "Latency per chunk:", chunk_micros, " us");
+
+    // Typing part way along the line restyles the chunk in view from the edit.  The edits work back
+    // along the line so that each one finds the text before it styled, as scrolling there would leave it.
+    std::mt19937 random{2};
+    std::vector<Sci_Position> positions;
+    for (std::size_t edit = 0; edit < LINE_START_EDITS + options.edits; ++edit)
+    {
+        positions.push_back(static_cast<Sci_Position>(random() % static_cast<unsigned int>(doc.Length())));
+    }
+    std::sort(positions.rbegin(), positions.rend());
+    std::vector<double> edit_micros;
+    std::vector<double> line_start_micros;
+    for (std::size_t edit = 0; edit < positions.size(); ++edit)
+    {
+        const Sci_Position position = positions[edit];
+        doc.insert(position, "z", 1);
+        const Clock::time_point begin = Clock::now();
+        if (edit < LINE_START_EDITS)
+        {
+            doc.colourise(lexer.get(), position + options.chunk);
+            line_start_micros.push_back(seconds_since(begin) * 1e6);
+        }
+        else
+        {
+            doc.colourise_from_end_styled(lexer.get(), position + options.chunk);
+            edit_micros.push_back(seconds_since(begin) * 1e6);
+        }
+    }
+    print_distribution(out, "Latency per edit:", edit_micros, " us");
+    print_distribution(out, "Latency per edit from line start:", line_start_micros, " us");
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-long-line [--size <megabytes>] [--chunk <kilobytes>] [--edits <count>]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--size" || arg == "--chunk" || arg == "--edits") && i + 1 < argc)
+        {
+            const double value = std::atof(argv[++i]);
+            if (arg == "--size")
+            {
+                options.size = static_cast<std::size_t>(value * 1e6);
+            }
+            else if (arg == "--chunk")
+            {
+                options.chunk = static_cast<Sci_Position>(value * 1024);
+            }
+            else
+            {
+                options.edits = static_cast<std::size_t>(value);
+            }
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (options.size == 0 || options.chunk <= 0 || options.edits == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    try
+    {
+        run(std::cout, options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "bench-long-line: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
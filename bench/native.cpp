@@ -0,0 +1,239 @@
+#include <formula/evaluator.h>
+#include <formula/native.h>
+#include <formula/parser.h>
+
+#include <wx/dynlib.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <complex>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using Complex = std::complex<double>;
+
+// Each measurement keeps the fastest of this many runs.
+constexpr int RUNS{3};
+
+// The parameters every formula is run with: a Julia constant for p1 and a bailout for p2.
+constexpr Complex P1{-0.745, 0.113};
+constexpr Complex P2{4.0, 0.0};
+
+struct Options
+{
+    std::string file{FORMULA_CORPUS_DIR "/id-formula.frm"};
+    wxString plugins;
+    int size{256};
+    int max_iterations{256};
+    std::vector<std::string> formulas;
+};
+
+struct Result
+{
+    std::string formula;
+    double batch_rate{};
+    double native_rate{};
+    std::size_t mismatches{};
+};
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+template <typename Function>
+double best_seconds(Function function)
+{
+    double best{};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        const Clock::time_point start = Clock::now();
+        function();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        best = run == 0 ? seconds : std::min(best, seconds);
+    }
+    return best;
+}
+
+// The plug-in add_compiled_formula built for a corpus formula is named after it.
+const formula::NativeFormula *load(wxDynamicLibrary &plugin, const std::string &name, const Options &options)
+{
+    std::string base{"formula-" + name};
+    std::transform(base.begin(), base.end(), base.begin(),
+        [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+    const wxFileName file(options.plugins, base + wxDynamicLibrary::GetDllExt(wxDL_LIBRARY));
+    if (!plugin.Load(file.GetFullPath()))
+    {
+        return nullptr;
+    }
+    bool found{};
+    void *function = plugin.GetSymbol(formula::NATIVE_ENTRY_POINT, &found);
+    if (!found)
+    {
+        return nullptr;
+    }
+    const formula::NativeFormula *native = reinterpret_cast<formula::GetNativeFormulaFn *>(function)();
+    return native != nullptr && native->abi_version == formula::NATIVE_ABI_VERSION ? native : nullptr;
+}
+
+Result measure(const formula::Entry &entry, std::string_view text, const formula::NativeFormula &native,
+    const Options &options)
+{
+    // A square of the plane around the origin, one pixel per point.
+    const std::size_t count = static_cast<std::size_t>(options.size) * options.size;
+    std::vector<double> re(count);
+    std::vector<double> im(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        re[i] = -2.0 + 4.0 * static_cast<double>(i % options.size) / options.size;
+        im[i] = -2.0 + 4.0 * static_cast<double>(i / options.size) / options.size;
+    }
+
+    // Interpret the formula with the same function bindings it was compiled with.
+    formula::CompileOptions compile_options;
+    std::copy(std::begin(native.functions), std::end(native.functions), std::begin(compile_options.functions));
+    std::vector<int> batch(count);
+    formula::BatchEvaluator evaluator(formula::compile(entry, text, compile_options));
+    evaluator.set_parameter(1, P1);
+    evaluator.set_parameter(2, P2);
+    const double batch_seconds = best_seconds(
+        [&] { evaluator.evaluate(re.data(), im.data(), count, options.max_iterations, batch.data()); });
+
+    std::vector<int> compiled(count);
+    const double parameters[10]{P1.real(), P1.imag(), P2.real(), P2.imag()};
+    const double native_seconds = best_seconds(
+        [&] { native.evaluate(re.data(), im.data(), count, options.max_iterations, parameters, compiled.data()); });
+
+    Result result{entry.name};
+    result.batch_rate = static_cast<double>(count) / batch_seconds / 1e6;
+    result.native_rate = static_cast<double>(count) / native_seconds / 1e6;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        result.mismatches += batch[i] != compiled[i] ? 1 : 0;
+    }
+    return result;
+}
+
+std::vector<Result> run(const Options &options)
+{
+    const std::string text = read_file(options.file);
+    std::vector<Result> results;
+    for (std::size_t position = formula::next_entry(text, 0); position < text.size();)
+    {
+        const formula::Entry entry = formula::parse_entry(text, position);
+        position = formula::next_entry(text, entry.end);
+        if (!options.formulas.empty()
+            && std::find(options.formulas.begin(), options.formulas.end(), entry.name) == options.formulas.end())
+        {
+            continue;
+        }
+        wxDynamicLibrary plugin;
+        const formula::NativeFormula *native = load(plugin, entry.name, options);
+        if (native == nullptr)
+        {
+            std::cerr << "No compiled plug-in for " << entry.name << ", skipped\n";
+            continue;
+        }
+        std::cerr << "Measuring " << entry.name << "...\n";
+        results.push_back(measure(entry, text, *native, options));
+    }
+    return results;
+}
+
+void report(std::ostream &out, const std::vector<Result> &results, const Options &options)
+{
+    out << "Pixels per second over " << options.size << 'x' << options.size << " pixels, at most "
+        << options.max_iterations << " iterations, best of " << RUNS << " runs\n\n";
+    out << std::left << std::setw(16) << "Formula" << std::right << std::setw(16) << "Batch Mpix/s"
+        << std::setw(16) << "Native Mpix/s" << std::setw(10) << "Speedup" << std::setw(12) << "Mismatches" << '\n';
+    out << std::fixed << std::setprecision(2);
+    for (const Result &result : results)
+    {
+        out << std::left << std::setw(16) << result.formula << std::right << std::setw(16) << result.batch_rate
+            << std::setw(16) << result.native_rate << std::setw(9) << result.native_rate / result.batch_rate << 'x'
+            << std::setw(12) << result.mismatches << '\n';
+    }
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-native [--file <frm>] [--plugins <directory>] [--size <pixels>] "
+                 "[--iterations <count>] [formula...]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    options.plugins = wxFileName(argv[0]).GetPath();
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--file" || arg == "--plugins" || arg == "--size" || arg == "--iterations") && i + 1 < argc)
+        {
+            if (arg == "--file")
+            {
+                options.file = argv[++i];
+            }
+            else if (arg == "--plugins")
+            {
+                options.plugins = argv[++i];
+            }
+            else if (arg == "--size")
+            {
+                options.size = std::atoi(argv[++i]);
+            }
+            else
+            {
+                options.max_iterations = std::atoi(argv[++i]);
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            options.formulas.push_back(arg);
+        }
+    }
+    if (options.size <= 0 || options.max_iterations <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    // Report plug-ins that fail to load as skipped rather than through wx's log.
+    wxLogNull no_log;
+    try
+    {
+        report(std::cout, run(options), options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "bench-native: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <formula/bytecode.h>
+#include <formula/parser.h>
+#include <formula/thread_pool.h>
+#include <formula/tile_renderer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Each measurement keeps the fastest of this many renders.
+constexpr int RUNS{3};
+
+struct Options
+{
+    std::string file{FORMULA_CORPUS_DIR "/id-formula.frm"};
+    int size{512};
+    int max_iterations{256};
+    std::vector<unsigned> threads;
+    std::vector<std::string> formulas;
+};
+
+struct Result
+{
+    std::string formula;
+    unsigned threads{};
+    double seconds{};
+    double tile_rate{};
+};
+
+std::string read_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Couldn't open " + path);
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// 1, 2, 4 and so on up to the number of cores, and the number of cores itself.
+std::vector<unsigned> default_threads()
+{
+    const unsigned cores = std::max(1U, std::thread::hardware_concurrency());
+    std::vector<unsigned> threads;
+    for (unsigned count = 1; count < cores; count *= 2)
+    {
+        threads.push_back(count);
+    }
+    threads.push_back(cores);
+    return threads;
+}
+
+Result measure(const std::string &name, const formula::Program &program, unsigned threads, const Options &options)
+{
+    formula::ThreadPool pool(threads);
+    formula::TileRenderer renderer(pool);
+    renderer.set_parameter(1, {-0.745, 0.113});
+    renderer.set_parameter(2, 4.0);
+    formula::Viewport viewport;
+    viewport.pixels_wide = options.size;
+    viewport.pixels_high = options.size;
+    std::vector<int> iterations;
+    const std::atomic<bool> cancel{};
+
+    Result result{name, threads};
+    std::size_t tiles{};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        const std::size_t before = renderer.tiles_rendered();
+        const Clock::time_point start = Clock::now();
+        renderer.render(program, viewport, options.max_iterations, iterations, cancel);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (run == 0 || seconds < result.seconds)
+        {
+            result.seconds = seconds;
+        }
+        tiles = renderer.tiles_rendered() - before;
+    }
+    result.tile_rate = static_cast<double>(tiles) / result.seconds;
+    return result;
+}
+
+std::vector<Result> run(const Options &options)
+{
+    const std::string text = read_file(options.file);
+    std::vector<Result> results;
+    for (std::size_t position = formula::next_entry(text, 0); position < text.size();)
+    {
+        const formula::Entry entry = formula::parse_entry(text, position);
+        position = formula::next_entry(text, entry.end);
+        if (!options.formulas.empty()
+            && std::find(options.formulas.begin(), options.formulas.end(), entry.name) == options.formulas.end())
+        {
+            continue;
+        }
+        const formula::Program program = formula::compile(entry, text);
+        for (const unsigned threads : options.threads)
+        {
+            std::cerr << "Measuring " << entry.name << " on " << threads << " threads...\n";
+            results.push_back(measure(entry.name, program, threads, options));
+        }
+    }
+    return results;
+}
+
+void report(std::ostream &out, const std::vector<Result> &results, const Options &options)
+{
+    out << "Rendering " << options.size << 'x' << options.size << " pixels in " << formula::TileRenderer::TILE_SIZE
+        << " pixel tiles, coarse to fine, at most " << options.max_iterations << " iterations, best of " << RUNS
+        << " runs\n\n";
+    out << std::left << std::setw(16) << "Formula" << std::right << std::setw(8) << "Threads" << std::setw(12) << "ms"
+        << std::setw(12) << "Tiles/s" << std::setw(10) << "Speedup" << std::setw(12) << "Efficiency" << '\n';
+    out << std::fixed;
+    const Result *base{};
+    for (const Result &result : results)
+    {
+        // Speedups are against the first thread count measured for the formula.
+        if (base == nullptr || base->formula != result.formula)
+        {
+            base = &result;
+        }
+        const double speedup = base->seconds / result.seconds;
+        const double efficiency = speedup * base->threads / result.threads;
+        out << std::left << std::setw(16) << result.formula << std::right << std::setw(8) << result.threads
+            << std::setprecision(1) << std::setw(12) << result.seconds * 1e3 << std::setprecision(0) << std::setw(12)
+            << result.tile_rate << std::setprecision(2) << std::setw(9) << speedup << 'x' << std::setprecision(0)
+            << std::setw(11) << efficiency * 100.0 << "%\n";
+    }
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-preview [--file <frm>] [--size <pixels>] [--iterations <count>] "
+                 "[--threads <count>]... [formula...]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--file" || arg == "--size" || arg == "--iterations" || arg == "--threads") && i + 1 < argc)
+        {
+            if (arg == "--file")
+            {
+                options.file = argv[++i];
+            }
+            else if (arg == "--size")
+            {
+                options.size = std::atoi(argv[++i]);
+            }
+            else if (arg == "--iterations")
+            {
+                options.max_iterations = std::atoi(argv[++i]);
+            }
+            else
+            {
+                options.threads.push_back(static_cast<unsigned>(std::max(1, std::atoi(argv[++i]))));
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            options.formulas.push_back(arg);
+        }
+    }
+    if (options.size <= 0 || options.max_iterations <= 0)
+    {
+        usage();
+        return 1;
+    }
+    if (options.threads.empty())
+    {
+        options.threads = default_threads();
+    }
+
+    try
+    {
+        report(std::cout, run(options), options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "bench-preview: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
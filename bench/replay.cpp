@@ -0,0 +1,185 @@
+#include <formula/edit_session.h>
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct LexerDeleter
+{
+    void operator()(ILexer *lexer) const
+    {
+        lexer->Release();
+    }
+};
+
+// The lexer work that followed one modification, up to the next one.
+struct EditCost
+{
+    std::ptrdiff_t edited{};
+    std::ptrdiff_t lexed{};
+    std::ptrdiff_t folded{};
+    double seconds{};
+};
+
+struct Replay
+{
+    std::vector<EditCost> edits;
+    EditCost initial;
+    std::size_t lex_calls{};
+    std::size_t fold_calls{};
+};
+
+Replay replay(std::istream &in)
+{
+    std::unique_ptr<ILexer, LexerDeleter> lexer{formula::create_lexer()};
+    formula::MemoryDocument doc;
+    Replay result;
+    EditCost *current = &result.initial;
+    formula::EditEvent event;
+    formula::read_edit_session_header(in);
+    while (formula::read_edit_event(in, event))
+    {
+        switch (event.type)
+        {
+        case formula::EditEventType::TEXT:
+            doc = formula::MemoryDocument(event.text);
+            break;
+
+        case formula::EditEventType::INSERT:
+            doc.insert(static_cast<Sci_Position>(event.position), event.text.data(), event.length);
+            result.edits.push_back(EditCost{event.length});
+            current = &result.edits.back();
+            break;
+
+        case formula::EditEventType::DELETE:
+            doc.erase(static_cast<Sci_Position>(event.position), event.length);
+            result.edits.push_back(EditCost{event.length});
+            current = &result.edits.back();
+            break;
+
+        case formula::EditEventType::LEX:
+        case formula::EditEventType::FOLD:
+        {
+            if (static_cast<Sci_Position>(event.position) + event.length > doc.Length())
+            {
+                throw std::runtime_error("Lexer range lies outside the recorded document");
+            }
+            const bool lex = event.type == formula::EditEventType::LEX;
+            const Clock::time_point begin = Clock::now();
+            if (lex)
+            {
+                lexer->Lex(event.position, event.length, event.init_style, &doc);
+            }
+            else
+            {
+                lexer->Fold(event.position, event.length, event.init_style, &doc);
+            }
+            current->seconds += std::chrono::duration<double>(Clock::now() - begin).count();
+            (lex ? current->lexed : current->folded) += event.length;
+            ++(lex ? result.lex_calls : result.fold_calls);
+            break;
+        }
+        }
+    }
+    return result;
+}
+
+template <typename T>
+T percentile(const std::vector<T> &sorted, double fraction)
+{
+    if (sorted.empty())
+    {
+        return T{};
+    }
+    const std::size_t rank = static_cast<std::size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+template <typename T>
+void print_distribution(std::ostream &out, const char *label, std::vector<T> values, const char *unit)
+{
+    std::sort(values.begin(), values.end());
+    out << std::left << std::setw(22) << label << std::right;
+    static const std::pair<const char *, double> points[]{{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"max", 1.0}};
+    const char *separator = "";
+    for (const auto &[name, fraction] : points)
+    {
+        out << separator << name << ' ' << percentile(values, fraction) << unit;
+        separator = "  ";
+    }
+    out << '\n';
+}
+
+void report(std::ostream &out, const Replay &result)
+{
+    std::vector<double> micros;
+    std::vector<std::ptrdiff_t> relexed;
+    EditCost total;
+    for (const EditCost &edit : result.edits)
+    {
+        micros.push_back(edit.seconds * 1e6);
+        relexed.push_back(edit.lexed);
+        total.edited += edit.edited;
+        total.lexed += edit.lexed;
+        total.folded += edit.folded;
+        total.seconds += edit.seconds;
+    }
+
+    out << std::fixed << std::setprecision(1);
+    out << std::left << std::setw(22) << "Edits:" << result.edits.size() << '\n'
+        << std::setw(22) << "Lexer calls:" << "lex " << result.lex_calls << ", fold " << result.fold_calls << '\n'
+        << std::setw(22) << "Initial styling:" << result.initial.lexed << " bytes in "
+        << result.initial.seconds * 1e3 << " ms\n";
+    print_distribution(out, "Latency per edit:", micros, " us");
+    print_distribution(out, "Relexed per edit:", relexed, " B");
+    out << std::left << std::setw(22) << "Total work:" << total.lexed << " bytes lexed, " << total.folded
+        << " bytes folded for " << total.edited << " bytes edited";
+    if (total.edited > 0)
+    {
+        out << " (" << static_cast<double>(total.lexed) / static_cast<double>(total.edited) << "x)";
+    }
+    out << " in " << total.seconds * 1e3 << " ms\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: bench-replay <session log>\n";
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in)
+    {
+        std::cerr << "Couldn't open " << argv[1] << '\n';
+        return 1;
+    }
+
+    try
+    {
+        report(std::cout, replay(in));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << argv[1] << ": " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
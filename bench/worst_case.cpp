@@ -0,0 +1,68 @@
+#include <lexer_cost.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Replays the inputs fuzz-lexer found to be slow, reporting what each costs per byte against typical text.
+
+namespace
+{
+
+constexpr int RUNS{5};
+
+std::string read_file(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void usage()
+{
+    std::cerr << "Usage: bench-worst-case [<directory>]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2)
+    {
+        usage();
+        return 1;
+    }
+    const std::filesystem::path dir{argc == 2 ? argv[1] : FORMULA_CORPUS_DIR "/worst-case"};
+    std::error_code error;
+    if (!std::filesystem::is_directory(dir, error))
+    {
+        std::cerr << "bench-worst-case: " << dir.string() << " is not a directory\n";
+        return 1;
+    }
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry : std::filesystem::directory_iterator(dir))
+    {
+        if (entry.is_regular_file())
+        {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    formula::LexerCost cost{read_file(FORMULA_CORPUS_DIR "/id-formula.frm")};
+    std::cout << std::left << std::setw(24) << "Input" << std::right << std::setw(10) << "Bytes" << std::setw(16)
+              << (std::string{cost.unit()} + "/byte") << std::setw(10) << "Relative" << '\n'
+              << std::fixed << std::setprecision(1);
+    for (const std::filesystem::path &path : paths)
+    {
+        const std::string text = read_file(path);
+        const double per_byte = text.empty() ? 0.0 : cost.measure(text, RUNS) / static_cast<double>(text.size());
+        std::cout << std::left << std::setw(24) << path.filename().string() << std::right << std::setw(10)
+                  << text.size() << std::setw(16) << per_byte << std::setw(9) << cost.relative(text, RUNS) << "x\n";
+    }
+    return 0;
+}
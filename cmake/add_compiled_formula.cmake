@@ -0,0 +1,31 @@
+# Compile the formula named entry in file to C++ with formula-compile and build it
+# into a plug-in; FUNCTIONS lists what fn1 to fn4 are bound to, in order.
+function(add_compiled_formula target file entry)
+    cmake_parse_arguments(PARSE_ARGV 3 FORMULA "" "" "FUNCTIONS")
+    get_filename_component(input "${file}" ABSOLUTE)
+    set(source "${CMAKE_CURRENT_BINARY_DIR}/${target}.cpp")
+    set(bindings)
+    set(index 1)
+    foreach(function IN LISTS FORMULA_FUNCTIONS)
+        list(APPEND bindings "--fn${index}" "${function}")
+        math(EXPR index "${index} + 1")
+    endforeach()
+    add_custom_command(OUTPUT "${source}"
+        COMMAND formula-compile ${bindings} "${input}" "${entry}" "${source}"
+        DEPENDS formula-compile "${input}"
+        COMMENT "Compiling formula ${entry}"
+        VERBATIM
+    )
+    add_library(${target} SHARED "${source}")
+    target_link_libraries(${target} PRIVATE formula-native)
+    target_folder(${target} "Plug-Ins")
+    target_prefix(${target} "")
+endfunction()
+
+# Copy a compiled formula plug-in to the target's executable directory
+function(target_copy_compiled_formula target formula)
+    add_custom_command(TARGET ${target} POST_BUILD
+        COMMAND ${CMAKE_COMMAND} -E copy $<TARGET_FILE:${formula}> $<TARGET_FILE_DIR:${target}>
+        COMMAND_EXPAND_LISTS
+    )
+endfunction()
@@ -0,0 +1,120 @@
+#include <formula/edit_session.h>
+
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+namespace formula
+{
+
+namespace
+{
+
+constexpr const char *SESSION_HEADER{"formula-edit-session 1"};
+
+void read_bytes(std::istream &in, std::ptrdiff_t length, std::string &text)
+{
+    if (in.get() != '\n' || length < 0)
+    {
+        throw std::runtime_error("Malformed edit session entry");
+    }
+    text.resize(length);
+    in.read(text.data(), length);
+    if (in.gcount() != length || in.get() != '\n')
+    {
+        throw std::runtime_error("Truncated edit session text");
+    }
+}
+
+} // namespace
+
+EditSessionWriter::EditSessionWriter(std::ostream &out) :
+    m_out(out)
+{
+    m_out << SESSION_HEADER << '\n';
+}
+
+void EditSessionWriter::text(const char *text, std::size_t length)
+{
+    m_out << "text " << length << '\n';
+    m_out.write(text, static_cast<std::streamsize>(length));
+    m_out << '\n';
+}
+
+void EditSessionWriter::insert(std::size_t position, const char *text, std::size_t length)
+{
+    m_out << "insert " << position << ' ' << length << '\n';
+    m_out.write(text, static_cast<std::streamsize>(length));
+    m_out << '\n';
+}
+
+void EditSessionWriter::erase(std::size_t position, std::size_t length)
+{
+    m_out << "delete " << position << ' ' << length << '\n';
+}
+
+void EditSessionWriter::lex(std::size_t start, std::ptrdiff_t length, int init_style)
+{
+    m_out << "lex " << start << ' ' << length << ' ' << init_style << '\n';
+}
+
+void EditSessionWriter::fold(std::size_t start, std::ptrdiff_t length, int init_style)
+{
+    m_out << "fold " << start << ' ' << length << ' ' << init_style << '\n';
+}
+
+void read_edit_session_header(std::istream &in)
+{
+    std::string header;
+    if (!std::getline(in, header) || header != SESSION_HEADER)
+    {
+        throw std::runtime_error("Not an edit session log");
+    }
+}
+
+bool read_edit_event(std::istream &in, EditEvent &event)
+{
+    std::string keyword;
+    if (!(in >> keyword))
+    {
+        return false;
+    }
+
+    event.position = 0;
+    event.length = 0;
+    event.init_style = 0;
+    event.text.clear();
+    if (keyword == "text")
+    {
+        event.type = EditEventType::TEXT;
+        in >> event.length;
+        read_bytes(in, event.length, event.text);
+    }
+    else if (keyword == "insert")
+    {
+        event.type = EditEventType::INSERT;
+        in >> event.position >> event.length;
+        read_bytes(in, event.length, event.text);
+    }
+    else if (keyword == "delete")
+    {
+        event.type = EditEventType::DELETE;
+        in >> event.position >> event.length;
+    }
+    else if (keyword == "lex" || keyword == "fold")
+    {
+        event.type = keyword == "lex" ? EditEventType::LEX : EditEventType::FOLD;
+        in >> event.position >> event.length >> event.init_style;
+    }
+    else
+    {
+        throw std::runtime_error("Unknown edit session entry '" + keyword + "'");
+    }
+    if (!in)
+    {
+        throw std::runtime_error("Malformed edit session entry '" + keyword + "'");
+    }
+    return true;
+}
+
+} // namespace formula
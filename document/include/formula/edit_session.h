@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace formula
+{
+
+// One entry in a recorded edit session.
+//
+// A session log starts with a header line and the document text, followed by the modifications made to it and
+// the ranges the lexer was asked to style and fold, in the order they happened:
+//
+//     formula-edit-session 1
+//     text <length>\n<bytes>\n
+//     insert <position> <length>\n<bytes>\n
+//     delete <position> <length>\n
+//     lex <start> <length> <init style>\n
+//     fold <start> <length> <init style>\n
+enum class EditEventType
+{
+    TEXT,
+    INSERT,
+    DELETE,
+    LEX,
+    FOLD,
+};
+
+struct EditEvent
+{
+    EditEventType type{};
+    std::size_t position{};
+    std::ptrdiff_t length{};
+    int init_style{};
+    std::string text;
+};
+
+class EditSessionWriter
+{
+public:
+    explicit EditSessionWriter(std::ostream &out);
+
+    void text(const char *text, std::size_t length);
+    void insert(std::size_t position, const char *text, std::size_t length);
+    void erase(std::size_t position, std::size_t length);
+    void lex(std::size_t start, std::ptrdiff_t length, int init_style);
+    void fold(std::size_t start, std::ptrdiff_t length, int init_style);
+
+private:
+    std::ostream &m_out;
+};
+
+// Reads the session header; throws std::runtime_error if in is not a session log.
+void read_edit_session_header(std::istream &in);
+
+// Reads the next event; returns false at the end of the log and throws std::runtime_error on a malformed entry.
+bool read_edit_event(std::istream &in, EditEvent &event);
+
+} // namespace formula
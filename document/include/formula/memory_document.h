@@ -0,0 +1,94 @@
+#pragma once
+
+#include <ILexer.h>
+#include <Scintilla.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace formula
+{
+
+// An IDocument held entirely in memory, so a lexer can be driven without an editor.
+// Edits move line levels, line states, styles and indicators the way Scintilla does.
+class MemoryDocument : public IDocument
+{
+public:
+    MemoryDocument() = default;
+    explicit MemoryDocument(std::string text);
+    virtual ~MemoryDocument() = default;
+
+    void insert(Sci_Position position, const char *text, Sci_Position length);
+    void erase(Sci_Position position, Sci_Position length);
+
+    // Style up to end as Scintilla does: relex from the start of the line holding the first unstyled position.
+    // Returns the number of bytes handed to the lexer.
+    Sci_Position colourise(ILexer *lexer, Sci_Position end);
+    // Style up to end from the first unstyled position itself, as an application styling a long line
+    // a piece at a time does; the lexer goes back from there as far as it needs.
+    Sci_Position colourise_from_end_styled(ILexer *lexer, Sci_Position end);
+
+    const std::string &text() const
+    {
+        return m_text;
+    }
+    const std::string &styles() const
+    {
+        return m_styles;
+    }
+    Sci_Position end_styled() const
+    {
+        return m_end_styled;
+    }
+    Sci_Position line_count() const
+    {
+        return static_cast<Sci_Position>(m_line_starts.size());
+    }
+    int error_status() const
+    {
+        return m_error_status;
+    }
+    int indicator_value(int indicator, Sci_Position position) const;
+
+    int SCI_METHOD Version() const override;
+    void SCI_METHOD SetErrorStatus(int status) override;
+    Sci_Position SCI_METHOD Length() const override;
+    void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const override;
+    char SCI_METHOD StyleAt(Sci_Position position) const override;
+    Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+    Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+    int SCI_METHOD GetLevel(Sci_Position line) const override;
+    int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+    int SCI_METHOD GetLineState(Sci_Position line) const override;
+    int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+    void SCI_METHOD StartStyling(Sci_Position position, char mask) override;
+    bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+    bool SCI_METHOD SetStyles(Sci_Position length, const char *styles) override;
+    void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+    void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position length) override;
+    void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+    int SCI_METHOD CodePage() const override;
+    bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+    const char *SCI_METHOD BufferPointer() override;
+    int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+
+private:
+    Sci_Position colourise_range(ILexer *lexer, Sci_Position start, Sci_Position end);
+    void find_line_starts(Sci_Position begin, Sci_Position end);
+    void lines_changed(Sci_Position line, Sci_Position old_count);
+    void modified_at(Sci_Position position);
+
+    std::string m_text;
+    std::string m_styles;
+    std::vector<Sci_Position> m_line_starts{0};
+    std::vector<int> m_levels{SC_FOLDLEVELBASE};
+    mutable std::vector<int> m_line_states;
+    std::map<int, std::vector<int>> m_indicators;
+    int m_current_indicator{};
+    Sci_Position m_styling_position{};
+    Sci_Position m_end_styled{};
+    int m_error_status{};
+};
+
+} // namespace formula
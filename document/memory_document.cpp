@@ -0,0 +1,329 @@
+#include <formula/memory_document.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace formula
+{
+
+MemoryDocument::MemoryDocument(std::string text) :
+    m_text(std::move(text)),
+    m_styles(m_text.size(), '\0')
+{
+    find_line_starts(0, Length());
+    m_levels.resize(m_line_starts.size(), SC_FOLDLEVELBASE);
+}
+
+void MemoryDocument::insert(Sci_Position position, const char *text, Sci_Position length)
+{
+    if (length <= 0)
+    {
+        return;
+    }
+    const Sci_Position old_count = line_count();
+    const Sci_Position line = LineFromPosition(position > 0 ? position - 1 : 0);
+
+    m_text.insert(position, text, length);
+    m_styles.insert(position, length, '\0');
+    for (auto &indicator : m_indicators)
+    {
+        if (!indicator.second.empty())
+        {
+            indicator.second.insert(indicator.second.begin() + position, length, 0);
+        }
+    }
+    for (auto it = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), position); it != m_line_starts.end();
+         ++it)
+    {
+        *it += length;
+    }
+
+    // A CR before the insertion point can pair with an inserted LF, and an inserted CR with a following LF.
+    find_line_starts(m_line_starts[line], std::min(position + length + 1, Length()));
+    lines_changed(line, old_count);
+    modified_at(position);
+}
+
+void MemoryDocument::erase(Sci_Position position, Sci_Position length)
+{
+    length = std::min(length, Length() - position);
+    if (length <= 0)
+    {
+        return;
+    }
+    const Sci_Position old_count = line_count();
+    const Sci_Position line = LineFromPosition(position > 0 ? position - 1 : 0);
+
+    m_text.erase(position, length);
+    m_styles.erase(position, length);
+    for (auto &indicator : m_indicators)
+    {
+        if (!indicator.second.empty())
+        {
+            const auto begin = indicator.second.begin() + position;
+            indicator.second.erase(begin, begin + length);
+        }
+    }
+    const auto first = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), position);
+    const auto last = std::upper_bound(first, m_line_starts.end(), position + length);
+    for (auto it = m_line_starts.erase(first, last); it != m_line_starts.end(); ++it)
+    {
+        *it -= length;
+    }
+
+    // Removing the text between a CR and an LF joins them into one line end.
+    find_line_starts(m_line_starts[line], std::min(position + 1, Length()));
+    lines_changed(line, old_count);
+    modified_at(position);
+}
+
+Sci_Position MemoryDocument::colourise(ILexer *lexer, Sci_Position end)
+{
+    return colourise_range(lexer, LineStart(LineFromPosition(m_end_styled)), end);
+}
+
+Sci_Position MemoryDocument::colourise_from_end_styled(ILexer *lexer, Sci_Position end)
+{
+    return colourise_range(lexer, m_end_styled, end);
+}
+
+Sci_Position MemoryDocument::colourise_range(ILexer *lexer, Sci_Position start, Sci_Position end)
+{
+    end = std::min(end, Length());
+    if (end <= m_end_styled)
+    {
+        return 0;
+    }
+    const int init_style = start > 0 ? StyleAt(start - 1) : 0;
+    lexer->Lex(start, end - start, init_style, this);
+    lexer->Fold(start, end - start, init_style, this);
+    return end - start;
+}
+
+int MemoryDocument::indicator_value(int indicator, Sci_Position position) const
+{
+    const auto it = m_indicators.find(indicator);
+    if (it == m_indicators.end() || position < 0 || position >= static_cast<Sci_Position>(it->second.size()))
+    {
+        return 0;
+    }
+    return it->second[position];
+}
+
+// Replace the line starts in (begin, end] with those found by scanning [begin, end).
+void MemoryDocument::find_line_starts(Sci_Position begin, Sci_Position end)
+{
+    const auto first = std::upper_bound(m_line_starts.begin(), m_line_starts.end(), begin);
+    const auto last = std::upper_bound(first, m_line_starts.end(), end);
+    std::vector<Sci_Position> found;
+    for (Sci_Position i = begin; i < end; ++i)
+    {
+        const char ch = m_text[i];
+        if (ch == '\n' || (ch == '\r' && (i + 1 >= Length() || m_text[i + 1] != '\n')))
+        {
+            found.push_back(i + 1);
+        }
+    }
+    m_line_starts.insert(m_line_starts.erase(first, last), found.begin(), found.end());
+}
+
+// Lines were added or removed after line; keep the per-line data in step, copying line's values into new lines.
+void MemoryDocument::lines_changed(Sci_Position line, Sci_Position old_count)
+{
+    const Sci_Position added = line_count() - old_count;
+    if (added > 0)
+    {
+        m_levels.insert(m_levels.begin() + line + 1, added, m_levels[line]);
+        if (line < static_cast<Sci_Position>(m_line_states.size()))
+        {
+            m_line_states.insert(m_line_states.begin() + line + 1, added, m_line_states[line]);
+        }
+    }
+    else if (added < 0)
+    {
+        m_levels.erase(m_levels.begin() + line + 1, m_levels.begin() + line + 1 - added);
+        if (line + 1 < static_cast<Sci_Position>(m_line_states.size()))
+        {
+            const Sci_Position end = std::min(line + 1 - added, static_cast<Sci_Position>(m_line_states.size()));
+            m_line_states.erase(m_line_states.begin() + line + 1, m_line_states.begin() + end);
+        }
+    }
+}
+
+void MemoryDocument::modified_at(Sci_Position position)
+{
+    m_end_styled = std::min(m_end_styled, position);
+}
+
+int MemoryDocument::Version() const
+{
+    return dvOriginal;
+}
+
+void MemoryDocument::SetErrorStatus(int status)
+{
+    m_error_status = status;
+}
+
+Sci_Position MemoryDocument::Length() const
+{
+    return static_cast<Sci_Position>(m_text.size());
+}
+
+void MemoryDocument::GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const
+{
+    std::memcpy(buffer, m_text.data() + position, length);
+}
+
+char MemoryDocument::StyleAt(Sci_Position position) const
+{
+    return position >= 0 && position < Length() ? m_styles[position] : '\0';
+}
+
+Sci_Position MemoryDocument::LineFromPosition(Sci_Position position) const
+{
+    return std::upper_bound(m_line_starts.begin(), m_line_starts.end(), position) - m_line_starts.begin() - 1;
+}
+
+Sci_Position MemoryDocument::LineStart(Sci_Position line) const
+{
+    if (line < 0)
+    {
+        return 0;
+    }
+    if (line >= line_count())
+    {
+        return Length();
+    }
+    return m_line_starts[line];
+}
+
+int MemoryDocument::GetLevel(Sci_Position line) const
+{
+    return line >= 0 && line < line_count() ? m_levels[line] : SC_FOLDLEVELBASE;
+}
+
+int MemoryDocument::SetLevel(Sci_Position line, int level)
+{
+    if (line < 0 || line >= line_count())
+    {
+        return 0;
+    }
+    const int previous = m_levels[line];
+    m_levels[line] = level;
+    return previous;
+}
+
+int MemoryDocument::GetLineState(Sci_Position line) const
+{
+    if (line < 0)
+    {
+        return 0;
+    }
+    if (line >= static_cast<Sci_Position>(m_line_states.size()))
+    {
+        m_line_states.resize(line + 1);
+    }
+    return m_line_states[line];
+}
+
+int MemoryDocument::SetLineState(Sci_Position line, int state)
+{
+    const int previous = GetLineState(line);
+    if (line >= 0)
+    {
+        m_line_states[line] = state;
+    }
+    return previous;
+}
+
+void MemoryDocument::StartStyling(Sci_Position position, char /*mask*/)
+{
+    m_styling_position = position;
+    m_end_styled = position;
+}
+
+bool MemoryDocument::SetStyleFor(Sci_Position length, char style)
+{
+    if (length < 0 || m_styling_position + length > Length())
+    {
+        return false;
+    }
+    std::fill_n(m_styles.begin() + m_styling_position, length, style);
+    m_styling_position += length;
+    m_end_styled = m_styling_position;
+    return true;
+}
+
+bool MemoryDocument::SetStyles(Sci_Position length, const char *styles)
+{
+    if (length < 0 || m_styling_position + length > Length())
+    {
+        return false;
+    }
+    std::copy_n(styles, length, m_styles.begin() + m_styling_position);
+    m_styling_position += length;
+    m_end_styled = m_styling_position;
+    return true;
+}
+
+void MemoryDocument::DecorationSetCurrentIndicator(int indicator)
+{
+    m_current_indicator = indicator;
+}
+
+void MemoryDocument::DecorationFillRange(Sci_Position position, int value, Sci_Position length)
+{
+    std::vector<int> &values = m_indicators[m_current_indicator];
+    values.resize(m_text.size());
+    position = std::max<Sci_Position>(position, 0);
+    length = std::min(length, Length() - position);
+    if (length > 0)
+    {
+        std::fill_n(values.begin() + position, length, value);
+    }
+}
+
+void MemoryDocument::ChangeLexerState(Sci_Position start, Sci_Position /*end*/)
+{
+    modified_at(start);
+}
+
+int MemoryDocument::CodePage() const
+{
+    return 0;
+}
+
+bool MemoryDocument::IsDBCSLeadByte(char /*ch*/) const
+{
+    return false;
+}
+
+const char *MemoryDocument::BufferPointer()
+{
+    return m_text.c_str();
+}
+
+int MemoryDocument::GetLineIndentation(Sci_Position line)
+{
+    int indent = 0;
+    for (Sci_Position i = LineStart(line); i < LineStart(line + 1); ++i)
+    {
+        if (m_text[i] == ' ')
+        {
+            ++indent;
+        }
+        else if (m_text[i] == '\t')
+        {
+            indent = (indent / 8 + 1) * 8;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return indent;
+}
+
+} // namespace formula
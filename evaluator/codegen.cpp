@@ -0,0 +1,620 @@
+#include <formula/codegen.h>
+
+#include <formula/evaluator.h>
+
+#include <cmath>
+#include <set>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace formula
+{
+
+namespace
+{
+
+// The number of registers an instruction reads: a, or a and b.
+int operand_count(Opcode op)
+{
+    if (op <= Opcode::MAKE_COMPLEX)
+    {
+        return 2;
+    }
+    return op == Opcode::ELSE || op == Opcode::JUMP_IF_NONE ? 0 : 1;
+}
+
+bool writes_register(Opcode op)
+{
+    return op < Opcode::IF;
+}
+
+// Whether an instruction reads the imaginary parts of a and of b, given whether the
+// imaginary part of what it writes is read anywhere.
+std::pair<bool, bool> reads_imaginary(Opcode op, bool imaginary_result)
+{
+    switch (op)
+    {
+    case Opcode::MULTIPLY:
+    case Opcode::DIVIDE:
+        return {true, true};
+    case Opcode::ADD:
+    case Opcode::SUBTRACT:
+        return {imaginary_result, imaginary_result};
+    case Opcode::MODULUS:
+    case Opcode::SQR:
+    case Opcode::IMAG:
+    case Opcode::FLIP:
+    case Opcode::CABS:
+        return {true, false};
+    case Opcode::NEGATE:
+    case Opcode::ABS:
+    case Opcode::CONJ:
+    case Opcode::SRAND:
+    case Opcode::FLOOR:
+    case Opcode::CEIL:
+    case Opcode::TRUNC:
+    case Opcode::ROUND:
+    case Opcode::STORE:
+        return {imaginary_result, false};
+    case Opcode::LESS:
+    case Opcode::LESS_EQUAL:
+    case Opcode::GREATER:
+    case Opcode::GREATER_EQUAL:
+    case Opcode::EQUAL:
+    case Opcode::NOT_EQUAL:
+    case Opcode::AND:
+    case Opcode::OR:
+    case Opcode::MAKE_COMPLEX:
+    case Opcode::REAL:
+    case Opcode::IF:
+    case Opcode::ELSE:
+    case Opcode::AND_IF:
+    case Opcode::JUMP_IF_NONE:
+        return {false, false};
+    default:
+        // The functions of a complex argument.
+        return {true, operand_count(op) > 1};
+    }
+}
+
+// Exact, so the generated code computes with the same constants as the evaluator.
+std::string literal(double value)
+{
+    if (std::isnan(value))
+    {
+        return "std::numeric_limits<double>::quiet_NaN()";
+    }
+    if (std::isinf(value))
+    {
+        return value < 0.0 ? "(-std::numeric_limits<double>::infinity())" : "std::numeric_limits<double>::infinity()";
+    }
+    std::ostringstream out;
+    out << std::hexfloat << value;
+    return std::signbit(value) ? '(' + out.str() + ')' : out.str();
+}
+
+std::string quoted(const std::string &text)
+{
+    std::string result{'"'};
+    for (const char ch : text)
+    {
+        if (ch == '"' || ch == '\\')
+        {
+            result += '\\';
+        }
+        if (static_cast<unsigned char>(ch) < ' ')
+        {
+            result += ' ';
+            continue;
+        }
+        result += ch;
+    }
+    return result + '"';
+}
+
+// The per-lane expression of a std::complex function of a and b, for the
+// operations that are not written out part by part.
+const char *complex_function(Opcode op)
+{
+    switch (op)
+    {
+    case Opcode::POWER:
+        return "formula::power(a, b)";
+    case Opcode::SIN:
+        return "std::sin(a)";
+    case Opcode::COS:
+        return "std::cos(a)";
+    case Opcode::SINH:
+        return "std::sinh(a)";
+    case Opcode::COSH:
+        return "std::cosh(a)";
+    case Opcode::COSXX:
+        return "std::conj(std::cos(a))";
+    case Opcode::TAN:
+        return "std::tan(a)";
+    case Opcode::COTAN:
+        return "formula::divide(std::cos(a), std::sin(a))";
+    case Opcode::TANH:
+        return "std::tanh(a)";
+    case Opcode::COTANH:
+        return "formula::divide(std::cosh(a), std::sinh(a))";
+    case Opcode::LOG:
+        return "std::log(a)";
+    case Opcode::EXP:
+        return "std::exp(a)";
+    case Opcode::ASIN:
+        return "std::asin(a)";
+    case Opcode::ASINH:
+        return "std::asinh(a)";
+    case Opcode::ACOS:
+        return "std::acos(a)";
+    case Opcode::ACOSH:
+        return "std::acosh(a)";
+    case Opcode::ATAN:
+        return "std::atan(a)";
+    case Opcode::ATANH:
+        return "std::atanh(a)";
+    case Opcode::SQRT:
+        return "std::sqrt(a)";
+    default:
+        return nullptr;
+    }
+}
+
+class Generator
+{
+public:
+    Generator(const Program &program, std::ostream &out);
+
+    void declarations();
+    void section(const char *name, const std::vector<Instruction> &code);
+    std::string re(std::uint16_t reg) const;
+    std::string im(std::uint16_t reg) const;
+    void indent(int depth);
+
+private:
+    bool is_constant(std::uint16_t reg) const;
+    bool imaginary(std::uint16_t reg) const
+    {
+        return m_imaginary.count(reg) != 0;
+    }
+    void lanes(const std::vector<std::string> &lines);
+    void arithmetic(const Instruction &instruction);
+    void control(const Instruction &instruction, const char *section);
+
+    const Program &m_program;
+    std::ostream &m_out;
+    std::set<std::uint16_t> m_used;
+    // The registers whose imaginary part is read; the rest only ever hold real numbers.
+    std::set<std::uint16_t> m_imaginary;
+    std::string m_indent;
+};
+
+Generator::Generator(const Program &program, std::ostream &out) :
+    m_program(program),
+    m_out(out)
+{
+    for (const std::vector<Instruction> *code : {&program.init, &program.iteration, &program.bailout})
+    {
+        for (const Instruction &instruction : *code)
+        {
+            int operands = operand_count(instruction.op);
+            for (const std::uint16_t reg : {instruction.a, instruction.b})
+            {
+                if (operands-- > 0 && !is_constant(reg))
+                {
+                    m_used.insert(reg);
+                }
+            }
+            if (writes_register(instruction.op))
+            {
+                m_used.insert(instruction.dst);
+            }
+        }
+    }
+    if (!is_constant(program.bailout_register))
+    {
+        m_used.insert(program.bailout_register);
+    }
+
+    // Reading the imaginary part of a result can mean reading those of its operands, until no more are found.
+    for (std::size_t found = 1; found != 0;)
+    {
+        found = 0;
+        for (const std::vector<Instruction> *code : {&program.init, &program.iteration, &program.bailout})
+        {
+            for (const Instruction &instruction : *code)
+            {
+                const auto [a, b] = reads_imaginary(instruction.op, imaginary(instruction.dst));
+                for (const auto &[reg, read] : {std::pair{instruction.a, a}, std::pair{instruction.b, b}})
+                {
+                    if (read && !is_constant(reg) && m_imaginary.insert(reg).second)
+                    {
+                        ++found;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool Generator::is_constant(std::uint16_t reg) const
+{
+    return reg >= m_program.constant_base
+        && static_cast<std::size_t>(reg - m_program.constant_base) < m_program.constants.size();
+}
+
+std::string Generator::re(std::uint16_t reg) const
+{
+    return is_constant(reg) ? literal(m_program.constants[reg - m_program.constant_base].real())
+                            : 'r' + std::to_string(reg) + "_re[i]";
+}
+
+std::string Generator::im(std::uint16_t reg) const
+{
+    return is_constant(reg) ? literal(m_program.constants[reg - m_program.constant_base].imag())
+                            : 'r' + std::to_string(reg) + "_im[i]";
+}
+
+void Generator::indent(int depth)
+{
+    m_indent.assign(depth * 4, ' ');
+}
+
+void Generator::lanes(const std::vector<std::string> &lines)
+{
+    m_out << m_indent << "for (std::size_t i = 0; i < LANES; ++i)\n" << m_indent << "{\n";
+    for (const std::string &line : lines)
+    {
+        m_out << m_indent << "    " << line << '\n';
+    }
+    m_out << m_indent << "}\n";
+}
+
+void Generator::declarations()
+{
+    for (const std::uint16_t reg : m_used)
+    {
+        const std::string name{'r' + std::to_string(reg)};
+        m_out << m_indent << "alignas(64) double " << name << "_re[LANES]{};\n";
+        if (imaginary(reg))
+        {
+            m_out << m_indent << "alignas(64) double " << name << "_im[LANES]{};\n";
+        }
+    }
+    m_out << m_indent << "alignas(64) std::int64_t active0[LANES]{};\n";
+    for (int level = 1; level < m_program.levels; ++level)
+    {
+        m_out << m_indent << "alignas(64) std::int64_t active" << level << "[LANES]{};\n";
+        m_out << m_indent << "alignas(64) std::int64_t taken" << level << "[LANES]{};\n";
+    }
+
+    // The predefined variables, when the formula uses them.
+    if (m_used.count(PIXEL_REGISTER) != 0)
+    {
+        m_out << m_indent << "std::copy_n(pixel_re + start, lanes, r0_re);\n";
+        if (imaginary(PIXEL_REGISTER))
+        {
+            m_out << m_indent << "std::copy_n(pixel_im + start, lanes, r0_im);\n";
+        }
+    }
+    std::vector<std::string> lines;
+    for (std::uint16_t i = 0; i < 5; ++i)
+    {
+        const std::uint16_t reg = PARAMETER_REGISTER + i;
+        if (m_used.count(reg) != 0)
+        {
+            lines.push_back(re(reg) + " = parameters[" + std::to_string(2 * i) + "];");
+            if (imaginary(reg))
+            {
+                lines.push_back(im(reg) + " = parameters[" + std::to_string(2 * i + 1) + "];");
+            }
+        }
+    }
+    if (m_used.count(PI_REGISTER) != 0)
+    {
+        lines.push_back(re(PI_REGISTER) + " = formula::PI;");
+    }
+    if (m_used.count(E_REGISTER) != 0)
+    {
+        lines.push_back(re(E_REGISTER) + " = formula::E;");
+    }
+    if (m_used.count(MAXIT_REGISTER) != 0)
+    {
+        lines.push_back(re(MAXIT_REGISTER) + " = max_iterations;");
+    }
+    lines.push_back("active0[i] = i < lanes ? -1 : 0;");
+    lanes(lines);
+}
+
+void Generator::section(const char *name, const std::vector<Instruction> &code)
+{
+    std::set<std::uint16_t> targets;
+    for (const Instruction &instruction : code)
+    {
+        if (instruction.op == Opcode::JUMP_IF_NONE)
+        {
+            targets.insert(instruction.dst);
+        }
+    }
+
+    m_out << m_indent << "// " << name << '\n';
+    for (std::size_t pc = 0; pc <= code.size(); ++pc)
+    {
+        if (targets.count(static_cast<std::uint16_t>(pc)) != 0)
+        {
+            m_out << m_indent << name << '_' << pc << ":;\n";
+        }
+        if (pc == code.size())
+        {
+            break;
+        }
+        if (writes_register(code[pc].op) && code[pc].op != Opcode::STORE)
+        {
+            arithmetic(code[pc]);
+        }
+        else
+        {
+            control(code[pc], name);
+        }
+    }
+}
+
+void Generator::arithmetic(const Instruction &instruction)
+{
+    const std::string ar{re(instruction.a)};
+    const std::string ai{im(instruction.a)};
+    const std::string br{re(instruction.b)};
+    const std::string bi{im(instruction.b)};
+    const auto truth = [](const std::string &condition) { return condition + " ? 1.0 : 0.0"; };
+
+    std::vector<std::string> lines;
+    std::string real;
+    std::string imag{"0.0"};
+    switch (instruction.op)
+    {
+    case Opcode::ADD:
+        real = ar + " + " + br;
+        imag = ai + " + " + bi;
+        break;
+    case Opcode::SUBTRACT:
+        real = ar + " - " + br;
+        imag = ai + " - " + bi;
+        break;
+    case Opcode::MULTIPLY:
+        real = ar + " * " + br + " - " + ai + " * " + bi;
+        imag = ar + " * " + bi + " + " + ai + " * " + br;
+        break;
+    case Opcode::DIVIDE:
+        lines.push_back("const double denominator = " + br + " * " + br + " + " + bi + " * " + bi + ';');
+        real = '(' + ar + " * " + br + " + " + ai + " * " + bi + ") / denominator";
+        imag = '(' + ai + " * " + br + " - " + ar + " * " + bi + ") / denominator";
+        break;
+    case Opcode::LESS:
+        real = truth(ar + " < " + br);
+        break;
+    case Opcode::LESS_EQUAL:
+        real = truth(ar + " <= " + br);
+        break;
+    case Opcode::GREATER:
+        real = truth(ar + " > " + br);
+        break;
+    case Opcode::GREATER_EQUAL:
+        real = truth(ar + " >= " + br);
+        break;
+    case Opcode::EQUAL:
+        real = truth(ar + " == " + br);
+        break;
+    case Opcode::NOT_EQUAL:
+        real = truth(ar + " != " + br);
+        break;
+    case Opcode::AND:
+        real = truth(ar + " != 0.0 && " + br + " != 0.0");
+        break;
+    case Opcode::OR:
+        real = truth(ar + " != 0.0 || " + br + " != 0.0");
+        break;
+    case Opcode::MAKE_COMPLEX:
+        real = ar;
+        imag = br;
+        break;
+    case Opcode::NEGATE:
+        real = '-' + ar;
+        imag = '-' + ai;
+        break;
+    case Opcode::MODULUS:
+        real = ar + " * " + ar + " + " + ai + " * " + ai;
+        break;
+    case Opcode::SQR:
+        real = ar + " * " + ar + " - " + ai + " * " + ai;
+        imag = "2.0 * " + ar + " * " + ai;
+        break;
+    case Opcode::CABS:
+        real = "std::sqrt(" + ar + " * " + ar + " + " + ai + " * " + ai + ')';
+        break;
+    case Opcode::ABS:
+        real = "std::abs(" + ar + ')';
+        imag = "std::abs(" + ai + ')';
+        break;
+    case Opcode::CONJ:
+        real = ar;
+        imag = '-' + ai;
+        break;
+    case Opcode::REAL:
+        real = ar;
+        break;
+    case Opcode::IMAG:
+        real = ai;
+        break;
+    case Opcode::FLIP:
+        real = ai;
+        imag = ar;
+        break;
+    case Opcode::SRAND:
+        real = ar;
+        imag = ai;
+        break;
+    case Opcode::FLOOR:
+    case Opcode::CEIL:
+    case Opcode::TRUNC:
+    case Opcode::ROUND:
+    {
+        const char *function = instruction.op == Opcode::FLOOR ? "std::floor("
+            : instruction.op == Opcode::CEIL                   ? "std::ceil("
+            : instruction.op == Opcode::TRUNC                  ? "std::trunc("
+                                                               : "std::round(";
+        real = function + ar + ')';
+        imag = function + ai + ')';
+        break;
+    }
+    default:
+        lines.push_back("const Complex a{" + ar + ", " + ai + "};");
+        if (operand_count(instruction.op) > 1)
+        {
+            lines.push_back("const Complex b{" + br + ", " + bi + "};");
+        }
+        lines.push_back(std::string{"const Complex value = "} + complex_function(instruction.op) + ';');
+        real = "value.real()";
+        imag = "value.imag()";
+        break;
+    }
+
+    // Both parts are worked out before either is stored, as dst may also be an operand.
+    lines.push_back("const double re = " + real + ';');
+    if (imaginary(instruction.dst))
+    {
+        lines.push_back("const double im = " + imag + ';');
+    }
+    lines.push_back(re(instruction.dst) + " = re;");
+    if (imaginary(instruction.dst))
+    {
+        lines.push_back(im(instruction.dst) + " = im;");
+    }
+    lanes(lines);
+}
+
+void Generator::control(const Instruction &instruction, const char *section)
+{
+    const std::string level{std::to_string(instruction.level)};
+    const std::string outer{std::to_string(instruction.level - 1)};
+    const std::string active{"active" + level + "[i]"};
+    const std::string taken{"taken" + level + "[i]"};
+    switch (instruction.op)
+    {
+    case Opcode::STORE:
+    {
+        // Lanes that have stopped iterating are never looked at again, so stores
+        // outside any if need no mask.
+        std::vector<std::string> lines;
+        for (const bool real : {true, false})
+        {
+            if (!real && !imaginary(instruction.dst))
+            {
+                break;
+            }
+            const std::string dst{real ? re(instruction.dst) : im(instruction.dst)};
+            const std::string a{real ? re(instruction.a) : im(instruction.a)};
+            lines.push_back(instruction.level == 0 ? dst + " = " + a + ';'
+                                                   : dst + " = " + active + " != 0 ? " + a + " : " + dst + ';');
+        }
+        lanes(lines);
+        break;
+    }
+    case Opcode::IF:
+        lanes({taken + " = " + re(instruction.a) + " != 0.0 ? active" + outer + "[i] : 0;",
+            active + " = " + taken + ';'});
+        break;
+    case Opcode::ELSE:
+        lanes({active + " = active" + outer + "[i] & ~" + taken + ';'});
+        break;
+    case Opcode::AND_IF:
+        lanes({active + " = " + re(instruction.a) + " != 0.0 ? " + active + " : 0;", taken + " |= " + active + ';'});
+        break;
+    case Opcode::JUMP_IF_NONE:
+        m_out << m_indent << "if (!any(active" << level << "))\n" << m_indent << "{\n";
+        m_out << m_indent << "    goto " << section << '_' << instruction.dst << ";\n" << m_indent << "}\n";
+        break;
+    default:
+        break;
+    }
+}
+
+} // namespace
+
+std::string generate_cpp(const Program &program, const std::string &name, const CompileOptions &options)
+{
+    std::ostringstream out;
+    Generator generator(program, out);
+
+    out << "// Generated by formula-compile from the formula " << name << "; do not edit.\n"
+        << "#include <formula/complex_math.h>\n"
+        << "#include <formula/native.h>\n"
+        << "\n"
+        << "#include <algorithm>\n"
+        << "#include <cmath>\n"
+        << "#include <complex>\n"
+        << "#include <cstddef>\n"
+        << "#include <cstdint>\n"
+        << "#include <limits>\n"
+        << "\n"
+        << "namespace\n"
+        << "{\n"
+        << "\n"
+        << "using Complex = std::complex<double>;\n"
+        << "\n"
+        << "constexpr std::size_t LANES{" << LANES << "};\n"
+        << "\n"
+        << "bool any(const std::int64_t *mask)\n"
+        << "{\n"
+        << "    std::int64_t bits{};\n"
+        << "    for (std::size_t i = 0; i < LANES; ++i)\n"
+        << "    {\n"
+        << "        bits |= mask[i];\n"
+        << "    }\n"
+        << "    return bits != 0;\n"
+        << "}\n"
+        << "\n"
+        << "void evaluate(const double *pixel_re, const double *pixel_im, std::size_t count, int max_iterations,\n"
+        << "    [[maybe_unused]] const double *parameters, int *iterations)\n"
+        << "{\n"
+        << "    for (std::size_t start = 0; start < count; start += LANES)\n"
+        << "    {\n"
+        << "        const std::size_t lanes = std::min(LANES, count - start);\n";
+    generator.indent(2);
+    generator.declarations();
+    out << "        std::int64_t counts[LANES]{};\n"
+        << "\n";
+    generator.section("init", program.init);
+    out << "        for (int iteration = 0; iteration < max_iterations && any(active0); ++iteration)\n"
+        << "        {\n";
+    generator.indent(3);
+    generator.section("iteration", program.iteration);
+    generator.section("bailout", program.bailout);
+    out << "            for (std::size_t i = 0; i < LANES; ++i)\n"
+        << "            {\n"
+        << "                counts[i] -= active0[i];\n"
+        << "                active0[i] &= " << generator.re(program.bailout_register) << " != 0.0 ? -1 : 0;\n"
+        << "            }\n"
+        << "        }\n"
+        << "        for (std::size_t i = 0; i < lanes; ++i)\n"
+        << "        {\n"
+        << "            iterations[start + i] = static_cast<int>(counts[i]);\n"
+        << "        }\n"
+        << "    }\n"
+        << "}\n"
+        << "\n"
+        << "const formula::NativeFormula FORMULA{formula::NATIVE_ABI_VERSION, " << quoted(name) << ",\n"
+        << "    {" << quoted(options.functions[0]) << ", " << quoted(options.functions[1]) << ", "
+        << quoted(options.functions[2]) << ", " << quoted(options.functions[3]) << "}, evaluate};\n"
+        << "\n"
+        << "} // namespace\n"
+        << "\n"
+        << "extern \"C\" FORMULA_NATIVE_EXPORT const formula::NativeFormula *GetNativeFormula()\n"
+        << "{\n"
+        << "    return &FORMULA;\n"
+        << "}\n";
+    return out.str();
+}
+
+} // namespace formula
@@ -0,0 +1,484 @@
+#include <formula/bytecode.h>
+
+#include <formula/vocabulary.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace formula
+{
+
+namespace
+{
+
+struct Builtin
+{
+    const char *name;
+    Opcode op;
+};
+
+constexpr Builtin BUILTINS[]{
+    {"sin", Opcode::SIN},       {"cos", Opcode::COS},       {"sinh", Opcode::SINH},     {"cosh", Opcode::COSH},
+    {"cosxx", Opcode::COSXX},   {"tan", Opcode::TAN},       {"cotan", Opcode::COTAN},   {"tanh", Opcode::TANH},
+    {"cotanh", Opcode::COTANH}, {"sqr", Opcode::SQR},       {"log", Opcode::LOG},       {"exp", Opcode::EXP},
+    {"abs", Opcode::ABS},       {"conj", Opcode::CONJ},     {"real", Opcode::REAL},     {"imag", Opcode::IMAG},
+    {"flip", Opcode::FLIP},     {"srand", Opcode::SRAND},   {"asin", Opcode::ASIN},     {"asinh", Opcode::ASINH},
+    {"acos", Opcode::ACOS},     {"acosh", Opcode::ACOSH},   {"atan", Opcode::ATAN},     {"atanh", Opcode::ATANH},
+    {"sqrt", Opcode::SQRT},     {"cabs", Opcode::CABS},     {"floor", Opcode::FLOOR},   {"ceil", Opcode::CEIL},
+    {"trunc", Opcode::TRUNC},   {"round", Opcode::ROUND},
+};
+
+std::string lowered(std::string_view word)
+{
+    std::string result(word);
+    std::transform(result.begin(), result.end(), result.begin(),
+        [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+    return result;
+}
+
+} // namespace
+
+Opcode function_opcode(const std::string &name)
+{
+    for (const Builtin &function : BUILTINS)
+    {
+        if (name == function.name)
+        {
+            return function.op;
+        }
+    }
+    throw std::runtime_error("Unknown function '" + name + "'");
+}
+
+Opcode operator_opcode(Operator op)
+{
+    switch (op)
+    {
+    case Operator::ADD:
+        return Opcode::ADD;
+    case Operator::SUBTRACT:
+        return Opcode::SUBTRACT;
+    case Operator::MULTIPLY:
+        return Opcode::MULTIPLY;
+    case Operator::DIVIDE:
+        return Opcode::DIVIDE;
+    case Operator::POWER:
+        return Opcode::POWER;
+    case Operator::LESS:
+        return Opcode::LESS;
+    case Operator::LESS_EQUAL:
+        return Opcode::LESS_EQUAL;
+    case Operator::GREATER:
+        return Opcode::GREATER;
+    case Operator::GREATER_EQUAL:
+        return Opcode::GREATER_EQUAL;
+    case Operator::EQUAL:
+        return Opcode::EQUAL;
+    case Operator::NOT_EQUAL:
+        return Opcode::NOT_EQUAL;
+    case Operator::AND:
+        return Opcode::AND;
+    case Operator::OR:
+        return Opcode::OR;
+    case Operator::NONE:
+    case Operator::NEGATE:
+        break;
+    }
+    throw std::runtime_error("Unexpected operator");
+}
+
+namespace
+{
+
+// Registers are numbered per kind while compiling, since the number of variables
+// and constants is only known at the end; finish() lays them out one after another.
+enum class RegisterKind : std::uint32_t
+{
+    VARIABLE,
+    CONSTANT,
+    TEMPORARY,
+};
+
+constexpr std::uint32_t KIND_SHIFT{16};
+
+std::uint32_t tagged(RegisterKind kind, std::size_t index)
+{
+    if (index > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::runtime_error("Formula has too many registers");
+    }
+    return static_cast<std::uint32_t>(kind) << KIND_SHIFT | static_cast<std::uint32_t>(index);
+}
+
+struct PendingInstruction
+{
+    Opcode op;
+    std::uint8_t level;
+    std::uint32_t dst;
+    std::uint32_t a;
+    std::uint32_t b;
+};
+
+class Compiler
+{
+public:
+    Compiler(const Entry &entry, std::string_view text, const CompileOptions &options);
+
+    Program compile();
+
+private:
+    void block(NodeId id, std::vector<PendingInstruction> &code);
+    void statement(NodeId id);
+    void if_statement(NodeId id);
+    std::uint32_t expression(NodeId id, std::size_t depth);
+    bool constant_value(NodeId id, std::complex<double> &value) const;
+    std::uint32_t variable(std::string name);
+    std::uint32_t constant(std::complex<double> value);
+    std::uint32_t temporary(std::size_t depth);
+    void emit(Opcode op, std::uint32_t dst, std::uint32_t a = 0, std::uint32_t b = 0);
+    std::size_t emit_jump();
+    void patch_jump(std::size_t jump);
+    std::uint16_t relocate(std::uint32_t reg) const;
+    std::vector<Instruction> finish(const std::vector<PendingInstruction> &code) const;
+
+    const Entry &m_entry;
+    std::string_view m_text;
+    Opcode m_functions[4]{};
+    Program m_program;
+    std::vector<PendingInstruction> m_init;
+    std::vector<PendingInstruction> m_iteration;
+    std::vector<PendingInstruction> m_bailout;
+    std::vector<PendingInstruction> *m_code{};
+    std::size_t m_temporaries{};
+    std::uint8_t m_level{};
+};
+
+Compiler::Compiler(const Entry &entry, std::string_view text, const CompileOptions &options) :
+    m_entry(entry),
+    m_text(text)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        m_functions[i] = function_opcode(lowered(options.functions[i]));
+    }
+    for (const char *name : PREDEFINED_VARIABLES)
+    {
+        m_program.variables.emplace_back(name);
+    }
+}
+
+Program Compiler::compile()
+{
+    if (!m_entry.diagnostics.empty())
+    {
+        throw std::runtime_error(m_entry.name + ": " + m_entry.diagnostics.front().message);
+    }
+    if (m_entry.bailout == NO_NODE)
+    {
+        throw std::runtime_error(m_entry.name + ": Missing bailout condition");
+    }
+
+    block(m_entry.init, m_init);
+    block(m_entry.iteration, m_iteration);
+    m_code = &m_bailout;
+    const std::uint32_t condition = expression(m_entry.bailout, 0);
+
+    m_program.constant_base = static_cast<std::uint16_t>(m_program.variables.size());
+    const std::size_t temporary_base = m_program.variables.size() + m_program.constants.size();
+    if (temporary_base + m_temporaries > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::runtime_error(m_entry.name + ": Formula has too many registers");
+    }
+    m_program.register_count = static_cast<std::uint16_t>(temporary_base + m_temporaries);
+    m_program.bailout_register = relocate(condition);
+    m_program.init = finish(m_init);
+    m_program.iteration = finish(m_iteration);
+    m_program.bailout = finish(m_bailout);
+    return std::move(m_program);
+}
+
+void Compiler::block(NodeId id, std::vector<PendingInstruction> &code)
+{
+    m_code = &code;
+    if (id == NO_NODE)
+    {
+        return;
+    }
+    for (NodeId child = m_entry.node(id).first_child; child != NO_NODE; child = m_entry.node(child).next_sibling)
+    {
+        statement(child);
+    }
+}
+
+void Compiler::statement(NodeId id)
+{
+    if (m_entry.node(id).kind == NodeKind::IF)
+    {
+        if_statement(id);
+    }
+    else
+    {
+        expression(id, 0);
+    }
+}
+
+void Compiler::if_statement(NodeId id)
+{
+    if (m_level == std::numeric_limits<std::uint8_t>::max() - 1)
+    {
+        throw std::runtime_error(m_entry.name + ": Formula nests too deeply");
+    }
+
+    // The first clause picks its lanes with IF; each later clause starts from the
+    // lanes no earlier clause took, so it can be skipped as soon as none are left.
+    const NodeId condition = m_entry.node(id).first_child;
+    const NodeId then_block = m_entry.node(condition).next_sibling;
+    const std::uint32_t taken = expression(condition, 0);
+    ++m_level;
+    m_program.levels = std::max<std::uint8_t>(m_program.levels, m_level + 1);
+    emit(Opcode::IF, 0, taken);
+    std::size_t skip = emit_jump();
+    block(then_block, *m_code);
+    patch_jump(skip);
+
+    std::vector<std::size_t> to_end;
+    for (NodeId clause = m_entry.node(then_block).next_sibling; clause != NO_NODE;
+         clause = m_entry.node(clause).next_sibling)
+    {
+        emit(Opcode::ELSE, 0);
+        to_end.push_back(emit_jump());
+        NodeId body = m_entry.node(clause).first_child;
+        if (m_entry.node(clause).kind == NodeKind::ELSEIF)
+        {
+            emit(Opcode::AND_IF, 0, expression(body, 0));
+            body = m_entry.node(body).next_sibling;
+        }
+        skip = emit_jump();
+        block(body, *m_code);
+        patch_jump(skip);
+    }
+    for (const std::size_t jump : to_end)
+    {
+        patch_jump(jump);
+    }
+    --m_level;
+}
+
+// Compiles an expression whose temporaries start at depth and returns the register
+// holding its value; variables and constants are used in place.
+std::uint32_t Compiler::expression(NodeId id, std::size_t depth)
+{
+    std::complex<double> value;
+    if (constant_value(id, value))
+    {
+        return constant(value);
+    }
+
+    const Node &node = m_entry.node(id);
+    switch (node.kind)
+    {
+    case NodeKind::IDENTIFIER:
+        return variable(lowered(m_entry.text(m_text, id)));
+
+    case NodeKind::ASSIGN:
+    {
+        const std::uint32_t target = variable(lowered(m_entry.text(m_text, node.first_child)));
+        const std::uint32_t source = expression(m_entry.node(node.first_child).next_sibling, depth);
+        emit(Opcode::STORE, target, source);
+        return target;
+    }
+
+    case NodeKind::CALL:
+    {
+        const std::string_view call = m_entry.text(m_text, id);
+        const std::string name = lowered(
+            call.substr(0, std::find_if_not(call.begin(), call.end(), is_identifier_char) - call.begin()));
+        const bool bound = name.size() == 3 && name.compare(0, 2, "fn") == 0 && name[2] >= '1' && name[2] <= '4';
+        const Opcode op = bound ? m_functions[name[2] - '1'] : function_opcode(name);
+        const std::uint32_t argument = expression(node.first_child, depth);
+        const std::uint32_t result = temporary(depth);
+        emit(op, result, argument);
+        return result;
+    }
+
+    case NodeKind::MODULUS:
+    case NodeKind::UNARY:
+    {
+        const std::uint32_t operand = expression(node.first_child, depth);
+        const std::uint32_t result = temporary(depth);
+        emit(node.kind == NodeKind::MODULUS ? Opcode::MODULUS : Opcode::NEGATE, result, operand);
+        return result;
+    }
+
+    case NodeKind::COMPLEX:
+    case NodeKind::BINARY:
+    {
+        const NodeId rhs = m_entry.node(node.first_child).next_sibling;
+        std::complex<double> exponent;
+        if (node.op == Operator::POWER && constant_value(rhs, exponent) && exponent == 2.0)
+        {
+            const std::uint32_t operand = expression(node.first_child, depth);
+            const std::uint32_t result = temporary(depth);
+            emit(Opcode::SQR, result, operand);
+            return result;
+        }
+        const std::uint32_t a = expression(node.first_child, depth);
+        const std::uint32_t b = expression(rhs, depth + 1);
+        const std::uint32_t result = temporary(depth);
+        emit(node.kind == NodeKind::COMPLEX ? Opcode::MAKE_COMPLEX : operator_opcode(node.op), result, a, b);
+        return result;
+    }
+
+    case NodeKind::NUMBER:
+    case NodeKind::BLOCK:
+    case NodeKind::IF:
+    case NodeKind::ELSEIF:
+    case NodeKind::ELSE:
+        break;
+    }
+    throw std::runtime_error(m_entry.name + ": Unexpected statement");
+}
+
+bool Compiler::constant_value(NodeId id, std::complex<double> &value) const
+{
+    const Node &node = m_entry.node(id);
+    switch (node.kind)
+    {
+    case NodeKind::NUMBER:
+        value = m_entry.numbers[node.value];
+        return true;
+
+    case NodeKind::UNARY:
+        if (constant_value(node.first_child, value))
+        {
+            value = -value;
+            return true;
+        }
+        return false;
+
+    case NodeKind::COMPLEX:
+    {
+        std::complex<double> real;
+        std::complex<double> imaginary;
+        if (constant_value(node.first_child, real)
+            && constant_value(m_entry.node(node.first_child).next_sibling, imaginary))
+        {
+            value = {real.real(), imaginary.real()};
+            return true;
+        }
+        return false;
+    }
+
+    default:
+        return false;
+    }
+}
+
+std::uint32_t Compiler::variable(std::string name)
+{
+    const auto it = std::find(m_program.variables.begin(), m_program.variables.end(), name);
+    if (it != m_program.variables.end())
+    {
+        return tagged(RegisterKind::VARIABLE, it - m_program.variables.begin());
+    }
+    m_program.variables.push_back(std::move(name));
+    return tagged(RegisterKind::VARIABLE, m_program.variables.size() - 1);
+}
+
+std::uint32_t Compiler::constant(std::complex<double> value)
+{
+    const auto it = std::find(m_program.constants.begin(), m_program.constants.end(), value);
+    if (it != m_program.constants.end())
+    {
+        return tagged(RegisterKind::CONSTANT, it - m_program.constants.begin());
+    }
+    m_program.constants.push_back(value);
+    return tagged(RegisterKind::CONSTANT, m_program.constants.size() - 1);
+}
+
+std::uint32_t Compiler::temporary(std::size_t depth)
+{
+    m_temporaries = std::max(m_temporaries, depth + 1);
+    return tagged(RegisterKind::TEMPORARY, depth);
+}
+
+void Compiler::emit(Opcode op, std::uint32_t dst, std::uint32_t a, std::uint32_t b)
+{
+    m_code->push_back({op, m_level, dst, a, b});
+}
+
+std::size_t Compiler::emit_jump()
+{
+    emit(Opcode::JUMP_IF_NONE, 0);
+    return m_code->size() - 1;
+}
+
+void Compiler::patch_jump(std::size_t jump)
+{
+    if (m_code->size() > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::runtime_error(m_entry.name + ": Formula is too long");
+    }
+    (*m_code)[jump].dst = static_cast<std::uint32_t>(m_code->size());
+}
+
+std::uint16_t Compiler::relocate(std::uint32_t reg) const
+{
+    const auto kind = static_cast<RegisterKind>(reg >> KIND_SHIFT);
+    std::size_t index = reg & 0xFFFFU;
+    if (kind != RegisterKind::VARIABLE)
+    {
+        index += m_program.variables.size();
+    }
+    if (kind == RegisterKind::TEMPORARY)
+    {
+        index += m_program.constants.size();
+    }
+    return static_cast<std::uint16_t>(index);
+}
+
+std::vector<Instruction> Compiler::finish(const std::vector<PendingInstruction> &code) const
+{
+    std::vector<Instruction> result;
+    result.reserve(code.size());
+    for (const PendingInstruction &pending : code)
+    {
+        Instruction instruction{pending.op, pending.level};
+        switch (pending.op)
+        {
+        case Opcode::JUMP_IF_NONE:
+            instruction.dst = static_cast<std::uint16_t>(pending.dst);
+            break;
+        case Opcode::ELSE:
+            break;
+        case Opcode::IF:
+        case Opcode::AND_IF:
+            instruction.a = relocate(pending.a);
+            break;
+        default:
+            instruction.dst = relocate(pending.dst);
+            instruction.a = relocate(pending.a);
+            if (pending.op <= Opcode::MAKE_COMPLEX)
+            {
+                instruction.b = relocate(pending.b);
+            }
+            break;
+        }
+        result.push_back(instruction);
+    }
+    return result;
+}
+
+} // namespace
+
+Program compile(const Entry &entry, std::string_view text, const CompileOptions &options)
+{
+    return Compiler(entry, text, options).compile();
+}
+
+} // namespace formula
@@ -0,0 +1,431 @@
+#include <formula/evaluator.h>
+
+#include <formula/complex_math.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace formula
+{
+
+namespace
+{
+
+using Complex = std::complex<double>;
+
+Complex truth(bool value)
+{
+    return value ? 1.0 : 0.0;
+}
+
+// Calls function for each lane as one SIMD loop, so the lanes must not depend on
+// each other.
+template <typename Function>
+void for_lanes(Function function)
+{
+#pragma omp simd
+    for (std::size_t i = 0; i < LANES; ++i)
+    {
+        function(i);
+    }
+}
+
+template <typename Mask>
+bool any(const Mask &mask)
+{
+    std::int64_t bits{};
+#pragma omp simd reduction(| : bits)
+    for (std::size_t i = 0; i < LANES; ++i)
+    {
+        bits |= mask.lanes[i];
+    }
+    return bits != 0;
+}
+
+// value in lanes whose mask has all bits set, otherwise old; selecting bits rather
+// than comparing the mask keeps to the integer operations every SIMD level has.
+double select(std::int64_t mask, double value, double old)
+{
+    std::int64_t value_bits;
+    std::int64_t old_bits;
+    std::memcpy(&value_bits, &value, sizeof value);
+    std::memcpy(&old_bits, &old, sizeof old);
+    const std::int64_t bits = (value_bits & mask) | (old_bits & ~mask);
+    double result;
+    std::memcpy(&result, &bits, sizeof result);
+    return result;
+}
+
+// Sets each lane of dst to function(i), the value computed for that lane.  A lane
+// reads its operands before dst is written, so dst may also be an operand.
+template <typename Register, typename Function>
+void assign(Register &dst, Function function)
+{
+    for_lanes(
+        [&](std::size_t i)
+        {
+            const Complex value = function(i);
+            dst.re[i] = value.real();
+            dst.im[i] = value.imag();
+        });
+}
+
+template <typename Register>
+void broadcast(Register &reg, Complex value)
+{
+    std::fill(std::begin(reg.re), std::end(reg.re), value.real());
+    std::fill(std::begin(reg.im), std::end(reg.im), value.imag());
+}
+
+} // namespace
+
+Complex apply(Opcode op, Complex a, Complex b)
+{
+    switch (op)
+    {
+    case Opcode::ADD:
+        return a + b;
+    case Opcode::SUBTRACT:
+        return a - b;
+    case Opcode::MULTIPLY:
+        return multiply(a, b);
+    case Opcode::DIVIDE:
+        return divide(a, b);
+    case Opcode::POWER:
+        return power(a, b);
+    case Opcode::LESS:
+        return truth(a.real() < b.real());
+    case Opcode::LESS_EQUAL:
+        return truth(a.real() <= b.real());
+    case Opcode::GREATER:
+        return truth(a.real() > b.real());
+    case Opcode::GREATER_EQUAL:
+        return truth(a.real() >= b.real());
+    case Opcode::EQUAL:
+        return truth(a.real() == b.real());
+    case Opcode::NOT_EQUAL:
+        return truth(a.real() != b.real());
+    case Opcode::AND:
+        return truth(a.real() != 0.0 && b.real() != 0.0);
+    case Opcode::OR:
+        return truth(a.real() != 0.0 || b.real() != 0.0);
+    case Opcode::MAKE_COMPLEX:
+        return {a.real(), b.real()};
+
+    case Opcode::NEGATE:
+        return -a;
+    case Opcode::MODULUS:
+        return a.real() * a.real() + a.imag() * a.imag();
+    case Opcode::SIN:
+        return std::sin(a);
+    case Opcode::COS:
+        return std::cos(a);
+    case Opcode::SINH:
+        return std::sinh(a);
+    case Opcode::COSH:
+        return std::cosh(a);
+    case Opcode::COSXX:
+        return std::conj(std::cos(a));
+    case Opcode::TAN:
+        return std::tan(a);
+    case Opcode::COTAN:
+        return divide(std::cos(a), std::sin(a));
+    case Opcode::TANH:
+        return std::tanh(a);
+    case Opcode::COTANH:
+        return divide(std::cosh(a), std::sinh(a));
+    case Opcode::SQR:
+        return {a.real() * a.real() - a.imag() * a.imag(), 2.0 * a.real() * a.imag()};
+    case Opcode::LOG:
+        return std::log(a);
+    case Opcode::EXP:
+        return std::exp(a);
+    case Opcode::ABS:
+        return {std::abs(a.real()), std::abs(a.imag())};
+    case Opcode::CONJ:
+        return std::conj(a);
+    case Opcode::REAL:
+        return a.real();
+    case Opcode::IMAG:
+        return a.imag();
+    case Opcode::FLIP:
+        return {a.imag(), a.real()};
+    case Opcode::SRAND:
+        return a;
+    case Opcode::ASIN:
+        return std::asin(a);
+    case Opcode::ASINH:
+        return std::asinh(a);
+    case Opcode::ACOS:
+        return std::acos(a);
+    case Opcode::ACOSH:
+        return std::acosh(a);
+    case Opcode::ATAN:
+        return std::atan(a);
+    case Opcode::ATANH:
+        return std::atanh(a);
+    case Opcode::SQRT:
+        return std::sqrt(a);
+    case Opcode::CABS:
+        return std::sqrt(a.real() * a.real() + a.imag() * a.imag());
+    case Opcode::FLOOR:
+        return {std::floor(a.real()), std::floor(a.imag())};
+    case Opcode::CEIL:
+        return {std::ceil(a.real()), std::ceil(a.imag())};
+    case Opcode::TRUNC:
+        return {std::trunc(a.real()), std::trunc(a.imag())};
+    case Opcode::ROUND:
+        return {std::round(a.real()), std::round(a.imag())};
+
+    case Opcode::STORE:
+    case Opcode::IF:
+    case Opcode::ELSE:
+    case Opcode::AND_IF:
+    case Opcode::JUMP_IF_NONE:
+        break;
+    }
+    throw std::invalid_argument("Not an arithmetic instruction");
+}
+
+BatchEvaluator::BatchEvaluator(Program program) :
+    m_program(std::move(program)),
+    m_registers(m_program.register_count),
+    m_active(m_program.levels),
+    m_taken(m_program.levels)
+{
+    // Nothing stores to the constants, so they are filled in once.
+    for (std::size_t i = 0; i < m_program.constants.size(); ++i)
+    {
+        broadcast(m_registers[m_program.constant_base + i], m_program.constants[i]);
+    }
+}
+
+void BatchEvaluator::set_parameter(int index, std::complex<double> value)
+{
+    if (index < 1 || index > 5)
+    {
+        throw std::out_of_range("No parameter p" + std::to_string(index));
+    }
+    m_parameters[index - 1] = value;
+}
+
+void BatchEvaluator::evaluate(const double *pixel_re, const double *pixel_im, std::size_t count, int max_iterations,
+    int *iterations)
+{
+    for (std::size_t start = 0; start < count; start += LANES)
+    {
+        const std::size_t lanes = std::min(LANES, count - start);
+        for (std::size_t i = 0; i < m_program.constant_base; ++i)
+        {
+            broadcast(m_registers[i], 0.0);
+        }
+        Register &pixel = m_registers[PIXEL_REGISTER];
+        std::copy_n(pixel_re + start, lanes, pixel.re);
+        std::copy_n(pixel_im + start, lanes, pixel.im);
+        for (int i = 0; i < 5; ++i)
+        {
+            broadcast(m_registers[PARAMETER_REGISTER + i], m_parameters[i]);
+        }
+        broadcast(m_registers[PI_REGISTER], PI);
+        broadcast(m_registers[E_REGISTER], E);
+        broadcast(m_registers[MAXIT_REGISTER], max_iterations);
+
+        // Lanes past the end of a partial batch never start.
+        Mask &iterating = m_active[0];
+        for_lanes([&](std::size_t i) { iterating.lanes[i] = i < lanes ? -1 : 0; });
+        std::int64_t counts[LANES]{};
+        run(m_program.init);
+        for (int iteration = 0; iteration < max_iterations && any(iterating); ++iteration)
+        {
+            run(m_program.iteration);
+            run(m_program.bailout);
+            const Register &condition = m_registers[m_program.bailout_register];
+            for_lanes(
+                [&](std::size_t i)
+                {
+                    counts[i] -= iterating.lanes[i];
+                    iterating.lanes[i] &= condition.re[i] != 0.0 ? -1 : 0;
+                });
+        }
+        for (std::size_t i = 0; i < lanes; ++i)
+        {
+            iterations[start + i] = static_cast<int>(counts[i]);
+        }
+    }
+}
+
+void BatchEvaluator::run(const std::vector<Instruction> &code)
+{
+    std::size_t pc{};
+    while (pc < code.size())
+    {
+        const Instruction &instruction = code[pc++];
+        Register &dst = m_registers[instruction.dst];
+        const Register &a = m_registers[instruction.a];
+        const Register &b = m_registers[instruction.b];
+
+        // Arithmetic only ever writes temporaries, which a lane reads only while it is
+        // active, so it runs unmasked in every lane; only stores to variables and the
+        // functions done one lane at a time look at the active lanes.
+        switch (instruction.op)
+        {
+        case Opcode::ADD:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i] + b.re[i], a.im[i] + b.im[i]}; });
+            break;
+        case Opcode::SUBTRACT:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i] - b.re[i], a.im[i] - b.im[i]}; });
+            break;
+        case Opcode::MULTIPLY:
+            assign(dst,
+                [&](std::size_t i)
+                {
+                    return Complex{
+                        a.re[i] * b.re[i] - a.im[i] * b.im[i], a.re[i] * b.im[i] + a.im[i] * b.re[i]};
+                });
+            break;
+        case Opcode::DIVIDE:
+            assign(dst,
+                [&](std::size_t i)
+                {
+                    const double denominator = b.re[i] * b.re[i] + b.im[i] * b.im[i];
+                    return Complex{(a.re[i] * b.re[i] + a.im[i] * b.im[i]) / denominator,
+                        (a.im[i] * b.re[i] - a.re[i] * b.im[i]) / denominator};
+                });
+            break;
+        case Opcode::LESS:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] < b.re[i]); });
+            break;
+        case Opcode::LESS_EQUAL:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] <= b.re[i]); });
+            break;
+        case Opcode::GREATER:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] > b.re[i]); });
+            break;
+        case Opcode::GREATER_EQUAL:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] >= b.re[i]); });
+            break;
+        case Opcode::EQUAL:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] == b.re[i]); });
+            break;
+        case Opcode::NOT_EQUAL:
+            assign(dst, [&](std::size_t i) { return truth(a.re[i] != b.re[i]); });
+            break;
+        case Opcode::AND:
+            assign(dst, [&](std::size_t i) { return truth((a.re[i] != 0.0) & (b.re[i] != 0.0)); });
+            break;
+        case Opcode::OR:
+            assign(dst, [&](std::size_t i) { return truth((a.re[i] != 0.0) | (b.re[i] != 0.0)); });
+            break;
+        case Opcode::MAKE_COMPLEX:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i], b.re[i]}; });
+            break;
+        case Opcode::NEGATE:
+            assign(dst, [&](std::size_t i) { return Complex{-a.re[i], -a.im[i]}; });
+            break;
+        case Opcode::MODULUS:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i] * a.re[i] + a.im[i] * a.im[i]}; });
+            break;
+        case Opcode::SQR:
+            assign(dst,
+                [&](std::size_t i)
+                { return Complex{a.re[i] * a.re[i] - a.im[i] * a.im[i], 2.0 * a.re[i] * a.im[i]}; });
+            break;
+        case Opcode::ABS:
+            assign(dst, [&](std::size_t i) { return Complex{std::abs(a.re[i]), std::abs(a.im[i])}; });
+            break;
+        case Opcode::CABS:
+            assign(dst,
+                [&](std::size_t i) { return Complex{std::sqrt(a.re[i] * a.re[i] + a.im[i] * a.im[i])}; });
+            break;
+        case Opcode::CONJ:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i], -a.im[i]}; });
+            break;
+        case Opcode::REAL:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i]}; });
+            break;
+        case Opcode::IMAG:
+            assign(dst, [&](std::size_t i) { return Complex{a.im[i]}; });
+            break;
+        case Opcode::FLIP:
+            assign(dst, [&](std::size_t i) { return Complex{a.im[i], a.re[i]}; });
+            break;
+        case Opcode::SRAND:
+            assign(dst, [&](std::size_t i) { return Complex{a.re[i], a.im[i]}; });
+            break;
+
+        case Opcode::STORE:
+        {
+            const Mask &active = m_active[instruction.level];
+            for_lanes(
+                [&](std::size_t i)
+                {
+                    dst.re[i] = select(active.lanes[i], a.re[i], dst.re[i]);
+                    dst.im[i] = select(active.lanes[i], a.im[i], dst.im[i]);
+                });
+            continue;
+        }
+        case Opcode::IF:
+        {
+            const Mask &outer = m_active[instruction.level - 1];
+            Mask &active = m_active[instruction.level];
+            Mask &taken = m_taken[instruction.level];
+            for_lanes(
+                [&](std::size_t i)
+                {
+                    taken.lanes[i] = a.re[i] != 0.0 ? outer.lanes[i] : 0;
+                    active.lanes[i] = taken.lanes[i];
+                });
+            continue;
+        }
+        case Opcode::ELSE:
+        {
+            const Mask &outer = m_active[instruction.level - 1];
+            Mask &active = m_active[instruction.level];
+            const Mask &taken = m_taken[instruction.level];
+            for_lanes([&](std::size_t i) { active.lanes[i] = outer.lanes[i] & ~taken.lanes[i]; });
+            continue;
+        }
+        case Opcode::AND_IF:
+        {
+            Mask &active = m_active[instruction.level];
+            Mask &taken = m_taken[instruction.level];
+            for_lanes(
+                [&](std::size_t i)
+                {
+                    active.lanes[i] = a.re[i] != 0.0 ? active.lanes[i] : 0;
+                    taken.lanes[i] |= active.lanes[i];
+                });
+            continue;
+        }
+        case Opcode::JUMP_IF_NONE:
+            if (!any(m_active[instruction.level]))
+            {
+                pc = instruction.dst;
+            }
+            continue;
+
+        default:
+        {
+            // Functions such as sin have no vector form, so they go through apply()
+            // one lane at a time, skipping the lanes that would not use the result.
+            const Mask &active = m_active[instruction.level];
+            for (std::size_t i = 0; i < LANES; ++i)
+            {
+                if (active.lanes[i] != 0)
+                {
+                    const Complex value = apply(instruction.op, {a.re[i], a.im[i]}, {b.re[i], b.im[i]});
+                    dst.re[i] = value.real();
+                    dst.im[i] = value.imag();
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+} // namespace formula
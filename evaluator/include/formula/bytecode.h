@@ -0,0 +1,122 @@
+#pragma once
+
+#include <formula/ast.h>
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace formula
+{
+
+enum class Opcode : std::uint8_t
+{
+    // dst = a op b; comparisons and logic look at real parts and give 1 or 0.
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    POWER,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+    AND,
+    OR,
+    MAKE_COMPLEX, // dst = (real part of a, real part of b)
+
+    // dst = f(a)
+    NEGATE,
+    MODULUS, // |a|, the squared modulus
+    SIN,
+    COS,
+    SINH,
+    COSH,
+    COSXX, // conj(cos(a)), Fractint's original cos
+    TAN,
+    COTAN,
+    TANH,
+    COTANH,
+    SQR,
+    LOG,
+    EXP,
+    ABS, // the absolute value of each part
+    CONJ,
+    REAL,
+    IMAG,
+    FLIP, // swaps the parts
+    SRAND, // a; random numbers are not supported, so seeding them does nothing
+    ASIN,
+    ASINH,
+    ACOS,
+    ACOSH,
+    ATAN,
+    ATANH,
+    SQRT,
+    CABS,
+    FLOOR,
+    CEIL,
+    TRUNC,
+    ROUND,
+
+    // Control flow.  Each lane is active or not at each if nesting level; level 0
+    // holds the lanes still iterating.  Stores only change the active lanes.
+    STORE,        // variable dst = a in the lanes active at level
+    IF,           // active[level] = taken[level] = active[level - 1] && a
+    ELSE,         // active[level] = active[level - 1] && !taken[level]
+    AND_IF,       // active[level] = active[level] && a; taken[level] |= active[level]
+    JUMP_IF_NONE, // to instruction dst when no lane is active at level
+};
+
+struct Instruction
+{
+    Opcode op{};
+    std::uint8_t level{};
+    std::uint16_t dst{};
+    std::uint16_t a{};
+    std::uint16_t b{};
+};
+
+// Variables every formula can use; they occupy the first registers in this order.
+constexpr const char *PREDEFINED_VARIABLES[]{"pixel", "p1", "p2", "p3", "p4", "p5", "pi", "e", "maxit"};
+constexpr std::uint16_t PIXEL_REGISTER{0};
+constexpr std::uint16_t PARAMETER_REGISTER{1}; // p1; p2 to p5 follow
+constexpr std::uint16_t PI_REGISTER{6};
+constexpr std::uint16_t E_REGISTER{7};
+constexpr std::uint16_t MAXIT_REGISTER{8};
+
+// A formula entry compiled to code for a register machine over complex values.
+// Registers hold the variables, then the constants, then temporaries.
+struct Program
+{
+    std::vector<Instruction> init;
+    std::vector<Instruction> iteration;
+    std::vector<Instruction> bailout; // leaves the condition in bailout_register
+    std::vector<std::string> variables;
+    std::vector<std::complex<double>> constants;
+    std::uint16_t constant_base{};
+    std::uint16_t register_count{};
+    std::uint16_t bailout_register{};
+    std::uint8_t levels{1}; // if nesting levels, plus level 0
+};
+
+struct CompileOptions
+{
+    // The functions that fn1 to fn4 stand for; Fractint's defaults.
+    std::string functions[4]{"sin", "sqr", "sinh", "cosh"};
+};
+
+// The instruction for a binary operator, and for a built-in function by lower case
+// name; both throw std::runtime_error for anything else.
+Opcode operator_opcode(Operator op);
+Opcode function_opcode(const std::string &name);
+
+// Compiles an entry without diagnostics; throws std::runtime_error when the entry
+// has errors or is too large for 16-bit registers and jumps.
+Program compile(const Entry &entry, std::string_view text, const CompileOptions &options = {});
+
+} // namespace formula
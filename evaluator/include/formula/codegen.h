@@ -0,0 +1,17 @@
+#pragma once
+
+#include <formula/bytecode.h>
+
+#include <string>
+
+namespace formula
+{
+
+// Translates a compiled formula into the source of a plug-in exporting it as a
+// NativeFormula.  Every register, constant and jump of the program is fixed in the
+// generated code, so a C++ compiler can keep values in registers, fold the
+// constants into the arithmetic and call the bound functions directly; options
+// records what fn1 to fn4 were bound to when program was compiled.
+std::string generate_cpp(const Program &program, const std::string &name, const CompileOptions &options = {});
+
+} // namespace formula
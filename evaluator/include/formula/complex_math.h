@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+
+namespace formula
+{
+
+// The values of the predefined variables pi and e.
+constexpr double PI{3.14159265358979323846};
+constexpr double E{2.71828182845904523536};
+
+// Complex arithmetic shared by the evaluator and by formulas compiled ahead of time,
+// so both give the same results.  Multiplication and division are written out
+// rather than left to std::complex, which takes a slower and subtly different route
+// around infinities and is harder for compilers to vectorize.
+
+inline std::complex<double> multiply(std::complex<double> a, std::complex<double> b)
+{
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+inline std::complex<double> divide(std::complex<double> a, std::complex<double> b)
+{
+    const double denominator = b.real() * b.real() + b.imag() * b.imag();
+    return {(a.real() * b.real() + a.imag() * b.imag()) / denominator,
+        (a.imag() * b.real() - a.real() * b.imag()) / denominator};
+}
+
+// Integer powers up to this are computed by repeated squaring, which is both
+// faster and more accurate than going through exp and log.
+constexpr double MAX_INTEGER_POWER{64.0};
+
+inline std::complex<double> power(std::complex<double> base, std::complex<double> exponent)
+{
+    const double n = exponent.real();
+    if (exponent.imag() == 0.0 && n == std::trunc(n) && std::abs(n) <= MAX_INTEGER_POWER)
+    {
+        std::complex<double> result{1.0};
+        for (auto bits = static_cast<unsigned>(std::abs(n)); bits != 0; bits >>= 1)
+        {
+            if (bits & 1U)
+            {
+                result = multiply(result, base);
+            }
+            base = multiply(base, base);
+        }
+        return n < 0.0 ? divide(1.0, result) : result;
+    }
+    if (base == 0.0)
+    {
+        return {};
+    }
+    return std::exp(exponent * std::log(base));
+}
+
+} // namespace formula
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <formula/bytecode.h>
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace formula
+{
+
+// Pixels evaluated together; each register holds this many real and imaginary parts.
+constexpr std::size_t LANES{8};
+
+// The result of an arithmetic instruction or function for a single value of a and
+// b; BatchEvaluator computes the same values in each of its lanes.
+std::complex<double> apply(Opcode op, std::complex<double> a, std::complex<double> b = {});
+
+// Runs a compiled formula over batches of LANES pixels at a time.
+//
+// Registers are kept in structure-of-arrays form, so each instruction is a loop
+// of fixed length over independent lanes, and the cost of decoding an instruction
+// is shared by the whole batch.  The arithmetic loops are SIMD loops; functions
+// such as sin go through apply() one lane at a time.  A lane stops when its
+// bailout condition fails: from then on it is masked out of every store and
+// function call, and the batch finishes once no lane is left iterating.
+class BatchEvaluator
+{
+public:
+    explicit BatchEvaluator(Program program);
+
+    // Sets p1 to p5, for index 1 to 5.
+    void set_parameter(int index, std::complex<double> value);
+
+    // Iterates each pixel until its bailout condition fails or max_iterations is
+    // reached; iterations[i] receives the number of iterations pixel i ran.
+    void evaluate(const double *pixel_re, const double *pixel_im, std::size_t count, int max_iterations,
+        int *iterations);
+
+private:
+    struct alignas(64) Register
+    {
+        double re[LANES];
+        double im[LANES];
+    };
+    struct alignas(64) Mask
+    {
+        std::int64_t lanes[LANES]; // all bits set in active lanes
+    };
+
+    void run(const std::vector<Instruction> &code);
+
+    Program m_program;
+    std::vector<Register> m_registers;
+    std::vector<Mask> m_active;
+    std::vector<Mask> m_taken;
+    std::complex<double> m_parameters[5]{};
+};
+
+} // namespace formula
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+
+#if WIN32
+#define FORMULA_NATIVE_EXPORT __declspec(dllexport)
+#else
+#define FORMULA_NATIVE_EXPORT
+#endif
+
+namespace formula
+{
+
+// The interface of a formula compiled ahead of time by formula-compile into a
+// plug-in.  The plug-in exports one function, NATIVE_ENTRY_POINT, of type
+// GetNativeFormulaFn, returning a description of the formula it holds.
+constexpr int NATIVE_ABI_VERSION{1};
+constexpr const char *NATIVE_ENTRY_POINT{"GetNativeFormula"};
+
+// Iterates count pixels, given in structure-of-arrays form, like BatchEvaluator;
+// parameters holds the real and imaginary parts of p1 to p5 in turn.
+using NativeEvaluateFn = void(const double *pixel_re, const double *pixel_im, std::size_t count, int max_iterations,
+    const double *parameters, int *iterations);
+
+struct NativeFormula
+{
+    int abi_version;
+    const char *name;
+    const char *functions[4]; // what fn1 to fn4 were bound to
+    NativeEvaluateFn *evaluate;
+};
+
+using GetNativeFormulaFn = const NativeFormula *();
+
+} // namespace formula
@@ -0,0 +1,129 @@
+#include "lexer_cost.h"
+
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace formula
+{
+
+namespace
+{
+
+// The example styles a screenful or so at a time; small pieces exercise carrying on part way along lines.
+constexpr Sci_Position CHUNK{256};
+
+struct LexerDeleter
+{
+    void operator()(ILexer *lexer) const
+    {
+        lexer->Release();
+    }
+};
+
+int open_instruction_counter()
+{
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    return -1;
+#endif
+}
+
+} // namespace
+
+LexerCost::LexerCost(std::string_view typical) :
+    m_counter(open_instruction_counter())
+{
+    m_fixed = measure({}, 5);
+    m_typical = measure(typical, 5) / static_cast<double>(std::max<std::size_t>(typical.size(), 1));
+}
+
+LexerCost::~LexerCost()
+{
+#ifdef __linux__
+    if (m_counter >= 0)
+    {
+        close(m_counter);
+    }
+#endif
+}
+
+double LexerCost::measure(std::string_view text, int runs)
+{
+    double lowest{std::numeric_limits<double>::max()};
+    for (int run = 0; run < runs; ++run)
+    {
+        lowest = std::min(lowest, style(text));
+    }
+    return std::max(lowest - m_fixed, 0.0);
+}
+
+double LexerCost::relative(std::string_view text, int runs)
+{
+    if (text.empty() || m_typical <= 0.0)
+    {
+        return 0.0;
+    }
+    return measure(text, runs) / static_cast<double>(text.size()) / m_typical;
+}
+
+double LexerCost::style(std::string_view text)
+{
+    std::unique_ptr<ILexer, LexerDeleter> lexer{create_lexer()};
+    lexer->PrivateCall(+LexerCall::INDEX_IDENTIFIERS, nullptr);
+    MemoryDocument doc{std::string{text}};
+    const auto restyle = [&]
+    {
+        doc.colourise(lexer.get(), doc.Length());
+        doc.StartStyling(0, 0);
+        while (doc.end_styled() < doc.Length())
+        {
+            doc.colourise_from_end_styled(lexer.get(), doc.end_styled() + CHUNK);
+        }
+    };
+
+#ifdef __linux__
+    if (m_counter >= 0)
+    {
+        ioctl(m_counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_counter, PERF_EVENT_IOC_ENABLE, 0);
+        restyle();
+        ioctl(m_counter, PERF_EVENT_IOC_DISABLE, 0);
+        std::uint64_t instructions{};
+        if (read(m_counter, &instructions, sizeof(instructions)) == sizeof(instructions))
+        {
+            return static_cast<double>(instructions);
+        }
+    }
+#endif
+    const auto begin = std::chrono::steady_clock::now();
+    restyle();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+}
+
+} // namespace formula
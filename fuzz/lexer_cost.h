@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string_view>
+
+namespace formula
+{
+
+// Measures what styling text with the formula lexer costs, styled the way the example styles
+// it: the whole document at once, then again a piece at a time from the start.  The cost is
+// counted in instructions where the system lets a process count its own, and otherwise in
+// nanoseconds; either way it is best compared with the cost of typical text.
+class LexerCost
+{
+public:
+    // Measures typical text, as the yardstick for relative().
+    explicit LexerCost(std::string_view typical);
+    ~LexerCost();
+    LexerCost(const LexerCost &) = delete;
+    LexerCost &operator=(const LexerCost &) = delete;
+
+    // The cost of styling text beyond that of styling nothing, the lowest of runs measurements.
+    double measure(std::string_view text, int runs);
+
+    // The cost per byte of styling text over the cost per byte of the typical text.
+    double relative(std::string_view text, int runs);
+
+    bool counts_instructions() const
+    {
+        return m_counter >= 0;
+    }
+    const char *unit() const
+    {
+        return counts_instructions() ? "instructions" : "ns";
+    }
+
+private:
+    double style(std::string_view text);
+
+    int m_counter{-1}; // a perf event counting this thread's instructions
+    double m_fixed{};
+    double m_typical{}; // per byte
+};
+
+} // namespace formula
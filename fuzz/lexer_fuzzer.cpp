@@ -0,0 +1,115 @@
+#include "lexer_cost.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+// Styles each input with the formula lexer and keeps any that cost much more per byte than
+// typical formula text, so that Lex or Fold going superlinear on some input is caught.  Kept
+// inputs are written to a directory, to be copied into bench/corpus/worst-case where
+// bench-worst-case replays them.
+//
+// libFuzzer owns the command line, so the target is configured from the environment:
+//   FORMULA_FUZZ_THRESHOLD  relative cost per byte above which an input is kept (default 4)
+//   FORMULA_FUZZ_SAVE_DIR   where kept inputs are written (default worst-case)
+
+namespace
+{
+
+// Below this size the cost of an input is too small to measure reliably.
+constexpr std::size_t MIN_JUDGED_SIZE{512};
+// An input over the threshold is measured again, keeping the lowest, before it is kept.
+constexpr int CONFIRM_RUNS{5};
+
+std::string read_file(const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+// FNV-1a, to name kept inputs by their contents.
+std::string content_name(std::string_view text)
+{
+    std::uint64_t hash{14695981039346656037ULL};
+    for (const char ch : text)
+    {
+        hash = (hash ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+    }
+    std::ostringstream name;
+    name << std::hex << hash << ".frm";
+    return name.str();
+}
+
+class Fuzzer
+{
+public:
+    Fuzzer();
+
+    void run(std::string_view input);
+
+private:
+    formula::LexerCost m_cost;
+    double m_threshold{4.0};
+    std::filesystem::path m_save_dir{"worst-case"};
+    double m_worst{};
+};
+
+Fuzzer::Fuzzer() :
+    m_cost(read_file(FORMULA_CORPUS_DIR "/id-formula.frm"))
+{
+    if (const char *threshold = std::getenv("FORMULA_FUZZ_THRESHOLD"))
+    {
+        m_threshold = std::atof(threshold);
+    }
+    if (const char *save_dir = std::getenv("FORMULA_FUZZ_SAVE_DIR"))
+    {
+        m_save_dir = save_dir;
+    }
+    std::cerr << "fuzz-lexer: counting " << m_cost.unit() << ", keeping inputs over " << m_threshold
+              << "x the typical cost per byte in " << m_save_dir.string() << '\n';
+}
+
+void Fuzzer::run(std::string_view input)
+{
+    if (input.size() < MIN_JUDGED_SIZE)
+    {
+        m_cost.measure(input, 1);
+        return;
+    }
+    double relative = m_cost.relative(input, 1);
+    if (relative <= m_threshold && relative <= m_worst)
+    {
+        return;
+    }
+    relative = m_cost.relative(input, CONFIRM_RUNS);
+    if (relative > m_worst)
+    {
+        m_worst = relative;
+        std::cerr << "fuzz-lexer: worst so far " << relative << "x typical, " << input.size() << " bytes\n";
+    }
+    if (relative > m_threshold)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(m_save_dir, error);
+        const std::filesystem::path path = m_save_dir / content_name(input);
+        std::ofstream out(path, std::ios::binary);
+        out.write(input.data(), static_cast<std::streamsize>(input.size()));
+        std::cerr << "fuzz-lexer: kept " << path.string() << '\n';
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    static Fuzzer fuzzer;
+    fuzzer.run(std::string_view{reinterpret_cast<const char *>(data), size});
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// A stand-in for libFuzzer's driver, so the fuzz target runs wherever the project builds.  It feeds
+// the target each seed, then mutations of them.  It doesn't follow coverage the way libFuzzer does;
+// instead its mutations favour what makes a lexer slow: repetition, long runs and long words.
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size);
+
+namespace
+{
+
+struct Options
+{
+    std::size_t runs{10000};
+    std::size_t max_len{64 * 1024};
+    unsigned int seed{1};
+    std::vector<std::filesystem::path> seeds;
+};
+
+// Pieces of formula text that change the lexer's state when inserted.
+const char *const TOKENS[]{"if", "elseif", "endif", "while", "endwhile", "sin", "cabs", "pixel", "{", "}", "(", ")",
+    "[", "]", "|", ";", ":", "=", "\"", "\n", " ", "1.5e3", "0x", "x", "_"};
+
+void run_one(const std::string &input)
+{
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t *>(input.data()), input.size());
+}
+
+void add_seed(std::vector<std::string> &seeds, const std::filesystem::path &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (in)
+    {
+        seeds.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+}
+
+std::vector<std::string> read_seeds(const std::vector<std::filesystem::path> &paths)
+{
+    std::vector<std::string> seeds;
+    for (const std::filesystem::path &path : paths)
+    {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error))
+        {
+            for (const auto &entry : std::filesystem::directory_iterator(path))
+            {
+                if (entry.is_regular_file())
+                {
+                    add_seed(seeds, entry.path());
+                }
+            }
+        }
+        else
+        {
+            add_seed(seeds, path);
+        }
+    }
+    return seeds;
+}
+
+class Mutator
+{
+public:
+    Mutator(unsigned int seed, std::size_t max_len) :
+        m_random(seed),
+        m_max_len(max_len)
+    {
+    }
+
+    std::string mutate(std::string text);
+
+private:
+    std::size_t below(std::size_t bound)
+    {
+        return bound == 0 ? 0 : std::uniform_int_distribution<std::size_t>(0, bound - 1)(m_random);
+    }
+
+    std::mt19937 m_random;
+    std::size_t m_max_len;
+};
+
+std::string Mutator::mutate(std::string text)
+{
+    const std::size_t mutations = 1 + below(4);
+    for (std::size_t i = 0; i < mutations; ++i)
+    {
+        const std::size_t position = below(text.size() + 1);
+        switch (below(5))
+        {
+        case 0:
+        {
+            // Repeat a slice of the text many times over.
+            const std::size_t length = 1 + below(std::min<std::size_t>(text.size() - position, 64));
+            const std::string slice = text.substr(position, length);
+            std::string repeated;
+            for (std::size_t count = 1 + below(1000); count > 0; --count)
+            {
+                repeated += slice;
+            }
+            text.insert(position, repeated);
+            break;
+        }
+        case 1:
+            // A long run of one character: a long word, number, comment or string.
+            text.insert(position, 1 + below(4096), static_cast<char>(text.empty() || below(2) == 0
+                                                                         ? "aZ_9.;\" \n"[below(9)]
+                                                                         : text[below(text.size())]));
+            break;
+        case 2:
+            text.insert(position, TOKENS[below(std::size(TOKENS))]);
+            break;
+        case 3:
+            text.erase(position, below(256));
+            break;
+        default:
+        {
+            // Move a piece of the text elsewhere in it.
+            const std::size_t from = below(text.size() + 1);
+            text.insert(position, text.substr(from, below(256)));
+            break;
+        }
+        }
+        if (text.size() > m_max_len)
+        {
+            text.resize(m_max_len);
+        }
+    }
+    return text;
+}
+
+void usage()
+{
+    std::cerr << "Usage: fuzz-lexer [--runs <count>] [--max-len <bytes>] [--seed <number>] [<file or directory>...]\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if ((arg == "--runs" || arg == "--max-len" || arg == "--seed") && i + 1 < argc)
+        {
+            const auto value = std::strtoul(argv[++i], nullptr, 10);
+            if (arg == "--runs")
+            {
+                options.runs = value;
+            }
+            else if (arg == "--max-len")
+            {
+                options.max_len = value;
+            }
+            else
+            {
+                options.seed = static_cast<unsigned int>(value);
+            }
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            options.seeds.emplace_back(arg);
+        }
+    }
+    if (options.seeds.empty())
+    {
+        options.seeds.emplace_back(FORMULA_CORPUS_DIR "/id-formula.frm");
+        options.seeds.emplace_back(FORMULA_CORPUS_DIR "/worst-case");
+    }
+
+    std::vector<std::string> seeds = read_seeds(options.seeds);
+    if (seeds.empty())
+    {
+        seeds.emplace_back();
+    }
+    for (const std::string &seed : seeds)
+    {
+        run_one(seed.substr(0, options.max_len));
+    }
+    Mutator mutator(options.seed, options.max_len);
+    std::mt19937 pick(options.seed);
+    for (std::size_t run = 0; run < options.runs; ++run)
+    {
+        run_one(mutator.mutate(seeds[pick() % seeds.size()].substr(0, options.max_len)));
+        if ((run + 1) % 1000 == 0)
+        {
+            std::cerr << "fuzz-lexer: " << run + 1 << " runs\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "entry_index.h"
+
+#include <formula/vocabulary.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace formula
+{
+
+namespace
+{
+
+std::string to_lower(std::string_view text)
+{
+    std::string result{text};
+    std::transform(result.begin(), result.end(), result.begin(),
+        [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+    return result;
+}
+
+bool is_space(char ch)
+{
+    return std::isspace(static_cast<unsigned char>(ch)) != 0;
+}
+
+} // namespace
+
+void EntryScanner::scan(char ch, std::size_t position)
+{
+    if (m_in_comment)
+    {
+        return;
+    }
+    switch (ch)
+    {
+    case COMMENT_CHAR:
+        m_in_comment = true;
+        m_naming = false;
+        break;
+
+    case '{':
+        while (!m_name.empty() && is_space(m_name.back()))
+        {
+            m_name.pop_back();
+        }
+        m_braces.push_back({m_name.empty() ? position : m_name_position, true, std::move(m_name)});
+        m_name.clear();
+        m_in_entry = true;
+        m_opened = true;
+        m_naming = false;
+        break;
+
+    case '}':
+        if (m_in_entry)
+        {
+            m_braces.push_back({position, false, {}});
+            m_in_entry = false;
+            m_closed = true;
+            // Another entry may follow on the same line.
+            m_naming = true;
+            m_name.clear();
+        }
+        break;
+
+    case '(':
+        m_naming = false;
+        break;
+
+    default:
+        if (m_naming && m_name.size() < MAX_NAME && (!m_name.empty() || !is_space(ch)))
+        {
+            if (m_name.empty())
+            {
+                m_name_position = position;
+            }
+            m_name += ch;
+        }
+        break;
+    }
+}
+
+void EntryScanner::end_line(std::vector<EntryBrace> &braces)
+{
+    add_braces(braces);
+    m_in_comment = false;
+    m_naming = true;
+    m_opened = false;
+    m_closed = false;
+    m_name.clear();
+}
+
+void EntryScanner::add_braces(std::vector<EntryBrace> &braces)
+{
+    std::move(m_braces.begin(), m_braces.end(), std::back_inserter(braces));
+    m_braces.clear();
+}
+
+void EntryIndex::index_text(std::string_view text)
+{
+    EntryScanner scanner;
+    std::vector<EntryBrace> braces;
+    for (std::size_t i = 0; i < text.size(); ++i)
+    {
+        if (text[i] == '\n')
+        {
+            scanner.end_line(braces);
+        }
+        else
+        {
+            scanner.scan(text[i], i);
+        }
+    }
+    scanner.end_line(braces);
+    *this = EntryIndex{};
+    m_length = text.size();
+    replace_range(0, text.size(), text.size(), std::move(braces));
+}
+
+void EntryIndex::replace_range(std::size_t start, std::size_t end, std::size_t length,
+    std::vector<EntryBrace> &&braces)
+{
+    // Before the change in length the refolded range was [start, old_end).
+    const std::ptrdiff_t added = static_cast<std::ptrdiff_t>(length) - static_cast<std::ptrdiff_t>(m_length);
+    const std::size_t old_end = static_cast<std::size_t>(std::max(static_cast<std::ptrdiff_t>(end) - added,
+        static_cast<std::ptrdiff_t>(start)));
+    const std::size_t first = lower_bound(start);
+    const std::size_t last = lower_bound(old_end);
+    move_step(last);
+
+    // The braces in the range go with it.  A closing brace after it belonged to the entry open
+    // across the range, and closes whichever entry is open there now.
+    std::size_t carried{NO_POSITION};
+    const auto drop_close = [&](Slot &slot)
+    {
+        if (slot.close != NO_POSITION && slot.close >= start)
+        {
+            if (slot.close >= old_end)
+            {
+                carried = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(slot.close) + added);
+            }
+            slot.close = NO_POSITION;
+        }
+    };
+    if (first > 0)
+    {
+        drop_close(m_slots[m_order[first - 1]]);
+    }
+    for (std::size_t i = first; i < last; ++i)
+    {
+        drop_close(m_slots[m_order[i]]);
+        remove_slot(m_order[i]);
+    }
+    m_order.erase(m_order.begin() + static_cast<std::ptrdiff_t>(first),
+        m_order.begin() + static_cast<std::ptrdiff_t>(last));
+    m_step_index = first;
+    m_step += added;
+
+    // A closing brace ends the entry it is in and is ignored outside one.
+    const auto close = [&](std::size_t position)
+    {
+        if (m_step_index > 0 && m_slots[m_order[m_step_index - 1]].close == NO_POSITION)
+        {
+            m_slots[m_order[m_step_index - 1]].close = position;
+        }
+    };
+    for (EntryBrace &brace : braces)
+    {
+        if (brace.open)
+        {
+            m_order.insert(m_order.begin() + static_cast<std::ptrdiff_t>(m_step_index), add_slot(std::move(brace)));
+            ++m_step_index;
+        }
+        else
+        {
+            close(brace.position);
+        }
+    }
+    if (carried != NO_POSITION)
+    {
+        close(carried);
+    }
+    m_length = length;
+    m_listed = false;
+}
+
+const std::vector<FormulaEntry> &EntryIndex::entries()
+{
+    move_step(m_order.size());
+    if (!m_listed)
+    {
+        m_entries.clear();
+        m_entries.reserve(m_order.size());
+        for (std::size_t i = 0; i < m_order.size(); ++i)
+        {
+            m_entries.push_back(entry(i));
+        }
+        m_listed = true;
+    }
+    return m_entries;
+}
+
+const FormulaEntry *EntryIndex::find(std::string_view name)
+{
+    move_step(m_order.size());
+    const auto [begin, end] = std::equal_range(m_by_name.begin(), m_by_name.end(),
+        std::pair<std::string, SlotId>{to_lower(name), 0},
+        [](const std::pair<std::string, SlotId> &lhs, const std::pair<std::string, SlotId> &rhs)
+        { return lhs.first < rhs.first; });
+    if (begin == end)
+    {
+        return nullptr;
+    }
+    const auto first = std::min_element(begin, end,
+        [this](const std::pair<std::string, SlotId> &lhs, const std::pair<std::string, SlotId> &rhs)
+        { return m_slots[lhs.second].start < m_slots[rhs.second].start; });
+    m_found = entry(lower_bound(m_slots[first->second].start));
+    return &m_found;
+}
+
+std::size_t EntryIndex::start_of(std::size_t index) const
+{
+    const std::size_t start = m_slots[m_order[index]].start;
+    return index < m_step_index ? start : static_cast<std::size_t>(static_cast<std::ptrdiff_t>(start) + m_step);
+}
+
+// The index of the first entry starting at or after position.
+std::size_t EntryIndex::lower_bound(std::size_t position) const
+{
+    std::size_t low{};
+    std::size_t high{m_order.size()};
+    while (low < high)
+    {
+        const std::size_t middle = low + (high - low) / 2;
+        if (start_of(middle) < position)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+// Moves the step to index, so that the entries before it are up to date and those from it on
+// have yet to move by m_step.
+void EntryIndex::move_step(std::size_t index)
+{
+    const auto shift = [](Slot &slot, std::ptrdiff_t delta)
+    {
+        slot.start = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(slot.start) + delta);
+        if (slot.close != NO_POSITION)
+        {
+            slot.close = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(slot.close) + delta);
+        }
+    };
+    if (m_step != 0)
+    {
+        for (; m_step_index < index; ++m_step_index)
+        {
+            shift(m_slots[m_order[m_step_index]], m_step);
+        }
+        for (; m_step_index > index; --m_step_index)
+        {
+            shift(m_slots[m_order[m_step_index - 1]], -m_step);
+        }
+    }
+    m_step_index = index;
+    if (m_step_index == m_order.size())
+    {
+        m_step = 0;
+    }
+}
+
+EntryIndex::SlotId EntryIndex::add_slot(EntryBrace &&brace)
+{
+    SlotId slot;
+    if (m_free_slots.empty())
+    {
+        slot = static_cast<SlotId>(m_slots.size());
+        m_slots.emplace_back();
+    }
+    else
+    {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    }
+    std::pair<std::string, SlotId> key{to_lower(brace.name), slot};
+    m_by_name.insert(std::lower_bound(m_by_name.begin(), m_by_name.end(), key), std::move(key));
+    m_slots[slot] = {std::move(brace.name), brace.position, NO_POSITION};
+    return slot;
+}
+
+void EntryIndex::remove_slot(SlotId slot)
+{
+    const std::pair<std::string, SlotId> key{to_lower(m_slots[slot].name), slot};
+    const auto it = std::lower_bound(m_by_name.begin(), m_by_name.end(), key);
+    if (it != m_by_name.end() && *it == key)
+    {
+        m_by_name.erase(it);
+    }
+    m_slots[slot] = {};
+    m_free_slots.push_back(slot);
+}
+
+// The entry at index, which is up to date.  One left unclosed ends where the next starts.
+FormulaEntry EntryIndex::entry(std::size_t index) const
+{
+    const Slot &slot = m_slots[m_order[index]];
+    std::size_t end = m_length;
+    if (slot.close != NO_POSITION)
+    {
+        end = slot.close + 1;
+    }
+    else if (index + 1 < m_order.size())
+    {
+        end = m_slots[m_order[index + 1]].start;
+    }
+    return {slot.name.c_str(), slot.start, end};
+}
+
+} // namespace formula
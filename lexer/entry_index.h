@@ -0,0 +1,142 @@
+#pragma once
+
+#include <formula/lexer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace formula
+{
+
+// An opening or closing brace of an entry.  An opening brace is located by the
+// start of the entry's name and carries the name; a closing brace by itself.
+struct EntryBrace
+{
+    std::size_t position;
+    bool open;
+    std::string name;
+};
+
+// Finds the braces of formula entries a character at a time, ignoring comments.
+// An opening brace starts an entry, ending any entry left unclosed; a closing
+// brace ends the entry it is in and is ignored outside one.  The name is the
+// text on the line before the brace, up to any parenthesised symmetry.
+//
+// The folder and EntryIndex::index_text both scan with it, so they agree on
+// where the entries are.
+class EntryScanner
+{
+public:
+    explicit EntryScanner(bool in_entry = false) :
+        m_in_entry(in_entry)
+    {
+    }
+
+    void scan(char ch, std::size_t position);
+
+    // Ends the current line, adding its braces to braces, and starts the next.
+    void end_line(std::vector<EntryBrace> &braces);
+    // Adds the braces found so far on the current line to braces, carrying on with the line.
+    void add_braces(std::vector<EntryBrace> &braces);
+
+    bool in_entry() const
+    {
+        return m_in_entry;
+    }
+    // The line leaves open an entry that it opened.
+    bool opens_entry() const
+    {
+        return m_opened && m_in_entry;
+    }
+    // The line closes the entry it started in, and opens none that stays open.
+    bool closes_entry() const
+    {
+        return m_closed && !m_in_entry;
+    }
+    // The lowest position a brace found from position on can have: an opening brace is placed
+    // at the start of its name, which may already be under way.
+    std::size_t brace_position(std::size_t position) const
+    {
+        return m_name.empty() ? position : m_name_position;
+    }
+
+private:
+    static constexpr std::size_t MAX_NAME{80};
+
+    bool m_in_entry;
+    bool m_in_comment{};
+    bool m_naming{true};
+    bool m_opened{};
+    bool m_closed{};
+    std::string m_name;
+    std::size_t m_name_position{};
+    std::vector<EntryBrace> m_braces;
+};
+
+// The formula entries of a document, kept as the positions of their names and
+// closing braces.
+//
+// Like IdentifierIndex, the index only sees edits through the ranges that are
+// refolded: the entries starting in one are replaced by those from its braces,
+// and only the entries either side of it are paired with them again.  Entries
+// after the range move by the change in the document's length; as in Scintilla's
+// Partitioning, the move is kept as a pending step applied on the way to the next
+// edit, so an edit costs time for the entries between it and the last one rather
+// than for all those after it.  Queries bring every position up to date.
+//
+// Entries live in slots that keep their identity as entries come and go around
+// them, so the index by name is updated for the entries replaced alone.
+class EntryIndex
+{
+public:
+    // Indexes the whole of text, replacing everything known.
+    void index_text(std::string_view text);
+
+    // The range [start, end) of a document now length bytes long was refolded and contains
+    // braces, in order.  As for IdentifierIndex::replace_lines, the range starts at or before
+    // the first change, and the text after it is assumed to have moved by the change in length.
+    void replace_range(std::size_t start, std::size_t end, std::size_t length, std::vector<EntryBrace> &&braces);
+
+    // Every entry, in document order.
+    const std::vector<FormulaEntry> &entries();
+
+    // The first entry called name, ignoring case, or nullptr.
+    const FormulaEntry *find(std::string_view name);
+
+private:
+    using SlotId = std::uint32_t;
+
+    static constexpr std::size_t NO_POSITION{static_cast<std::size_t>(-1)};
+
+    struct Slot
+    {
+        std::string name;
+        std::size_t start{};
+        std::size_t close{NO_POSITION}; // the closing brace, if any
+    };
+
+    std::size_t start_of(std::size_t index) const;
+    std::size_t lower_bound(std::size_t position) const;
+    void move_step(std::size_t index);
+    SlotId add_slot(EntryBrace &&brace);
+    void remove_slot(SlotId slot);
+    FormulaEntry entry(std::size_t index) const;
+
+    std::vector<Slot> m_slots;
+    std::vector<SlotId> m_free_slots;
+    std::vector<SlotId> m_order; // the entries in document order
+    // Entries from m_step_index on have yet to move by m_step.
+    std::size_t m_step_index{};
+    std::ptrdiff_t m_step{};
+    std::size_t m_length{};
+    std::vector<std::pair<std::string, SlotId>> m_by_name; // lower case names and slots, sorted
+    bool m_listed{true};
+    std::vector<FormulaEntry> m_entries;
+    FormulaEntry m_found{};
+};
+
+} // namespace formula
@@ -0,0 +1,432 @@
+#include "identifier_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+
+namespace formula
+{
+
+namespace
+{
+
+constexpr IdentifierIndex::WordId NO_WORD{std::numeric_limits<IdentifierIndex::WordId>::max()};
+
+template <typename Iterator>
+std::vector<IdentifierIndex::WordId> distinct_words(Iterator begin, Iterator end)
+{
+    std::vector<IdentifierIndex::WordId> words;
+    words.reserve(static_cast<std::size_t>(std::distance(begin, end)));
+    for (Iterator it = begin; it != end; ++it)
+    {
+        words.push_back(it->word);
+    }
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+} // namespace
+
+IdentifierIndex::IdentifierIndex() :
+    m_nodes(1)
+{
+}
+
+void IdentifierIndex::add_builtin(std::string_view word)
+{
+    const WordId id = intern(word);
+    if (!m_nodes[id].builtin)
+    {
+        m_nodes[id].builtin = true;
+        if (m_nodes[id].count == 0)
+        {
+            adjust_live(id, 1);
+        }
+    }
+}
+
+IdentifierIndex::WordId IdentifierIndex::intern(std::string_view word)
+{
+    WordId node{};
+    for (const char ch : word)
+    {
+        node = child(node, ch);
+    }
+    return node;
+}
+
+void IdentifierIndex::replace_lines(std::size_t first, std::size_t last, std::size_t line_count,
+    std::vector<std::vector<Identifier>> &&lines, std::size_t first_column)
+{
+    assert(first <= last && last <= line_count && lines.size() == last - first);
+    if (first_column > 0 && first < last && first < m_lines.size())
+    {
+        // The first line is unchanged up to first_column, so its record carries on as that line.
+        splice_identifiers(m_lines[first], first_column, std::move(lines.front()));
+        lines.erase(lines.begin());
+        ++first;
+    }
+    if (m_lines.size() < first)
+    {
+        while (m_lines.size() < first)
+        {
+            m_lines.push_back(allocate_record());
+        }
+        m_numbered = false;
+    }
+
+    // Replace the old lines the relexed range covers, adjusted by the change in line count,
+    // and any that fall off the end; pad with empty lines any new lines past the relexed range.
+    const std::size_t lexed = last - first;
+    const std::size_t tail = m_lines.size() - first;
+    const std::ptrdiff_t added = static_cast<std::ptrdiff_t>(line_count) - static_cast<std::ptrdiff_t>(m_lines.size());
+    std::size_t replaced =
+        static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(lexed) - added, 0,
+            static_cast<std::ptrdiff_t>(tail)));
+    std::size_t padding{};
+    if (line_count - last >= tail - replaced)
+    {
+        padding = line_count - last - (tail - replaced);
+    }
+    else
+    {
+        replaced = tail - (line_count - last);
+    }
+
+    const std::size_t inserted = lexed + padding;
+    const std::size_t reused = std::min(replaced, inserted);
+    const auto line_identifiers = [&](std::size_t i)
+    { return i < lexed ? std::move(lines[i]) : std::vector<Identifier>{}; };
+    for (std::size_t i = 0; i < reused; ++i)
+    {
+        set_identifiers(m_lines[first + i], line_identifiers(i));
+    }
+    const auto at = m_lines.begin() + static_cast<std::ptrdiff_t>(first + reused);
+    if (inserted > replaced)
+    {
+        std::vector<RecordId> records;
+        for (std::size_t i = reused; i < inserted; ++i)
+        {
+            records.push_back(allocate_record());
+            set_identifiers(records.back(), line_identifiers(i));
+        }
+        m_lines.insert(at, records.begin(), records.end());
+        m_numbered = false;
+    }
+    else if (inserted < replaced)
+    {
+        const auto end = at + static_cast<std::ptrdiff_t>(replaced - inserted);
+        for (auto it = at; it != end; ++it)
+        {
+            free_record(*it);
+        }
+        m_lines.erase(at, end);
+        m_numbered = false;
+    }
+    prune();
+}
+
+const std::string &IdentifierIndex::complete(std::string_view prefix, std::size_t max_words)
+{
+    m_completions.clear();
+    const WordId node = find(prefix);
+    if (node != NO_WORD && m_nodes[node].live > 0 && max_words > 0)
+    {
+        std::string word{prefix};
+        collect(node, word, max_words);
+    }
+    return m_completions;
+}
+
+const std::vector<IdentifierOccurrence> &IdentifierIndex::occurrences(std::string_view word)
+{
+    m_occurrences.clear();
+    const WordId node = find(word);
+    if (node == NO_WORD)
+    {
+        return m_occurrences;
+    }
+    if (!m_numbered)
+    {
+        number_lines();
+    }
+    for (const RecordId record : m_nodes[node].records)
+    {
+        for (const Identifier &identifier : m_records[record].identifiers)
+        {
+            if (identifier.word == node)
+            {
+                m_occurrences.push_back({m_records[record].line, identifier.column});
+            }
+        }
+    }
+    std::sort(m_occurrences.begin(), m_occurrences.end(),
+        [](const IdentifierOccurrence &lhs, const IdentifierOccurrence &rhs)
+        { return lhs.line != rhs.line ? lhs.line < rhs.line : lhs.column < rhs.column; });
+    return m_occurrences;
+}
+
+IdentifierIndex::WordId IdentifierIndex::child(WordId node, char ch)
+{
+    std::vector<std::pair<char, WordId>> &children = m_nodes[node].children;
+    const auto it = std::lower_bound(children.begin(), children.end(), ch,
+        [](const std::pair<char, WordId> &entry, char value) { return entry.first < value; });
+    if (it != children.end() && it->first == ch)
+    {
+        return it->second;
+    }
+    WordId id{static_cast<WordId>(m_nodes.size())};
+    if (!m_free_nodes.empty())
+    {
+        id = m_free_nodes.back();
+        m_free_nodes.pop_back();
+    }
+    children.insert(it, {ch, id});
+    if (id == m_nodes.size())
+    {
+        m_nodes.emplace_back();
+    }
+    m_nodes[id].parent = node;
+    m_unreferenced.push_back(id);
+    return id;
+}
+
+IdentifierIndex::WordId IdentifierIndex::find(std::string_view word) const
+{
+    WordId node{};
+    for (const char ch : word)
+    {
+        const std::vector<std::pair<char, WordId>> &children = m_nodes[node].children;
+        const auto it = std::lower_bound(children.begin(), children.end(), ch,
+            [](const std::pair<char, WordId> &entry, char value) { return entry.first < value; });
+        if (it == children.end() || it->first != ch)
+        {
+            return NO_WORD;
+        }
+        node = it->second;
+    }
+    return node;
+}
+
+void IdentifierIndex::reference(WordId word)
+{
+    Node &node = m_nodes[word];
+    if (node.count++ == 0 && !node.builtin)
+    {
+        adjust_live(word, 1);
+    }
+}
+
+void IdentifierIndex::release(WordId word)
+{
+    Node &node = m_nodes[word];
+    assert(node.count > 0);
+    if (--node.count == 0 && !node.builtin)
+    {
+        adjust_live(word, -1);
+        m_unreferenced.push_back(word);
+    }
+}
+
+IdentifierIndex::RecordId IdentifierIndex::allocate_record()
+{
+    if (!m_free_records.empty())
+    {
+        const RecordId record = m_free_records.back();
+        m_free_records.pop_back();
+        return record;
+    }
+    m_records.emplace_back();
+    return static_cast<RecordId>(m_records.size() - 1);
+}
+
+void IdentifierIndex::free_record(RecordId record)
+{
+    set_identifiers(record, {});
+    m_free_records.push_back(record);
+}
+
+// Replaces the identifiers of a line, updating reference counts and the lines listed for each word.
+void IdentifierIndex::set_identifiers(RecordId record, std::vector<Identifier> &&identifiers)
+{
+    std::vector<Identifier> &current = m_records[record].identifiers;
+    for (const Identifier &identifier : identifiers)
+    {
+        reference(identifier.word);
+    }
+    for (const Identifier &identifier : current)
+    {
+        release(identifier.word);
+    }
+
+    const std::vector<WordId> old_words = distinct_words(current.begin(), current.end());
+    const std::vector<WordId> new_words = distinct_words(identifiers.begin(), identifiers.end());
+    std::vector<WordId> changed;
+    std::set_difference(
+        old_words.begin(), old_words.end(), new_words.begin(), new_words.end(), std::back_inserter(changed));
+    for (const WordId word : changed)
+    {
+        std::vector<RecordId> &records = m_nodes[word].records;
+        records.erase(std::lower_bound(records.begin(), records.end(), record));
+    }
+    changed.clear();
+    std::set_difference(
+        new_words.begin(), new_words.end(), old_words.begin(), old_words.end(), std::back_inserter(changed));
+    for (const WordId word : changed)
+    {
+        std::vector<RecordId> &records = m_nodes[word].records;
+        records.insert(std::lower_bound(records.begin(), records.end(), record), record);
+    }
+    current = std::move(identifiers);
+}
+
+// Replaces the identifiers of a line from column on, keeping those before it.  The kept
+// identifiers are only looked through for words that the line might have stopped using,
+// so carrying on along a long line costs time in proportion to what is added.
+void IdentifierIndex::splice_identifiers(
+    RecordId record, std::size_t column, std::vector<Identifier> &&identifiers)
+{
+    std::vector<Identifier> &current = m_records[record].identifiers;
+    const auto kept = std::lower_bound(current.begin(), current.end(), column,
+        [](const Identifier &identifier, std::size_t value) { return identifier.column < value; });
+    for (const Identifier &identifier : identifiers)
+    {
+        reference(identifier.word);
+    }
+    for (auto it = kept; it != current.end(); ++it)
+    {
+        release(it->word);
+    }
+
+    const std::vector<WordId> old_words = distinct_words(kept, current.end());
+    const std::vector<WordId> new_words = distinct_words(identifiers.begin(), identifiers.end());
+    current.erase(kept, current.end());
+    std::vector<WordId> dropped;
+    std::set_difference(
+        old_words.begin(), old_words.end(), new_words.begin(), new_words.end(), std::back_inserter(dropped));
+    if (!dropped.empty())
+    {
+        const std::vector<WordId> kept_words = distinct_words(current.begin(), current.end());
+        std::vector<WordId> unused;
+        std::set_difference(
+            dropped.begin(), dropped.end(), kept_words.begin(), kept_words.end(), std::back_inserter(unused));
+        for (const WordId word : unused)
+        {
+            std::vector<RecordId> &records = m_nodes[word].records;
+            records.erase(std::lower_bound(records.begin(), records.end(), record));
+        }
+    }
+    for (const WordId word : new_words)
+    {
+        std::vector<RecordId> &records = m_nodes[word].records;
+        const auto it = std::lower_bound(records.begin(), records.end(), record);
+        if (it == records.end() || *it != record)
+        {
+            records.insert(it, record);
+        }
+    }
+    current.insert(current.end(), identifiers.begin(), identifiers.end());
+}
+
+const std::vector<IdentifierOccurrence> &IdentifierIndex::occurrences(
+    std::string_view word, std::size_t first, std::size_t last)
+{
+    m_occurrences.clear();
+    const WordId node = find(word);
+    if (node == NO_WORD)
+    {
+        return m_occurrences;
+    }
+    // The lines are numbered by their place in m_lines, so the records needn't be.
+    for (std::size_t line = first; line < std::min(last, m_lines.size()); ++line)
+    {
+        for (const Identifier &identifier : m_records[m_lines[line]].identifiers)
+        {
+            if (identifier.word == node)
+            {
+                m_occurrences.push_back({line, identifier.column});
+            }
+        }
+    }
+    return m_occurrences;
+}
+
+void IdentifierIndex::number_lines()
+{
+    for (std::size_t line = 0; line < m_lines.size(); ++line)
+    {
+        m_records[m_lines[line]].line = line;
+    }
+    m_numbered = true;
+}
+
+void IdentifierIndex::adjust_live(WordId node, int delta)
+{
+    for (;;)
+    {
+        m_nodes[node].live = static_cast<std::uint32_t>(static_cast<int>(m_nodes[node].live) + delta);
+        if (node == 0)
+        {
+            break;
+        }
+        node = m_nodes[node].parent;
+    }
+}
+
+// Frees the nodes that went unreferenced and lead to no other word, and then any of
+// their ancestors left the same way.
+void IdentifierIndex::prune()
+{
+    for (WordId word : m_unreferenced)
+    {
+        while (word != 0 && m_nodes[word].parent != NO_WORD && m_nodes[word].count == 0 && !m_nodes[word].builtin
+            && m_nodes[word].children.empty())
+        {
+            Node &node = m_nodes[word];
+            const WordId parent = node.parent;
+            std::vector<std::pair<char, WordId>> &siblings = m_nodes[parent].children;
+            siblings.erase(std::find_if(siblings.begin(), siblings.end(),
+                [word](const std::pair<char, WordId> &entry) { return entry.second == word; }));
+            node = Node{};
+            node.parent = NO_WORD;
+            m_free_nodes.push_back(word);
+            word = parent;
+        }
+    }
+    m_unreferenced.clear();
+}
+
+// Appends the live words below node in sorted order; word holds the characters leading to node.
+void IdentifierIndex::collect(WordId node, std::string &word, std::size_t &remaining)
+{
+    if (m_nodes[node].count > 0 || m_nodes[node].builtin)
+    {
+        if (!m_completions.empty())
+        {
+            m_completions += ' ';
+        }
+        m_completions += word;
+        if (--remaining == 0)
+        {
+            return;
+        }
+    }
+    for (const auto &[ch, id] : m_nodes[node].children)
+    {
+        if (m_nodes[id].live == 0)
+        {
+            continue;
+        }
+        word += ch;
+        collect(id, word, remaining);
+        word.pop_back();
+        if (remaining == 0)
+        {
+            return;
+        }
+    }
+}
+
+} // namespace formula
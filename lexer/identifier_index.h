@@ -0,0 +1,116 @@
+#pragma once
+
+#include <formula/lexer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace formula
+{
+
+// A prefix trie of the built-in function names and the identifiers in a document,
+// with an inverted index from each identifier to the lines that use it.
+//
+// The document side is kept per line: when lines are relexed their previous
+// identifiers are released and the new ones referenced, so a word stays in the
+// trie exactly as long as some line uses it.  Each node counts the live words
+// beneath it, so completion only visits branches that lead to a word and costs
+// time proportional to the list it returns, not to the size of the document.
+// Nodes left with no word and nothing beneath them, such as those for the partial
+// words typed on the way to a whole one, are freed and reused.
+//
+// Lines are held in records that keep their identity while lines are inserted and
+// removed around them.  Each word lists the records that use it, so finding its
+// occurrences visits only those lines; record line numbers are refreshed lazily,
+// on the first search after the number of lines changed.
+class IdentifierIndex
+{
+public:
+    using WordId = std::uint32_t;
+
+    struct Identifier
+    {
+        std::size_t column;
+        WordId word;
+    };
+
+    IdentifierIndex();
+
+    void add_builtin(std::string_view word);
+
+    // The node for word, created if necessary; it is not referenced until used by a line,
+    // and is freed by the next replace_lines that doesn't use it.
+    WordId intern(std::string_view word);
+
+    // Lines [first, last) of a document now holding line_count lines were relexed and
+    // contain identifiers.  The lexer only sees edits through the ranges it is asked to
+    // lex, which always start at or before the first modified line; lines after the
+    // relexed range are assumed to have moved by the change in line count.  A range
+    // starting first_column into its first line keeps that line's identifiers before it.
+    void replace_lines(std::size_t first, std::size_t last, std::size_t line_count,
+        std::vector<std::vector<Identifier>> &&lines, std::size_t first_column = 0);
+
+    // Up to max_words live words starting with prefix, in sorted order and separated by spaces.
+    const std::string &complete(std::string_view prefix, std::size_t max_words);
+
+    // Every use of word in the indexed lines, in document order.
+    const std::vector<IdentifierOccurrence> &occurrences(std::string_view word);
+
+    // The uses of word on lines [first, last), in document order, visiting only those lines.
+    const std::vector<IdentifierOccurrence> &occurrences(std::string_view word, std::size_t first, std::size_t last);
+
+    std::size_t line_count() const
+    {
+        return m_lines.size();
+    }
+
+private:
+    using RecordId = std::uint32_t;
+
+    struct Node
+    {
+        WordId parent{};
+        std::uint32_t live{};  // live words in this subtree, including this node
+        std::uint32_t count{}; // references from document lines
+        bool builtin{};
+        std::vector<std::pair<char, WordId>> children; // sorted by character
+        std::vector<RecordId> records;                 // sorted; the lines using this word
+    };
+
+    struct Record
+    {
+        std::vector<Identifier> identifiers;
+        std::size_t line{};
+    };
+
+    WordId child(WordId node, char ch);
+    WordId find(std::string_view word) const;
+    void reference(WordId word);
+    void release(WordId word);
+    void adjust_live(WordId node, int delta);
+    void prune();
+    void collect(WordId node, std::string &word, std::size_t &remaining);
+    RecordId allocate_record();
+    void free_record(RecordId record);
+    void set_identifiers(RecordId record, std::vector<Identifier> &&identifiers);
+    void splice_identifiers(RecordId record, std::size_t column, std::vector<Identifier> &&identifiers);
+    void number_lines();
+
+    std::vector<Node> m_nodes;
+    std::vector<WordId> m_free_nodes;
+    // Nodes whose word went unreferenced, to be freed once replace_lines has referenced
+    // everything the lexer interned for it.
+    std::vector<WordId> m_unreferenced;
+    std::vector<RecordId> m_lines;
+    std::vector<Record> m_records;
+    std::vector<RecordId> m_free_records;
+    bool m_numbered{true};
+    std::string m_completions;
+    std::vector<IdentifierOccurrence> m_occurrences;
+};
+
+} // namespace formula
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+
+class ILexer;
+
+namespace formula
+{
+
+// Operations for ILexer::PrivateCall.
+enum class LexerCall : int
+{
+    SET_LEX_OBSERVER = 1,       // pointer is a LexObserver *, or nullptr to stop observing
+    INDEX_IDENTIFIERS = 2,      // start indexing identifiers; relex the document to index existing text
+    COMPLETE_IDENTIFIER = 3,    // pointer is a const char * prefix; returns a const char * list of words
+    FIND_OCCURRENCES = 4,       // pointer is a const char * identifier; returns const IdentifierOccurrences *
+    SET_TRACE_LOG = 5,          // pointer is a TraceLog * for Lex and Fold events, or nullptr to stop tracing
+    INDEX_ENTRIES = 6,          // pointer is a const DocumentText *; finds every formula entry in it
+    LIST_ENTRIES = 7,           // returns const FormulaEntries *
+    FIND_ENTRY = 8,             // pointer is a const char * name; returns const FormulaEntry *, or nullptr
+    MATCH_PAREN = 9,            // pointer is a ParenMatch *; returns it with its match set, or nullptr
+    FIND_LINE_OCCURRENCES = 10, // pointer is a const LineOccurrences *; returns const IdentifierOccurrences *
+};
+
+constexpr int operator+(LexerCall value)
+{
+    return static_cast<int>(value);
+}
+
+// Most words returned by LexerCall::COMPLETE_IDENTIFIER.  The words are lower case, sorted
+// and separated by spaces, ready for AutoCompShow; the list is valid until the next call.
+constexpr int MAX_COMPLETIONS{200};
+
+// A use of an identifier: its line and the byte offset of its first character within the line.
+struct IdentifierOccurrence
+{
+    std::size_t line;
+    std::size_t column;
+};
+
+// The result of LexerCall::FIND_OCCURRENCES, in document order and valid until the next call.
+// Identifiers are case insensitive, so every spelling of the identifier is included.
+struct IdentifierOccurrences
+{
+    const IdentifierOccurrence *items;
+    std::size_t count;
+};
+
+// An identifier to find on lines [first_line, last_line) with LexerCall::FIND_LINE_OCCURRENCES,
+// such as those in view.  Only those lines are visited, however many uses there are elsewhere.
+struct LineOccurrences
+{
+    const char *identifier;
+    std::size_t first_line;
+    std::size_t last_line;
+};
+
+// The text of the whole document, for LexerCall::INDEX_ENTRIES.  The folder keeps the
+// entries up to date as it refolds edited lines, so the text need only be indexed once,
+// after it is loaded, rather than folded to the end.
+struct DocumentText
+{
+    const char *text;
+    std::size_t length;
+};
+
+// A named formula, "name(symmetry) { ... }", as the positions from the start of its name to
+// just after its closing brace.  An entry left unclosed ends where the next one starts, or at
+// the end of the document when it is the last entry.
+struct FormulaEntry
+{
+    const char *name;
+    std::size_t start;
+    std::size_t end;
+};
+
+// The result of LexerCall::LIST_ENTRIES, in document order.  LexerCall::FIND_ENTRY looks an
+// entry up by name, ignoring case.  Both are valid until the next call, Lex or Fold.
+struct FormulaEntries
+{
+    const FormulaEntry *items;
+    std::size_t count;
+};
+
+// A parenthesis to match with LexerCall::MATCH_PAREN in the document the lexer last styled.
+// Lines are skipped by their line state when it shows they can't hold the match; lines from
+// the one holding end_styled on may be out of date, so they are searched a character at a
+// time, for up to a megabyte.  Parentheses in comments are ignored, and one without a match
+// within that has none.
+struct ParenMatch
+{
+    std::size_t position;   // of the parenthesis
+    std::size_t end_styled; // the end of the text whose line states are up to date
+    std::size_t match;      // set to the position of the matching parenthesis
+};
+
+// Told about every range the lexer is asked to style or fold, before it does so.
+class LexObserver
+{
+public:
+    virtual ~LexObserver() = default;
+
+    virtual void lex(std::size_t start, std::ptrdiff_t length, int init_style) = 0;
+    virtual void fold(std::size_t start, std::ptrdiff_t length, int init_style) = 0;
+};
+
+// Name under which the lexer is known to Scintilla.
+constexpr const char *LEXER_NAME{"id-formula"};
+
+// Creates the lexer in-process, without loading the plug-in.
+// The caller owns the lexer and frees it with ILexer::Release.
+ILexer *create_lexer();
+
+} // namespace formula
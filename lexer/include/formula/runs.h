@@ -0,0 +1,68 @@
+#pragma once
+
+#include <formula/syntax.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+namespace formula
+{
+
+// A span of text with a single style.
+struct StyleRun
+{
+    std::size_t start;
+    std::size_t length;
+    Syntax style;
+};
+
+// Receives style runs in document order as the lexer completes them.
+class StyleRunWriter
+{
+public:
+    virtual ~StyleRunWriter() = default;
+
+    // text points at the run's characters and is only valid during the call.
+    virtual void write(const StyleRun &run, const char *text) = 0;
+};
+
+// Collects style runs in fixed size blocks; growing never moves stored runs.
+class StyleRunArena : public StyleRunWriter
+{
+public:
+    void write(const StyleRun &run, const char *text) override;
+
+    std::size_t size() const
+    {
+        return m_size;
+    }
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+    const StyleRun &operator[](std::size_t index) const
+    {
+        return m_blocks[index / BLOCK_SIZE][index % BLOCK_SIZE];
+    }
+
+    // Forgets the runs, keeping the blocks for reuse.
+    void clear();
+
+private:
+    static constexpr std::size_t BLOCK_SIZE{4096};
+
+    std::vector<std::unique_ptr<StyleRun[]>> m_blocks;
+    std::size_t m_size{};
+};
+
+// Lexes text in memory, writing one run per maximal span of a style.
+void lex_runs(const char *text, std::size_t length, StyleRunWriter &writer);
+
+// Lexes text read from in through a fixed size window, so memory use does not
+// depend on the input size.  A run may be split in two where the window is
+// refilled.  Returns the number of characters read.
+std::size_t lex_runs(std::istream &in, StyleRunWriter &writer);
+
+} // namespace formula
@@ -18,4 +18,49 @@ constexpr int operator+(Syntax value)
     return static_cast<int>(value);
 }
 
+enum class Indicator : int
+{
+    STRUCTURE_ERROR = 0,
+};
+
+constexpr int operator+(Indicator value)
+{
+    return static_cast<int>(value);
+}
+
+// Set in a line's fold level when the line has a structural error, such as
+// an endif without a matching if.  Lies outside the bits used by Scintilla.
+constexpr int FOLD_LEVEL_ERROR_FLAG{0x4000};
+
+// The line state of each folded line describes the end of the line: whether it is inside
+// an entry, and the parenthesis depth there with how far the depth falls below and rises
+// above that within the line.  Values too large for their bits are capped, so a capped
+// fall or rise means at least that much.
+constexpr int LINE_STATE_IN_ENTRY{0x1};
+constexpr int LINE_STATE_MAX_DEPTH{0x7fff};
+constexpr int LINE_STATE_MAX_FALL{0xff};
+constexpr int LINE_STATE_MAX_RISE{0x7f};
+
+constexpr int line_state(bool in_entry, int depth, int fall, int rise)
+{
+    return (in_entry ? LINE_STATE_IN_ENTRY : 0) | (depth < LINE_STATE_MAX_DEPTH ? depth : LINE_STATE_MAX_DEPTH) << 1
+        | (fall < LINE_STATE_MAX_FALL ? fall : LINE_STATE_MAX_FALL) << 16
+        | (rise < LINE_STATE_MAX_RISE ? rise : LINE_STATE_MAX_RISE) << 24;
+}
+
+constexpr int line_state_depth(int state)
+{
+    return state >> 1 & LINE_STATE_MAX_DEPTH;
+}
+
+constexpr int line_state_fall(int state)
+{
+    return state >> 16 & LINE_STATE_MAX_FALL;
+}
+
+constexpr int line_state_rise(int state)
+{
+    return state >> 24 & LINE_STATE_MAX_RISE;
+}
+
 } // namespace formula
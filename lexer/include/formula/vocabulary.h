@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+
+namespace formula
+{
+
+// The words and character classes of the id-formula language, shared by the
+// lexer and the parser so that both agree on what is a keyword or a function.
+// Word lists are space separated and in lower case; the language ignores case.
+constexpr const char *KEYWORDS{"if endif elseif else"};
+constexpr const char *BUILTIN_FUNCTIONS{"sin cos sinh cosh cosxx tan cotan tanh cotanh sqr log exp "
+                                        "abs conj real imag flip fn1 fn2 fn3 fn4 srand asin asinh "
+                                        "acos acosh atan atanh sqrt cabs floor ceil trunc round"};
+
+// Whether word is one of the words in a space separated list.
+constexpr bool in_word_list(std::string_view list, std::string_view word)
+{
+    for (std::size_t begin = 0; begin < list.size();)
+    {
+        const std::size_t end = std::min(list.find(' ', begin), list.size());
+        if (list.substr(begin, end - begin) == word)
+        {
+            return true;
+        }
+        begin = end + 1;
+    }
+    return false;
+}
+
+// Whether a word in lower case is a keyword or a built-in function, and so can't name a variable.
+constexpr bool is_keyword(std::string_view word)
+{
+    return in_word_list(KEYWORDS, word);
+}
+constexpr bool is_builtin_function(std::string_view word)
+{
+    return in_word_list(BUILTIN_FUNCTIONS, word);
+}
+
+// Whitespace within a line; line ends separate statements and are not included.
+constexpr const char *WHITESPACE_CHARS{" \t\v\f"};
+constexpr char COMMENT_CHAR{';'};
+
+constexpr bool is_whitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f';
+}
+
+// Keywords are made of letters.
+constexpr bool is_keyword_char(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+// Functions and identifiers are made of letters and digits.
+constexpr bool is_identifier_char(char ch)
+{
+    return is_keyword_char(ch) || (ch >= '0' && ch <= '9');
+}
+
+} // namespace formula
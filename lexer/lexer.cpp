@@ -1,4 +1,13 @@
+#include "entry_index.h"
+#include "identifier_index.h"
+#include "paren_depth.h"
+#include "run_context.h"
+
+#include <formula/lexer.h>
+#include <formula/runs.h>
 #include <formula/syntax.h>
+#include <formula/trace.h>
+#include <formula/vocabulary.h>
 
 #include <ILexer.h>
 #include <Scintilla.h>
@@ -11,14 +20,54 @@
 #include <StyleContext.h>
 #include <WordList.h>
 
+#include <algorithm>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <istream>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace
 {
 
+std::string to_lower(const char *text)
+{
+    std::string result{text};
+    std::transform(result.begin(), result.end(), result.begin(),
+        [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+    return result;
+}
+
+// The length of the longest word in a space separated list.
+std::size_t longest_word(const char *words)
+{
+    std::size_t longest{};
+    std::size_t length{};
+    for (const char *ch = words;; ++ch)
+    {
+        if (*ch == ' ' || *ch == '\0')
+        {
+            longest = std::max(longest, length);
+            length = 0;
+            if (*ch == '\0')
+            {
+                return longest;
+            }
+        }
+        else
+        {
+            ++length;
+        }
+    }
+}
+
 class Lexer : public ILexer
 {
 public:
@@ -37,27 +86,101 @@ public:
     void SCI_METHOD Fold(Sci_PositionU start, Sci_Position len, int init_style, IDocument *doc) override;
     void *SCI_METHOD PrivateCall(int operation, void *pointer) override;
 
+    template <typename Context>
+    void lex(Context &sc);
+
 private:
-    bool finish_state(StyleContext &sc);
-    void begin_state(StyleContext &sc);
+    struct FoldKeyword
+    {
+        std::string text; // lower case, and no longer than MAX_FOLD_KEYWORD
+        Sci_Position start{};
+        Sci_Position end{};
+    };
+
+    // Where a line is with respect to the formula entries.
+    struct FoldEntry
+    {
+        bool inside{}; // at the start of the line
+        bool opens{};
+        bool closes{};
+    };
+
+    // Everything the folder knows at a position, so that folding a long line can stop part
+    // way along it and carry on later.
+    struct FoldState
+    {
+        Sci_PositionU position{};
+        Sci_Position line{};
+        int level{};
+        bool in_entry{}; // at the start of the line
+        FoldKeyword keyword;
+        bool in_keyword{};
+        bool skip_to_eol{};
+        formula::EntryScanner entries;
+        formula::ParenDepth parens;
+    };
+
+    // A word is looked back for this far when a range starts inside it; longer words are
+    // neither keywords nor indexed, so they needn't be seen whole.
+    static constexpr Sci_PositionU MAX_WORD_BACKTRACK{128};
+    // Longer than any fold keyword, so a longer word matches none.
+    static constexpr std::size_t MAX_FOLD_KEYWORD{7};
+    // Long lines keep a fold state this often, so refolding part way along one starts near the change.
+    static constexpr Sci_PositionU FOLD_STATE_INTERVAL{64 * 1024};
+
+    template <typename Context>
+    bool finish_state(Context &sc);
+    template <typename Context>
+    void begin_state(Context &sc);
+    template <typename Context>
+    void index_identifier(Context &sc);
+    void index_lines(IDocument *doc, Sci_PositionU start, Sci_Position len);
+    void *complete_identifier(const char *prefix);
+    void *find_occurrences(const char *identifier);
+    void *find_line_occurrences(const formula::LineOccurrences *lines);
+    void *list_entries();
+    void *find_entry(const char *name);
+    int fold_line(LexAccessor &accessor, IDocument *doc, Sci_Position line, int level, int base_level,
+        const FoldKeyword &keyword, const FoldEntry &entry, bool last_line);
+    static int level_after(LexAccessor &accessor, Sci_Position line, int base_level);
+    FoldState resume_fold(LexAccessor &accessor, Sci_PositionU start, int base_level);
 
     WordList m_keywords;
     WordList m_functions;
+    std::size_t m_longest_keyword{};
+    std::size_t m_longest_function{};
     CharacterSet m_keyword_charset{CharacterSet::setAlpha};
     CharacterSet m_function_charset{CharacterSet::setAlphaNum};
-    CharacterSet m_whitespace_charset{CharacterSet::setNone, " \t\v\f"};
+    CharacterSet m_whitespace_charset{CharacterSet::setNone, formula::WHITESPACE_CHARS};
     CharacterSet m_identifier_charset{CharacterSet::setAlphaNum};
     CharacterSet m_fold_keyword_charset{CharacterSet::setAlpha};
     bool m_maybe_keyword{};
     bool m_maybe_function{};
+    // The range being lexed starts part way through a word too long to look back over, or
+    // ends part way through one; the part seen isn't indexed.
+    bool m_skip_identifier{};
+    bool m_word_continues{};
+    formula::LexObserver *m_observer{};
+    formula::TraceLog *m_trace{};
+    std::unique_ptr<formula::IdentifierIndex> m_index;
+    std::vector<std::pair<Sci_Position, formula::IdentifierIndex::WordId>> m_lexed_identifiers;
+    formula::IdentifierOccurrences m_occurrences{};
+    formula::EntryIndex m_entries;
+    formula::FormulaEntries m_entry_list{};
+    // The document last styled, for LexerCall::MATCH_PAREN.  Scintilla keeps a lexer with
+    // one document for the whole of the lexer's life.
+    IDocument *m_document{};
+    // Where folding stopped, and points part way along long lines, in order.  A range to fold
+    // starts at or before the first change since it was last folded, so those before it still hold.
+    std::vector<FoldState> m_fold_states;
 };
 
 Lexer::Lexer()
 {
-    m_keywords.Set("if endif elseif else");
-    m_functions.Set("sin cos sinh cosh cosxx tan cotan tanh cotanh sqr log exp "
-                    "abs conj real imag flip fn1 fn2 fn3 fn4 srand asin asinh "
-                    "acos acosh atan atanh sqrt cabs floor ceil trunc round");
+    m_keywords.Set(formula::KEYWORDS);
+    m_functions.Set(formula::BUILTIN_FUNCTIONS);
+    m_longest_keyword = longest_word(formula::KEYWORDS);
+    m_longest_function = longest_word(formula::BUILTIN_FUNCTIONS);
 }
 
 int Lexer::Version() const
@@ -100,12 +223,71 @@ Sci_Position Lexer::WordListSet(int /*n*/, const char * /*wl*/)
     return -1;
 }
 
-void *Lexer::PrivateCall(int /*operation*/, void */*pointer*/)
+void *Lexer::PrivateCall(int operation, void *pointer)
 {
+    switch (operation)
+    {
+    case +formula::LexerCall::SET_LEX_OBSERVER:
+        m_observer = static_cast<formula::LexObserver *>(pointer);
+        break;
+
+    case +formula::LexerCall::SET_TRACE_LOG:
+        m_trace = static_cast<formula::TraceLog *>(pointer);
+        break;
+
+    case +formula::LexerCall::INDEX_IDENTIFIERS:
+        if (!m_index)
+        {
+            m_index = std::make_unique<formula::IdentifierIndex>();
+            const std::string functions{formula::BUILTIN_FUNCTIONS};
+            for (std::size_t begin = 0; begin < functions.size();)
+            {
+                const std::size_t end = std::min(functions.find(' ', begin), functions.size());
+                m_index->add_builtin(std::string_view{functions}.substr(begin, end - begin));
+                begin = end + 1;
+            }
+        }
+        break;
+
+    case +formula::LexerCall::COMPLETE_IDENTIFIER:
+        return complete_identifier(static_cast<const char *>(pointer));
+
+    case +formula::LexerCall::FIND_OCCURRENCES:
+        return find_occurrences(static_cast<const char *>(pointer));
+
+    case +formula::LexerCall::FIND_LINE_OCCURRENCES:
+        return find_line_occurrences(static_cast<const formula::LineOccurrences *>(pointer));
+
+    case +formula::LexerCall::INDEX_ENTRIES:
+        if (pointer != nullptr)
+        {
+            const auto *text = static_cast<const formula::DocumentText *>(pointer);
+            m_entries.index_text(std::string_view{text->text, text->length});
+        }
+        break;
+
+    case +formula::LexerCall::LIST_ENTRIES:
+        return list_entries();
+
+    case +formula::LexerCall::FIND_ENTRY:
+        return find_entry(static_cast<const char *>(pointer));
+
+    case +formula::LexerCall::MATCH_PAREN:
+        if (pointer != nullptr && m_document != nullptr)
+        {
+            auto *match = static_cast<formula::ParenMatch *>(pointer);
+            return formula::match_paren(m_document, *match) ? match : nullptr;
+        }
+        break;
+
+    default:
+        break;
+    }
     return nullptr;
 }
 
-bool Lexer::finish_state(StyleContext &sc)
+template <typename Context>
+bool Lexer::finish_state(Context &sc)
 {
     switch (sc.state)
     {
@@ -123,7 +305,7 @@ bool Lexer::finish_state(StyleContext &sc)
         break;
 
     case +formula::Syntax::KEYWORD:
-        if (sc.ch == ';' || !m_keyword_charset.Contains(sc.ch))
+        if (sc.ch == formula::COMMENT_CHAR || !m_keyword_charset.Contains(sc.ch))
         {
             sc.SetState(+formula::Syntax::NONE);
         }
@@ -137,15 +319,16 @@ bool Lexer::finish_state(StyleContext &sc)
         break;
 
     case +formula::Syntax::FUNCTION:
-        if (sc.ch == ';' || !m_function_charset.Contains(sc.ch))
+        if (sc.ch == formula::COMMENT_CHAR || !m_function_charset.Contains(sc.ch))
         {
             sc.SetState(+formula::Syntax::NONE);
         }
         break;
 
     case +formula::Syntax::IDENTIFIER:
-        if (sc.ch == ';' || !m_identifier_charset.Contains(sc.ch))
+        if (sc.ch == formula::COMMENT_CHAR || !m_identifier_charset.Contains(sc.ch))
         {
+            index_identifier(sc);
             sc.SetState(+formula::Syntax::NONE);
         }
         break;
@@ -156,12 +339,16 @@ bool Lexer::finish_state(StyleContext &sc)
     return true;
 }
 
-void Lexer::begin_state(StyleContext &sc)
+template <typename Context>
+void Lexer::begin_state(Context &sc)
 {
     if (sc.state == +formula::Syntax::IDENTIFIER)
     {
-        m_maybe_keyword = m_keyword_charset.Contains(sc.ch) && m_maybe_keyword;
-        m_maybe_function = m_function_charset.Contains(sc.ch) && m_maybe_function;
+        // Past the longest keyword or function, a word can't be one; checking each character of a
+        // long word would cost its length over again.
+        const std::size_t length{static_cast<std::size_t>(sc.LengthCurrent()) + 1};
+        m_maybe_keyword = m_keyword_charset.Contains(sc.ch) && m_maybe_keyword && length <= m_longest_keyword;
+        m_maybe_function = m_function_charset.Contains(sc.ch) && m_maybe_function && length <= m_longest_function;
 
         if (m_maybe_keyword)
         {
@@ -194,7 +381,7 @@ void Lexer::begin_state(StyleContext &sc)
         return;
     }
 
-    if (sc.ch == ';')
+    if (sc.ch == formula::COMMENT_CHAR)
     {
         sc.SetState(+formula::Syntax::COMMENT);
         return;
@@ -214,10 +401,12 @@ void Lexer::begin_state(StyleContext &sc)
         return;
     }
 }
-void Lexer::Lex(Sci_PositionU start, Sci_Position len, int init_style, IDocument *doc)
+
+// Runs the state machine over a StyleContext, or over a RunContext when
+// producing style runs without a Scintilla document.
+template <typename Context>
+void Lexer::lex(Context &sc)
 {
-    LexAccessor accessor{doc};
-    StyleContext sc{start, static_cast<Sci_PositionU>(len), init_style, accessor};
     while (sc.More())
     {
         const bool advance{finish_state(sc)};
@@ -228,116 +417,407 @@ void Lexer::Lex(Sci_PositionU start, Sci_Position len, int init_style, IDocument
             sc.Forward();
         }
     }
+    if (sc.state == +formula::Syntax::IDENTIFIER && !m_word_continues)
+    {
+        index_identifier(sc);
+    }
     sc.Complete();
 }
 
-void Lexer::Fold(Sci_PositionU start, Sci_Position len, int init_style, IDocument *doc)
+// Notes the identifier ending at the current position when identifiers are indexed.
+template <typename Context>
+void Lexer::index_identifier(Context &sc)
+{
+    if (!m_index || std::exchange(m_skip_identifier, false))
+    {
+        return;
+    }
+    char buffer[MAX_WORD_BACKTRACK];
+    sc.GetCurrentLowered(buffer, sizeof(buffer));
+    const std::size_t length{std::strlen(buffer)};
+    // Numbers are lexed as identifiers and longer identifiers come back truncated; leave both out.
+    if (length > 0 && length + 1 < sizeof(buffer) && std::isdigit(static_cast<unsigned char>(buffer[0])) == 0)
+    {
+        m_lexed_identifiers.emplace_back(static_cast<Sci_Position>(sc.currentPos - length),
+            m_index->intern(std::string_view{buffer, length}));
+    }
+}
+
+// Hands the identifiers found by Lex to the index, grouped by line.
+void Lexer::index_lines(IDocument *doc, Sci_PositionU start, Sci_Position len)
+{
+    const Sci_Position first = doc->LineFromPosition(static_cast<Sci_Position>(start));
+    const Sci_Position first_column = static_cast<Sci_Position>(start) - doc->LineStart(first);
+    const Sci_Position last = len > 0 ? doc->LineFromPosition(static_cast<Sci_Position>(start) + len - 1) + 1 : first;
+    const Sci_Position line_count = doc->LineFromPosition(doc->Length()) + 1;
+    std::vector<std::vector<formula::IdentifierIndex::Identifier>> lines(static_cast<std::size_t>(last - first));
+    Sci_Position line = first;
+    Sci_Position line_start = doc->LineStart(line);
+    Sci_Position line_end = doc->LineStart(line + 1);
+    for (const auto &[position, word] : m_lexed_identifiers)
+    {
+        while (position >= line_end && line + 1 < last)
+        {
+            ++line;
+            line_start = line_end;
+            line_end = doc->LineStart(line + 1);
+        }
+        lines[static_cast<std::size_t>(line - first)].push_back(
+            {static_cast<std::size_t>(position - line_start), word});
+    }
+    m_lexed_identifiers.clear();
+    m_index->replace_lines(static_cast<std::size_t>(first), static_cast<std::size_t>(last),
+        static_cast<std::size_t>(line_count), std::move(lines), static_cast<std::size_t>(first_column));
+}
+
+void *Lexer::complete_identifier(const char *prefix)
+{
+    if (!m_index || prefix == nullptr)
+    {
+        return nullptr;
+    }
+    const std::string &words = m_index->complete(to_lower(prefix), formula::MAX_COMPLETIONS);
+    return const_cast<char *>(words.c_str());
+}
+
+void *Lexer::find_occurrences(const char *identifier)
+{
+    if (!m_index || identifier == nullptr)
+    {
+        return nullptr;
+    }
+    const std::vector<formula::IdentifierOccurrence> &found = m_index->occurrences(to_lower(identifier));
+    m_occurrences = {found.data(), found.size()};
+    return &m_occurrences;
+}
+
+void *Lexer::find_line_occurrences(const formula::LineOccurrences *lines)
+{
+    if (!m_index || lines == nullptr || lines->identifier == nullptr)
+    {
+        return nullptr;
+    }
+    const std::vector<formula::IdentifierOccurrence> &found =
+        m_index->occurrences(to_lower(lines->identifier), lines->first_line, lines->last_line);
+    m_occurrences = {found.data(), found.size()};
+    return &m_occurrences;
+}
+
+void *Lexer::list_entries()
+{
+    const std::vector<formula::FormulaEntry> &entries = m_entries.entries();
+    m_entry_list = {entries.data(), entries.size()};
+    return &m_entry_list;
+}
+
+void *Lexer::find_entry(const char *name)
+{
+    if (name == nullptr)
+    {
+        return nullptr;
+    }
+    return const_cast<formula::FormulaEntry *>(m_entries.find(name));
+}
+
+void Lexer::Lex(Sci_PositionU start, Sci_Position len, int init_style, IDocument *doc)
 {
+    FORMULA_TRACE_SCOPE(m_trace, "Lex", "lexer", "start", static_cast<std::int64_t>(start), "length", len);
+    if (m_observer != nullptr)
+    {
+        m_observer->lex(start, len, init_style);
+    }
+    m_document = doc;
     LexAccessor accessor{doc};
+    // A range may start or end part way along a line.  One starting inside a word goes back to
+    // the start of it, so the word is classified whole.
+    const auto in_word = [&](Sci_PositionU position)
+    {
+        const char ch{accessor[static_cast<Sci_Position>(position)]};
+        return m_identifier_charset.Contains(static_cast<unsigned char>(ch));
+    };
+    if (start > 0 && in_word(start) && in_word(start - 1))
+    {
+        Sci_PositionU word_start{start - 1};
+        while (word_start > 0 && start - word_start < MAX_WORD_BACKTRACK && in_word(word_start - 1))
+        {
+            --word_start;
+        }
+        len += static_cast<Sci_Position>(start - word_start);
+        start = word_start;
+        init_style = start > 0 ? accessor.StyleAt(static_cast<Sci_Position>(start) - 1) : +formula::Syntax::NONE;
+        if (start > 0 && in_word(start - 1) && init_style == +formula::Syntax::IDENTIFIER)
+        {
+            m_maybe_keyword = false;
+            m_maybe_function = false;
+            m_skip_identifier = true;
+        }
+    }
+    const Sci_PositionU end{start + static_cast<Sci_PositionU>(len)};
+    m_word_continues = static_cast<Sci_Position>(end) < accessor.Length() && end > start && in_word(end)
+        && in_word(end - 1);
     StyleContext sc{start, static_cast<Sci_PositionU>(len), init_style, accessor};
-    int line = accessor.GetLine(start);
-    int level = accessor.LevelAt(line);
-    std::string text;
-    bool in_keyword{false};
-    bool skip_to_eol{false};
-    while (sc.More())
+    lex(sc);
+    m_skip_identifier = false;
+    m_word_continues = false;
+    if (m_index)
+    {
+        index_lines(doc, start, len);
+    }
+}
+
+void Lexer::Fold(Sci_PositionU start, Sci_Position len, int init_style, IDocument *doc)
+{
+    FORMULA_TRACE_SCOPE(m_trace, "Fold", "lexer", "start", static_cast<std::int64_t>(start), "length", len);
+    if (m_observer != nullptr)
+    {
+        m_observer->fold(start, len, init_style);
+    }
+    m_document = doc;
+    // Read the text through the accessor alone; a StyleContext would restart styling at start.
+    LexAccessor accessor{doc};
+    const int base_level = accessor.LevelAt(0) & SC_FOLDLEVELNUMBERMASK;
+    FoldState state{resume_fold(accessor, start, base_level)};
+    Sci_PositionU line_start{static_cast<Sci_PositionU>(accessor.LineStart(state.line))};
+    const std::size_t first_position{state.entries.brace_position(state.position)};
+    const bool at_end = static_cast<Sci_Position>(start) + len >= accessor.Length();
+    std::vector<formula::EntryBrace> braces;
+    const Sci_PositionU end{start + static_cast<Sci_PositionU>(len)};
+    for (Sci_PositionU position = state.position; position < end; ++position)
     {
-        if (sc.Match("\n"))
+        const int ch{static_cast<unsigned char>(accessor[static_cast<Sci_Position>(position)])};
+        if (ch == '\n')
         {
-            if (text == "if")
+            if (state.in_keyword)
             {
-                accessor.SetLevel(line, level | SC_FOLDLEVELHEADERFLAG);
-                ++level;
+                state.keyword.end = position;
             }
-            else if (text == "elseif" || text == "else")
-            {
-                --level;
-                accessor.SetLevel(line, level | SC_FOLDLEVELHEADERFLAG);
-                ++level;
-            }
-            else if (text == "endif")
-            {
-                --level;
-                accessor.SetLevel(line, level);
-            }
-            else
-            {
-                accessor.SetLevel(line, level);
-            }
-            text.clear();
-            sc.Forward();
-            ++line;
-            skip_to_eol = false;
-            in_keyword = false;
+            const bool last_line{at_end && static_cast<Sci_Position>(position) + 1 >= accessor.Length()};
+            state.level = fold_line(accessor, doc, state.line, state.level, base_level, state.keyword,
+                {state.in_entry, state.entries.opens_entry(), state.entries.closes_entry()}, last_line);
+            state.in_entry = state.entries.in_entry();
+            state.entries.end_line(braces);
+            accessor.SetLineState(state.line, state.parens.end_line(state.in_entry));
+            state.keyword.text.clear();
+            ++state.line;
+            line_start = position + 1;
+            state.skip_to_eol = false;
+            state.in_keyword = false;
             continue;
         }
+        if (position > line_start && (position - line_start) % FOLD_STATE_INTERVAL == 0)
+        {
+            state.entries.add_braces(braces);
+            state.position = position;
+            m_fold_states.push_back(state);
+        }
 
-        if (in_keyword)
+        state.entries.scan(static_cast<char>(ch), position);
+        state.parens.scan(static_cast<char>(ch));
+        if (state.in_keyword)
         {
-            if (m_fold_keyword_charset.Contains(sc.ch))
+            if (m_fold_keyword_charset.Contains(ch))
             {
-                text += static_cast<char>(std::tolower(static_cast<unsigned char>(sc.ch)));
+                if (state.keyword.text.size() < MAX_FOLD_KEYWORD)
+                {
+                    state.keyword.text += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+                }
             }
             else
             {
-                in_keyword = false;
-                skip_to_eol = true;
+                state.keyword.end = position;
+                state.in_keyword = false;
+                state.skip_to_eol = true;
             }
         }
-        else if (m_whitespace_charset.Contains(sc.ch))
+        else if (m_whitespace_charset.Contains(ch))
         {
         }
-        else if (!skip_to_eol)
+        else if (!state.skip_to_eol)
         {
-            if (m_fold_keyword_charset.Contains(sc.ch))
+            if (m_fold_keyword_charset.Contains(ch))
             {
-                in_keyword = true;
-                text += static_cast<char>(std::tolower(static_cast<unsigned char>(sc.ch)));
+                state.in_keyword = true;
+                state.keyword.start = position;
+                state.keyword.text += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
             }
         }
-        sc.Forward();
     }
-    if (!text.empty())
+    if (state.in_keyword)
     {
-        ++line;
-        accessor.SetLevel(line, level);
+        state.keyword.end = end;
     }
+    if (at_end)
+    {
+        // The last line has no newline; fold it so a trailing endif closes its block.
+        if (static_cast<Sci_Position>(line_start) < accessor.Length())
+        {
+            fold_line(accessor, doc, state.line, state.level, base_level, state.keyword,
+                {state.in_entry, state.entries.opens_entry(), state.entries.closes_entry()}, true);
+            state.entries.end_line(braces);
+            accessor.SetLineState(state.line, state.parens.end_line(state.entries.in_entry()));
+        }
+    }
+    else
+    {
+        // Keep the state for the range that carries on from here: the line it ends in isn't folded
+        // yet, so neither its level nor the state part way along it is anywhere else.
+        state.entries.add_braces(braces);
+        state.position = end;
+        m_fold_states.push_back(std::move(state));
+    }
+    m_entries.replace_range(first_position, std::max(static_cast<std::size_t>(end), first_position),
+        static_cast<std::size_t>(doc->Length()), std::move(braces));
 }
 
-using LexerFactoryFunction = ILexer *();
+// The level of the line after a folded line, from the line's level and line states.  The level of
+// a line is that of the lines before it, except for those of if, elseif, else and lines opening
+// entries, which are headers over the lines after them, and of a line closing an entry, after
+// which the level is that outside entries.
+int Lexer::level_after(LexAccessor &accessor, Sci_Position line, int base_level)
+{
+    const int level{accessor.LevelAt(line)};
+    if ((level & SC_FOLDLEVELHEADERFLAG) != 0)
+    {
+        return (level & SC_FOLDLEVELNUMBERMASK) + 1;
+    }
+    const bool starts_in_entry{line > 0 && (accessor.GetLineState(line - 1) & formula::LINE_STATE_IN_ENTRY) != 0};
+    const bool ends_in_entry{(accessor.GetLineState(line) & formula::LINE_STATE_IN_ENTRY) != 0};
+    return starts_in_entry && !ends_in_entry ? base_level : level & SC_FOLDLEVELNUMBERMASK;
+}
 
-ILexer *create_lexer()
+// The state to fold from for a range starting at start: the last one kept at or before start
+// on its line, or else the state at the start of the line from the level and line state of the
+// line before it.  The states kept after it are
+// dropped, as the text there may have changed.
+Lexer::FoldState Lexer::resume_fold(LexAccessor &accessor, Sci_PositionU start, int base_level)
 {
-    return new Lexer;
+    FoldState state;
+    state.line = accessor.GetLine(static_cast<Sci_Position>(start));
+    state.position = static_cast<Sci_PositionU>(accessor.LineStart(state.line));
+    auto kept = std::upper_bound(m_fold_states.begin(), m_fold_states.end(), start,
+        [](Sci_PositionU value, const FoldState &fold) { return value < fold.position; });
+    if (kept != m_fold_states.begin() && std::prev(kept)->position >= state.position)
+    {
+        --kept;
+        state = std::move(*kept);
+    }
+    else
+    {
+        kept = std::lower_bound(m_fold_states.begin(), m_fold_states.end(), state.position,
+            [](const FoldState &fold, Sci_PositionU value) { return fold.position < value; });
+        state.level = state.line == 0 ? base_level : level_after(accessor, state.line - 1, base_level);
+        const int previous_state{state.line > 0 ? accessor.GetLineState(state.line - 1) : 0};
+        state.in_entry = (previous_state & formula::LINE_STATE_IN_ENTRY) != 0;
+        if (state.in_entry)
+        {
+            // A line opening an entry inside an unclosed one was left at the level outside entries.
+            state.level = std::max(state.level, base_level + 1);
+        }
+        state.entries = formula::EntryScanner{state.in_entry};
+        state.parens = formula::ParenDepth{formula::line_state_depth(previous_state)};
+    }
+    m_fold_states.erase(kept, m_fold_states.end());
+    return state;
 }
 
+// Sets the fold level of a completed line and returns the level of the following line.
+// Entries are folded from the line that opens them to the line that closes them, and
+// if blocks nest inside them.  Structural errors are recorded with FOLD_LEVEL_ERROR_FLAG;
+// Scintilla keeps fold levels with their lines across edits, so SetLevel returns the
+// previous diagnostic state and the indicator is only touched on lines that are or were in error.
+int Lexer::fold_line(LexAccessor &accessor, IDocument *doc, Sci_Position line, int level, int base_level,
+    const FoldKeyword &keyword, const FoldEntry &entry, bool last_line)
+{
+    // else and endif can't close the entry a line is in.
+    const int entry_level{base_level + (entry.inside ? 1 : 0)};
+    int line_level{level};
+    bool keyword_error{false};
+    bool closes_open_if{false};
+    if (entry.opens)
+    {
+        line_level = base_level | SC_FOLDLEVELHEADERFLAG;
+        level = base_level + 1;
+    }
+    else if (entry.closes)
+    {
+        closes_open_if = level > entry_level;
+        level = base_level;
+    }
+    else if (keyword.text == "if")
+    {
+        line_level |= SC_FOLDLEVELHEADERFLAG;
+        ++level;
+    }
+    else if (keyword.text == "elseif" || keyword.text == "else")
+    {
+        if (level > entry_level)
+        {
+            line_level = (level - 1) | SC_FOLDLEVELHEADERFLAG;
+        }
+        else
+        {
+            keyword_error = true;
+        }
+    }
+    else if (keyword.text == "endif")
+    {
+        if (level > entry_level)
+        {
+            --level;
+            line_level = level;
+        }
+        else
+        {
+            keyword_error = true;
+        }
+    }
+    const bool unterminated{closes_open_if || (last_line && !entry.opens && !entry.closes && level > entry_level)};
+    if (keyword_error || unterminated)
+    {
+        line_level |= formula::FOLD_LEVEL_ERROR_FLAG;
+    }
+
+    const int previous = doc->SetLevel(line, line_level);
+    constexpr int indicator{+formula::Indicator::STRUCTURE_ERROR};
+    if ((previous & formula::FOLD_LEVEL_ERROR_FLAG) != 0)
+    {
+        // The error may have moved or gone; clear the line before marking where it is now.
+        accessor.IndicatorFill(accessor.LineStart(line), accessor.LineStart(line + 1), indicator, 0);
+    }
+    if (keyword_error)
+    {
+        accessor.IndicatorFill(keyword.start, keyword.end, indicator, 1);
+    }
+    else if (unterminated)
+    {
+        accessor.IndicatorFill(accessor.LineStart(line), accessor.LineStart(line + 1), indicator, 1);
+    }
+    return level;
+}
 
 } // namespace
 
-#if WIN32
-#define EXPORT __declspec(dllexport)
-#else
-#define EXPORT
-#endif
+namespace formula
+{
 
-extern "C" EXPORT int SCI_METHOD GetLexerCount()
+ILexer *create_lexer()
 {
-    return 1;
+    return new Lexer;
 }
 
-extern "C" EXPORT void SCI_METHOD GetLexerName(unsigned int index, char *name, int size)
+void lex_runs(const char *text, std::size_t length, StyleRunWriter &writer)
 {
-    if (index == 0)
-    {
-        std::strncpy(name, "id-formula", size);
-    }
+    RunContext sc{text, length, +Syntax::NONE, writer};
+    Lexer lexer;
+    lexer.lex(sc);
 }
 
-extern "C" EXPORT LexerFactoryFunction *SCI_METHOD GetLexerFactory(unsigned int index)
+std::size_t lex_runs(std::istream &in, StyleRunWriter &writer)
 {
-    if (index == 0)
-    {
-        return create_lexer;
-    }
-    return nullptr;
+    RunContext sc{in, +Syntax::NONE, writer};
+    Lexer lexer;
+    lexer.lex(sc);
+    return sc.length();
 }
+
+} // namespace formula
@@ -0,0 +1,287 @@
+#include "paren_depth.h"
+
+#include <formula/syntax.h>
+#include <formula/vocabulary.h>
+
+#include <ILexer.h>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace formula
+{
+
+namespace
+{
+
+// Where a line's depth starts and ends, and the lowest and highest it reaches.
+struct LineDepths
+{
+    int start;
+    int end;
+    int low;
+    int high;
+};
+
+// The line may step between depth and depth + 1.
+bool may_cross(const LineDepths &line, int depth)
+{
+    return line.low <= depth && line.high > depth;
+}
+
+// Text is read into a buffer this size, as LexAccessor does, a line at a time so that lines
+// that are skipped aren't read.
+constexpr Sci_Position BUFFER_SIZE{4000};
+
+// Lines after those with up to date line states are scanned a character at a time, for at most
+// this much text; a parenthesis whose match lies further on is taken to have none.
+constexpr Sci_Position MAX_SCAN{1024 * 1024};
+
+// The depths of a document's lines, from their line states while those are up to date and by
+// scanning the text after that.  Lines are scanned in order, once, as they are asked for.
+class DocumentDepths
+{
+public:
+    DocumentDepths(IDocument *doc, std::size_t end_styled) :
+        m_doc(doc),
+        m_up_to_date(doc->LineFromPosition(static_cast<Sci_Position>(end_styled))),
+        m_line_count(doc->LineFromPosition(std::min(doc->Length(), doc->LineStart(m_up_to_date) + MAX_SCAN)) + 1)
+    {
+    }
+
+    // The lines that may be searched.
+    Sci_Position line_count() const
+    {
+        return m_line_count;
+    }
+
+    // Calls visit(column, ch) for each character of line until it returns true, and returns
+    // that column, or npos.
+    template <typename Visit>
+    std::size_t scan(Sci_Position line, Visit visit)
+    {
+        const Sci_Position start = m_doc->LineStart(line);
+        const Sci_Position end = m_doc->LineStart(line + 1);
+        for (Sci_Position piece = start; piece < end; piece += BUFFER_SIZE)
+        {
+            const Sci_Position length = std::min(end - piece, BUFFER_SIZE);
+            m_doc->GetCharRange(m_buffer.data(), piece, length);
+            for (Sci_Position i = 0; i < length; ++i)
+            {
+                const auto column = static_cast<std::size_t>(piece + i - start);
+                if (visit(column, m_buffer[static_cast<std::size_t>(i)]))
+                {
+                    return column;
+                }
+            }
+        }
+        return std::string::npos;
+    }
+
+    LineDepths line(Sci_Position line)
+    {
+        if (line < m_up_to_date)
+        {
+            return stored(line);
+        }
+        while (static_cast<Sci_Position>(m_scanned.size()) <= line - m_up_to_date)
+        {
+            const Sci_Position next = m_up_to_date + static_cast<Sci_Position>(m_scanned.size());
+            ParenDepth parens{m_scanned.empty() ? start_depth(next) : m_scanned.back().end};
+            const int start = parens.depth();
+            scan(next,
+                [&parens](std::size_t, char ch)
+                {
+                    parens.scan(ch);
+                    return false;
+                });
+            m_scanned.push_back({start, parens.depth(), parens.low(), parens.high()});
+        }
+        return m_scanned[static_cast<std::size_t>(line - m_up_to_date)];
+    }
+
+private:
+    int start_depth(Sci_Position line) const
+    {
+        return line > 0 ? line_state_depth(m_doc->GetLineState(line - 1)) : 0;
+    }
+
+    LineDepths stored(Sci_Position line) const
+    {
+        const int state = m_doc->GetLineState(line);
+        const int end = line_state_depth(state);
+        if (end == LINE_STATE_MAX_DEPTH)
+        {
+            return {start_depth(line), end, INT_MIN, INT_MAX};
+        }
+        const int fall = line_state_fall(state);
+        const int rise = line_state_rise(state);
+        return {start_depth(line), end, fall == LINE_STATE_MAX_FALL ? INT_MIN : end - fall,
+            rise == LINE_STATE_MAX_RISE ? INT_MAX : end + rise};
+    }
+
+    IDocument *m_doc;
+    Sci_Position m_up_to_date; // lines before this have up to date line states
+    Sci_Position m_line_count;
+    std::vector<LineDepths> m_scanned; // lines from m_up_to_date on
+    std::array<char, BUFFER_SIZE> m_buffer{};
+};
+
+// Calls found(column, paren, depth) for each parenthesis on line outside comments, with the
+// depth before it, until found returns true.  Returns that column, or npos.
+template <typename Found>
+std::size_t find_paren(DocumentDepths &depths, Sci_Position line, Found found)
+{
+    ParenDepth parens{depths.line(line).start};
+    return depths.scan(line,
+        [&](std::size_t column, char ch)
+        {
+            if ((ch == '(' || ch == ')') && !parens.in_comment() && found(column, ch, parens.depth()))
+            {
+                return true;
+            }
+            parens.scan(ch);
+            return false;
+        });
+}
+
+} // namespace
+
+void ParenDepth::scan(char ch)
+{
+    if (m_in_comment)
+    {
+        return;
+    }
+    switch (ch)
+    {
+    case COMMENT_CHAR:
+        m_in_comment = true;
+        break;
+
+    case '(':
+        m_high = std::max(m_high, ++m_depth);
+        break;
+
+    case ')':
+        if (m_depth > 0)
+        {
+            m_low = std::min(m_low, --m_depth);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+int ParenDepth::end_line(bool in_entry)
+{
+    const int state = line_state(in_entry, m_depth, m_depth - m_low, m_high - m_depth);
+    m_low = m_depth;
+    m_high = m_depth;
+    m_in_comment = false;
+    return state;
+}
+
+bool match_paren(IDocument *doc, ParenMatch &match)
+{
+    const auto position = static_cast<Sci_Position>(match.position);
+    if (position >= doc->Length())
+    {
+        return false;
+    }
+    DocumentDepths depths{doc, match.end_styled};
+    const Sci_Position line = doc->LineFromPosition(position);
+    if (line >= depths.line_count())
+    {
+        return false;
+    }
+    const auto column = static_cast<std::size_t>(position - doc->LineStart(line));
+    char paren{};
+    int depth{-1};
+    find_paren(depths, line,
+        [&](std::size_t at, char ch, int before)
+        {
+            if (at == column)
+            {
+                paren = ch;
+                depth = before;
+            }
+            return at >= column;
+        });
+    if (depth < 0 || (paren == ')' && depth == 0))
+    {
+        return false;
+    }
+    const auto found = [&](Sci_Position at_line, std::size_t at_column)
+    {
+        match.match = static_cast<std::size_t>(doc->LineStart(at_line)) + at_column;
+        return true;
+    };
+
+    if (paren == '(')
+    {
+        // The closing parenthesis steps back down to depth.
+        const int inside{depth + 1};
+        const auto closes = [inside](std::size_t, char ch, int before) { return ch == ')' && before == inside; };
+        const std::size_t here = find_paren(depths, line,
+            [&](std::size_t at, char ch, int before) { return at > column && closes(at, ch, before); });
+        if (here != std::string::npos)
+        {
+            return found(line, here);
+        }
+        for (Sci_Position next = line + 1; next < depths.line_count(); ++next)
+        {
+            if (may_cross(depths.line(next), depth))
+            {
+                const std::size_t at = find_paren(depths, next, closes);
+                if (at != std::string::npos)
+                {
+                    return found(next, at);
+                }
+            }
+        }
+        return false;
+    }
+
+    // The opening parenthesis is the last to step up from depth - 1 before this one.
+    const int outside{depth - 1};
+    const auto last_open = [&](Sci_Position at_line, std::size_t end_column)
+    {
+        std::size_t last{std::string::npos};
+        find_paren(depths, at_line,
+            [&](std::size_t at, char ch, int before)
+            {
+                if (at < end_column && ch == '(' && before == outside)
+                {
+                    last = at;
+                }
+                return at >= end_column;
+            });
+        return last;
+    };
+    std::size_t at = last_open(line, column);
+    if (at != std::string::npos)
+    {
+        return found(line, at);
+    }
+    for (Sci_Position previous = line; previous-- > 0;)
+    {
+        if (may_cross(depths.line(previous), outside))
+        {
+            at = last_open(previous, std::string::npos);
+            if (at != std::string::npos)
+            {
+                return found(previous, at);
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace formula
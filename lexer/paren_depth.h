@@ -0,0 +1,57 @@
+#pragma once
+
+#include <formula/lexer.h>
+
+class IDocument;
+
+namespace formula
+{
+
+// Follows the parenthesis depth through text a character at a time, ignoring
+// comments.  A closing parenthesis with nothing to close leaves the depth at 0.
+// The folder records each line's depths in its line state with it.
+class ParenDepth
+{
+public:
+    explicit ParenDepth(int depth = 0) :
+        m_depth(depth),
+        m_low(depth),
+        m_high(depth)
+    {
+    }
+
+    void scan(char ch);
+
+    // Ends the current line, returning its line state, and starts the next.
+    int end_line(bool in_entry);
+
+    int depth() const
+    {
+        return m_depth;
+    }
+    // The lowest and highest depths of the current line so far.
+    int low() const
+    {
+        return m_low;
+    }
+    int high() const
+    {
+        return m_high;
+    }
+    bool in_comment() const
+    {
+        return m_in_comment;
+    }
+
+private:
+    int m_depth;
+    int m_low;
+    int m_high;
+    bool m_in_comment{};
+};
+
+// Finds the parenthesis matching the one at match.position, skipping the lines whose
+// line states show they can't hold it.  Returns false when there is no match.
+bool match_paren(IDocument *doc, ParenMatch &match);
+
+} // namespace formula
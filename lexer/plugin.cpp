@@ -0,0 +1,35 @@
+#include <formula/lexer.h>
+
+#include <ILexer.h>
+
+#include <cstring>
+
+using LexerFactoryFunction = ILexer *();
+
+#if WIN32
+#define EXPORT __declspec(dllexport)
+#else
+#define EXPORT
+#endif
+
+extern "C" EXPORT int SCI_METHOD GetLexerCount()
+{
+    return 1;
+}
+
+extern "C" EXPORT void SCI_METHOD GetLexerName(unsigned int index, char *name, int size)
+{
+    if (index == 0)
+    {
+        std::strncpy(name, formula::LEXER_NAME, size);
+    }
+}
+
+extern "C" EXPORT LexerFactoryFunction *SCI_METHOD GetLexerFactory(unsigned int index)
+{
+    if (index == 0)
+    {
+        return formula::create_lexer;
+    }
+    return nullptr;
+}
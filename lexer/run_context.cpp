@@ -0,0 +1,142 @@
+#include "run_context.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+
+namespace formula
+{
+
+RunContext::RunContext(const char *text, std::size_t length, int init_style, StyleRunWriter &writer) :
+    state(init_style),
+    m_writer(writer),
+    m_data(text),
+    m_count(length),
+    m_length(length),
+    m_length_known(true)
+{
+    ch = char_at(0);
+    chNext = char_at(1);
+}
+
+RunContext::RunContext(std::istream &in, int init_style, StyleRunWriter &writer) :
+    state(init_style),
+    m_writer(writer),
+    m_in(&in),
+    m_buffer(WINDOW_SIZE + TOKEN_SIZE)
+{
+    m_data = m_buffer.data();
+    refill();
+    ch = char_at(0);
+    chNext = char_at(1);
+}
+
+int RunContext::char_at(std::size_t pos)
+{
+    if (pos - m_base >= m_count && !m_length_known)
+    {
+        refill();
+    }
+    if (pos - m_base < m_count)
+    {
+        return static_cast<unsigned char>(m_data[pos - m_base]);
+    }
+    return 0;
+}
+
+void RunContext::refill()
+{
+    // Write out everything whose style is settled before the window moves.
+    if (state != +Syntax::IDENTIFIER || currentPos - m_token_start >= TOKEN_SIZE)
+    {
+        emit(m_segment_start, currentPos, state);
+        m_segment_start = currentPos;
+    }
+    flush();
+
+    const std::size_t keep_from = std::min(m_segment_start, currentPos);
+    const std::size_t kept = m_base + m_count - std::min(keep_from, m_base + m_count);
+    std::memmove(m_buffer.data(), m_buffer.data() + (m_count - kept), kept);
+    m_base += m_count - kept;
+    m_in->read(m_buffer.data() + kept, static_cast<std::streamsize>(m_buffer.size() - kept));
+    const std::size_t read = static_cast<std::size_t>(m_in->gcount());
+    m_count = kept + read;
+    if (read == 0)
+    {
+        m_length = m_base + m_count;
+        m_length_known = true;
+    }
+}
+
+void RunContext::Forward()
+{
+    if (currentPos - m_token_start < TOKEN_SIZE)
+    {
+        m_token[currentPos - m_token_start] = static_cast<char>(ch);
+        m_token_length = currentPos - m_token_start + 1;
+    }
+    chPrev = ch;
+    ++currentPos;
+    ch = chNext;
+    chNext = char_at(currentPos + 1);
+    atLineStart = chPrev == '\n' || (chPrev == '\r' && ch != '\n');
+}
+
+void RunContext::SetState(int state_)
+{
+    emit(m_segment_start, currentPos, state);
+    m_segment_start = currentPos;
+    m_token_start = currentPos;
+    m_token_length = 0;
+    state = state_;
+}
+
+void RunContext::GetCurrentLowered(char *s, std::size_t len) const
+{
+    std::size_t i = 0;
+    for (; i < m_token_length && i + 1 < len; ++i)
+    {
+        const char c = m_token[i];
+        s[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    s[i] = '\0';
+}
+
+void RunContext::Complete()
+{
+    emit(m_segment_start, currentPos, state);
+    m_segment_start = currentPos;
+    flush();
+}
+
+void RunContext::emit(std::size_t start, std::size_t end, int style)
+{
+    if (m_length_known)
+    {
+        end = std::min(end, m_length);
+    }
+    if (start >= end)
+    {
+        return;
+    }
+    if (m_has_pending && +m_pending.style == style && m_pending.start + m_pending.length == start)
+    {
+        m_pending.length += end - start;
+        return;
+    }
+    flush();
+    m_pending = StyleRun{start, end - start, static_cast<Syntax>(style)};
+    m_pending_text = m_data + (start - m_base);
+    m_has_pending = true;
+}
+
+void RunContext::flush()
+{
+    if (m_has_pending)
+    {
+        m_writer.write(m_pending, m_pending_text);
+        m_has_pending = false;
+    }
+}
+
+} // namespace formula
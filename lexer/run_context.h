@@ -0,0 +1,83 @@
+#pragma once
+
+#include <formula/runs.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace formula
+{
+
+// Presents text to the lexer's state machine through the subset of the
+// StyleContext interface it uses, reporting style runs to a StyleRunWriter
+// instead of writing a style byte per character.
+//
+// Stream input is read through a window of WINDOW_SIZE characters.  Only
+// the unfinished part of the current run is carried over when the window is
+// refilled: runs whose style can no longer change are written out first, and
+// an identifier that might still become a keyword or function is shorter than
+// TOKEN_SIZE.
+class RunContext
+{
+public:
+    RunContext(const char *text, std::size_t length, int init_style, StyleRunWriter &writer);
+    RunContext(std::istream &in, int init_style, StyleRunWriter &writer);
+
+    bool More() const
+    {
+        return !m_length_known || currentPos <= m_length;
+    }
+    void Forward();
+    void SetState(int state_);
+    void ChangeState(int state_)
+    {
+        state = state_;
+    }
+    std::size_t LengthCurrent() const
+    {
+        return currentPos - m_token_start;
+    }
+    void GetCurrentLowered(char *s, std::size_t len) const;
+    void Complete();
+
+    // Total number of characters, known once the end of the input is reached.
+    std::size_t length() const
+    {
+        return m_length;
+    }
+
+    std::size_t currentPos{};
+    bool atLineStart{true};
+    int state;
+    int chPrev{};
+    int ch{};
+    int chNext{};
+
+private:
+    static constexpr std::size_t WINDOW_SIZE{64 * 1024};
+    static constexpr std::size_t TOKEN_SIZE{80};
+
+    int char_at(std::size_t pos);
+    void refill();
+    void emit(std::size_t start, std::size_t end, int style);
+    void flush();
+
+    StyleRunWriter &m_writer;
+    std::istream *m_in{};
+    std::vector<char> m_buffer;
+    const char *m_data{};
+    std::size_t m_base{};
+    std::size_t m_count{};
+    std::size_t m_length{};
+    bool m_length_known{};
+    std::size_t m_segment_start{};
+    std::size_t m_token_start{};
+    char m_token[TOKEN_SIZE]{};
+    std::size_t m_token_length{};
+    StyleRun m_pending{};
+    const char *m_pending_text{};
+    bool m_has_pending{};
+};
+
+} // namespace formula
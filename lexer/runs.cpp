@@ -0,0 +1,22 @@
+#include <formula/runs.h>
+
+namespace formula
+{
+
+void StyleRunArena::write(const StyleRun &run, const char * /*text*/)
+{
+    const std::size_t block = m_size / BLOCK_SIZE;
+    if (block == m_blocks.size())
+    {
+        m_blocks.emplace_back(new StyleRun[BLOCK_SIZE]);
+    }
+    m_blocks[block][m_size % BLOCK_SIZE] = run;
+    ++m_size;
+}
+
+void StyleRunArena::clear()
+{
+    m_size = 0;
+}
+
+} // namespace formula
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace formula
+{
+
+using NodeId = std::uint32_t;
+constexpr NodeId NO_NODE{0xFFFFFFFFU};
+
+enum class NodeKind : std::uint8_t
+{
+    BLOCK,      // statements in order
+    NUMBER,     // Entry::numbers[value]
+    COMPLEX,    // (real, imaginary)
+    IDENTIFIER, // a variable or constant such as pixel
+    CALL,       // a function applied to its one argument
+    UNARY,      // op applied to the child
+    BINARY,     // op applied to the two children
+    ASSIGN,     // identifier = value
+    MODULUS,    // |value|, the squared modulus
+    IF,         // condition, block, then any ELSEIF and an ELSE
+    ELSEIF,     // condition, block
+    ELSE,       // block
+};
+
+enum class Operator : std::uint8_t
+{
+    NONE,
+    NEGATE,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    POWER,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+    AND,
+    OR,
+};
+
+// Nodes refer to their children by index into their entry's arena and
+// record their source text as offsets from the start of the entry, so a
+// tree stays valid while text before its entry is edited.
+struct Node
+{
+    NodeKind kind{};
+    Operator op{};
+    std::uint32_t begin{};
+    std::uint32_t end{};
+    std::uint32_t value{};
+    NodeId first_child{NO_NODE};
+    NodeId next_sibling{NO_NODE};
+};
+
+struct Diagnostic
+{
+    std::uint32_t begin{}; // offsets from the start of the entry
+    std::uint32_t end{};
+    std::string message;
+};
+
+// One formula of a .frm file:
+//
+//     Name(SYMMETRY) { init : iteration, bailout }
+//
+// The init section is optional; the last statement of the body is the bailout
+// condition.  All of the entry's nodes live in one arena that is discarded as
+// a whole when the entry is reparsed.
+struct Entry
+{
+    std::size_t begin{}; // the document range from the name to the closing brace
+    std::size_t end{};
+    std::string name;
+    std::string symmetry;
+    NodeId init{NO_NODE};      // a BLOCK
+    NodeId iteration{NO_NODE}; // a BLOCK
+    NodeId bailout{NO_NODE};   // an expression, or NO_NODE when missing
+    std::vector<Node> nodes;
+    std::vector<double> numbers;
+    std::vector<Diagnostic> diagnostics;
+
+    const Node &node(NodeId id) const
+    {
+        return nodes[id];
+    }
+
+    // The source text of a node, given the text of the document holding the entry.
+    std::string_view text(std::string_view document, NodeId id) const
+    {
+        return document.substr(begin + nodes[id].begin, nodes[id].end - nodes[id].begin);
+    }
+};
+
+} // namespace formula
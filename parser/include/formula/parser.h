@@ -0,0 +1,75 @@
+#pragma once
+
+#include <formula/ast.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace formula
+{
+
+// The position of the next entry at or after position, skipping blank lines and
+// comments, or text.size() when there are no more entries.
+std::size_t next_entry(std::string_view text, std::size_t position);
+
+// Parses the entry that starts at begin, as found by next_entry.  Parsing stops at
+// the closing brace, or at the start of the line holding the next opening brace
+// when the closing brace is missing, so one broken entry doesn't swallow the rest.
+Entry parse_entry(std::string_view text, std::size_t begin);
+
+// The entry's sections as S-expressions, for tests and debugging.
+std::string to_string(const Entry &entry, std::string_view text);
+
+// removed bytes at position replaced by inserted bytes.
+struct TextChange
+{
+    std::size_t position{};
+    std::size_t removed{};
+    std::size_t inserted{};
+};
+
+// The change from one text to a third, given the change from it to a second and from that to the third.
+TextChange merge_changes(const TextChange &first, const TextChange &second);
+
+// The entries of a formula file, reparsed entry by entry as the text changes.
+class FormulaFile
+{
+public:
+    struct Range
+    {
+        std::size_t first{}; // index of the first reparsed entry
+        std::size_t count{};
+        std::size_t replaced{}; // the number of old entries they replace
+    };
+
+    void parse(std::string_view text);
+
+    // text is the document after removed bytes at position were replaced by inserted
+    // bytes.  Reparses from the entry containing the edit until an entry starts where
+    // an old entry after the edit moved to; returns the entries that were reparsed, so
+    // that anything kept alongside the entries can be updated to match.
+    Range update(std::string_view text, std::size_t position, std::size_t removed, std::size_t inserted);
+
+    // Where update starts reading the text for an edit at position.
+    std::size_t reparse_start(std::size_t position) const;
+
+    // As update, with text only the document from text_start on, for a text_start at or before
+    // reparse_start(position), so the text before it needn't be fetched.
+    Range update(std::string_view text, std::size_t text_start, std::size_t position, std::size_t removed,
+        std::size_t inserted);
+
+    const std::vector<Entry> &entries() const
+    {
+        return m_entries;
+    }
+
+    // The entry whose range contains position, or nullptr.
+    const Entry *find(std::size_t position) const;
+
+private:
+    std::vector<Entry> m_entries;
+};
+
+} // namespace formula
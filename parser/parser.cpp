@@ -0,0 +1,999 @@
+#include <formula/parser.h>
+#include <formula/vocabulary.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+namespace formula
+{
+
+namespace
+{
+
+enum class Token
+{
+    END,
+    NEWLINE,
+    COMMA,
+    COLON,
+    OPEN_PAREN,
+    CLOSE_PAREN,
+    PIPE,
+    ASSIGN,
+    PLUS,
+    MINUS,
+    STAR,
+    SLASH,
+    CARET,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    EQUAL,
+    NOT_EQUAL,
+    AND,
+    OR,
+    NUMBER,
+    IDENTIFIER,
+    IF,
+    ELSEIF,
+    ELSE,
+    ENDIF,
+    UNKNOWN,
+};
+
+// Binary operators from the loosest binding to the tightest; POWER and NEGATE bind tighter still.
+constexpr int BINARY_LEVELS{5};
+
+Operator binary_operator(Token token, int level)
+{
+    switch (level)
+    {
+    case 0:
+        return token == Token::OR ? Operator::OR : Operator::NONE;
+    case 1:
+        return token == Token::AND ? Operator::AND : Operator::NONE;
+    case 2:
+        switch (token)
+        {
+        case Token::LESS:
+            return Operator::LESS;
+        case Token::LESS_EQUAL:
+            return Operator::LESS_EQUAL;
+        case Token::GREATER:
+            return Operator::GREATER;
+        case Token::GREATER_EQUAL:
+            return Operator::GREATER_EQUAL;
+        case Token::EQUAL:
+            return Operator::EQUAL;
+        case Token::NOT_EQUAL:
+            return Operator::NOT_EQUAL;
+        default:
+            return Operator::NONE;
+        }
+    case 3:
+        return token == Token::PLUS ? Operator::ADD : token == Token::MINUS ? Operator::SUBTRACT : Operator::NONE;
+    case 4:
+        return token == Token::STAR ? Operator::MULTIPLY : token == Token::SLASH ? Operator::DIVIDE : Operator::NONE;
+    default:
+        return Operator::NONE;
+    }
+}
+
+const char *operator_text(Operator op)
+{
+    static const char *const TEXT[]{"", "-", "+", "-", "*", "/", "^", "<", "<=", ">", ">=", "==", "!=", "&&", "||"};
+    return TEXT[static_cast<int>(op)];
+}
+
+std::string lowered(std::string_view word)
+{
+    std::string result{word};
+    std::transform(result.begin(), result.end(), result.begin(),
+        [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+    return result;
+}
+
+bool is_line_end(char ch)
+{
+    return ch == '\n' || ch == '\r';
+}
+
+bool is_digit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+std::size_t line_end(std::string_view text, std::size_t position)
+{
+    while (position < text.size() && !is_line_end(text[position]))
+    {
+        ++position;
+    }
+    return position;
+}
+
+std::size_t line_start(std::string_view text, std::size_t position)
+{
+    while (position > 0 && !is_line_end(text[position - 1]))
+    {
+        --position;
+    }
+    return position;
+}
+
+std::string_view trimmed(std::string_view text)
+{
+    while (!text.empty() && is_whitespace(text.front()))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && is_whitespace(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// The first brace after position outside comments, or text.size().
+std::size_t next_brace(std::string_view text, std::size_t position)
+{
+    while (position < text.size() && text[position] != '{' && text[position] != '}')
+    {
+        position = text[position] == COMMENT_CHAR ? line_end(text, position) : position + 1;
+    }
+    return position;
+}
+
+// A recursive descent parser over the body of one entry, between its braces.
+// Statements are separated by commas and line ends; line ends inside parentheses
+// and modulus bars continue the statement.  After an error the rest of the
+// statement is skipped, so each broken statement reports one diagnostic.
+class Parser
+{
+public:
+    Parser(std::string_view text, std::size_t begin, std::size_t end, Entry &entry) :
+        m_text(text),
+        m_limit(end),
+        m_pos(begin),
+        m_entry(entry)
+    {
+    }
+
+    void parse_body(std::size_t close);
+
+private:
+    void next();
+    void lex_word();
+    void lex_number();
+    bool at(Token token) const
+    {
+        return m_token == token;
+    }
+    bool at_separator() const
+    {
+        return at(Token::NEWLINE) || at(Token::COMMA);
+    }
+    bool at_block_end(bool in_if) const
+    {
+        return at(Token::END) || at(Token::COLON) ||
+            (in_if && (at(Token::ELSEIF) || at(Token::ELSE) || at(Token::ENDIF)));
+    }
+    bool expect(Token token, const char *description);
+    void error(std::size_t begin, std::size_t end, std::string message);
+    void recover(bool in_if);
+
+    NodeId add(NodeKind kind, std::size_t begin, std::size_t end, Operator op = Operator::NONE);
+    void append(NodeId parent, NodeId &last, NodeId child);
+    NodeId combine(NodeKind kind, Operator op, NodeId lhs, NodeId rhs);
+    void finish(NodeId node)
+    {
+        m_entry.nodes[node].end = static_cast<std::uint32_t>(m_previous_end - m_entry.begin);
+    }
+
+    NodeId statements(bool in_if);
+    NodeId statement();
+    NodeId if_statement();
+    NodeId expression();
+    NodeId binary(int level);
+    NodeId unary();
+    NodeId power();
+    NodeId exponent();
+    NodeId primary();
+
+    std::string_view m_text;
+    std::size_t m_limit;
+    std::size_t m_pos;
+    Entry &m_entry;
+    Token m_token{Token::END};
+    std::size_t m_token_begin{};
+    std::size_t m_token_end{};
+    std::size_t m_previous_end{};
+    double m_number{};
+    int m_depth{}; // open parentheses and modulus bars
+};
+
+void Parser::next()
+{
+    m_previous_end = m_token_end;
+    for (;;)
+    {
+        while (m_pos < m_limit && is_whitespace(m_text[m_pos]))
+        {
+            ++m_pos;
+        }
+        if (m_pos < m_limit && m_text[m_pos] == COMMENT_CHAR)
+        {
+            m_pos = std::min(line_end(m_text, m_pos), m_limit);
+        }
+        if (m_pos >= m_limit)
+        {
+            m_token = Token::END;
+            m_token_begin = m_limit;
+            m_token_end = m_limit;
+            return;
+        }
+        if (!is_line_end(m_text[m_pos]))
+        {
+            break;
+        }
+        m_token_begin = m_pos;
+        if (m_text[m_pos++] == '\r' && m_pos < m_limit && m_text[m_pos] == '\n')
+        {
+            ++m_pos;
+        }
+        if (m_depth == 0)
+        {
+            m_token = Token::NEWLINE;
+            m_token_end = m_pos;
+            return;
+        }
+    }
+
+    m_token_begin = m_pos;
+    const char ch = m_text[m_pos];
+    const char next_ch = m_pos + 1 < m_limit ? m_text[m_pos + 1] : '\0';
+    if (is_keyword_char(ch))
+    {
+        lex_word();
+        return;
+    }
+    if (is_digit(ch) || (ch == '.' && is_digit(next_ch)))
+    {
+        lex_number();
+        return;
+    }
+
+    static constexpr struct
+    {
+        char first;
+        char second;
+        Token token;
+    } PUNCTUATION[]{
+        {'<', '=', Token::LESS_EQUAL},
+        {'>', '=', Token::GREATER_EQUAL},
+        {'=', '=', Token::EQUAL},
+        {'!', '=', Token::NOT_EQUAL},
+        {'&', '&', Token::AND},
+        {'|', '|', Token::OR},
+        {',', '\0', Token::COMMA},
+        {':', '\0', Token::COLON},
+        {'(', '\0', Token::OPEN_PAREN},
+        {')', '\0', Token::CLOSE_PAREN},
+        {'|', '\0', Token::PIPE},
+        {'=', '\0', Token::ASSIGN},
+        {'+', '\0', Token::PLUS},
+        {'-', '\0', Token::MINUS},
+        {'*', '\0', Token::STAR},
+        {'/', '\0', Token::SLASH},
+        {'^', '\0', Token::CARET},
+        {'<', '\0', Token::LESS},
+        {'>', '\0', Token::GREATER},
+    };
+    m_token = Token::UNKNOWN;
+    m_pos += 1;
+    for (const auto &entry : PUNCTUATION)
+    {
+        if (entry.first == ch && (entry.second == '\0' || entry.second == next_ch))
+        {
+            m_token = entry.token;
+            m_pos += entry.second == '\0' ? 0 : 1;
+            break;
+        }
+    }
+    m_token_end = m_pos;
+}
+
+void Parser::lex_word()
+{
+    while (m_pos < m_limit && is_identifier_char(m_text[m_pos]))
+    {
+        ++m_pos;
+    }
+    m_token_end = m_pos;
+    m_token = Token::IDENTIFIER;
+    const std::string word = lowered(m_text.substr(m_token_begin, m_token_end - m_token_begin));
+    if (is_keyword(word))
+    {
+        m_token = word == "if"   ? Token::IF
+            : word == "elseif"   ? Token::ELSEIF
+            : word == "else"     ? Token::ELSE
+                                 : Token::ENDIF;
+    }
+}
+
+void Parser::lex_number()
+{
+    const auto digits = [this]
+    {
+        while (m_pos < m_limit && is_digit(m_text[m_pos]))
+        {
+            ++m_pos;
+        }
+    };
+    digits();
+    if (m_pos < m_limit && m_text[m_pos] == '.')
+    {
+        ++m_pos;
+        digits();
+    }
+    if (m_pos < m_limit && (m_text[m_pos] == 'e' || m_text[m_pos] == 'E'))
+    {
+        std::size_t exponent = m_pos + 1;
+        if (exponent < m_limit && (m_text[exponent] == '+' || m_text[exponent] == '-'))
+        {
+            ++exponent;
+        }
+        if (exponent < m_limit && is_digit(m_text[exponent]))
+        {
+            m_pos = exponent;
+            digits();
+        }
+    }
+    m_token_end = m_pos;
+    m_token = Token::NUMBER;
+    m_number = std::strtod(std::string{m_text.substr(m_token_begin, m_token_end - m_token_begin)}.c_str(), nullptr);
+}
+
+bool Parser::expect(Token token, const char *description)
+{
+    if (!at(token))
+    {
+        error(m_token_begin, std::max(m_token_end, m_token_begin + 1), std::string{"Expected "} + description);
+        return false;
+    }
+    next();
+    return true;
+}
+
+void Parser::error(std::size_t begin, std::size_t end, std::string message)
+{
+    m_entry.diagnostics.push_back({static_cast<std::uint32_t>(begin - m_entry.begin),
+        static_cast<std::uint32_t>(end - m_entry.begin), std::move(message)});
+}
+
+// Skips to the end of the broken statement.
+void Parser::recover(bool in_if)
+{
+    m_depth = 0;
+    while (!at_separator() && !at_block_end(in_if))
+    {
+        next();
+    }
+}
+
+NodeId Parser::add(NodeKind kind, std::size_t begin, std::size_t end, Operator op)
+{
+    Node node;
+    node.kind = kind;
+    node.op = op;
+    node.begin = static_cast<std::uint32_t>(begin - m_entry.begin);
+    node.end = static_cast<std::uint32_t>(end - m_entry.begin);
+    m_entry.nodes.push_back(node);
+    return static_cast<NodeId>(m_entry.nodes.size() - 1);
+}
+
+void Parser::append(NodeId parent, NodeId &last, NodeId child)
+{
+    if (last == NO_NODE)
+    {
+        m_entry.nodes[parent].first_child = child;
+    }
+    else
+    {
+        m_entry.nodes[last].next_sibling = child;
+    }
+    last = child;
+}
+
+NodeId Parser::combine(NodeKind kind, Operator op, NodeId lhs, NodeId rhs)
+{
+    const NodeId node = add(kind, m_entry.begin + m_entry.nodes[lhs].begin, m_entry.begin + m_entry.nodes[rhs].end, op);
+    m_entry.nodes[node].first_child = lhs;
+    m_entry.nodes[lhs].next_sibling = rhs;
+    return node;
+}
+
+void Parser::parse_body(std::size_t close)
+{
+    next();
+    const NodeId first = statements(false);
+    if (at(Token::COLON))
+    {
+        m_entry.init = first;
+        next();
+        m_entry.iteration = statements(false);
+        while (at(Token::COLON))
+        {
+            error(m_token_begin, m_token_end, "Only one ':' may end the init section");
+            next();
+            statements(false);
+        }
+    }
+    else
+    {
+        m_entry.init = add(NodeKind::BLOCK, m_entry.begin + m_entry.nodes[first].begin,
+            m_entry.begin + m_entry.nodes[first].begin);
+        m_entry.iteration = first;
+    }
+
+    // The last statement of the iteration section is the bailout condition.
+    Node &iteration = m_entry.nodes[m_entry.iteration];
+    NodeId previous = NO_NODE;
+    NodeId last = iteration.first_child;
+    while (last != NO_NODE && m_entry.nodes[last].next_sibling != NO_NODE)
+    {
+        previous = last;
+        last = m_entry.nodes[last].next_sibling;
+    }
+    if (last == NO_NODE)
+    {
+        error(close, std::min(close + 1, m_text.size()), "Missing bailout condition");
+    }
+    else if (m_entry.nodes[last].kind == NodeKind::IF)
+    {
+        error(m_entry.begin + m_entry.nodes[last].begin, m_entry.begin + m_entry.nodes[last].end,
+            "The bailout condition must be an expression");
+    }
+    else
+    {
+        m_entry.bailout = last;
+        (previous == NO_NODE ? iteration.first_child : m_entry.nodes[previous].next_sibling) = NO_NODE;
+    }
+}
+
+NodeId Parser::statements(bool in_if)
+{
+    const NodeId block = add(NodeKind::BLOCK, m_token_begin, m_token_begin);
+    NodeId last = NO_NODE;
+    for (;;)
+    {
+        while (at_separator())
+        {
+            next();
+        }
+        if (at_block_end(in_if))
+        {
+            break;
+        }
+        const NodeId node = statement();
+        if (node != NO_NODE)
+        {
+            append(block, last, node);
+            if (!at_separator() && !at_block_end(in_if))
+            {
+                error(m_token_begin, m_token_end, "Expected ',' or a new line");
+            }
+        }
+        recover(in_if);
+    }
+    if (last != NO_NODE)
+    {
+        Node &node = m_entry.nodes[block];
+        node.begin = m_entry.nodes[node.first_child].begin;
+        node.end = m_entry.nodes[last].end;
+    }
+    return block;
+}
+
+NodeId Parser::statement()
+{
+    if (at(Token::IF))
+    {
+        return if_statement();
+    }
+    if (at(Token::ELSEIF) || at(Token::ELSE) || at(Token::ENDIF))
+    {
+        const std::string keyword = lowered(m_text.substr(m_token_begin, m_token_end - m_token_begin));
+        error(m_token_begin, m_token_end, "'" + keyword + "' without 'if'");
+        next();
+        return NO_NODE;
+    }
+    return expression();
+}
+
+NodeId Parser::if_statement()
+{
+    const std::size_t keyword_begin = m_token_begin;
+    const std::size_t keyword_end = m_token_end;
+    const NodeId node = add(NodeKind::IF, keyword_begin, keyword_end);
+    NodeId last = NO_NODE;
+    next();
+    const NodeId condition = expression();
+    if (condition == NO_NODE)
+    {
+        return NO_NODE;
+    }
+    append(node, last, condition);
+    append(node, last, statements(true));
+
+    while (at(Token::ELSEIF) || at(Token::ELSE))
+    {
+        const bool is_else = at(Token::ELSE);
+        const NodeId clause = add(is_else ? NodeKind::ELSE : NodeKind::ELSEIF, m_token_begin, m_token_end);
+        NodeId clause_last = NO_NODE;
+        next();
+        if (!is_else)
+        {
+            const NodeId clause_condition = expression();
+            if (clause_condition == NO_NODE)
+            {
+                return NO_NODE;
+            }
+            append(clause, clause_last, clause_condition);
+        }
+        append(clause, clause_last, statements(true));
+        finish(clause);
+        append(node, last, clause);
+        if (is_else)
+        {
+            break;
+        }
+    }
+
+    if (at(Token::ENDIF))
+    {
+        next();
+    }
+    else
+    {
+        error(keyword_begin, keyword_end, "Missing 'endif'");
+    }
+    finish(node);
+    return node;
+}
+
+NodeId Parser::expression()
+{
+    const NodeId lhs = binary(0);
+    if (lhs == NO_NODE || !at(Token::ASSIGN))
+    {
+        return lhs;
+    }
+    if (m_entry.nodes[lhs].kind != NodeKind::IDENTIFIER)
+    {
+        error(m_entry.begin + m_entry.nodes[lhs].begin, m_entry.begin + m_entry.nodes[lhs].end,
+            "Only a variable can be assigned");
+    }
+    next();
+    const NodeId rhs = expression();
+    return rhs == NO_NODE ? NO_NODE : combine(NodeKind::ASSIGN, Operator::NONE, lhs, rhs);
+}
+
+NodeId Parser::binary(int level)
+{
+    if (level == BINARY_LEVELS)
+    {
+        return unary();
+    }
+    NodeId lhs = binary(level + 1);
+    for (Operator op; lhs != NO_NODE && (op = binary_operator(m_token, level)) != Operator::NONE;)
+    {
+        next();
+        const NodeId rhs = binary(level + 1);
+        lhs = rhs == NO_NODE ? NO_NODE : combine(NodeKind::BINARY, op, lhs, rhs);
+    }
+    return lhs;
+}
+
+// Negation binds looser than powers, so -z^2 is -(z^2).
+NodeId Parser::unary()
+{
+    if (at(Token::PLUS))
+    {
+        next();
+        return unary();
+    }
+    if (!at(Token::MINUS))
+    {
+        return power();
+    }
+    const NodeId node = add(NodeKind::UNARY, m_token_begin, m_token_end, Operator::NEGATE);
+    next();
+    const NodeId operand = unary();
+    if (operand == NO_NODE)
+    {
+        return NO_NODE;
+    }
+    m_entry.nodes[node].first_child = operand;
+    finish(node);
+    return node;
+}
+
+// Powers group to the left, as in Fractint.
+NodeId Parser::power()
+{
+    NodeId lhs = primary();
+    while (lhs != NO_NODE && at(Token::CARET))
+    {
+        next();
+        const NodeId rhs = exponent();
+        lhs = rhs == NO_NODE ? NO_NODE : combine(NodeKind::BINARY, Operator::POWER, lhs, rhs);
+    }
+    return lhs;
+}
+
+// An exponent may be negated, as in z^-1.
+NodeId Parser::exponent()
+{
+    if (!at(Token::MINUS))
+    {
+        return primary();
+    }
+    const NodeId node = add(NodeKind::UNARY, m_token_begin, m_token_end, Operator::NEGATE);
+    next();
+    const NodeId operand = exponent();
+    if (operand == NO_NODE)
+    {
+        return NO_NODE;
+    }
+    m_entry.nodes[node].first_child = operand;
+    finish(node);
+    return node;
+}
+
+NodeId Parser::primary()
+{
+    const std::size_t begin = m_token_begin;
+    switch (m_token)
+    {
+    case Token::NUMBER:
+    {
+        const NodeId node = add(NodeKind::NUMBER, begin, m_token_end);
+        m_entry.nodes[node].value = static_cast<std::uint32_t>(m_entry.numbers.size());
+        m_entry.numbers.push_back(m_number);
+        next();
+        return node;
+    }
+
+    case Token::IDENTIFIER:
+    {
+        const NodeId node = add(NodeKind::IDENTIFIER, begin, m_token_end);
+        const std::string name = lowered(m_text.substr(begin, m_token_end - begin));
+        next();
+        if (!at(Token::OPEN_PAREN))
+        {
+            return node;
+        }
+        m_entry.nodes[node].kind = NodeKind::CALL;
+        if (!is_builtin_function(name))
+        {
+            error(begin, begin + name.size(), "Unknown function '" + name + "'");
+        }
+        ++m_depth;
+        next();
+        const NodeId argument = expression();
+        --m_depth;
+        if (argument == NO_NODE || !expect(Token::CLOSE_PAREN, "')'"))
+        {
+            return NO_NODE;
+        }
+        m_entry.nodes[node].first_child = argument;
+        finish(node);
+        return node;
+    }
+
+    case Token::OPEN_PAREN:
+    {
+        ++m_depth;
+        next();
+        const NodeId real = expression();
+        if (real == NO_NODE)
+        {
+            return NO_NODE;
+        }
+        NodeId node = real;
+        if (at(Token::COMMA))
+        {
+            next();
+            const NodeId imaginary = expression();
+            if (imaginary == NO_NODE)
+            {
+                return NO_NODE;
+            }
+            node = combine(NodeKind::COMPLEX, Operator::NONE, real, imaginary);
+            m_entry.nodes[node].begin = static_cast<std::uint32_t>(begin - m_entry.begin);
+        }
+        --m_depth;
+        if (!expect(Token::CLOSE_PAREN, "')'"))
+        {
+            return NO_NODE;
+        }
+        if (node != real)
+        {
+            finish(node);
+        }
+        return node;
+    }
+
+    case Token::PIPE:
+    {
+        const NodeId node = add(NodeKind::MODULUS, begin, m_token_end);
+        ++m_depth;
+        next();
+        const NodeId operand = expression();
+        --m_depth;
+        if (operand == NO_NODE || !expect(Token::PIPE, "'|'"))
+        {
+            return NO_NODE;
+        }
+        m_entry.nodes[node].first_child = operand;
+        finish(node);
+        return node;
+    }
+
+    default:
+        error(begin, std::max(m_token_end, begin + 1), "Expected an expression");
+        return NO_NODE;
+    }
+}
+
+void write_node(std::string &out, const Entry &entry, std::string_view text, NodeId id);
+
+void write_children(std::string &out, const Entry &entry, std::string_view text, NodeId id)
+{
+    for (NodeId child = entry.node(id).first_child; child != NO_NODE; child = entry.node(child).next_sibling)
+    {
+        out += ' ';
+        write_node(out, entry, text, child);
+    }
+}
+
+void write_node(std::string &out, const Entry &entry, std::string_view text, NodeId id)
+{
+    const Node &node = entry.node(id);
+    switch (node.kind)
+    {
+    case NodeKind::NUMBER:
+    case NodeKind::IDENTIFIER:
+        out += entry.text(text, id);
+        return;
+
+    case NodeKind::CALL:
+    {
+        const std::string_view call = entry.text(text, id);
+        out += '(';
+        out += lowered(call.substr(0, std::find_if_not(call.begin(), call.end(), is_identifier_char) - call.begin()));
+        break;
+    }
+
+    case NodeKind::UNARY:
+    case NodeKind::BINARY:
+        out += '(';
+        out += operator_text(node.op);
+        break;
+
+    default:
+    {
+        static const char *const NAMES[]{
+            "block", "", "complex", "", "", "", "", "=", "modulus", "if", "elseif", "else"};
+        out += '(';
+        out += NAMES[static_cast<int>(node.kind)];
+        break;
+    }
+    }
+    write_children(out, entry, text, id);
+    out += ')';
+}
+
+} // namespace
+
+std::size_t next_entry(std::string_view text, std::size_t position)
+{
+    while (position < text.size())
+    {
+        const char ch = text[position];
+        if (ch == COMMENT_CHAR)
+        {
+            position = line_end(text, position);
+        }
+        else if (is_whitespace(ch) || is_line_end(ch))
+        {
+            ++position;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return position;
+}
+
+Entry parse_entry(std::string_view text, std::size_t begin)
+{
+    Entry entry;
+    entry.begin = begin;
+    const std::size_t eol = line_end(text, begin);
+    std::size_t pos = begin;
+    while (pos < eol && text[pos] != '(' && text[pos] != '{' && text[pos] != COMMENT_CHAR)
+    {
+        ++pos;
+    }
+    entry.name = trimmed(text.substr(begin, pos - begin));
+    const auto fail = [&](std::size_t error_begin, const char *message)
+    {
+        entry.diagnostics.push_back({static_cast<std::uint32_t>(error_begin - begin),
+            static_cast<std::uint32_t>(eol - begin), message});
+        entry.end = eol;
+        return entry;
+    };
+    if (pos < eol && text[pos] == '(')
+    {
+        const std::size_t close = text.substr(0, eol).find(')', pos);
+        if (close == std::string_view::npos)
+        {
+            return fail(pos, "Missing ')' after the symmetry");
+        }
+        entry.symmetry = trimmed(text.substr(pos + 1, close - pos - 1));
+        pos = close + 1;
+        while (pos < eol && is_whitespace(text[pos]))
+        {
+            ++pos;
+        }
+    }
+    if (pos >= eol || text[pos] != '{')
+    {
+        return fail(begin, "Expected '{' after the formula name");
+    }
+
+    const std::size_t open = pos;
+    const std::size_t close = next_brace(text, open + 1);
+    Parser parser{text, open + 1, close, entry};
+    parser.parse_body(close);
+    if (close < text.size() && text[close] == '}')
+    {
+        entry.end = close + 1;
+    }
+    else
+    {
+        // Stop before the header of the entry that opens the next brace.
+        entry.diagnostics.push_back({static_cast<std::uint32_t>(open - begin),
+            static_cast<std::uint32_t>(open + 1 - begin), "Missing '}'"});
+        entry.end = close < text.size() ? std::max(line_start(text, close), open + 1) : text.size();
+    }
+    return entry;
+}
+
+std::string to_string(const Entry &entry, std::string_view text)
+{
+    std::string out;
+    const auto section = [&](const char *name, NodeId block)
+    {
+        out += out.empty() ? "(" : " (";
+        out += name;
+        if (block != NO_NODE)
+        {
+            write_children(out, entry, text, block);
+        }
+        out += ')';
+    };
+    section("init", entry.init);
+    section("iteration", entry.iteration);
+    out += " (bailout";
+    if (entry.bailout != NO_NODE)
+    {
+        out += ' ';
+        write_node(out, entry, text, entry.bailout);
+    }
+    out += ')';
+    return out;
+}
+
+void FormulaFile::parse(std::string_view text)
+{
+    m_entries.clear();
+    for (std::size_t pos = next_entry(text, 0); pos < text.size(); pos = next_entry(text, m_entries.back().end))
+    {
+        m_entries.push_back(parse_entry(text, pos));
+    }
+}
+
+TextChange merge_changes(const TextChange &first, const TextChange &second)
+{
+    // The range of the second text either change covers, and where it came from in the first.
+    const std::size_t start = std::min(first.position, second.position);
+    const std::size_t end = std::max(first.position + first.inserted, second.position + second.removed);
+    return {start, end - first.inserted + first.removed - start, end - second.removed + second.inserted - start};
+}
+
+FormulaFile::Range FormulaFile::update(
+    std::string_view text, std::size_t position, std::size_t removed, std::size_t inserted)
+{
+    return update(text, 0, position, removed, inserted);
+}
+
+// Parsing restarts after the last entry that ends before the edit, which is always outside any entry.
+std::size_t FormulaFile::reparse_start(std::size_t position) const
+{
+    const auto first = std::lower_bound(m_entries.begin(), m_entries.end(), position,
+        [](const Entry &entry, std::size_t value) { return entry.end < value; });
+    return first != m_entries.begin() ? std::prev(first)->end : 0;
+}
+
+FormulaFile::Range FormulaFile::update(
+    std::string_view text, std::size_t text_start, std::size_t position, std::size_t removed, std::size_t inserted)
+{
+    // Parsing stops where an entry wholly after the edit has moved to.
+    const auto first = std::lower_bound(m_entries.begin(), m_entries.end(), position,
+        [](const Entry &entry, std::size_t value) { return entry.end < value; });
+    const std::size_t first_index = static_cast<std::size_t>(first - m_entries.begin());
+    auto keep = std::upper_bound(first, m_entries.end(), position + removed,
+        [](std::size_t value, const Entry &entry) { return value < entry.begin; });
+
+    // Positions are in the document; text starts text_start into it.
+    const std::size_t length = text_start + text.size();
+    const auto next = [&](std::size_t from) { return next_entry(text, from - text_start) + text_start; };
+    std::vector<Entry> parsed;
+    std::size_t pos = next(reparse_start(position));
+    for (; pos < length; pos = next(parsed.back().end))
+    {
+        while (keep != m_entries.end() && keep->begin + inserted < pos + removed)
+        {
+            ++keep;
+        }
+        if (keep != m_entries.end() && keep->begin + inserted == pos + removed)
+        {
+            break;
+        }
+        parsed.push_back(parse_entry(text, pos - text_start));
+        parsed.back().begin += text_start;
+        parsed.back().end += text_start;
+    }
+    if (pos >= length)
+    {
+        keep = m_entries.end();
+    }
+
+    for (auto it = keep; it != m_entries.end(); ++it)
+    {
+        it->begin = it->begin + inserted - removed;
+        it->end = it->end + inserted - removed;
+    }
+    // Move reparsed entries into the slots of the ones they replace, so the entries
+    // after them are only moved when the number of entries changed.
+    const auto old_count = static_cast<std::size_t>(keep - first);
+    const std::size_t replaced = std::min(parsed.size(), old_count);
+    const auto moved = std::move(parsed.begin(), parsed.begin() + static_cast<std::ptrdiff_t>(replaced), first);
+    if (replaced < parsed.size())
+    {
+        m_entries.insert(moved, std::make_move_iterator(parsed.begin() + static_cast<std::ptrdiff_t>(replaced)),
+            std::make_move_iterator(parsed.end()));
+    }
+    else
+    {
+        m_entries.erase(moved, keep);
+    }
+    return {first_index, parsed.size(), old_count};
+}
+
+const Entry *FormulaFile::find(std::size_t position) const
+{
+    const auto it = std::upper_bound(m_entries.begin(), m_entries.end(), position,
+        [](std::size_t value, const Entry &entry) { return value < entry.end; });
+    return it != m_entries.end() && it->begin <= position ? &*it : nullptr;
+}
+
+} // namespace formula
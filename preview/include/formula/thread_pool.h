@@ -0,0 +1,64 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace formula
+{
+
+// A fixed set of worker threads that share out numbered tasks by work stealing.
+//
+// Each run deals the task indices out to the workers in contiguous shares.  A
+// worker takes tasks from the front of its own queue, and when that is empty it
+// steals the back half of another worker's queue, so a worker that drew cheap
+// tasks helps with the expensive ones instead of going idle.
+class ThreadPool
+{
+public:
+    // Task index and the number of the worker running it, from 0 to size() - 1.
+    using Task = std::function<void(std::size_t index, unsigned worker)>;
+
+    // Uses one thread per core when threads is 0.
+    explicit ThreadPool(unsigned threads = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(m_threads.size());
+    }
+
+    // Runs task for each index below count and returns once all have finished.
+    // Tasks must not throw; one run at a time.
+    void run(std::size_t count, const Task &task);
+
+private:
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> indices;
+    };
+
+    void work(unsigned worker);
+    bool next_task(unsigned worker, std::size_t &index);
+
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<Queue[]> m_queues;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const Task *m_task{};
+    std::uint64_t m_generation{};
+    unsigned m_busy{};
+    bool m_stop{};
+};
+
+} // namespace formula
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <formula/bytecode.h>
+#include <formula/thread_pool.h>
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace formula
+{
+
+// The part of the complex plane shown in an image, with imaginary parts growing upwards.
+struct Viewport
+{
+    std::complex<double> center;
+    double width{4.0}; // of the plane, across the image
+    int pixels_wide{};
+    int pixels_high{};
+
+    std::complex<double> point(int x, int y) const;
+};
+
+// Renders escape-time images of a formula on a thread pool, tile by tile.
+//
+// Images are rendered in passes from coarse to fine: each pass evaluates every
+// step-th pixel that no earlier pass did and fills the step by step block below
+// and to the right of it, so the whole image is usable after every pass and the
+// last pass, at step 1, leaves every pixel evaluated.  Tiles vary a lot in cost,
+// since pixels inside the set run to the iteration limit, and the pool balances
+// them by work stealing.
+class TileRenderer
+{
+public:
+    static constexpr int TILE_SIZE{64};
+    static constexpr int COARSEST_STEP{8};
+
+    explicit TileRenderer(ThreadPool &pool) :
+        m_pool(pool)
+    {
+    }
+
+    // Sets p1 to p5, for index 1 to 5.
+    void set_parameter(int index, std::complex<double> value);
+
+    // Fills iterations, row by row, with the iteration count of each pixel of the
+    // viewport, calling on_pass with the step of each pass once it is complete.
+    // Returns false when cancel was set before the last pass finished; tiles check
+    // it between rows, so a render stops soon after cancel is set.
+    bool render(const Program &program, const Viewport &viewport, int max_iterations, std::vector<int> &iterations,
+        const std::atomic<bool> &cancel, const std::function<void(int step)> &on_pass = {});
+
+    // Tiles rendered over all passes of all renders, for measuring throughput.
+    std::size_t tiles_rendered() const
+    {
+        return m_tiles_rendered;
+    }
+
+private:
+    ThreadPool &m_pool;
+    std::complex<double> m_parameters[5]{};
+    std::atomic<std::size_t> m_tiles_rendered{};
+};
+
+} // namespace formula
@@ -0,0 +1,132 @@
+#include <formula/thread_pool.h>
+
+#include <algorithm>
+
+namespace formula
+{
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    m_queues = std::make_unique<Queue[]>(threads);
+    m_threads.reserve(threads);
+    for (unsigned worker = 0; worker < threads; ++worker)
+    {
+        m_threads.emplace_back([this, worker] { work(worker); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (std::thread &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(std::size_t count, const Task &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    const std::size_t workers = m_threads.size();
+    for (std::size_t worker = 0; worker < workers; ++worker)
+    {
+        Queue &queue = m_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (std::size_t index = worker * count / workers; index < (worker + 1) * count / workers; ++index)
+        {
+            queue.indices.push_back(index);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_busy = static_cast<unsigned>(workers);
+    ++m_generation;
+    m_start.notify_all();
+    m_done.wait(lock, [this] { return m_busy == 0; });
+    m_task = nullptr;
+}
+
+void ThreadPool::work(unsigned worker)
+{
+    std::uint64_t generation{};
+    for (;;)
+    {
+        const Task *task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, generation] { return m_stop || m_generation != generation; });
+            if (m_stop)
+            {
+                return;
+            }
+            generation = m_generation;
+            task = m_task;
+        }
+
+        std::size_t index;
+        while (next_task(worker, index))
+        {
+            (*task)(index, worker);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::next_task(unsigned worker, std::size_t &index)
+{
+    Queue &own = m_queues[worker];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.indices.empty())
+        {
+            index = own.indices.front();
+            own.indices.pop_front();
+            return true;
+        }
+    }
+
+    // Tasks never add tasks, so once every queue has been found empty the run is
+    // over for this worker, though others may still be finishing theirs.
+    const unsigned workers = size();
+    for (unsigned offset = 1; offset < workers; ++offset)
+    {
+        Queue &victim = m_queues[(worker + offset) % workers];
+        std::deque<std::size_t> stolen;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            const std::size_t half = (victim.indices.size() + 1) / 2;
+            const auto middle = victim.indices.end() - static_cast<std::ptrdiff_t>(half);
+            stolen.assign(middle, victim.indices.end());
+            victim.indices.erase(middle, victim.indices.end());
+        }
+        if (stolen.empty())
+        {
+            continue;
+        }
+        index = stolen.front();
+        stolen.pop_front();
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.indices.insert(own.indices.end(), stolen.begin(), stolen.end());
+        return true;
+    }
+    return false;
+}
+
+} // namespace formula
@@ -0,0 +1,130 @@
+#include <formula/tile_renderer.h>
+
+#include <formula/evaluator.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace formula
+{
+
+namespace
+{
+
+// One worker's buffers for the pixels of a row of a tile.
+struct Scratch
+{
+    std::vector<int> xs;
+    std::vector<double> re;
+    std::vector<double> im;
+    std::vector<int> counts;
+};
+
+} // namespace
+
+std::complex<double> Viewport::point(int x, int y) const
+{
+    const double scale = width / pixels_wide;
+    return center + std::complex<double>{(x + 0.5 - pixels_wide / 2.0) * scale, (pixels_high / 2.0 - y - 0.5) * scale};
+}
+
+void TileRenderer::set_parameter(int index, std::complex<double> value)
+{
+    if (index < 1 || index > 5)
+    {
+        throw std::out_of_range("No parameter p" + std::to_string(index));
+    }
+    m_parameters[index - 1] = value;
+}
+
+bool TileRenderer::render(const Program &program, const Viewport &viewport, int max_iterations,
+    std::vector<int> &iterations, const std::atomic<bool> &cancel, const std::function<void(int step)> &on_pass)
+{
+    const int width = viewport.pixels_wide;
+    const int height = viewport.pixels_high;
+    iterations.assign(static_cast<std::size_t>(std::max(width, 0)) * std::max(height, 0), 0);
+    if (width <= 0 || height <= 0)
+    {
+        return true;
+    }
+
+    // Evaluators hold registers for the batch they are running, so each worker has its own.
+    std::vector<BatchEvaluator> evaluators;
+    evaluators.reserve(m_pool.size());
+    for (unsigned worker = 0; worker < m_pool.size(); ++worker)
+    {
+        evaluators.emplace_back(program);
+        for (int i = 0; i < 5; ++i)
+        {
+            evaluators.back().set_parameter(i + 1, m_parameters[i]);
+        }
+    }
+    std::vector<Scratch> scratch(m_pool.size());
+    const int tiles_wide = (width + TILE_SIZE - 1) / TILE_SIZE;
+    const int tiles_high = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (int step = COARSEST_STEP; step >= 1; step /= 2)
+    {
+        const bool first = step == COARSEST_STEP;
+        const auto tile_pass = [&](std::size_t tile, unsigned worker)
+        {
+            const int left = static_cast<int>(tile % tiles_wide) * TILE_SIZE;
+            const int top = static_cast<int>(tile / tiles_wide) * TILE_SIZE;
+            const int right = std::min(left + TILE_SIZE, width);
+            const int bottom = std::min(top + TILE_SIZE, height);
+            Scratch &row = scratch[worker];
+            for (int y = top; y < bottom; y += step)
+            {
+                if (cancel)
+                {
+                    return;
+                }
+                // Tiles are a multiple of every step wide, so earlier passes sampled
+                // the pixels at multiples of twice this step.
+                const bool sampled_row = !first && y % (2 * step) == 0;
+                row.xs.clear();
+                row.re.clear();
+                row.im.clear();
+                for (int x = left; x < right; x += step)
+                {
+                    if (sampled_row && x % (2 * step) == 0)
+                    {
+                        continue;
+                    }
+                    const std::complex<double> point = viewport.point(x, y);
+                    row.xs.push_back(x);
+                    row.re.push_back(point.real());
+                    row.im.push_back(point.imag());
+                }
+                row.counts.resize(row.xs.size());
+                evaluators[worker].evaluate(row.re.data(), row.im.data(), row.xs.size(), max_iterations,
+                    row.counts.data());
+
+                const int block_bottom = std::min(y + step, bottom);
+                for (std::size_t i = 0; i < row.xs.size(); ++i)
+                {
+                    const int block_right = std::min(row.xs[i] + step, right);
+                    for (int block_y = y; block_y < block_bottom; ++block_y)
+                    {
+                        int *pixel = &iterations[static_cast<std::size_t>(block_y) * width];
+                        std::fill(pixel + row.xs[i], pixel + block_right, row.counts[i]);
+                    }
+                }
+            }
+            ++m_tiles_rendered;
+        };
+        m_pool.run(static_cast<std::size_t>(tiles_wide) * tiles_high, tile_pass);
+        if (cancel)
+        {
+            return false;
+        }
+        if (on_pass)
+        {
+            on_pass(step);
+        }
+    }
+    return true;
+}
+
+} // namespace formula
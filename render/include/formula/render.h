@@ -0,0 +1,16 @@
+#pragma once
+
+#include <iosfwd>
+
+namespace formula
+{
+
+// Write formula text from in to out as a standalone HTML document, with one
+// span per style run.  The input is streamed, so files of any size can be
+// rendered in constant memory.
+void render_html(std::istream &in, std::ostream &out);
+
+// Write formula text from in to out with ANSI escape sequences for each style.
+void render_ansi(std::istream &in, std::ostream &out);
+
+} // namespace formula
@@ -0,0 +1,193 @@
+#include <formula/render.h>
+
+#include <formula/runs.h>
+#include <formula/syntax.h>
+
+#include <ostream>
+
+namespace formula
+{
+
+namespace
+{
+
+// Colors match those used by the example editor.
+const char *css_class(Syntax style)
+{
+    switch (style)
+    {
+    case Syntax::COMMENT:
+        return "comment";
+    case Syntax::KEYWORD:
+        return "keyword";
+    case Syntax::FUNCTION:
+        return "function";
+    case Syntax::IDENTIFIER:
+        return "identifier";
+    case Syntax::NONE:
+    case Syntax::WHITESPACE:
+        break;
+    }
+    return nullptr;
+}
+
+const char *ansi_color(Syntax style)
+{
+    switch (style)
+    {
+    case Syntax::COMMENT:
+        return "\x1b[32m";
+    case Syntax::KEYWORD:
+        return "\x1b[34m";
+    case Syntax::FUNCTION:
+        return "\x1b[31m";
+    case Syntax::IDENTIFIER:
+        return "\x1b[35m";
+    case Syntax::NONE:
+    case Syntax::WHITESPACE:
+        break;
+    }
+    return nullptr;
+}
+
+const char *const ANSI_RESET{"\x1b[0m"};
+
+// Runs may be split where the input window is refilled, so the writers
+// only change markup when the style actually changes.
+class HtmlWriter : public StyleRunWriter
+{
+public:
+    explicit HtmlWriter(std::ostream &out) :
+        m_out(out)
+    {
+    }
+
+    void write(const StyleRun &run, const char *text) override;
+    void finish();
+
+private:
+    std::ostream &m_out;
+    const char *m_open{};
+};
+
+void HtmlWriter::write(const StyleRun &run, const char *text)
+{
+    const char *css = css_class(run.style);
+    if (css != m_open)
+    {
+        if (m_open != nullptr)
+        {
+            m_out << "</span>";
+        }
+        if (css != nullptr)
+        {
+            m_out << "<span class=\"" << css << "\">";
+        }
+        m_open = css;
+    }
+
+    const char *begin = text;
+    const char *const end = text + run.length;
+    for (const char *pos = text; pos != end; ++pos)
+    {
+        const char *entity;
+        switch (*pos)
+        {
+        case '<':
+            entity = "&lt;";
+            break;
+        case '>':
+            entity = "&gt;";
+            break;
+        case '&':
+            entity = "&amp;";
+            break;
+        default:
+            continue;
+        }
+        m_out.write(begin, pos - begin);
+        m_out << entity;
+        begin = pos + 1;
+    }
+    m_out.write(begin, end - begin);
+}
+
+void HtmlWriter::finish()
+{
+    if (m_open != nullptr)
+    {
+        m_out << "</span>";
+        m_open = nullptr;
+    }
+}
+
+class AnsiWriter : public StyleRunWriter
+{
+public:
+    explicit AnsiWriter(std::ostream &out) :
+        m_out(out)
+    {
+    }
+
+    void write(const StyleRun &run, const char *text) override;
+    void finish();
+
+private:
+    std::ostream &m_out;
+    const char *m_color{};
+};
+
+void AnsiWriter::write(const StyleRun &run, const char *text)
+{
+    const char *color = ansi_color(run.style);
+    if (color != m_color)
+    {
+        m_out << (color != nullptr ? color : ANSI_RESET);
+        m_color = color;
+    }
+    m_out.write(text, static_cast<std::streamsize>(run.length));
+}
+
+void AnsiWriter::finish()
+{
+    if (m_color != nullptr)
+    {
+        m_out << ANSI_RESET;
+        m_color = nullptr;
+    }
+}
+
+} // namespace
+
+void render_html(std::istream &in, std::ostream &out)
+{
+    out << "<!DOCTYPE html>\n"
+           "<html>\n"
+           "<head>\n"
+           "<meta charset=\"utf-8\">\n"
+           "<style>\n"
+           "pre.formula { color: black; }\n"
+           ".comment { color: forestgreen; }\n"
+           ".keyword { color: blue; }\n"
+           ".function { color: red; }\n"
+           ".identifier { color: purple; }\n"
+           "</style>\n"
+           "</head>\n"
+           "<body>\n"
+           "<pre class=\"formula\">";
+    HtmlWriter writer{out};
+    lex_runs(in, writer);
+    writer.finish();
+    out << "</pre>\n"
+           "</body>\n"
+           "</html>\n";
+}
+
+void render_ansi(std::istream &in, std::ostream &out)
+{
+    AnsiWriter writer{out};
+    lex_runs(in, writer);
+    writer.finish();
+}
+
+} // namespace formula
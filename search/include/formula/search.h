@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace formula
+{
+
+// Which styled text a search may match.
+enum class SearchScope
+{
+    EVERYTHING,
+    IDENTIFIERS,
+    SKIP_COMMENTS,
+    FUNCTIONS,
+};
+
+struct SearchOptions
+{
+    SearchScope scope{SearchScope::EVERYTHING};
+    bool match_case{};
+    bool whole_word{};
+};
+
+// Finds a string in text with one formula::Syntax style byte per character.
+//
+// A match must lie entirely in text whose style the scope allows.  Text in other
+// styles is skipped a style run at a time with a byte scan rather than searched,
+// and the allowed text is searched with SSE2 where it is available, testing the
+// first and last characters of the needle sixteen positions at a time.
+class StyledSearch
+{
+public:
+    static constexpr std::size_t npos{std::string_view::npos};
+
+    StyledSearch(std::string_view needle, SearchOptions options);
+
+    // The position of the first match starting in [from, to), or npos.
+    std::size_t find(std::string_view text, const char *styles, std::size_t from, std::size_t to) const;
+    std::size_t find(std::string_view text, const char *styles, std::size_t from = 0) const
+    {
+        return find(text, styles, from, text.size());
+    }
+
+    // The number of matches starting in [from, to); matches do not overlap.
+    std::size_t count(std::string_view text, const char *styles, std::size_t from, std::size_t to) const;
+
+    std::size_t length() const
+    {
+        return m_needle.size();
+    }
+
+private:
+    std::size_t next_allowed(const char *styles, std::size_t from, std::size_t to) const;
+    std::size_t next_disallowed(const char *styles, std::size_t from, std::size_t to) const;
+    std::size_t find_in(std::string_view text, std::size_t begin, std::size_t end, std::size_t to) const;
+    bool matches_at(const char *text) const;
+    bool whole_word_at(std::string_view text, std::size_t pos) const;
+
+    std::string m_needle;
+    std::string m_folded; // the needle with the other case of each letter when case is ignored
+    SearchOptions m_options;
+    bool m_everything{};
+    bool m_skip{}; // allowed styles are all but m_style
+    char m_style{};
+};
+
+} // namespace formula
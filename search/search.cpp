@@ -0,0 +1,229 @@
+#include <formula/search.h>
+
+#include <formula/syntax.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FORMULA_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(FORMULA_SEARCH_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace formula
+{
+
+namespace
+{
+
+#ifdef FORMULA_SEARCH_SSE2
+unsigned lowest_bit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// The first byte in [begin, end) that isn't value, or end.
+const char *find_other_byte(const char *begin, const char *end, char value)
+{
+#ifdef FORMULA_SEARCH_SSE2
+    const __m128i pattern = _mm_set1_epi8(value);
+    for (; end - begin >= 16; begin += 16)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+        const unsigned same = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)));
+        if (same != 0xFFFF)
+        {
+            return begin + lowest_bit(~same & 0xFFFF);
+        }
+    }
+#endif
+    while (begin != end && *begin == value)
+    {
+        ++begin;
+    }
+    return begin;
+}
+
+// The first byte in [begin, end) that is value, or end.
+const char *find_byte(const char *begin, const char *end, char value)
+{
+    const void *found = std::memchr(begin, value, static_cast<std::size_t>(end - begin));
+    return found != nullptr ? static_cast<const char *>(found) : end;
+}
+
+bool is_word_char(char ch)
+{
+    return std::isalnum(static_cast<unsigned char>(ch)) != 0;
+}
+
+} // namespace
+
+StyledSearch::StyledSearch(std::string_view needle, SearchOptions options) :
+    m_needle(needle),
+    m_folded(needle),
+    m_options(options)
+{
+    if (!m_options.match_case)
+    {
+        std::transform(m_needle.begin(), m_needle.end(), m_needle.begin(),
+            [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+        std::transform(m_folded.begin(), m_folded.end(), m_folded.begin(),
+            [](char ch) { return static_cast<char>(std::toupper(static_cast<unsigned char>(ch))); });
+    }
+    switch (m_options.scope)
+    {
+    case SearchScope::EVERYTHING:
+        m_everything = true;
+        break;
+
+    case SearchScope::IDENTIFIERS:
+        m_style = static_cast<char>(+Syntax::IDENTIFIER);
+        break;
+
+    case SearchScope::SKIP_COMMENTS:
+        m_style = static_cast<char>(+Syntax::COMMENT);
+        m_skip = true;
+        break;
+
+    case SearchScope::FUNCTIONS:
+        m_style = static_cast<char>(+Syntax::FUNCTION);
+        break;
+    }
+}
+
+std::size_t StyledSearch::find(std::string_view text, const char *styles, std::size_t from, std::size_t to) const
+{
+    to = std::min(to, text.size());
+    if (m_needle.empty())
+    {
+        return npos;
+    }
+    if (m_everything)
+    {
+        return find_in(text, from, text.size(), to);
+    }
+
+    std::size_t pos = from;
+    while (pos < to)
+    {
+        pos = next_allowed(styles, pos, text.size());
+        if (pos >= to)
+        {
+            break;
+        }
+        const std::size_t end = next_disallowed(styles, pos, text.size());
+        const std::size_t found = find_in(text, pos, end, to);
+        if (found != npos)
+        {
+            return found;
+        }
+        pos = end;
+    }
+    return npos;
+}
+
+std::size_t StyledSearch::count(std::string_view text, const char *styles, std::size_t from, std::size_t to) const
+{
+    std::size_t result{};
+    for (std::size_t pos = find(text, styles, from, to); pos != npos; pos = find(text, styles, pos + length(), to))
+    {
+        ++result;
+    }
+    return result;
+}
+
+std::size_t StyledSearch::next_allowed(const char *styles, std::size_t from, std::size_t to) const
+{
+    const char *found = m_skip ? find_other_byte(styles + from, styles + to, m_style)
+                               : find_byte(styles + from, styles + to, m_style);
+    return static_cast<std::size_t>(found - styles);
+}
+
+std::size_t StyledSearch::next_disallowed(const char *styles, std::size_t from, std::size_t to) const
+{
+    const char *found = m_skip ? find_byte(styles + from, styles + to, m_style)
+                               : find_other_byte(styles + from, styles + to, m_style);
+    return static_cast<std::size_t>(found - styles);
+}
+
+// The first match lying in [begin, end) and starting before to.
+std::size_t StyledSearch::find_in(std::string_view text, std::size_t begin, std::size_t end, std::size_t to) const
+{
+    const std::size_t length = m_needle.size();
+    if (end - begin < length || begin >= to)
+    {
+        return npos;
+    }
+    const std::size_t last = std::min(end - length, to - 1);
+    const char *data = text.data();
+    std::size_t pos = begin;
+#ifdef FORMULA_SEARCH_SSE2
+    const __m128i first = _mm_set1_epi8(m_needle.front());
+    const __m128i first_folded = _mm_set1_epi8(m_folded.front());
+    const __m128i final = _mm_set1_epi8(m_needle.back());
+    const __m128i final_folded = _mm_set1_epi8(m_folded.back());
+    for (; pos + 15 <= last; pos += 16)
+    {
+        const __m128i starts = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        const __m128i ends = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + length - 1));
+        const __m128i candidates =
+            _mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(starts, first), _mm_cmpeq_epi8(starts, first_folded)),
+                _mm_or_si128(_mm_cmpeq_epi8(ends, final), _mm_cmpeq_epi8(ends, final_folded)));
+        for (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(candidates)); mask != 0; mask &= mask - 1)
+        {
+            const std::size_t candidate = pos + lowest_bit(mask);
+            if (matches_at(data + candidate) && whole_word_at(text, candidate))
+            {
+                return candidate;
+            }
+        }
+    }
+#endif
+    for (; pos <= last; ++pos)
+    {
+        if (matches_at(data + pos) && whole_word_at(text, pos))
+        {
+            return pos;
+        }
+    }
+    return npos;
+}
+
+bool StyledSearch::matches_at(const char *text) const
+{
+    if (m_options.match_case)
+    {
+        return std::memcmp(text, m_needle.data(), m_needle.size()) == 0;
+    }
+    for (std::size_t i = 0; i < m_needle.size(); ++i)
+    {
+        if (text[i] != m_needle[i] && text[i] != m_folded[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StyledSearch::whole_word_at(std::string_view text, std::size_t pos) const
+{
+    if (!m_options.whole_word)
+    {
+        return true;
+    }
+    const std::size_t end = pos + m_needle.size();
+    return (pos == 0 || !is_word_char(text[pos - 1])) && (end == text.size() || !is_word_char(text[end]));
+}
+
+} // namespace formula
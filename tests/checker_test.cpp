@@ -0,0 +1,150 @@
+#include <formula/checker.h>
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+constexpr const char *MANDELBROT{"Mandelbrot {\n"
+                                 "  z = 0, c = pixel:\n"
+                                 "  z = sqr(z) + c\n"
+                                 "  |z| <= 4\n"
+                                 "}\n"};
+
+class TestBackgroundChecker : public Test
+{
+protected:
+    // Waits for the check of the given generation to be published.
+    bool wait_for(unsigned generation)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_published.wait_for(lock, std::chrono::seconds(10),
+            [&] { return !m_generations.empty() && m_generations.back() == generation; });
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_published;
+    std::vector<unsigned> m_generations;
+    std::vector<formula::Problem> m_problems;
+    formula::BackgroundChecker m_checker{[this](unsigned generation, std::vector<formula::Problem> problems)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_generations.push_back(generation);
+            m_problems = std::move(problems);
+            m_published.notify_all();
+        }};
+};
+
+} // namespace
+
+TEST(TestCheckFormulas, cleanFileHasNoProblems)
+{
+    const std::string text{std::string{"; comment\n"} + MANDELBROT + '\n' + MANDELBROT};
+    std::vector<formula::Problem> problems;
+    const std::atomic<bool> cancel{};
+
+    EXPECT_TRUE(formula::check_formulas(text, problems, cancel));
+    EXPECT_TRUE(problems.empty());
+}
+
+TEST(TestCheckFormulas, parseErrorsAreAtTheirDocumentPosition)
+{
+    const std::string broken{"Broken {\n  z = (1 +\n  |z| <= 4\n}\n"};
+    const std::string text{MANDELBROT + broken};
+    std::vector<formula::Problem> problems;
+    const std::atomic<bool> cancel{};
+
+    EXPECT_TRUE(formula::check_formulas(text, problems, cancel));
+    ASSERT_FALSE(problems.empty());
+    EXPECT_GE(problems[0].begin, text.find("Broken"));
+    EXPECT_LE(problems[0].end, text.size());
+    EXPECT_FALSE(problems[0].message.empty());
+}
+
+TEST(TestCheckFormulas, compileErrorsPointAtTheEntryName)
+{
+    // Parses cleanly, but nests deeper than the evaluator can follow.
+    std::string deep{"Deep {\n  z = pixel:\n"};
+    for (int i = 0; i < 300; ++i)
+    {
+        deep += "if (z > 0)\n";
+    }
+    deep += "z = z + 1\n";
+    for (int i = 0; i < 300; ++i)
+    {
+        deep += "endif\n";
+    }
+    const std::string text{MANDELBROT + deep + "  |z| <= 4\n}\n"};
+    std::vector<formula::Problem> problems;
+    const std::atomic<bool> cancel{};
+
+    EXPECT_TRUE(formula::check_formulas(text, problems, cancel));
+    ASSERT_EQ(1U, problems.size());
+    EXPECT_EQ("Deep", text.substr(problems[0].begin, problems[0].end - problems[0].begin));
+}
+
+TEST(TestCheckFormulas, cancelledCheckGivesUp)
+{
+    std::vector<formula::Problem> problems;
+    const std::atomic<bool> cancel{true};
+
+    EXPECT_FALSE(formula::check_formulas(MANDELBROT, problems, cancel));
+}
+
+TEST_F(TestBackgroundChecker, publishesProblemsOfSubmittedText)
+{
+    const unsigned generation = m_checker.submit("Unknown {\n  z = nosuch(z)\n  |z| <= 4\n}\n");
+
+    ASSERT_TRUE(wait_for(generation));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EXPECT_EQ(1U, m_problems.size());
+}
+
+TEST_F(TestBackgroundChecker, newerSnapshotCancelsCheckInProgress)
+{
+    std::string large;
+    for (int i = 0; i < 50000; ++i)
+    {
+        large += MANDELBROT;
+    }
+
+    m_checker.submit(std::move(large));
+    const unsigned latest = m_checker.submit(MANDELBROT);
+
+    ASSERT_TRUE(wait_for(latest));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EXPECT_EQ(std::vector<unsigned>{latest}, m_generations);
+    EXPECT_EQ(1U, m_checker.completed());
+}
+
+TEST_F(TestBackgroundChecker, editsRecheckOnlyTheEntriesTheyTouch)
+{
+    const std::string unknown{"Unknown {\n  z = nosuch(z)\n  |z| <= 4\n}\n"};
+    std::string text{MANDELBROT + unknown + MANDELBROT};
+    ASSERT_TRUE(wait_for(m_checker.submit(text)));
+    EXPECT_EQ(3U, m_checker.checked_entries());
+
+    const std::size_t position = text.find("+ c");
+    text.insert(position, "* 1 ");
+    m_checker.edited(position, 0, 4);
+    m_checker.cancel();
+    const std::size_t bailout = text.find("<=");
+    text.replace(bailout, 2, "<");
+    m_checker.edited(bailout, 2, 1);
+
+    ASSERT_TRUE(wait_for(m_checker.submit(text)));
+    EXPECT_EQ(4U, m_checker.checked_entries());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ASSERT_EQ(1U, m_problems.size());
+    EXPECT_LE(text.find("Unknown {"), m_problems[0].begin);
+    EXPECT_GE(text.find("}\nMandelbrot", text.find("Unknown {")), m_problems[0].end);
+}
@@ -0,0 +1,142 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace testing;
+
+namespace
+{
+
+class TestCompletion : public Test
+{
+protected:
+    void SetUp() override
+    {
+        m_lexer->PrivateCall(+formula::LexerCall::INDEX_IDENTIFIERS, nullptr);
+    }
+    ~TestCompletion() override
+    {
+        m_lexer->Release();
+    }
+
+    std::string complete(const char *prefix)
+    {
+        const void *words = m_lexer->PrivateCall(+formula::LexerCall::COMPLETE_IDENTIFIER, const_cast<char *>(prefix));
+        return words != nullptr ? static_cast<const char *>(words) : "";
+    }
+
+    // Restyles the rest of the document after an edit, as the editor would.
+    void relex()
+    {
+        m_doc.colourise(m_lexer, m_doc.Length());
+    }
+
+    ILexer *m_lexer{formula::create_lexer()};
+    formula::MemoryDocument m_doc;
+};
+
+} // namespace
+
+TEST(TestCompletionDisabled, noCompletionsWithoutIndex)
+{
+    ILexer *lexer = formula::create_lexer();
+
+    EXPECT_EQ(nullptr, lexer->PrivateCall(+formula::LexerCall::COMPLETE_IDENTIFIER, const_cast<char *>("s")));
+
+    lexer->Release();
+}
+
+TEST_F(TestCompletion, builtinFunctions)
+{
+    EXPECT_EQ("sin sinh sqr sqrt srand", complete("s"));
+    EXPECT_EQ("cosxx", complete("COSX"));
+    EXPECT_EQ("", complete("q"));
+}
+
+TEST_F(TestCompletion, documentIdentifiers)
+{
+    m_doc = formula::MemoryDocument{"Scale = 2\nsum = scale + SIN(z)\nif (z < 4) ; scratch\nendif\n"};
+
+    relex();
+
+    EXPECT_EQ("scale sin sinh sqr sqrt srand sum", complete("s"));
+    EXPECT_EQ("z", complete("z"));
+}
+
+TEST_F(TestCompletion, deletedIdentifierIsForgottenOnceUnused)
+{
+    m_doc = formula::MemoryDocument{"alpha = 1\nbeta = alpha\nalpha = beta\n"};
+    relex();
+
+    m_doc.erase(0, 10);
+    relex();
+    EXPECT_EQ("alpha", complete("al"));
+
+    m_doc.erase(13, 13);
+    relex();
+    EXPECT_EQ("beta = alpha\n", m_doc.text());
+    EXPECT_EQ("alpha", complete("al"));
+
+    m_doc.erase(4, 8);
+    relex();
+    EXPECT_EQ("", complete("al"));
+    EXPECT_EQ("beta", complete("b"));
+}
+
+TEST_F(TestCompletion, insertedLinesKeepLaterLinesIndexed)
+{
+    m_doc = formula::MemoryDocument{"one = 1\ntwo = 2\nthree = 3\n"};
+    relex();
+
+    m_doc.insert(8, "new = 4\nnewer = 5\n", 18);
+    relex();
+    m_doc.erase(0, 8);
+    relex();
+
+    EXPECT_EQ("new newer", complete("ne"));
+    EXPECT_EQ("three", complete("th"));
+    EXPECT_EQ("two", complete("tw"));
+    EXPECT_EQ("", complete("on"));
+}
+
+TEST_F(TestCompletion, partialRelexKeepsLaterLinesUntilTheyAreLexed)
+{
+    m_doc = formula::MemoryDocument{"qa = 1\nqb = 2\nqc = 3\n"};
+    relex();
+
+    m_doc.insert(0, "qd = 0\n", 7);
+    m_doc.colourise(m_lexer, 7);
+
+    EXPECT_EQ("qa qb qc qd", complete("q"));
+}
+
+TEST_F(TestCompletion, partialWordsTypedAndDeletedLeaveNoCompletions)
+{
+    m_doc = formula::MemoryDocument{"alpine = 1\nz = \n"};
+    relex();
+    const std::string word{"alphabet"};
+
+    // Each keystroke relexes the line, indexing the word typed so far, then backspacing removes it again.
+    for (std::size_t i = 0; i < word.size(); ++i)
+    {
+        m_doc.insert(15 + static_cast<Sci_Position>(i), &word[i], 1);
+        relex();
+    }
+    EXPECT_EQ("alphabet alpine", complete("al"));
+    for (std::size_t i = word.size(); i > 0; --i)
+    {
+        m_doc.erase(15 + static_cast<Sci_Position>(i) - 1, 1);
+        relex();
+    }
+    m_doc.insert(15, "alto", 4);
+    relex();
+
+    EXPECT_EQ("alpine alto", complete("al"));
+    EXPECT_EQ("alpine", complete("alp"));
+    EXPECT_EQ("", complete("alph"));
+}
@@ -0,0 +1,290 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+#include <formula/syntax.h>
+#include <formula/thread_pool.h>
+
+#include <ILexer.h>
+#include <Scintilla.h>
+
+#ifndef FORMULA_LEXER_STATIC
+#include <wx/dynlib.h>
+#include <wx/log.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Lexes every .frm file of a directory in a MemoryDocument and compares the
+// styles and fold levels with the golden files next to it:
+//
+//     case.frm     the input
+//     case.styles  one line per document line, one character per byte including
+//                  the line end, giving the style of that byte: 0-9, then a-z
+//     case.folds   one line per document line: the fold depth, then "header",
+//                  "white" and "error" for the flags that are set
+//
+// The plug-in is loaded once and the cases are shared out over every core, each
+// case getting a lexer of its own.  With --update, the golden files of the cases
+// that differ or have none are rewritten instead of being reported.
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using LexerFactoryFunction = ILexer *();
+
+struct LexerDeleter
+{
+    void operator()(ILexer *lexer) const
+    {
+        lexer->Release();
+    }
+};
+
+struct Options
+{
+    std::filesystem::path directory;
+    unsigned threads{};
+    bool update{};
+};
+
+struct Outcome
+{
+    bool passed{};
+    bool updated{};
+    std::string message;
+};
+
+constexpr const char *STYLE_DIGITS{"0123456789abcdefghijklmnopqrstuvwxyz"};
+
+std::string read_file(const std::filesystem::path &path, bool &found)
+{
+    std::ifstream in(path, std::ios::binary);
+    found = static_cast<bool>(in);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+bool write_file(const std::filesystem::path &path, const std::string &contents)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return static_cast<bool>(out);
+}
+
+std::string format_styles(const formula::MemoryDocument &doc)
+{
+    const std::string &styles = doc.styles();
+    std::string result;
+    result.reserve(styles.size() + static_cast<std::size_t>(doc.line_count()));
+    for (Sci_Position line = 0; line < doc.line_count(); ++line)
+    {
+        const Sci_Position end = line + 1 < doc.line_count() ? doc.LineStart(line + 1) : doc.Length();
+        for (Sci_Position i = doc.LineStart(line); i < end; ++i)
+        {
+            const auto style = static_cast<unsigned char>(styles[i]);
+            result += style < 36 ? STYLE_DIGITS[style] : '?';
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+std::string format_folds(const formula::MemoryDocument &doc)
+{
+    std::string result;
+    for (Sci_Position line = 0; line < doc.line_count(); ++line)
+    {
+        const int level = doc.GetLevel(line);
+        result += std::to_string((level & SC_FOLDLEVELNUMBERMASK) - SC_FOLDLEVELBASE);
+        if ((level & SC_FOLDLEVELHEADERFLAG) != 0)
+        {
+            result += " header";
+        }
+        if ((level & SC_FOLDLEVELWHITEFLAG) != 0)
+        {
+            result += " white";
+        }
+        if ((level & formula::FOLD_LEVEL_ERROR_FLAG) != 0)
+        {
+            result += " error";
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+// Where two golden files first differ, as "line n: expected ..., got ...".
+std::string first_difference(const std::string &expected, const std::string &actual)
+{
+    std::istringstream expected_lines(expected);
+    std::istringstream actual_lines(actual);
+    std::string expected_line;
+    std::string actual_line;
+    for (int line = 1;; ++line)
+    {
+        const bool more_expected = static_cast<bool>(std::getline(expected_lines, expected_line));
+        const bool more_actual = static_cast<bool>(std::getline(actual_lines, actual_line));
+        if (!more_expected && !more_actual)
+        {
+            return "differs";
+        }
+        if (!more_expected || !more_actual || expected_line != actual_line)
+        {
+            return "line " + std::to_string(line) + ": expected '" + (more_expected ? expected_line : "<end>")
+                + "', got '" + (more_actual ? actual_line : "<end>") + "'";
+        }
+    }
+}
+
+Outcome run_case(const std::filesystem::path &input, LexerFactoryFunction *factory, bool update)
+{
+    bool found{};
+    formula::MemoryDocument doc(read_file(input, found));
+    if (!found)
+    {
+        return {false, false, "couldn't read the input"};
+    }
+    std::unique_ptr<ILexer, LexerDeleter> lexer{factory()};
+    doc.colourise(lexer.get(), doc.Length());
+
+    Outcome outcome{true, false, {}};
+    const std::pair<const char *, std::string> results[]{
+        {".styles", format_styles(doc)},
+        {".folds", format_folds(doc)},
+    };
+    for (const auto &[extension, actual] : results)
+    {
+        std::filesystem::path golden{input};
+        golden.replace_extension(extension);
+        const std::string expected = read_file(golden, found);
+        if (found && expected == actual)
+        {
+            continue;
+        }
+        if (update)
+        {
+            if (!write_file(golden, actual))
+            {
+                return {false, false, "couldn't write " + golden.filename().string()};
+            }
+            outcome.updated = true;
+            continue;
+        }
+        outcome.passed = false;
+        outcome.message += (outcome.message.empty() ? "" : "; ") + golden.filename().string() + ' '
+            + (found ? first_difference(expected, actual) : "is missing");
+    }
+    return outcome;
+}
+
+int usage()
+{
+    std::cerr << "Usage: test-corpus [--update] [--threads <count>] <directory>\n";
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg{argv[i]};
+        if (arg == "--update")
+        {
+            options.update = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        }
+        else if (!arg.empty() && arg[0] != '-' && options.directory.empty())
+        {
+            options.directory = arg;
+        }
+        else
+        {
+            return usage();
+        }
+    }
+    if (options.directory.empty())
+    {
+        return usage();
+    }
+
+#ifdef FORMULA_LEXER_STATIC
+    LexerFactoryFunction *factory = formula::create_lexer;
+#else
+    wxLogStderr logger;
+    wxLog::SetActiveTarget(&logger);
+    wxDynamicLibrary plugin(wxT("./formula-lexer") + wxDynamicLibrary::GetDllExt(wxDL_LIBRARY));
+    if (!plugin.IsLoaded())
+    {
+        std::cerr << "test-corpus: couldn't load the formula-lexer plug-in\n";
+        return 1;
+    }
+    using GetLexerFactoryFn = LexerFactoryFunction *(unsigned int index);
+    auto *get_lexer_factory = reinterpret_cast<GetLexerFactoryFn *>(plugin.GetSymbol(wxT("GetLexerFactory")));
+    LexerFactoryFunction *factory = get_lexer_factory != nullptr ? get_lexer_factory(0) : nullptr;
+    if (factory == nullptr)
+    {
+        std::cerr << "test-corpus: the plug-in exports no lexer factory\n";
+        return 1;
+    }
+#endif
+
+    std::vector<std::filesystem::path> inputs;
+    std::error_code error;
+    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(options.directory, error))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".frm")
+        {
+            inputs.push_back(entry.path());
+        }
+    }
+    if (error)
+    {
+        std::cerr << "test-corpus: " << options.directory.string() << ": " << error.message() << '\n';
+        return 1;
+    }
+    std::sort(inputs.begin(), inputs.end());
+
+    const Clock::time_point start = Clock::now();
+    std::vector<Outcome> outcomes(inputs.size());
+    formula::ThreadPool pool(options.threads);
+    pool.run(inputs.size(),
+        [&](std::size_t index, unsigned /*worker*/)
+        { outcomes[index] = run_case(inputs[index], factory, options.update); });
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::size_t failed{};
+    std::size_t updated{};
+    for (std::size_t i = 0; i < inputs.size(); ++i)
+    {
+        updated += outcomes[i].updated ? 1 : 0;
+        if (!outcomes[i].passed)
+        {
+            ++failed;
+            std::cerr << inputs[i].filename().string() << ": " << outcomes[i].message << '\n';
+        }
+    }
+    std::cout << inputs.size() << " cases on " << pool.size() << " threads in " << seconds << " s: " << failed
+              << " failed";
+    if (options.update)
+    {
+        std::cout << ", " << updated << " updated";
+    }
+    std::cout << '\n';
+    return failed == 0 && !inputs.empty() ? 0 : 1;
+}
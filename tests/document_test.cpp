@@ -0,0 +1,202 @@
+#include <formula/edit_session.h>
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+#include <formula/runs.h>
+#include <formula/syntax.h>
+
+#include <ILexer.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+using namespace testing;
+
+namespace
+{
+
+// Expands runs to a style per character.
+class StyleBytesWriter : public formula::StyleRunWriter
+{
+public:
+    void write(const formula::StyleRun &run, const char * /*text*/) override
+    {
+        styles.append(run.length, static_cast<char>(+run.style));
+    }
+
+    std::string styles;
+};
+
+std::string lexed_styles(const std::string &text)
+{
+    StyleBytesWriter writer;
+    formula::lex_runs(text.data(), text.size(), writer);
+    return writer.styles;
+}
+
+class RecordingObserver : public formula::LexObserver
+{
+public:
+    void lex(std::size_t start, std::ptrdiff_t length, int init_style) override
+    {
+        calls << "lex " << start << ' ' << length << ' ' << init_style << '\n';
+    }
+    void fold(std::size_t start, std::ptrdiff_t length, int init_style) override
+    {
+        calls << "fold " << start << ' ' << length << ' ' << init_style << '\n';
+    }
+
+    std::ostringstream calls;
+};
+
+class TestMemoryDocument : public Test
+{
+protected:
+    ~TestMemoryDocument() override
+    {
+        m_lexer->Release();
+    }
+
+    ILexer *m_lexer{formula::create_lexer()};
+};
+
+} // namespace
+
+TEST(TestMemoryDocumentLines, lineEndings)
+{
+    formula::MemoryDocument doc{"a\nb\r\nc\rd"};
+
+    EXPECT_EQ(4, doc.line_count());
+    EXPECT_EQ(0, doc.LineStart(0));
+    EXPECT_EQ(2, doc.LineStart(1));
+    EXPECT_EQ(5, doc.LineStart(2));
+    EXPECT_EQ(7, doc.LineStart(3));
+    EXPECT_EQ(8, doc.LineStart(4));
+    EXPECT_EQ(1, doc.LineFromPosition(4));
+}
+
+TEST(TestMemoryDocumentLines, insertSplitsLineCopyingLevel)
+{
+    formula::MemoryDocument doc{"ab\ncd"};
+    doc.SetLevel(0, SC_FOLDLEVELBASE | SC_FOLDLEVELHEADERFLAG);
+    doc.SetLevel(1, SC_FOLDLEVELBASE + 1);
+
+    doc.insert(1, "x\ny", 3);
+
+    EXPECT_EQ("ax\nyb\ncd", doc.text());
+    EXPECT_EQ(3, doc.line_count());
+    EXPECT_EQ(SC_FOLDLEVELBASE | SC_FOLDLEVELHEADERFLAG, doc.GetLevel(1));
+    EXPECT_EQ(SC_FOLDLEVELBASE + 1, doc.GetLevel(2));
+    EXPECT_EQ(6, doc.LineStart(2));
+}
+
+TEST(TestMemoryDocumentLines, insertLineFeedAfterCarriageReturnJoinsLineEnd)
+{
+    formula::MemoryDocument doc{"a\rb"};
+
+    doc.insert(2, "\n", 1);
+
+    EXPECT_EQ(2, doc.line_count());
+    EXPECT_EQ(3, doc.LineStart(1));
+}
+
+TEST(TestMemoryDocumentLines, eraseJoinsLines)
+{
+    formula::MemoryDocument doc{"a\r\nb\nc\nd"};
+    doc.SetLevel(3, SC_FOLDLEVELBASE + 2);
+
+    doc.erase(1, 5);
+
+    EXPECT_EQ("a\nd", doc.text());
+    EXPECT_EQ(2, doc.line_count());
+    EXPECT_EQ(SC_FOLDLEVELBASE + 2, doc.GetLevel(1));
+}
+
+TEST(TestMemoryDocumentLines, eraseBetweenCarriageReturnAndLineFeedJoinsLineEnd)
+{
+    formula::MemoryDocument doc{"a\rx\nb"};
+
+    doc.erase(2, 1);
+
+    EXPECT_EQ(2, doc.line_count());
+    EXPECT_EQ(3, doc.LineStart(1));
+}
+
+TEST_F(TestMemoryDocument, colouriseMatchesStyleRuns)
+{
+    const std::string text{"if (z < 4) ; test\n  z = sin(z)\nelse\n  abc = cosxx(q)\nendif\n"};
+    formula::MemoryDocument doc{text};
+
+    EXPECT_EQ(doc.Length(), doc.colourise(m_lexer, doc.Length()));
+
+    EXPECT_EQ(lexed_styles(text), doc.styles());
+}
+
+TEST_F(TestMemoryDocument, editRelexesFromStartOfLine)
+{
+    formula::MemoryDocument doc{"z = 1\nif (z)\nendif\n"};
+    doc.colourise(m_lexer, doc.Length());
+    doc.StartStyling(doc.Length(), 0);
+
+    doc.insert(7, "sin", 3);
+
+    EXPECT_EQ(7, doc.end_styled());
+    EXPECT_EQ(doc.Length() - 6, doc.colourise(m_lexer, doc.Length()));
+    EXPECT_EQ(lexed_styles(doc.text()), doc.styles());
+}
+
+TEST_F(TestMemoryDocument, observerSeesLexAndFold)
+{
+    formula::MemoryDocument doc{"a\nb\n"};
+    RecordingObserver observer;
+    m_lexer->PrivateCall(+formula::LexerCall::SET_LEX_OBSERVER, &observer);
+
+    doc.colourise(m_lexer, doc.Length());
+    m_lexer->PrivateCall(+formula::LexerCall::SET_LEX_OBSERVER, nullptr);
+    doc.ChangeLexerState(0, doc.Length());
+    doc.colourise(m_lexer, doc.Length());
+
+    EXPECT_EQ("lex 0 4 0\nfold 0 4 0\n", observer.calls.str());
+}
+
+TEST(TestEditSession, roundTrip)
+{
+    std::ostringstream out;
+    {
+        formula::EditSessionWriter writer{out};
+        writer.text("a\nb", 3);
+        writer.insert(1, "\r\n", 2);
+        writer.erase(0, 1);
+        writer.lex(0, 4, 2);
+        writer.fold(0, 4, 2);
+    }
+    std::istringstream in{out.str()};
+    formula::EditEvent event;
+
+    formula::read_edit_session_header(in);
+    ASSERT_TRUE(formula::read_edit_event(in, event));
+    EXPECT_EQ(formula::EditEventType::TEXT, event.type);
+    EXPECT_EQ("a\nb", event.text);
+    ASSERT_TRUE(formula::read_edit_event(in, event));
+    EXPECT_EQ(formula::EditEventType::INSERT, event.type);
+    EXPECT_EQ(1U, event.position);
+    EXPECT_EQ("\r\n", event.text);
+    ASSERT_TRUE(formula::read_edit_event(in, event));
+    EXPECT_EQ(formula::EditEventType::DELETE, event.type);
+    EXPECT_EQ(1, event.length);
+    ASSERT_TRUE(formula::read_edit_event(in, event));
+    EXPECT_EQ(formula::EditEventType::LEX, event.type);
+    EXPECT_EQ(4, event.length);
+    EXPECT_EQ(2, event.init_style);
+    ASSERT_TRUE(formula::read_edit_event(in, event));
+    EXPECT_EQ(formula::EditEventType::FOLD, event.type);
+    EXPECT_FALSE(formula::read_edit_event(in, event));
+}
+
+TEST(TestEditSession, rejectsOtherFiles)
+{
+    std::istringstream in{"if (z)\n"};
+
+    EXPECT_THROW(formula::read_edit_session_header(in), std::runtime_error);
+}
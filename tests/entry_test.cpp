@@ -0,0 +1,226 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+#include <formula/syntax.h>
+
+#include <ILexer.h>
+#include <Scintilla.h>
+
+#include <gtest/gtest.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+struct Entry
+{
+    std::string name;
+    std::size_t line;
+    std::size_t column;
+    std::size_t end_line;
+    std::size_t end_column;
+
+    bool operator==(const Entry &rhs) const
+    {
+        return name == rhs.name && line == rhs.line && column == rhs.column && end_line == rhs.end_line
+            && end_column == rhs.end_column;
+    }
+};
+
+std::ostream &operator<<(std::ostream &str, const Entry &entry)
+{
+    return str << entry.name << " (" << entry.line << ", " << entry.column << ")-(" << entry.end_line << ", "
+               << entry.end_column << ')';
+}
+
+using Entries = std::vector<Entry>;
+
+class TestEntries : public Test
+{
+protected:
+    ~TestEntries() override
+    {
+        m_lexer->Release();
+    }
+
+    Entries list()
+    {
+        const auto *found = static_cast<const formula::FormulaEntries *>(
+            m_lexer->PrivateCall(+formula::LexerCall::LIST_ENTRIES, nullptr));
+        Entries result;
+        for (std::size_t i = 0; i < found->count; ++i)
+        {
+            const formula::FormulaEntry &entry = found->items[i];
+            const auto start = static_cast<Sci_Position>(entry.start);
+            const auto end = static_cast<Sci_Position>(entry.end);
+            const Sci_Position line = m_doc.LineFromPosition(start);
+            const Sci_Position end_line = m_doc.LineFromPosition(end);
+            result.push_back({entry.name, static_cast<std::size_t>(line),
+                static_cast<std::size_t>(start - m_doc.LineStart(line)), static_cast<std::size_t>(end_line),
+                static_cast<std::size_t>(end - m_doc.LineStart(end_line))});
+        }
+        return result;
+    }
+
+    const formula::FormulaEntry *find(const char *name)
+    {
+        return static_cast<const formula::FormulaEntry *>(
+            m_lexer->PrivateCall(+formula::LexerCall::FIND_ENTRY, const_cast<char *>(name)));
+    }
+
+    void index_text()
+    {
+        const std::string &text = m_doc.text();
+        formula::DocumentText document{text.data(), text.size()};
+        m_lexer->PrivateCall(+formula::LexerCall::INDEX_ENTRIES, &document);
+    }
+
+    void relex()
+    {
+        m_doc.colourise(m_lexer, m_doc.Length());
+    }
+
+    std::vector<int> levels() const
+    {
+        std::vector<int> result;
+        for (Sci_Position line = 0; line < m_doc.line_count(); ++line)
+        {
+            const int level = m_doc.GetLevel(line);
+            result.push_back((level & SC_FOLDLEVELNUMBERMASK) - SC_FOLDLEVELBASE
+                + ((level & SC_FOLDLEVELHEADERFLAG) != 0 ? 100 : 0));
+        }
+        return result;
+    }
+
+    ILexer *m_lexer{formula::create_lexer()};
+    formula::MemoryDocument m_doc;
+};
+
+constexpr int HEADER{100};
+
+} // namespace
+
+TEST_F(TestEntries, entriesAreFoldPoints)
+{
+    m_doc = formula::MemoryDocument{"; comment\nMandel (XAXIS) {\n  z = 0:\n  if (z)\n  endif\n}\n\nJulia { z = 0 }\n"};
+
+    relex();
+
+    EXPECT_EQ((std::vector<int>{0, HEADER, 1, HEADER + 1, 1, 1, 0, 0, 0}), levels());
+}
+
+TEST_F(TestEntries, ifLeftOpenIsMarkedAtTheClosingBrace)
+{
+    m_doc = formula::MemoryDocument{"A {\n  if (z)\n}\nB {\n  endif\n}\n"};
+
+    relex();
+
+    EXPECT_EQ(0, m_doc.GetLevel(1) & formula::FOLD_LEVEL_ERROR_FLAG);
+    EXPECT_NE(0, m_doc.GetLevel(2) & formula::FOLD_LEVEL_ERROR_FLAG);
+    EXPECT_EQ(0, m_doc.GetLevel(3) & formula::FOLD_LEVEL_ERROR_FLAG);
+    EXPECT_NE(0, m_doc.GetLevel(4) & formula::FOLD_LEVEL_ERROR_FLAG);
+}
+
+TEST_F(TestEntries, foldedEntriesAreListed)
+{
+    m_doc = formula::MemoryDocument{"Mandel (XAXIS) { ; {\n  z = 0:\n}\n  Julia{z = 0 }\nOpen {\n  z = 1\n"};
+
+    relex();
+
+    EXPECT_EQ((Entries{{"Mandel", 0, 0, 2, 1}, {"Julia", 3, 2, 3, 15}, {"Open", 4, 0, 6, 0}}), list());
+}
+
+TEST_F(TestEntries, unclosedEntryEndsAtTheNext)
+{
+    m_doc = formula::MemoryDocument{"Unclosed {\n  z = 0\n\nNext {\n}\n"};
+
+    relex();
+
+    EXPECT_EQ((Entries{{"Unclosed", 0, 0, 3, 0}, {"Next", 3, 0, 4, 1}}), list());
+    EXPECT_EQ((std::vector<int>{HEADER, 1, 1, HEADER, 1, 0}), levels());
+}
+
+TEST_F(TestEntries, entriesAreFoundByName)
+{
+    m_doc = formula::MemoryDocument{"b {\n}\nA {\n}\nB {\n}\n"};
+    relex();
+
+    const formula::FormulaEntry *found = find("B");
+
+    ASSERT_NE(nullptr, found);
+    EXPECT_EQ(0U, found->start);
+    EXPECT_EQ(5U, found->end);
+    ASSERT_NE(nullptr, find("a"));
+    EXPECT_EQ(6U, find("a")->start);
+    EXPECT_EQ(nullptr, find("c"));
+}
+
+TEST_F(TestEntries, indexedTextMatchesFolding)
+{
+    m_doc = formula::MemoryDocument{"A (XAXIS) {\n  z = 0 ; }\n}\n} stray\nB {\nC { z }\n"};
+    relex();
+    const Entries folded = list();
+
+    m_lexer->Release();
+    m_lexer = formula::create_lexer();
+    index_text();
+
+    EXPECT_EQ(folded, list());
+    EXPECT_EQ(3U, folded.size());
+}
+
+TEST_F(TestEntries, editsMoveEntries)
+{
+    m_doc = formula::MemoryDocument{"A {\n}\nB {\n}\nC {\n}\n"};
+    index_text();
+
+    m_doc.insert(0, "; one\n; two\n", 12);
+    m_doc.colourise(m_lexer, 12);
+    m_doc.erase(m_doc.LineStart(4), 4);
+    m_doc.colourise(m_lexer, m_doc.LineStart(5));
+
+    EXPECT_EQ("; one\n; two\nA {\n}\n}\nC {\n}\n", m_doc.text());
+    EXPECT_EQ((Entries{{"A", 2, 0, 3, 1}, {"C", 5, 0, 6, 1}}), list());
+}
+
+TEST_F(TestEntries, editsMatchIndexingTheEditedText)
+{
+    m_doc = formula::MemoryDocument{"A {\n}\nB {\n  z = 0\n}\nC {\n}\nD {\n}\n"};
+    index_text();
+
+    m_doc.insert(m_doc.LineStart(6), "; note\n", 7);
+    m_doc.colourise(m_lexer, m_doc.LineStart(7));
+    m_doc.insert(m_doc.LineStart(1), "  z = 1\n", 8);
+    m_doc.colourise(m_lexer, m_doc.LineStart(2));
+    m_doc.erase(m_doc.LineStart(3), 4);
+    m_doc.colourise(m_lexer, m_doc.LineStart(4));
+    m_doc.insert(m_doc.LineStart(8), "E {\n", 4);
+    m_doc.colourise(m_lexer, m_doc.LineStart(9));
+    const Entries edited = list();
+    ASSERT_NE(nullptr, find("d"));
+    const std::size_t found = find("d")->start;
+
+    m_lexer->Release();
+    m_lexer = formula::create_lexer();
+    index_text();
+
+    EXPECT_EQ("A {\n  z = 1\n}\n  z = 0\n}\nC {\n; note\n}\nE {\nD {\n}\n", m_doc.text());
+    EXPECT_EQ(list(), edited);
+    EXPECT_EQ(find("d")->start, found);
+    EXPECT_EQ(4U, edited.size());
+}
+
+TEST_F(TestEntries, refoldingInsideAnEntryKeepsItsLevels)
+{
+    m_doc = formula::MemoryDocument{"A {\n  z = 0\n  z = 1\n}\n"};
+    relex();
+
+    m_doc.insert(m_doc.LineStart(2), "  if (z)\n  endif\n", 17);
+    relex();
+
+    EXPECT_EQ((std::vector<int>{HEADER, 1, HEADER + 1, 1, 1, 1, 0}), levels());
+}
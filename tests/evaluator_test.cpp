@@ -0,0 +1,368 @@
+#include <formula/evaluator.h>
+
+#include <formula/codegen.h>
+#include <formula/native.h>
+#include <formula/parser.h>
+
+#include <wx/dynlib.h>
+#include <wx/filename.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <complex>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+class TestEvaluator : public Test
+{
+protected:
+    void compile(std::string text, const formula::CompileOptions &options = {})
+    {
+        m_text = std::move(text);
+        const formula::Entry entry = formula::parse_entry(m_text, formula::next_entry(m_text, 0));
+        m_program = formula::compile(entry, m_text, options);
+    }
+
+    std::vector<int> evaluate(const std::vector<std::complex<double>> &pixels, int max_iterations)
+    {
+        std::vector<double> re;
+        std::vector<double> im;
+        for (const std::complex<double> &pixel : pixels)
+        {
+            re.push_back(pixel.real());
+            im.push_back(pixel.imag());
+        }
+        std::vector<int> iterations(pixels.size(), -1);
+        formula::BatchEvaluator evaluator(m_program);
+        evaluator.set_parameter(1, m_p1);
+        evaluator.evaluate(re.data(), im.data(), pixels.size(), max_iterations, iterations.data());
+        return iterations;
+    }
+
+    // A condition holds when it keeps a formula iterating.
+    bool holds(const std::string &condition)
+    {
+        compile("Check {\n" + condition + "\n}\n");
+        return evaluate({0.0}, 3)[0] == 3;
+    }
+
+    std::string m_text;
+    formula::Program m_program;
+    std::complex<double> m_p1;
+};
+
+int mandelbrot(std::complex<double> c, int max_iterations)
+{
+    std::complex<double> z;
+    for (int iteration = 1; iteration <= max_iterations; ++iteration)
+    {
+        z = z * z + c;
+        if (std::norm(z) > 4.0)
+        {
+            return iteration;
+        }
+    }
+    return max_iterations;
+}
+
+// The plug-in built from the corpus formula Switched, with fn1 bound to cos.
+class TestNativeFormula : public TestEvaluator
+{
+protected:
+    void SetUp() override
+    {
+        m_plugin.Load(m_plugin_file.GetFullPath());
+        ASSERT_TRUE(m_plugin.IsLoaded()) << "full path: " << m_plugin_file.GetFullPath();
+        bool found{};
+        void *function = m_plugin.GetSymbol(formula::NATIVE_ENTRY_POINT, &found);
+        ASSERT_TRUE(found);
+        m_formula = reinterpret_cast<formula::GetNativeFormulaFn *>(function)();
+        ASSERT_NE(nullptr, m_formula);
+    }
+
+    wxFileName m_plugin_file{wxT("./formula-switched-cos") + wxDynamicLibrary::GetDllExt(wxDL_LIBRARY)};
+    wxDynamicLibrary m_plugin;
+    const formula::NativeFormula *m_formula{};
+};
+
+} // namespace
+
+TEST_F(TestEvaluator, mandelbrotMatchesScalarLoop)
+{
+    compile("Mandelbrot {\n"
+            "  z = 0, c = pixel:\n"
+            "  z = sqr(z) + c\n"
+            "  |z| <= 4\n"
+            "}\n");
+    std::vector<std::complex<double>> pixels;
+    for (int i = 0; i < 37; ++i)
+    {
+        pixels.emplace_back(-2.0 + 0.07 * i, 0.5 - 0.03 * i);
+    }
+
+    const std::vector<int> iterations = evaluate(pixels, 50);
+
+    for (std::size_t i = 0; i < pixels.size(); ++i)
+    {
+        EXPECT_EQ(mandelbrot(pixels[i], 50), iterations[i]) << pixels[i];
+    }
+}
+
+TEST_F(TestEvaluator, escapedLanesStopCountingWhileOthersContinue)
+{
+    compile("Mandelbrot {\n"
+            "  z = 0, c = pixel:\n"
+            "  z = sqr(z) + c\n"
+            "  |z| <= 4\n"
+            "}\n");
+
+    const std::vector<int> iterations = evaluate({0.0, 2.0, 1.0, -1.0, 0.5}, 50);
+
+    EXPECT_EQ((std::vector<int>{50, 2, 3, 50, 5}), iterations);
+}
+
+TEST_F(TestEvaluator, partialBatchWritesOnlyItsPixels)
+{
+    compile("Once {\n"
+            "  z = 0\n"
+            "  0\n"
+            "}\n");
+    std::vector<double> re(formula::LANES + 3);
+    std::vector<double> im(formula::LANES + 3);
+    std::vector<int> iterations(formula::LANES + 4, -1);
+    formula::BatchEvaluator evaluator(m_program);
+
+    evaluator.evaluate(re.data(), im.data(), re.size(), 10, iterations.data());
+
+    EXPECT_EQ(1, *std::min_element(iterations.begin(), iterations.end() - 1));
+    EXPECT_EQ(1, *std::max_element(iterations.begin(), iterations.end() - 1));
+    EXPECT_EQ(-1, iterations.back());
+}
+
+TEST_F(TestEvaluator, branchesAreTakenPerLane)
+{
+    compile("Branches {\n"
+            "  z = 0:\n"
+            "  if (real(pixel) > 0)\n"
+            "    z = z + 1\n"
+            "  elseif (imag(pixel) > 0)\n"
+            "    z = z + 2\n"
+            "  else\n"
+            "    z = z + 3\n"
+            "  endif\n"
+            "  |z| < 100\n"
+            "}\n");
+
+    const std::vector<int> iterations = evaluate({{1, 0}, {-1, 1}, {-1, -1}, {1, 1}, {0, 1}, {0, 0}}, 50);
+
+    EXPECT_EQ((std::vector<int>{10, 5, 4, 10, 5, 4}), iterations);
+}
+
+TEST_F(TestEvaluator, nestedBranchesOnlyStoreToTheirLanes)
+{
+    compile("Nested {\n"
+            "  z = 0:\n"
+            "  if (real(pixel) > 0)\n"
+            "    if (imag(pixel) > 0)\n"
+            "      z = z + 5\n"
+            "    endif\n"
+            "    z = z + 1\n"
+            "  endif\n"
+            "  z = z + 1\n"
+            "  |z| < 144\n"
+            "}\n");
+
+    const std::vector<int> iterations = evaluate({{1, 1}, {1, -1}, {-1, 1}}, 50);
+
+    EXPECT_EQ((std::vector<int>{2, 6, 12}), iterations);
+}
+
+TEST_F(TestEvaluator, branchWithNoLanesIsSkipped)
+{
+    compile("Skipped {\n"
+            "  z = 0:\n"
+            "  if (real(pixel) > 100)\n"
+            "    z = z + 1\n"
+            "  else\n"
+            "    z = z + 2\n"
+            "  endif\n"
+            "  |z| < 100\n"
+            "}\n");
+
+    EXPECT_EQ((std::vector<int>{5, 5}), evaluate({0.0, 1.0}, 50));
+}
+
+TEST_F(TestEvaluator, builtinFunctions)
+{
+    EXPECT_TRUE(holds("cabs((3, 4)) == 5"));
+    EXPECT_TRUE(holds("z = flip((1, 2)), real(z) == 2 && imag(z) == 1"));
+    EXPECT_TRUE(holds("z = abs((-1, -2)), real(z) == 1 && imag(z) == 2"));
+    EXPECT_TRUE(holds("z = conj((1, 2)), real(z) == 1 && imag(z) == -2"));
+    EXPECT_TRUE(holds("z = (0.5, 0.25), w = cosxx(z) - conj(cos(z)), |w| == 0"));
+    EXPECT_TRUE(holds("z = (1, 1)^2, real(z) == 0 && imag(z) == 2"));
+    EXPECT_TRUE(holds("z = (2, 0)^-1, real(z) == 0.5"));
+    EXPECT_TRUE(holds("z = floor((1.5, -1.5)), real(z) == 1 && imag(z) == -2"));
+    EXPECT_TRUE(holds("|exp(log((3, 4))) - (3, 4)| < 0.000001"));
+    EXPECT_FALSE(holds("real(sqrt(4)) == 3"));
+}
+
+TEST_F(TestEvaluator, predefinedVariables)
+{
+    m_p1 = {2.0, 3.0};
+
+    EXPECT_TRUE(holds("real(p1) == 2 && imag(p1) == 3"));
+    EXPECT_TRUE(holds("maxit == 3"));
+    EXPECT_TRUE(holds("pi > 3.14159 && pi < 3.1416"));
+    EXPECT_TRUE(holds("|p2| == 0"));
+}
+
+TEST_F(TestEvaluator, boundFunctions)
+{
+    formula::CompileOptions options;
+    options.functions[0] = "sqr";
+    options.functions[3] = "FLIP";
+
+    compile("Bound {\n"
+            "z = fn1((1, 1)), w = fn4((1, 2)):\n"
+            "real(z) == 0 && imag(z) == 2 && real(w) == 2\n"
+            "}\n",
+        options);
+
+    EXPECT_EQ(3, evaluate({0.0}, 3)[0]);
+}
+
+TEST_F(TestEvaluator, unknownBoundFunctionThrows)
+{
+    formula::CompileOptions options;
+    options.functions[1] = "nosuch";
+
+    EXPECT_THROW(compile("Bound {\nz = fn2(z)\n|z| < 4\n}\n", options), std::runtime_error);
+}
+
+TEST_F(TestEvaluator, entryWithDiagnosticsThrows)
+{
+    EXPECT_THROW(compile("Broken {\nz = nosuch(z)\n|z| < 4\n}\n"), std::runtime_error);
+}
+
+TEST_F(TestEvaluator, constantsAreFoldedAndShared)
+{
+    compile("Constants {\n"
+            "z = (1, -2), w = (1, -2):\n"
+            "z = z * 2 + w\n"
+            "|z| < 4\n"
+            "}\n");
+
+    EXPECT_EQ((std::vector<std::complex<double>>{{1.0, -2.0}, 2.0, 4.0}), m_program.constants);
+    EXPECT_EQ(2U, m_program.init.size());
+    for (const formula::Instruction &instruction : m_program.init)
+    {
+        EXPECT_EQ(formula::Opcode::STORE, instruction.op);
+    }
+}
+
+TEST_F(TestEvaluator, applyMatchesStandardComplexArithmetic)
+{
+    const std::complex<double> a{0.75, -1.5};
+    const std::complex<double> b{-2.0, 0.5};
+
+    EXPECT_EQ(a * b, formula::apply(formula::Opcode::MULTIPLY, a, b));
+    EXPECT_NEAR(0.0, std::abs(a / b - formula::apply(formula::Opcode::DIVIDE, a, b)), 1e-15);
+    EXPECT_NEAR(0.0, std::abs(std::pow(a, b) - formula::apply(formula::Opcode::POWER, a, b)), 1e-12);
+    EXPECT_NEAR(0.0, std::abs(std::sin(a) - formula::apply(formula::Opcode::SIN, a)), 1e-15);
+    EXPECT_EQ(std::norm(a), formula::apply(formula::Opcode::MODULUS, a).real());
+    EXPECT_THROW(formula::apply(formula::Opcode::STORE, a), std::invalid_argument);
+}
+
+TEST_F(TestEvaluator, generatedSourceFixesConstantsAndBindings)
+{
+    formula::CompileOptions options;
+    options.functions[0] = "cosh";
+    compile("Bound {\n"
+            "z = pixel:\n"
+            "z = fn1(z) + 2\n"
+            "|z| <= 4\n"
+            "}\n",
+        options);
+
+    const std::string source = formula::generate_cpp(m_program, "Bound", options);
+
+    EXPECT_NE(std::string::npos, source.find("std::cosh(a)"));
+    EXPECT_NE(std::string::npos, source.find(" + 0x1p+1;"));
+    EXPECT_NE(std::string::npos, source.find(formula::NATIVE_ENTRY_POINT));
+    EXPECT_NE(std::string::npos, source.find("{\"cosh\", \"sqr\", \"sinh\", \"cosh\"}"));
+}
+
+TEST_F(TestEvaluator, generatedSourceKeepsNoImaginaryPartsForRealRegisters)
+{
+    compile("Counted {\n"
+            "z = pixel, n = 0:\n"
+            "z = z * z + pixel, n = n + 1\n"
+            "|z| <= 4 && n < 50\n"
+            "}\n");
+
+    const std::string source = formula::generate_cpp(m_program, "Counted", formula::CompileOptions{});
+
+    const auto count = [&](const std::string &text)
+    {
+        std::size_t found{};
+        for (std::size_t pos = source.find(text); pos != std::string::npos; pos = source.find(text, pos + 1))
+        {
+            ++found;
+        }
+        return found;
+    };
+    // z and pixel are complex; n, the comparisons and the bailout condition are not.
+    EXPECT_LT(count("_im[LANES]{};"), count("_re[LANES]{};"));
+    EXPECT_NE(std::string::npos, source.find("_im[i] = im;"));
+}
+
+TEST_F(TestNativeFormula, describesItself)
+{
+    EXPECT_EQ(formula::NATIVE_ABI_VERSION, m_formula->abi_version);
+    EXPECT_STREQ("Switched", m_formula->name);
+    EXPECT_STREQ("cos", m_formula->functions[0]);
+    EXPECT_STREQ("sqr", m_formula->functions[1]);
+}
+
+TEST_F(TestNativeFormula, matchesBatchEvaluator)
+{
+    std::ifstream file(FORMULA_CORPUS_DIR "/id-formula.frm", std::ios::binary);
+    const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    std::size_t position = formula::next_entry(text, 0);
+    while (position < text.size() && formula::parse_entry(text, position).name != "Switched")
+    {
+        position = formula::next_entry(text, formula::parse_entry(text, position).end);
+    }
+    ASSERT_LT(position, text.size());
+    formula::CompileOptions options;
+    options.functions[0] = "cos";
+    formula::BatchEvaluator evaluator(formula::compile(formula::parse_entry(text, position), text, options));
+    evaluator.set_parameter(2, 4.0);
+
+    // Enough pixels for a partial batch at the end; every quadrant takes a different branch.
+    constexpr int SIZE{45};
+    std::vector<double> re;
+    std::vector<double> im;
+    for (int i = 0; i < SIZE * SIZE; ++i)
+    {
+        re.push_back(-2.0 + 4.0 * (i % SIZE) / SIZE);
+        im.push_back(-2.0 + 4.0 * (i / SIZE) / SIZE);
+    }
+    const double parameters[10]{0.0, 0.0, 4.0, 0.0};
+    std::vector<int> expected(re.size());
+    std::vector<int> native(re.size(), -1);
+    evaluator.evaluate(re.data(), im.data(), re.size(), 100, expected.data());
+    m_formula->evaluate(re.data(), im.data(), re.size(), 100, parameters, native.data());
+
+    EXPECT_EQ(expected, native);
+    EXPECT_NE(std::count(expected.begin(), expected.end(), 100), static_cast<std::ptrdiff_t>(expected.size()));
+}
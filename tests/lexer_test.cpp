@@ -1,3 +1,5 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
 #include <formula/syntax.h>
 
 #include <ILexer.h>
@@ -188,7 +190,15 @@ TEST_F(TestPluginLoaded, factoryCreatesLexer)
     lexer->Release();
 }
 
-class TestLexer : public TestPluginLoaded
+// With BUILD_STATIC_LEXER the lexer is created in-process, so lexer tests
+// don't load the plug-in; the plug-in tests above still exercise it.
+#ifdef FORMULA_LEXER_STATIC
+using TestLexerBase = Test;
+#else
+using TestLexerBase = TestPluginLoaded;
+#endif
+
+class TestLexer : public TestLexerBase
 {
 protected:
     void SetUp() override;
@@ -199,7 +209,10 @@ protected:
 
 void TestLexer::SetUp()
 {
-    TestPluginLoaded::SetUp();
+    TestLexerBase::SetUp();
+#ifdef FORMULA_LEXER_STATIC
+    m_lexer = formula::create_lexer();
+#else
     GetExportedSymbol get_lexer_factory{m_plugin, wxT("GetLexerFactory")};
     using LexerFactoryFunction = ILexer *();
     using GetLexerFactoryFn = LexerFactoryFunction *(unsigned int index);
@@ -208,6 +221,7 @@ void TestLexer::SetUp()
     LexerFactoryFunction *factory{GetLexerFactory(0)};
     ASSERT_NE(nullptr, factory);
     m_lexer = factory();
+#endif
     ASSERT_NE(nullptr, m_lexer);
 }
 
@@ -217,7 +231,7 @@ void TestLexer::TearDown()
     {
         m_lexer->Release();
     }
-    TestPluginLoaded::TearDown();
+    TestLexerBase::TearDown();
 }
 
 TEST_F(TestLexer, version)
@@ -291,7 +305,7 @@ public:
     MOCK_METHOD(int, GetLineIndentation, (Sci_Position), (override));
 };
 
-class TestLexText : public TestLexer
+class TestDocumentText : public TestLexer
 {
 protected:
     void SetUp() override;
@@ -299,14 +313,28 @@ protected:
     MockDocument m_doc;
 };
 
-void TestLexText::SetUp()
+void TestDocumentText::SetUp()
 {
     TestLexer::SetUp();
     EXPECT_CALL(m_doc, CodePage()).WillRepeatedly(Return(0));
     EXPECT_CALL(m_doc, Version()).WillRepeatedly(Return(dvOriginal));
+}
+
+class TestLexText : public TestDocumentText
+{
+protected:
+    void SetUp() override;
+};
+
+void TestLexText::SetUp()
+{
+    TestDocumentText::SetUp();
     EXPECT_CALL(m_doc, StartStyling(0, _)).Times(1);
 }
 
+// Folding reads the text without styling it, so it leaves the end of the styled text alone.
+using TestFoldText = TestDocumentText;
+
 TEST_F(TestLexText, lexSemiColon)
 {
     m_text = ";";
@@ -541,7 +569,7 @@ TEST_F(TestLexText, keywordJunkIsNotAKeyword)
     m_lexer->Lex(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
 }
 
-TEST_F(TestLexText, ifIncreasesFoldLevel)
+TEST_F(TestFoldText, ifIncreasesFoldLevel)
 {
     const std::string line1{"if (1 != 0)\n"};
     const std::string line2{"\n"};
@@ -564,12 +592,18 @@ TEST_F(TestLexText, ifIncreasesFoldLevel)
     EXPECT_CALL(m_doc, SetLevel(0, SC_FOLDLEVELHEADERFLAG)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(1, 1)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(2, 0)).WillOnce(Return(0));
-    EXPECT_CALL(m_doc, SetLevel(4, 0)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(3, 0)).WillOnce(Return(0));
+    // No line ends inside an entry or a parenthesis; the condition's rise one level.
+    EXPECT_CALL(m_doc, SetLineState(0, formula::line_state(false, 0, 0, 1))).WillOnce(Return(0));
+    for (Sci_Position line = 1; line < 4; ++line)
+    {
+        EXPECT_CALL(m_doc, SetLineState(line, 0)).WillOnce(Return(0));
+    }
 
     m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
 }
 
-TEST_F(TestLexText, elseIfIncreasesFoldLevel)
+TEST_F(TestFoldText, elseIfIncreasesFoldLevel)
 {
     const std::string lines[]{
         {"if (1 != 0)\n"},     // 0
@@ -600,12 +634,18 @@ TEST_F(TestLexText, elseIfIncreasesFoldLevel)
     EXPECT_CALL(m_doc, SetLevel(2, SC_FOLDLEVELHEADERFLAG)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(3, 1)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(4, 0)).WillOnce(Return(0));
-    EXPECT_CALL(m_doc, SetLevel(6, 0)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(5, 0)).WillOnce(Return(0));
+    // No line ends inside an entry or a parenthesis; the conditions' rise one level.
+    for (Sci_Position line = 0; line < 6; ++line)
+    {
+        const bool condition{line == 0 || line == 2};
+        EXPECT_CALL(m_doc, SetLineState(line, formula::line_state(false, 0, 0, condition ? 1 : 0))).WillOnce(Return(0));
+    }
 
     m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
 }
 
-TEST_F(TestLexText, elseIncreasesFoldLevel)
+TEST_F(TestFoldText, elseIncreasesFoldLevel)
 {
     const std::string lines[]{
         {"if (1 != 0)\n"}, // 0
@@ -636,7 +676,197 @@ TEST_F(TestLexText, elseIncreasesFoldLevel)
     EXPECT_CALL(m_doc, SetLevel(2, SC_FOLDLEVELHEADERFLAG)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(3, 1)).WillOnce(Return(0));
     EXPECT_CALL(m_doc, SetLevel(4, 0)).WillOnce(Return(0));
-    EXPECT_CALL(m_doc, SetLevel(6, 0)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(5, 0)).WillOnce(Return(0));
+    // No line ends inside an entry or a parenthesis; the condition's rise one level.
+    EXPECT_CALL(m_doc, SetLineState(0, formula::line_state(false, 0, 0, 1))).WillOnce(Return(0));
+    for (Sci_Position line = 1; line < 6; ++line)
+    {
+        EXPECT_CALL(m_doc, SetLineState(line, 0)).WillOnce(Return(0));
+    }
+
+    m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
+}
+
+TEST_F(TestFoldText, endifWithoutIfIsMarked)
+{
+    m_text = "endif";
+    EXPECT_CALL(m_doc, Length()).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, LineFromPosition(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineFromPosition(as_pos(m_text.size()))).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(Ge(1))).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, GetCharRange(_, 0, as_pos(m_text.size())))
+        .WillRepeatedly([&](char *dest, Sci_Position start, Sci_Position len)
+            { std::strncpy(dest, m_text.substr(start, len).data(), len); });
+    EXPECT_CALL(m_doc, GetLevel(0)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(0, formula::FOLD_LEVEL_ERROR_FLAG)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, DecorationSetCurrentIndicator(+formula::Indicator::STRUCTURE_ERROR)).Times(1);
+    EXPECT_CALL(m_doc, DecorationFillRange(0, 1, as_pos(m_text.size()))).Times(1);
+
+    EXPECT_CALL(m_doc, SetLineState(0, 0)).WillOnce(Return(0));
+    m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
+}
+
+TEST_F(TestFoldText, remainingStructuralErrorIsRemarked)
+{
+    m_text = "endif";
+    EXPECT_CALL(m_doc, Length()).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, LineFromPosition(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineFromPosition(as_pos(m_text.size()))).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(Ge(1))).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, GetCharRange(_, 0, as_pos(m_text.size())))
+        .WillRepeatedly([&](char *dest, Sci_Position start, Sci_Position len)
+            { std::strncpy(dest, m_text.substr(start, len).data(), len); });
+    EXPECT_CALL(m_doc, GetLevel(0)).WillOnce(Return(formula::FOLD_LEVEL_ERROR_FLAG));
+    EXPECT_CALL(m_doc, SetLevel(0, formula::FOLD_LEVEL_ERROR_FLAG)).WillOnce(Return(formula::FOLD_LEVEL_ERROR_FLAG));
+    // The error may have moved along the line, so the line is cleared before it is marked.
+    EXPECT_CALL(m_doc, DecorationSetCurrentIndicator(+formula::Indicator::STRUCTURE_ERROR)).Times(2);
+    {
+        InSequence sequence;
+        EXPECT_CALL(m_doc, DecorationFillRange(0, 0, as_pos(m_text.size()))).Times(1);
+        EXPECT_CALL(m_doc, DecorationFillRange(0, 1, as_pos(m_text.size()))).Times(1);
+    }
+
+    EXPECT_CALL(m_doc, SetLineState(0, 0)).WillOnce(Return(0));
+    m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
+}
+
+TEST_F(TestFoldText, unterminatedIfIsMarked)
+{
+    const std::string lines[]{
+        {"if (1 != 0)\n"}, // 0
+        {"z = z + 1"},     // 1
+    };
+    m_text = std::accumulate(std::begin(lines), std::end(lines), std::string{});
+    EXPECT_CALL(m_doc, Length()).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, LineFromPosition(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineFromPosition(as_pos(m_text.size()))).WillRepeatedly(Return(1));
+    EXPECT_CALL(m_doc, LineStart(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(1)).WillRepeatedly(Return(as_pos(lines[0].size())));
+    EXPECT_CALL(m_doc, LineStart(Ge(2))).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, GetCharRange(_, 0, as_pos(m_text.size())))
+        .WillRepeatedly([&](char *dest, Sci_Position start, Sci_Position len)
+            { std::strncpy(dest, m_text.substr(start, len).data(), len); });
+    EXPECT_CALL(m_doc, GetLevel(0)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(0, SC_FOLDLEVELHEADERFLAG)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLevel(1, 1 | formula::FOLD_LEVEL_ERROR_FLAG)).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, DecorationSetCurrentIndicator(+formula::Indicator::STRUCTURE_ERROR)).Times(1);
+    EXPECT_CALL(m_doc, DecorationFillRange(as_pos(lines[0].size()), 1, as_pos(lines[1].size()))).Times(1);
+    EXPECT_CALL(m_doc, SetLineState(0, formula::line_state(false, 0, 0, 1))).WillOnce(Return(0));
+    EXPECT_CALL(m_doc, SetLineState(1, 0)).WillOnce(Return(0));
+
+    m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
+}
+
+TEST_F(TestFoldText, correctedStructuralErrorIsCleared)
+{
+    m_text = "z = z + 1";
+    EXPECT_CALL(m_doc, Length()).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, LineFromPosition(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineFromPosition(as_pos(m_text.size()))).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(0)).WillRepeatedly(Return(0));
+    EXPECT_CALL(m_doc, LineStart(Ge(1))).WillRepeatedly(Return(as_pos(m_text.size())));
+    EXPECT_CALL(m_doc, GetCharRange(_, 0, as_pos(m_text.size())))
+        .WillRepeatedly([&](char *dest, Sci_Position start, Sci_Position len)
+            { std::strncpy(dest, m_text.substr(start, len).data(), len); });
+    EXPECT_CALL(m_doc, GetLevel(0)).WillOnce(Return(formula::FOLD_LEVEL_ERROR_FLAG));
+    EXPECT_CALL(m_doc, SetLevel(0, 0)).WillOnce(Return(formula::FOLD_LEVEL_ERROR_FLAG));
+    EXPECT_CALL(m_doc, DecorationSetCurrentIndicator(+formula::Indicator::STRUCTURE_ERROR)).Times(1);
+    EXPECT_CALL(m_doc, DecorationFillRange(0, 0, as_pos(m_text.size()))).Times(1);
 
+    EXPECT_CALL(m_doc, SetLineState(0, 0)).WillOnce(Return(0));
     m_lexer->Fold(0, as_pos(m_text.size()), +formula::Syntax::NONE, &m_doc);
 }
+
+namespace
+{
+
+// Refolds documents after edits, to compare with folding the edited text from scratch.
+class TestRefold : public TestLexer
+{
+protected:
+    // The fold levels and error indicators of each line of doc.
+    static std::vector<std::string> folds(formula::MemoryDocument &doc)
+    {
+        std::vector<std::string> result;
+        for (Sci_Position line = 0; line < doc.line_count(); ++line)
+        {
+            std::ostringstream folded;
+            folded << std::hex << doc.GetLevel(line) << ' ';
+            for (Sci_Position pos = doc.LineStart(line); pos < doc.LineStart(line + 1); ++pos)
+            {
+                folded << doc.indicator_value(+formula::Indicator::STRUCTURE_ERROR, pos);
+            }
+            result.push_back(folded.str());
+        }
+        return result;
+    }
+
+    std::vector<std::string> folded_whole() const
+    {
+        ILexer *lexer = formula::create_lexer();
+        formula::MemoryDocument doc{m_doc.text()};
+        doc.colourise(lexer, doc.Length());
+        lexer->Release();
+        return folds(doc);
+    }
+
+    // Inserts text at the start of line, which has the refold start there.
+    void insert_at_line(Sci_Position line, const char *text)
+    {
+        m_doc.insert(m_doc.LineStart(line), text, static_cast<Sci_Position>(std::strlen(text)));
+        m_doc.colourise(m_lexer, m_doc.Length());
+    }
+
+    formula::MemoryDocument m_doc{"A {\n"
+                                  "  if (x)\n"
+                                  "    z = 1\n"
+                                  "  else\n"
+                                  "    z = 2\n"
+                                  "  endif\n"
+                                  "  z = 3\n"
+                                  "}\n"};
+};
+
+} // namespace
+
+TEST_F(TestRefold, refoldFromElseLineKeepsLevels)
+{
+    m_doc.colourise(m_lexer, m_doc.Length());
+
+    insert_at_line(3, " ");
+
+    EXPECT_EQ(folded_whole(), folds(m_doc));
+}
+
+TEST_F(TestRefold, refoldFromEndifLineKeepsLevels)
+{
+    m_doc.colourise(m_lexer, m_doc.Length());
+
+    insert_at_line(5, " ");
+
+    EXPECT_EQ(folded_whole(), folds(m_doc));
+}
+
+TEST_F(TestRefold, refoldAfterClosingLineKeepsLevels)
+{
+    m_doc = formula::MemoryDocument{"A {\n  if (x)\n  endif\n}\nB {\n  z = 1\n}\n"};
+    m_doc.colourise(m_lexer, m_doc.Length());
+
+    insert_at_line(4, " ");
+
+    EXPECT_EQ(folded_whole(), folds(m_doc));
+}
+
+TEST_F(TestRefold, errorMarkedOverTheWholeKeywordAfterItGrows)
+{
+    m_doc = formula::MemoryDocument{"A {\n  else\n}\n"};
+    m_doc.colourise(m_lexer, m_doc.Length());
+
+    m_doc.insert(m_doc.LineStart(1) + 6, "if", 2);
+    m_doc.colourise(m_lexer, m_doc.Length());
+
+    EXPECT_EQ(folded_whole(), folds(m_doc));
+    EXPECT_EQ(1, m_doc.indicator_value(+formula::Indicator::STRUCTURE_ERROR, m_doc.LineStart(1) + 7));
+}
@@ -0,0 +1,216 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+#include <formula/syntax.h>
+
+#include <ILexer.h>
+#include <Scintilla.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+// Everything a lexer leaves behind for a document, for comparing two ways of styling it.
+struct Lexed
+{
+    std::string styles;
+    std::vector<int> levels;
+    std::vector<int> line_states;
+    std::vector<std::string> entries;
+    std::vector<std::size_t> occurrences;
+};
+
+void expect_same(const Lexed &expected, const Lexed &actual)
+{
+    EXPECT_EQ(expected.styles, actual.styles);
+    EXPECT_EQ(expected.levels, actual.levels);
+    EXPECT_EQ(expected.line_states, actual.line_states);
+    EXPECT_EQ(expected.entries.size(), actual.entries.size());
+    for (std::size_t i = 0; i < std::min(expected.entries.size(), actual.entries.size()); ++i)
+    {
+        EXPECT_EQ(expected.entries[i], actual.entries[i]) << i;
+    }
+    EXPECT_EQ(expected.occurrences, actual.occurrences);
+}
+
+// Remembers the lowest position whose text was read.
+class ReadFromDocument : public formula::MemoryDocument
+{
+public:
+    using MemoryDocument::MemoryDocument;
+
+    void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const override
+    {
+        m_read_from = std::min(m_read_from, position);
+        MemoryDocument::GetCharRange(buffer, position, length);
+    }
+
+    mutable Sci_Position m_read_from{std::numeric_limits<Sci_Position>::max()};
+};
+
+class TestLongLines : public Test
+{
+protected:
+    ~TestLongLines() override
+    {
+        m_lexer->Release();
+    }
+
+    static ILexer *create_indexing_lexer()
+    {
+        ILexer *lexer = formula::create_lexer();
+        lexer->PrivateCall(+formula::LexerCall::INDEX_IDENTIFIERS, nullptr);
+        return lexer;
+    }
+
+    // Styles the rest of the document a chunk at a time, each chunk starting where the last one stopped.
+    void style_in_chunks(Sci_Position chunk)
+    {
+        while (m_doc.end_styled() < m_doc.Length())
+        {
+            m_doc.colourise_from_end_styled(m_lexer, m_doc.end_styled() + chunk);
+        }
+    }
+
+    static Lexed lexed(ILexer *lexer, formula::MemoryDocument &doc, const char *identifier)
+    {
+        Lexed result{doc.styles(), {}, {}, {}, {}};
+        for (Sci_Position line = 0; line < doc.line_count(); ++line)
+        {
+            result.levels.push_back(doc.GetLevel(line));
+            result.line_states.push_back(doc.GetLineState(line));
+        }
+        const auto *entries = static_cast<const formula::FormulaEntries *>(
+            lexer->PrivateCall(+formula::LexerCall::LIST_ENTRIES, nullptr));
+        for (std::size_t i = 0; i < entries->count; ++i)
+        {
+            const formula::FormulaEntry &entry = entries->items[i];
+            result.entries.push_back(entry.name + (' ' + std::to_string(entry.start)) + ' '
+                + std::to_string(entry.end));
+        }
+        const auto *found = static_cast<const formula::IdentifierOccurrences *>(
+            lexer->PrivateCall(+formula::LexerCall::FIND_OCCURRENCES, const_cast<char *>(identifier)));
+        for (std::size_t i = 0; i < found->count; ++i)
+        {
+            result.occurrences.push_back(found->items[i].line * 1000000 + found->items[i].column);
+        }
+        return result;
+    }
+
+    // What styling the whole of the current text at once leaves behind.
+    Lexed styled_whole(const char *identifier) const
+    {
+        ILexer *lexer = create_indexing_lexer();
+        formula::MemoryDocument doc{m_doc.text()};
+        doc.colourise(lexer, doc.Length());
+        Lexed result = lexed(lexer, doc, identifier);
+        lexer->Release();
+        return result;
+    }
+
+    static std::string long_line(std::size_t repeats)
+    {
+        std::string line;
+        for (std::size_t i = 0; i < repeats; ++i)
+        {
+            line += "z = sin(alpha" + std::to_string(i % 7) + ") + if2 * (beta ";
+            line += i % 3 == 0 ? "} Next" + std::to_string(i) + " { " : ") elseif ";
+        }
+        return line;
+    }
+
+    ILexer *m_lexer{create_indexing_lexer()};
+    ReadFromDocument m_doc;
+};
+
+} // namespace
+
+TEST_F(TestLongLines, chunkedStylingMatchesWholeStyling)
+{
+    m_doc = ReadFromDocument{"Long {\n" + long_line(4000) + "\n}\nB {\n  if (x)\n  endif\n}\n"};
+
+    style_in_chunks(997);
+
+    expect_same(styled_whole("alpha3"), lexed(m_lexer, m_doc, "alpha3"));
+}
+
+TEST_F(TestLongLines, editingPartWayAlongALongLineRestylesFromTheEdit)
+{
+    m_doc = ReadFromDocument{"Long {\n" + long_line(4000) + "\n}\n"};
+    style_in_chunks(4096);
+    const Sci_Position position = m_doc.LineStart(1) + 150000;
+
+    m_doc.insert(position, "(alpha3 ", 8);
+    const Sci_Position restyled_from = m_doc.end_styled();
+    style_in_chunks(4096);
+
+    EXPECT_EQ(position, restyled_from);
+    expect_same(styled_whole("alpha3"), lexed(m_lexer, m_doc, "alpha3"));
+}
+
+TEST_F(TestLongLines, restylingPartWayAlongALongLineDoesntGoBackToItsStart)
+{
+    m_doc = ReadFromDocument{"Long {\n" + long_line(8000) + "\n}\n"};
+    style_in_chunks(4096);
+    const Sci_Position position = m_doc.LineStart(1) + 300000;
+    m_doc.insert(position, "z", 1);
+
+    m_doc.m_read_from = m_doc.Length();
+    m_doc.colourise_from_end_styled(m_lexer, position + 4096);
+
+    // Folding carries on from the last state it kept, at most 64K back.
+    EXPECT_GT(m_doc.m_read_from, position - 70000);
+}
+
+TEST_F(TestLongLines, wordsLongerThanTheBacktrackKeepTheirStyle)
+{
+    const std::string word(1000, 'q');
+    m_doc = ReadFromDocument{"if " + word + " sin(" + word + ")\nendif\n"};
+
+    style_in_chunks(61);
+
+    expect_same(styled_whole(word.c_str()), lexed(m_lexer, m_doc, word.c_str()));
+    EXPECT_EQ(+formula::Syntax::IDENTIFIER, m_doc.StyleAt(3 + 500));
+    const auto *completions = static_cast<const char *>(
+        m_lexer->PrivateCall(+formula::LexerCall::COMPLETE_IDENTIFIER, const_cast<char *>("q")));
+    EXPECT_STREQ("", completions);
+}
+
+TEST_F(TestLongLines, chunksStartingInsideKeywordsClassifyThemWhole)
+{
+    m_doc = ReadFromDocument{"if (x)\n  z = sinh(y)\nelse\n  z = cosxx(y)\nendif\n"};
+
+    style_in_chunks(2);
+
+    expect_same(styled_whole("y"), lexed(m_lexer, m_doc, "y"));
+}
+
+TEST_F(TestLongLines, restylingPartWayAlongALongClosingLineKeepsItsLevel)
+{
+    std::string body;
+    for (int i = 0; i < 8000; ++i)
+    {
+        body += "z = sin(alpha3) * (beta + 1) ";
+    }
+    m_doc = ReadFromDocument{"Long {\n  if (x)\n  else " + body + "\n  endif " + body + "\n}\n"};
+    style_in_chunks(4096);
+
+    // Near the start of each line, before any state kept along it, and far along, after some.
+    for (const Sci_Position line : {2, 3})
+    {
+        for (const Sci_Position offset : {10, 150000})
+        {
+            m_doc.insert(m_doc.LineStart(line) + offset, "z", 1);
+            style_in_chunks(4096);
+        }
+    }
+
+    expect_same(styled_whole("alpha3"), lexed(m_lexer, m_doc, "alpha3"));
+}
@@ -0,0 +1,133 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+
+#include <ILexer.h>
+
+#include <gtest/gtest.h>
+
+#include <ostream>
+#include <vector>
+
+using namespace testing;
+
+namespace formula
+{
+
+bool operator==(const IdentifierOccurrence &lhs, const IdentifierOccurrence &rhs)
+{
+    return lhs.line == rhs.line && lhs.column == rhs.column;
+}
+
+std::ostream &operator<<(std::ostream &str, const IdentifierOccurrence &occurrence)
+{
+    return str << '(' << occurrence.line << ", " << occurrence.column << ')';
+}
+
+} // namespace formula
+
+namespace
+{
+
+class TestOccurrences : public Test
+{
+protected:
+    void SetUp() override
+    {
+        m_lexer->PrivateCall(+formula::LexerCall::INDEX_IDENTIFIERS, nullptr);
+    }
+    ~TestOccurrences() override
+    {
+        m_lexer->Release();
+    }
+
+    std::vector<formula::IdentifierOccurrence> find(const char *identifier)
+    {
+        const auto *found = static_cast<const formula::IdentifierOccurrences *>(
+            m_lexer->PrivateCall(+formula::LexerCall::FIND_OCCURRENCES, const_cast<char *>(identifier)));
+        return {found->items, found->items + found->count};
+    }
+
+    std::vector<formula::IdentifierOccurrence> find_in_lines(const char *identifier, std::size_t first,
+        std::size_t last)
+    {
+        formula::LineOccurrences lines{identifier, first, last};
+        const auto *found = static_cast<const formula::IdentifierOccurrences *>(
+            m_lexer->PrivateCall(+formula::LexerCall::FIND_LINE_OCCURRENCES, &lines));
+        return {found->items, found->items + found->count};
+    }
+
+    void relex()
+    {
+        m_doc.colourise(m_lexer, m_doc.Length());
+    }
+
+    ILexer *m_lexer{formula::create_lexer()};
+    formula::MemoryDocument m_doc;
+};
+
+using Occurrences = std::vector<formula::IdentifierOccurrence>;
+
+} // namespace
+
+TEST_F(TestOccurrences, onlyIdentifiersAreFound)
+{
+    m_doc = formula::MemoryDocument{"z = sin(z) ; z in a comment\nZ = z*z\nzz = 1\n"};
+
+    relex();
+
+    EXPECT_EQ((Occurrences{{0, 0}, {0, 8}, {1, 0}, {1, 4}, {1, 6}}), find("z"));
+    EXPECT_EQ((Occurrences{{2, 0}}), find("ZZ"));
+    EXPECT_EQ(Occurrences{}, find("sin"));
+    EXPECT_EQ(Occurrences{}, find("comment"));
+}
+
+TEST_F(TestOccurrences, editsMoveOccurrences)
+{
+    m_doc = formula::MemoryDocument{"c = 1\nz = c\n"};
+    relex();
+
+    m_doc.insert(0, "q = 2\n", 6);
+    relex();
+    m_doc.insert(15, "  ", 2);
+    relex();
+
+    EXPECT_EQ("q = 2\nc = 1\nz =   c\n", m_doc.text());
+    EXPECT_EQ((Occurrences{{1, 0}, {2, 6}}), find("c"));
+    EXPECT_EQ((Occurrences{{0, 0}}), find("q"));
+}
+
+TEST_F(TestOccurrences, removedLinesAreForgotten)
+{
+    m_doc = formula::MemoryDocument{"a = 1\nb = a\nc = a + b\n"};
+    relex();
+
+    m_doc.erase(0, 12);
+    relex();
+
+    EXPECT_EQ("c = a + b\n", m_doc.text());
+    EXPECT_EQ((Occurrences{{0, 4}}), find("a"));
+    EXPECT_EQ((Occurrences{{0, 8}}), find("b"));
+}
+
+TEST_F(TestOccurrences, numbersAreNotIdentifiers)
+{
+    m_doc = formula::MemoryDocument{"z = 4 + z4\n"};
+
+    relex();
+
+    EXPECT_EQ(Occurrences{}, find("4"));
+    EXPECT_EQ((Occurrences{{0, 8}}), find("z4"));
+}
+
+TEST_F(TestOccurrences, lineRangeFindsOnlyThoseLines)
+{
+    m_doc = formula::MemoryDocument{"a = 1\nb = a\nc = a + b\na = c\n"};
+    relex();
+    m_doc.insert(0, "q = a\n", 6);
+    relex();
+
+    EXPECT_EQ((Occurrences{{2, 4}, {3, 4}}), find_in_lines("A", 2, 4));
+    EXPECT_EQ((Occurrences{{4, 0}}), find_in_lines("a", 4, 100));
+    EXPECT_EQ(Occurrences{}, find_in_lines("a", 5, 100));
+    EXPECT_EQ(find("a"), find_in_lines("a", 0, 5));
+}
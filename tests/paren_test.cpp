@@ -0,0 +1,169 @@
+#include <formula/lexer.h>
+#include <formula/memory_document.h>
+#include <formula/syntax.h>
+
+#include <ILexer.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+// Remembers the lines whose text was read.
+class ReadLinesDocument : public formula::MemoryDocument
+{
+public:
+    using MemoryDocument::MemoryDocument;
+
+    void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const override
+    {
+        m_read.push_back(LineFromPosition(position));
+        MemoryDocument::GetCharRange(buffer, position, length);
+    }
+
+    mutable std::vector<Sci_Position> m_read;
+};
+
+class TestParens : public Test
+{
+protected:
+    ~TestParens() override
+    {
+        m_lexer->Release();
+    }
+
+    void relex()
+    {
+        m_doc.colourise(m_lexer, m_doc.Length());
+    }
+
+    // The position matching the parenthesis at position, or -1.
+    Sci_Position match(Sci_Position position)
+    {
+        formula::ParenMatch paren{static_cast<std::size_t>(position), static_cast<std::size_t>(m_doc.end_styled()), 0};
+        if (m_lexer->PrivateCall(+formula::LexerCall::MATCH_PAREN, &paren) == nullptr)
+        {
+            return -1;
+        }
+        return static_cast<Sci_Position>(paren.match);
+    }
+
+    Sci_Position find(const char *text, std::size_t from = 0) const
+    {
+        return static_cast<Sci_Position>(m_doc.text().find(text, from));
+    }
+
+    ILexer *m_lexer{formula::create_lexer()};
+    ReadLinesDocument m_doc;
+};
+
+} // namespace
+
+TEST_F(TestParens, lineStatesHoldDepths)
+{
+    m_doc = ReadLinesDocument{"z = (a + (b\n  * c)) - (d\n) + ((e)\n"};
+
+    relex();
+
+    EXPECT_EQ(formula::line_state(false, 2, 2, 0), m_doc.GetLineState(0));
+    EXPECT_EQ(formula::line_state(false, 1, 1, 1), m_doc.GetLineState(1));
+    EXPECT_EQ(formula::line_state(false, 1, 1, 1), m_doc.GetLineState(2));
+}
+
+TEST_F(TestParens, strayClosingParenStaysAtZero)
+{
+    m_doc = ReadLinesDocument{") ) (\n"};
+
+    relex();
+
+    EXPECT_EQ(formula::line_state(false, 1, 1, 0), m_doc.GetLineState(0));
+    EXPECT_EQ(-1, match(0));
+    EXPECT_EQ(-1, match(4));
+}
+
+TEST_F(TestParens, matchesAcrossLines)
+{
+    m_doc = ReadLinesDocument{"A {\n  z = (a + (b\n  * c))\n  w = (z)\n}\n"};
+    relex();
+    const Sci_Position outer_open = find("(a");
+    const Sci_Position outer_close = find("))") + 1;
+
+    EXPECT_EQ(outer_close, match(outer_open));
+    EXPECT_EQ(outer_open, match(outer_close));
+    EXPECT_EQ(outer_close - 1, match(find("(b")));
+    EXPECT_EQ(find("(b"), match(outer_close - 1));
+    EXPECT_EQ(find("(z)") + 2, match(find("(z)")));
+}
+
+TEST_F(TestParens, commentsAreIgnored)
+{
+    m_doc = ReadLinesDocument{"z = (a ; )\n  )\n; (\n"};
+    relex();
+
+    EXPECT_EQ(find("  )") + 2, match(find("(a")));
+    EXPECT_EQ(-1, match(find(")")));
+    EXPECT_EQ(-1, match(find("; (") + 2));
+}
+
+TEST_F(TestParens, unmatchedParenHasNoMatch)
+{
+    m_doc = ReadLinesDocument{"z = (a\n+ b\n"};
+    relex();
+
+    EXPECT_EQ(-1, match(find("(")));
+    EXPECT_EQ(-1, match(find("a")));
+}
+
+TEST_F(TestParens, linesThatCantHoldTheMatchArentRead)
+{
+    std::string text{"z = (a\n"};
+    for (int i = 0; i < 10; ++i)
+    {
+        text += "  + (b * c)\n";
+    }
+    text += ")\n";
+    m_doc = ReadLinesDocument{text};
+    relex();
+    m_doc.m_read.clear();
+
+    EXPECT_EQ(static_cast<Sci_Position>(text.size()) - 2, match(find("(a")));
+
+    EXPECT_EQ((std::vector<Sci_Position>{0, 0, 11}), m_doc.m_read);
+}
+
+TEST_F(TestParens, linesAfterTheStyledTextAreScanned)
+{
+    m_doc = ReadLinesDocument{"z = (a\n+ b\n"};
+    relex();
+    m_doc.insert(find("+ b"), "(c)\n)", 5);
+    m_doc.colourise(m_lexer, m_doc.LineStart(1));
+
+    EXPECT_EQ(find(")+"), match(find("(a")));
+    EXPECT_EQ(find("(a"), match(find(")+")));
+    EXPECT_EQ(find("(c)") + 2, match(find("(c)")));
+}
+
+TEST_F(TestParens, searchAfterTheStyledTextIsBounded)
+{
+    std::string text{"z = (a\n"};
+    while (text.size() < 2 * 1024 * 1024)
+    {
+        text += "  + b\n";
+    }
+    text += ")\n";
+    m_doc = ReadLinesDocument{text};
+    m_doc.colourise(m_lexer, m_doc.LineStart(1));
+    m_doc.m_read.clear();
+
+    EXPECT_EQ(-1, match(find("(a")));
+
+    ASSERT_FALSE(m_doc.m_read.empty());
+    EXPECT_LT(*std::max_element(m_doc.m_read.begin(), m_doc.m_read.end()), m_doc.line_count() / 2);
+}
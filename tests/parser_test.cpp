@@ -0,0 +1,338 @@
+#include <formula/parser.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+class TestParser : public Test
+{
+protected:
+    void parse(std::string text)
+    {
+        m_text = std::move(text);
+        m_entry = formula::parse_entry(m_text, formula::next_entry(m_text, 0));
+    }
+
+    std::string tree() const
+    {
+        return formula::to_string(m_entry, m_text);
+    }
+
+    std::vector<std::string> messages() const
+    {
+        std::vector<std::string> result;
+        for (const formula::Diagnostic &diagnostic : m_entry.diagnostics)
+        {
+            result.push_back(diagnostic.message);
+        }
+        return result;
+    }
+
+    std::string m_text;
+    formula::Entry m_entry;
+};
+
+class TestFormulaFile : public Test
+{
+protected:
+    void parse(std::string text)
+    {
+        m_text = std::move(text);
+        m_file.parse(m_text);
+    }
+
+    formula::FormulaFile::Range replace(std::size_t position, std::size_t removed, const std::string &inserted)
+    {
+        m_text.replace(position, removed, inserted);
+        return m_file.update(m_text, position, removed, inserted.size());
+    }
+
+    std::vector<std::string> names() const
+    {
+        std::vector<std::string> result;
+        for (const formula::Entry &entry : m_file.entries())
+        {
+            result.push_back(entry.name);
+        }
+        return result;
+    }
+
+    // Checks the incrementally updated entries against a full parse of the same text.
+    void expect_full_parse() const
+    {
+        formula::FormulaFile full;
+        full.parse(m_text);
+        ASSERT_EQ(full.entries().size(), m_file.entries().size());
+        for (std::size_t i = 0; i < full.entries().size(); ++i)
+        {
+            const formula::Entry &expected = full.entries()[i];
+            const formula::Entry &actual = m_file.entries()[i];
+            EXPECT_EQ(expected.begin, actual.begin) << i;
+            EXPECT_EQ(expected.end, actual.end) << i;
+            EXPECT_EQ(formula::to_string(expected, m_text), formula::to_string(actual, m_text)) << i;
+        }
+    }
+
+    std::string m_text;
+    formula::FormulaFile m_file;
+};
+
+const char *const THREE_ENTRIES{
+    "; collection\n"
+    "Mandel (XAXIS) {\n"
+    "  z = 0, c = pixel:\n"
+    "  z = sqr(z) + c\n"
+    "  |z| <= 4\n"
+    "}\n"
+    "\n"
+    "Julia {\n"
+    "  z = pixel:\n"
+    "  z = z*z + p1, |z| <= 4\n"
+    "}\n"
+    "Lambda {\n"
+    "  z = pixel:\n"
+    "  z = p1*z*(1 - z), |z| <= 64\n"
+    "}\n"};
+
+} // namespace
+
+TEST_F(TestParser, sections)
+{
+    parse("; comment\nMandel (XAXIS) {\n  z = 0, c = pixel:\n  z = sqr(z) + c\n  |z| <= 4\n}\n");
+
+    EXPECT_EQ("Mandel", m_entry.name);
+    EXPECT_EQ("XAXIS", m_entry.symmetry);
+    EXPECT_EQ(10U, m_entry.begin);
+    EXPECT_EQ(m_text.size() - 1, m_entry.end);
+    EXPECT_EQ("(init (= z 0) (= c pixel)) (iteration (= z (+ (sqr z) c))) (bailout (<= (modulus z) 4))", tree());
+    EXPECT_TRUE(m_entry.diagnostics.empty());
+}
+
+TEST_F(TestParser, initSectionIsOptional)
+{
+    parse("Julia { z = z*z + c, |z| < 4 }");
+
+    EXPECT_EQ("(init) (iteration (= z (+ (* z z) c))) (bailout (< (modulus z) 4))", tree());
+}
+
+TEST_F(TestParser, precedence)
+{
+    parse("P { z = -z^2 + 3*c/2 - 1, a == b && c < d || e }");
+
+    EXPECT_EQ("(init) (iteration (= z (- (+ (- (^ z 2)) (/ (* 3 c) 2)) 1))) (bailout (|| (&& (== a b) (< c d)) e))",
+        tree());
+}
+
+TEST_F(TestParser, complexConstantsAndNegativeExponents)
+{
+    parse("C { z = (1, -2) * z^-1 ^ 2, 1 }");
+
+    EXPECT_EQ("(init) (iteration (= z (* (complex 1 (- 2)) (^ (^ z (- 1)) 2)))) (bailout 1)", tree());
+}
+
+TEST_F(TestParser, numbers)
+{
+    parse("N { z = 1.5e2 + .25, z = 3E-1 }");
+
+    EXPECT_EQ((std::vector<double>{150.0, 0.25, 0.3}), m_entry.numbers);
+}
+
+TEST_F(TestParser, lineEndsInsideParenthesesContinueStatement)
+{
+    parse("L {\n  z = sqr(z +\n    c)\n  |z| < 4\n}");
+
+    EXPECT_EQ("(init) (iteration (= z (sqr (+ z c)))) (bailout (< (modulus z) 4))", tree());
+}
+
+TEST_F(TestParser, ifBlocks)
+{
+    parse("S {\n"
+          "  z = 0:\n"
+          "  if (real(z) > 0)\n"
+          "    z = fn1(z)\n"
+          "  elseif (imag(z) > 0)\n"
+          "    z = fn2(z)\n"
+          "  else\n"
+          "    z = conj(z)\n"
+          "  endif\n"
+          "  |z| <= 4\n"
+          "}\n");
+
+    EXPECT_EQ("(init (= z 0)) (iteration (if (> (real z) 0) (block (= z (fn1 z))) (elseif (> (imag z) 0) "
+              "(block (= z (fn2 z)))) (else (block (= z (conj z)))))) (bailout (<= (modulus z) 4))",
+        tree());
+    EXPECT_TRUE(m_entry.diagnostics.empty());
+}
+
+TEST_F(TestParser, nodeText)
+{
+    parse("T { z = sqr(z) + c, |z| < 4 }");
+
+    const formula::NodeId assign = m_entry.node(m_entry.iteration).first_child;
+    EXPECT_EQ("z = sqr(z) + c", m_entry.text(m_text, assign));
+    EXPECT_EQ("|z| < 4", m_entry.text(m_text, m_entry.bailout));
+}
+
+TEST_F(TestParser, commentsMayHoldBraces)
+{
+    parse("A { ; } is not the end\n z = 1, z < 4 }");
+
+    EXPECT_EQ("(init) (iteration (= z 1)) (bailout (< z 4))", tree());
+}
+
+TEST_F(TestParser, diagnostics)
+{
+    parse("D {\n  z = foo(z)\n  3 = z\n  z = (1 + )\n  endif\n  if (z)\n}\n");
+
+    EXPECT_EQ((std::vector<std::string>{"Unknown function 'foo'", "Only a variable can be assigned",
+                  "Expected an expression", "'endif' without 'if'", "Missing 'endif'",
+                  "The bailout condition must be an expression"}),
+        messages());
+}
+
+TEST_F(TestParser, missingBailout)
+{
+    parse("E { }");
+
+    EXPECT_EQ((std::vector<std::string>{"Missing bailout condition"}), messages());
+    EXPECT_EQ(formula::NO_NODE, m_entry.bailout);
+}
+
+TEST_F(TestParser, missingOpenBrace)
+{
+    parse("Broken (XAXIS)\nNext { z, 1 }");
+
+    EXPECT_EQ((std::vector<std::string>{"Expected '{' after the formula name"}), messages());
+    EXPECT_EQ(14U, m_entry.end);
+}
+
+TEST_F(TestFormulaFile, parsesEveryEntry)
+{
+    parse(THREE_ENTRIES);
+
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Julia", "Lambda"}), names());
+    EXPECT_EQ("Julia", m_file.find(m_text.find("z*z"))->name);
+    EXPECT_EQ(nullptr, m_file.find(0));
+}
+
+TEST_F(TestFormulaFile, missingCloseBraceStopsAtNextEntry)
+{
+    std::string text{THREE_ENTRIES};
+    text.erase(text.find("}\n\nJulia"), 1);
+    parse(text);
+
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Julia", "Lambda"}), names());
+    EXPECT_EQ("Missing '}'", m_file.entries()[0].diagnostics.front().message);
+    EXPECT_TRUE(m_file.entries()[1].diagnostics.empty());
+}
+
+TEST_F(TestFormulaFile, editReparsesOnlyItsEntry)
+{
+    parse(THREE_ENTRIES);
+    const formula::Entry *lambda = &m_file.entries()[2];
+
+    const formula::FormulaFile::Range range = replace(m_text.find("p1,"), 2, "sin(p1)");
+
+    EXPECT_EQ(1U, range.first);
+    EXPECT_EQ(1U, range.count);
+    EXPECT_EQ(1U, range.replaced);
+    EXPECT_EQ(lambda, &m_file.entries()[2]);
+    EXPECT_EQ(m_text.find("Lambda"), m_file.entries()[2].begin);
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, commentBetweenEntriesOnlyMovesThem)
+{
+    parse(THREE_ENTRIES);
+
+    const formula::FormulaFile::Range range = replace(m_text.find("\n\nJulia") + 1, 0, "; Julia sets\n");
+
+    EXPECT_EQ(1U, range.first);
+    EXPECT_EQ(0U, range.count);
+    EXPECT_EQ(0U, range.replaced);
+    EXPECT_EQ(m_text.find("Julia {"), m_file.entries()[1].begin);
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, insertEntry)
+{
+    parse(THREE_ENTRIES);
+
+    const formula::FormulaFile::Range range = replace(m_text.find("Lambda"), 0, "Newton { z = z - 1, 1 }\n");
+
+    EXPECT_EQ(2U, range.first);
+    EXPECT_EQ(2U, range.count);
+    EXPECT_EQ(1U, range.replaced);
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Julia", "Newton", "Lambda"}), names());
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, deleteClosingBrace)
+{
+    parse(THREE_ENTRIES);
+
+    const formula::FormulaFile::Range range = replace(m_text.find("}\nLambda"), 1, "");
+
+    EXPECT_EQ(1U, range.first);
+    EXPECT_EQ(1U, range.count);
+    EXPECT_EQ(1U, range.replaced);
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Julia", "Lambda"}), names());
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, mergeEntries)
+{
+    parse(THREE_ENTRIES);
+    const std::size_t begin = m_text.find("  |z| <= 4\n}");
+
+    replace(begin, m_text.find("Julia {\n") + 8 - begin, "");
+
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Lambda"}), names());
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, deleteEverything)
+{
+    parse(THREE_ENTRIES);
+
+    replace(0, m_text.size(), "");
+
+    EXPECT_TRUE(m_file.entries().empty());
+}
+
+TEST_F(TestFormulaFile, updateReadsOnlyFromTheReparseStart)
+{
+    parse(THREE_ENTRIES);
+    const std::size_t position = m_text.find("p1,");
+    m_text.replace(position, 2, "sin(p1)");
+    const std::size_t start = m_file.reparse_start(position);
+
+    const formula::FormulaFile::Range range =
+        m_file.update(std::string_view{m_text}.substr(start), start, position, 2, 7);
+
+    EXPECT_EQ(m_text.find("}\n\nJulia") + 1, start);
+    EXPECT_EQ(1U, range.first);
+    EXPECT_EQ(1U, range.count);
+    expect_full_parse();
+}
+
+TEST_F(TestFormulaFile, mergedEditsReparseTogether)
+{
+    parse(THREE_ENTRIES);
+    const std::size_t first = m_text.find("Julia");
+    m_text.replace(first, 5, "Fatou");
+    const std::size_t second = m_text.find("Lambda");
+    m_text.insert(second, "Newton { z = z - 1, 1 }\n");
+
+    const formula::TextChange edit = formula::merge_changes({first, 5, 5}, {second, 0, 24});
+    m_file.update(m_text, edit.position, edit.removed, edit.inserted);
+
+    EXPECT_EQ((std::vector<std::string>{"Mandel", "Fatou", "Newton", "Lambda"}), names());
+    expect_full_parse();
+}
@@ -0,0 +1,207 @@
+#include <formula/evaluator.h>
+#include <formula/parser.h>
+#include <formula/thread_pool.h>
+#include <formula/tile_renderer.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+constexpr const char *MANDELBROT{"Mandelbrot {\n"
+                                 "  z = 0, c = pixel:\n"
+                                 "  z = sqr(z) + c\n"
+                                 "  |z| <= 4\n"
+                                 "}\n"};
+
+class TestTileRenderer : public Test
+{
+protected:
+    TestTileRenderer() :
+        m_text(MANDELBROT),
+        m_program(formula::compile(formula::parse_entry(m_text, 0), m_text))
+    {
+        m_viewport.center = {-0.5, 0.0};
+        m_viewport.width = 3.0;
+        m_viewport.pixels_wide = 100;
+        m_viewport.pixels_high = 70;
+    }
+
+    int expected(int x, int y)
+    {
+        const std::complex<double> point = m_viewport.point(x, y);
+        const double re = point.real();
+        const double im = point.imag();
+        int count{};
+        formula::BatchEvaluator(m_program).evaluate(&re, &im, 1, MAX_ITERATIONS, &count);
+        return count;
+    }
+
+    static constexpr int MAX_ITERATIONS{64};
+
+    std::string m_text;
+    formula::Program m_program;
+    formula::Viewport m_viewport;
+    formula::ThreadPool m_pool{4};
+    formula::TileRenderer m_renderer{m_pool};
+    std::vector<int> m_iterations;
+    std::atomic<bool> m_cancel{};
+};
+
+} // namespace
+
+TEST(TestThreadPool, runsEveryTaskOnce)
+{
+    formula::ThreadPool pool(3);
+    std::vector<std::atomic<int>> runs(1000);
+    std::atomic<bool> bad_worker{};
+
+    for (int repeat = 0; repeat < 3; ++repeat)
+    {
+        pool.run(runs.size(),
+            [&](std::size_t index, unsigned worker)
+            {
+                ++runs[index];
+                bad_worker = bad_worker || worker >= 3;
+            });
+    }
+
+    EXPECT_EQ(3U, pool.size());
+    EXPECT_TRUE(std::all_of(runs.begin(), runs.end(), [](const std::atomic<int> &count) { return count == 3; }));
+    EXPECT_FALSE(bad_worker);
+}
+
+TEST(TestThreadPool, idleWorkerStealsFromBusyOne)
+{
+    formula::ThreadPool pool(2);
+    constexpr std::size_t COUNT{20};
+    std::vector<unsigned> workers(COUNT);
+
+    pool.run(COUNT,
+        [&](std::size_t index, unsigned worker)
+        {
+            workers[index] = worker;
+            if (index == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        });
+
+    // The first half is dealt to worker 0, which is held up by its first task.
+    EXPECT_TRUE(
+        std::any_of(workers.begin() + 1, workers.begin() + COUNT / 2, [](unsigned worker) { return worker == 1; }));
+}
+
+TEST(TestThreadPool, emptyRunReturns)
+{
+    formula::ThreadPool pool(2);
+    bool ran{};
+
+    pool.run(0, [&](std::size_t, unsigned) { ran = true; });
+
+    EXPECT_FALSE(ran);
+}
+
+TEST(TestViewport, pointsAreCenteredOnPixels)
+{
+    formula::Viewport viewport;
+    viewport.center = {1.0, 1.0};
+    viewport.width = 4.0;
+    viewport.pixels_wide = 4;
+    viewport.pixels_high = 2;
+
+    EXPECT_EQ(std::complex<double>(-0.5, 1.5), viewport.point(0, 0));
+    EXPECT_EQ(std::complex<double>(2.5, 0.5), viewport.point(3, 1));
+}
+
+TEST_F(TestTileRenderer, finalPassEvaluatesEveryPixel)
+{
+    std::vector<int> steps;
+
+    const bool finished = m_renderer.render(
+        m_program, m_viewport, MAX_ITERATIONS, m_iterations, m_cancel, [&](int step) { steps.push_back(step); });
+
+    ASSERT_TRUE(finished);
+    EXPECT_EQ((std::vector<int>{8, 4, 2, 1}), steps);
+    ASSERT_EQ(100U * 70U, m_iterations.size());
+    for (int y = 0; y < m_viewport.pixels_high; ++y)
+    {
+        for (int x = 0; x < m_viewport.pixels_wide; ++x)
+        {
+            ASSERT_EQ(expected(x, y), m_iterations[y * m_viewport.pixels_wide + x]) << x << ',' << y;
+        }
+    }
+    EXPECT_EQ(4U * 2U * 2U, m_renderer.tiles_rendered());
+}
+
+TEST_F(TestTileRenderer, coarsePassFillsBlocksFromTheirCorner)
+{
+    std::vector<int> coarse;
+
+    m_renderer.render(m_program, m_viewport, MAX_ITERATIONS, m_iterations, m_cancel,
+        [&](int step)
+        {
+            if (step == formula::TileRenderer::COARSEST_STEP)
+            {
+                coarse = m_iterations;
+            }
+        });
+
+    ASSERT_EQ(m_iterations.size(), coarse.size());
+    for (int y = 0; y < m_viewport.pixels_high; y += 5)
+    {
+        for (int x = 0; x < m_viewport.pixels_wide; x += 3)
+        {
+            ASSERT_EQ(expected(x / 8 * 8, y / 8 * 8), coarse[y * m_viewport.pixels_wide + x]) << x << ',' << y;
+        }
+    }
+}
+
+TEST_F(TestTileRenderer, cancelStopsBeforeTheNextPass)
+{
+    std::vector<int> steps;
+
+    const bool finished = m_renderer.render(m_program, m_viewport, MAX_ITERATIONS, m_iterations, m_cancel,
+        [&](int step)
+        {
+            steps.push_back(step);
+            m_cancel = true;
+        });
+
+    EXPECT_FALSE(finished);
+    EXPECT_EQ(std::vector<int>{8}, steps);
+}
+
+TEST_F(TestTileRenderer, cancelledRenderDoesNoTiles)
+{
+    m_cancel = true;
+    bool passed{};
+
+    EXPECT_FALSE(
+        m_renderer.render(m_program, m_viewport, MAX_ITERATIONS, m_iterations, m_cancel, [&](int) { passed = true; }));
+    EXPECT_FALSE(passed);
+    EXPECT_EQ(0U, m_renderer.tiles_rendered());
+}
+
+TEST_F(TestTileRenderer, parametersReachTheFormula)
+{
+    const std::string text{"Julia {\n  z = pixel:\n  z = z*z + p1\n  |z| <= 4\n}\n"};
+    const formula::Program julia = formula::compile(formula::parse_entry(text, 0), text);
+    m_viewport.pixels_wide = 1;
+    m_viewport.pixels_high = 1;
+    m_viewport.center = 0.0;
+
+    m_renderer.set_parameter(1, 2.0);
+    m_renderer.render(julia, m_viewport, MAX_ITERATIONS, m_iterations, m_cancel);
+
+    EXPECT_EQ(2, m_iterations[0]);
+}
@@ -0,0 +1,163 @@
+#include <formula/render.h>
+#include <formula/runs.h>
+#include <formula/syntax.h>
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+std::vector<formula::StyleRun> runs_of(const formula::StyleRunArena &arena)
+{
+    std::vector<formula::StyleRun> result;
+    for (std::size_t i = 0; i < arena.size(); ++i)
+    {
+        result.push_back(arena[i]);
+    }
+    return result;
+}
+
+// Expands runs to a style per character, merging runs split by the stream window.
+class StyleBytesWriter : public formula::StyleRunWriter
+{
+public:
+    void write(const formula::StyleRun &run, const char *text) override
+    {
+        EXPECT_EQ(styles.size(), run.start);
+        styles.append(run.length, static_cast<char>(+run.style));
+        chars.append(text, run.length);
+    }
+
+    std::string styles;
+    std::string chars;
+};
+
+} // namespace
+
+namespace formula
+{
+
+bool operator==(const StyleRun &lhs, const StyleRun &rhs)
+{
+    return lhs.start == rhs.start && lhs.length == rhs.length && lhs.style == rhs.style;
+}
+
+std::ostream &operator<<(std::ostream &str, const StyleRun &run)
+{
+    return str << '(' << run.start << ", " << run.length << ", " << +run.style << ')';
+}
+
+} // namespace formula
+
+TEST(TestStyleRuns, emptyTextHasNoRuns)
+{
+    formula::StyleRunArena runs;
+
+    formula::lex_runs("", 0, runs);
+
+    EXPECT_TRUE(runs.empty());
+}
+
+TEST(TestStyleRuns, keywordFunctionIdentifier)
+{
+    const std::string text{"if sin(z) ; test\n"};
+    formula::StyleRunArena runs;
+
+    formula::lex_runs(text.data(), text.size(), runs);
+
+    const std::vector<formula::StyleRun> expected{
+        {0, 2, formula::Syntax::KEYWORD},
+        {2, 1, formula::Syntax::WHITESPACE},
+        {3, 3, formula::Syntax::FUNCTION},
+        {6, 1, formula::Syntax::NONE},
+        {7, 1, formula::Syntax::IDENTIFIER},
+        {8, 1, formula::Syntax::NONE},
+        {9, 1, formula::Syntax::WHITESPACE},
+        {10, 7, formula::Syntax::COMMENT},
+    };
+    EXPECT_EQ(expected, runs_of(runs));
+}
+
+TEST(TestStyleRuns, adjacentRunsOfOneStyleAreMerged)
+{
+    const std::string text{"(()) ((\n"};
+    formula::StyleRunArena runs;
+
+    formula::lex_runs(text.data(), text.size(), runs);
+
+    const std::vector<formula::StyleRun> expected{
+        {0, 4, formula::Syntax::NONE},
+        {4, 1, formula::Syntax::WHITESPACE},
+        {5, 3, formula::Syntax::NONE},
+    };
+    EXPECT_EQ(expected, runs_of(runs));
+}
+
+TEST(TestStyleRuns, arenaGrowsPastOneBlock)
+{
+    std::string text;
+    for (int i = 0; i < 10000; ++i)
+    {
+        text += "z ";
+    }
+    formula::StyleRunArena runs;
+
+    formula::lex_runs(text.data(), text.size(), runs);
+
+    ASSERT_EQ(20000U, runs.size());
+    EXPECT_EQ(formula::Syntax::IDENTIFIER, runs[19998].style);
+    EXPECT_EQ(19998U, runs[19999].start - 1);
+}
+
+TEST(TestStyleRuns, streamMatchesMemory)
+{
+    std::string text;
+    while (text.size() < 300000)
+    {
+        text += "fractal(XAXIS) {\n"
+                "  z = pixel, c = fn1(p1) ; init\n"
+                "  :\n"
+                "  if (cabs(z) > 4) z = sqr(z) + c else z = conj(z) endif\n"
+                "  |z| <= " + std::string(text.size() % 97, 'q') + "\n"
+                "}\n";
+    }
+    StyleBytesWriter memory;
+    formula::lex_runs(text.data(), text.size(), memory);
+    std::istringstream in{text};
+    StyleBytesWriter stream;
+
+    const std::size_t length = formula::lex_runs(in, stream);
+
+    EXPECT_EQ(text.size(), length);
+    EXPECT_EQ(text, stream.chars);
+    EXPECT_EQ(memory.styles, stream.styles);
+}
+
+TEST(TestRender, htmlEscapesAndStyles)
+{
+    std::istringstream in{"if z<4&1 ; x"};
+    std::ostringstream out;
+
+    formula::render_html(in, out);
+
+    EXPECT_NE(std::string::npos,
+        out.str().find("<span class=\"keyword\">if</span> <span class=\"identifier\">z</span>&lt;"
+                       "<span class=\"identifier\">4</span>&amp;<span class=\"identifier\">1</span> "
+                       "<span class=\"comment\">; x</span>"));
+}
+
+TEST(TestRender, ansiResetsAtEnd)
+{
+    std::istringstream in{"sin"};
+    std::ostringstream out;
+
+    formula::render_ansi(in, out);
+
+    EXPECT_EQ("\x1b[31msin\x1b[0m", out.str());
+}
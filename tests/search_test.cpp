@@ -0,0 +1,125 @@
+#include <formula/runs.h>
+#include <formula/search.h>
+#include <formula/syntax.h>
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace testing;
+
+namespace
+{
+
+class StyleBytesWriter : public formula::StyleRunWriter
+{
+public:
+    void write(const formula::StyleRun &run, const char * /*text*/) override
+    {
+        styles.append(run.length, static_cast<char>(+run.style));
+    }
+
+    std::string styles;
+};
+
+class TestStyledSearch : public Test
+{
+protected:
+    void set_text(std::string text)
+    {
+        m_text = std::move(text);
+        StyleBytesWriter writer;
+        formula::lex_runs(m_text.data(), m_text.size(), writer);
+        m_styles = std::move(writer.styles);
+    }
+
+    std::size_t find(const char *needle, formula::SearchOptions options, std::size_t from = 0) const
+    {
+        return formula::StyledSearch{needle, options}.find(m_text, m_styles.data(), from);
+    }
+
+    std::size_t count(const char *needle, formula::SearchOptions options) const
+    {
+        return formula::StyledSearch{needle, options}.count(m_text, m_styles.data(), 0, m_text.size());
+    }
+
+    std::string m_text;
+    std::string m_styles;
+};
+
+} // namespace
+
+TEST_F(TestStyledSearch, everythingFindsFirstMatch)
+{
+    set_text("z = sin(z) ; sin\n");
+
+    EXPECT_EQ(4U, find("sin", {}));
+    EXPECT_EQ(13U, find("sin", {}, 5));
+    EXPECT_EQ(formula::StyledSearch::npos, find("cos", {}));
+}
+
+TEST_F(TestStyledSearch, ignoresCaseUnlessAsked)
+{
+    set_text("z = SIN(z)\n");
+
+    EXPECT_EQ(4U, find("sin", {}));
+    EXPECT_EQ(formula::StyledSearch::npos, find("sin", {formula::SearchScope::EVERYTHING, true}));
+    EXPECT_EQ(4U, find("SIN", {formula::SearchScope::EVERYTHING, true}));
+}
+
+TEST_F(TestStyledSearch, identifiersSkipFunctionsAndComments)
+{
+    set_text("abc = abs(x) ; abc\nx = abc\n");
+
+    EXPECT_EQ(0U, find("abc", {formula::SearchScope::IDENTIFIERS}));
+    EXPECT_EQ(23U, find("abc", {formula::SearchScope::IDENTIFIERS}, 1));
+    EXPECT_EQ(formula::StyledSearch::npos, find("abs", {formula::SearchScope::IDENTIFIERS}));
+}
+
+TEST_F(TestStyledSearch, functionsOnly)
+{
+    set_text("sine = 1 ; sin\nz = sin(sine)\n");
+
+    EXPECT_EQ(19U, find("sin", {formula::SearchScope::FUNCTIONS}));
+    EXPECT_EQ(1U, count("sin", {formula::SearchScope::FUNCTIONS}));
+}
+
+TEST_F(TestStyledSearch, skipCommentsSearchesCode)
+{
+    set_text("; sin in a comment\nz = sin(z)\n");
+
+    EXPECT_EQ(23U, find("sin", {formula::SearchScope::SKIP_COMMENTS}));
+    EXPECT_EQ(formula::StyledSearch::npos, find("comment", {formula::SearchScope::SKIP_COMMENTS}));
+}
+
+TEST_F(TestStyledSearch, matchMustLieInOneAllowedRun)
+{
+    // "z = s" spans identifier, whitespace and operator styles.
+    set_text("z = s\n");
+
+    EXPECT_EQ(0U, find("z = s", {}));
+    EXPECT_EQ(formula::StyledSearch::npos, find("z = s", {formula::SearchScope::IDENTIFIERS}));
+}
+
+TEST_F(TestStyledSearch, wholeWord)
+{
+    set_text("zz = z + z2 + z\n");
+
+    EXPECT_EQ(5U, find("z", {formula::SearchScope::EVERYTHING, false, true}));
+    EXPECT_EQ(2U, count("z", {formula::SearchScope::EVERYTHING, false, true}));
+}
+
+TEST_F(TestStyledSearch, countsNonOverlappingMatchesAcrossVectorBlocks)
+{
+    std::string text;
+    for (int i = 0; i < 50; ++i)
+    {
+        text += "aaa = aaaa ; aa\n";
+    }
+    set_text(text);
+
+    EXPECT_EQ(150U, count("aa", {formula::SearchScope::IDENTIFIERS}));
+    EXPECT_EQ(50U, count("aa", {formula::SearchScope::EVERYTHING, false, true}));
+    EXPECT_EQ(150U, count("aa", {formula::SearchScope::SKIP_COMMENTS}));
+    EXPECT_EQ(200U, count("aa", {}));
+}
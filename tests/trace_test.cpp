@@ -0,0 +1,134 @@
+#include <formula/trace.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+
+using Clock = formula::TraceLog::Clock;
+
+void record_numbered(formula::TraceLog &log, int count)
+{
+    const Clock::time_point now = Clock::now();
+    for (int i = 0; i < count; ++i)
+    {
+        log.record("Event", "test", now, now, "index", i);
+    }
+}
+
+} // namespace
+
+TEST(TestTraceLog, disabledLogRecordsNothing)
+{
+    formula::TraceLog log;
+
+    record_numbered(log, 10);
+    {
+        formula::TraceScope scope(&log, "Scope", "test");
+    }
+
+    EXPECT_TRUE(log.events().empty());
+}
+
+TEST(TestTraceLog, scopeRecordsItsDurationAndArguments)
+{
+    formula::TraceLog log;
+    log.set_enabled(true);
+
+    {
+        formula::TraceScope scope(&log, "Lex", "lexer", "start", 10, "length", 20);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const std::vector<formula::TraceEvent> events = log.events();
+    ASSERT_EQ(1U, events.size());
+    EXPECT_STREQ("Lex", events[0].name);
+    EXPECT_STREQ("lexer", events[0].category);
+    EXPECT_GE(events[0].duration, 1000000);
+    EXPECT_STREQ("start", events[0].arg_names[0]);
+    EXPECT_EQ(10, events[0].arg_values[0]);
+    EXPECT_STREQ("length", events[0].arg_names[1]);
+    EXPECT_EQ(20, events[0].arg_values[1]);
+}
+
+TEST(TestTraceLog, fullBufferKeepsTheNewestEvents)
+{
+    formula::TraceLog log(4);
+    log.set_enabled(true);
+
+    record_numbered(log, 10);
+
+    const std::vector<formula::TraceEvent> events = log.events();
+    ASSERT_EQ(4U, events.size());
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(6 + i, events[i].arg_values[0]);
+    }
+}
+
+TEST(TestTraceLog, eachThreadRecordsUnderItsOwnId)
+{
+    formula::TraceLog log;
+    log.set_enabled(true);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i)
+    {
+        threads.emplace_back([&log] { record_numbered(log, 100); });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    const std::vector<formula::TraceEvent> events = log.events();
+    ASSERT_EQ(400U, events.size());
+    std::set<unsigned> ids;
+    for (const formula::TraceEvent &event : events)
+    {
+        ids.insert(event.thread);
+    }
+    EXPECT_EQ(4U, ids.size());
+}
+
+TEST(TestTraceLog, logsCreatedInTurnDontShareBuffers)
+{
+    {
+        formula::TraceLog first;
+        first.set_enabled(true);
+        record_numbered(first, 3);
+    }
+    formula::TraceLog second;
+    second.set_enabled(true);
+
+    record_numbered(second, 2);
+
+    EXPECT_EQ(2U, second.events().size());
+}
+
+TEST(TestTraceLog, writesChromeTraceJson)
+{
+    formula::TraceLog log;
+    log.set_enabled(true);
+    const Clock::time_point begin = Clock::now();
+    log.record("Fold \"all\"", "lexer", begin, begin + std::chrono::microseconds(1500), "length", 42);
+    log.record("Paint", "editor", begin, begin);
+    std::ostringstream out;
+
+    log.write_chrome_trace(out);
+
+    const std::string json = out.str();
+    EXPECT_EQ(0U, json.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"Fold \\\"all\\\"\",\"cat\":\"lexer\",\"ph\":\"X\",\"pid\":1"));
+    EXPECT_NE(std::string::npos, json.find("\"dur\":1500.000,\"args\":{\"length\":42}"));
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"Paint\""));
+}
@@ -0,0 +1,88 @@
+#include <formula/codegen.h>
+#include <formula/parser.h>
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+namespace
+{
+
+int usage()
+{
+    std::cerr << "Usage: formula-compile [--fn<1-4> <function>]... input entry [output]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    formula::CompileOptions options;
+    int arg = 1;
+    for (; arg + 1 < argc && std::string{argv[arg]}.compare(0, 4, "--fn") == 0; arg += 2)
+    {
+        const std::string flag{argv[arg]};
+        if (flag.size() != 5 || flag[4] < '1' || flag[4] > '4')
+        {
+            return usage();
+        }
+        options.functions[flag[4] - '1'] = argv[arg + 1];
+    }
+    if (argc - arg < 2 || argc - arg > 3)
+    {
+        return usage();
+    }
+
+    std::ifstream input(argv[arg], std::ios::binary);
+    if (!input)
+    {
+        std::cerr << "Couldn't open " << argv[arg] << '\n';
+        return 1;
+    }
+    const std::string text{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    const std::string name{argv[arg + 1]};
+    std::string source;
+    try
+    {
+        std::size_t position = formula::next_entry(text, 0);
+        while (position < text.size())
+        {
+            const formula::Entry entry = formula::parse_entry(text, position);
+            if (entry.name == name)
+            {
+                source = formula::generate_cpp(formula::compile(entry, text, options), name, options);
+                break;
+            }
+            position = formula::next_entry(text, entry.end);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << argv[arg] << ": " << name << ": " << e.what() << '\n';
+        return 1;
+    }
+    if (source.empty())
+    {
+        std::cerr << argv[arg] << ": no formula named " << name << '\n';
+        return 1;
+    }
+
+    std::ofstream file;
+    std::ostream *out = &std::cout;
+    if (argc - arg > 2)
+    {
+        file.open(argv[arg + 2], std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Couldn't create " << argv[arg + 2] << '\n';
+            return 1;
+        }
+        out = &file;
+    }
+    *out << source;
+    out->flush();
+    return out->good() ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "container_document.h"
+
+#include <wx/stc/stc.h>
+
+#include <cstring>
+
+ContainerDocument::ContainerDocument(wxStyledTextCtrl *stc) :
+    m_stc(stc)
+{
+}
+
+int ContainerDocument::Version() const
+{
+    return dvOriginal;
+}
+
+void ContainerDocument::SetErrorStatus(int status)
+{
+    m_stc->SetStatus(status);
+}
+
+Sci_Position ContainerDocument::Length() const
+{
+    return m_stc->GetLength();
+}
+
+void ContainerDocument::GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const
+{
+    std::memcpy(buffer, m_stc->GetRangePointer(position, length), length);
+}
+
+char ContainerDocument::StyleAt(Sci_Position position) const
+{
+    return static_cast<char>(m_stc->GetStyleAt(position));
+}
+
+Sci_Position ContainerDocument::LineFromPosition(Sci_Position position) const
+{
+    return m_stc->LineFromPosition(position);
+}
+
+Sci_Position ContainerDocument::LineStart(Sci_Position line) const
+{
+    // Scintilla answers -1 past the end; documents answer the length.
+    if (line >= m_stc->GetLineCount())
+    {
+        return m_stc->GetLength();
+    }
+    return m_stc->PositionFromLine(line);
+}
+
+int ContainerDocument::GetLevel(Sci_Position line) const
+{
+    return m_stc->GetFoldLevel(line);
+}
+
+int ContainerDocument::SetLevel(Sci_Position line, int level)
+{
+    const int previous = m_stc->GetFoldLevel(line);
+    if (previous != level)
+    {
+        m_stc->SetFoldLevel(line, level);
+    }
+    return previous;
+}
+
+int ContainerDocument::GetLineState(Sci_Position line) const
+{
+    return m_stc->GetLineState(line);
+}
+
+int ContainerDocument::SetLineState(Sci_Position line, int state)
+{
+    const int previous = m_stc->GetLineState(line);
+    if (previous != state)
+    {
+        m_stc->SetLineState(line, state);
+    }
+    return previous;
+}
+
+void ContainerDocument::StartStyling(Sci_Position position, char /*mask*/)
+{
+    m_stc->StartStyling(position);
+}
+
+bool ContainerDocument::SetStyleFor(Sci_Position length, char style)
+{
+    m_stc->SetStyling(length, static_cast<unsigned char>(style));
+    return true;
+}
+
+bool ContainerDocument::SetStyles(Sci_Position length, const char *styles)
+{
+    m_stc->SetStyleBytes(length, const_cast<char *>(styles));
+    return true;
+}
+
+void ContainerDocument::DecorationSetCurrentIndicator(int indicator)
+{
+    m_stc->SetIndicatorCurrent(indicator);
+}
+
+void ContainerDocument::DecorationFillRange(Sci_Position position, int value, Sci_Position length)
+{
+    if (value == 0)
+    {
+        m_stc->IndicatorClearRange(position, length);
+        return;
+    }
+    m_stc->SetIndicatorValue(value);
+    m_stc->IndicatorFillRange(position, length);
+}
+
+void ContainerDocument::ChangeLexerState(Sci_Position start, Sci_Position end)
+{
+    m_stc->ChangeLexerState(start, end);
+}
+
+int ContainerDocument::CodePage() const
+{
+    return m_stc->GetCodePage();
+}
+
+bool ContainerDocument::IsDBCSLeadByte(char /*ch*/) const
+{
+    // The formula lexer only handles single byte and UTF-8 text.
+    return false;
+}
+
+const char *ContainerDocument::BufferPointer()
+{
+    return m_stc->GetCharacterPointer();
+}
+
+int ContainerDocument::GetLineIndentation(Sci_Position line)
+{
+    return m_stc->GetLineIndentation(line);
+}
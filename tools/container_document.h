@@ -0,0 +1,45 @@
+#pragma once
+
+#include <ILexer.h>
+
+class wxStyledTextCtrl;
+
+// Presents a wxStyledTextCtrl as the IDocument a lexer expects, so a lexer
+// created in-process can style the control as a container lexer.
+class ContainerDocument : public IDocument
+{
+public:
+    explicit ContainerDocument(wxStyledTextCtrl *stc);
+    virtual ~ContainerDocument() = default;
+
+    // Another view of the same document.
+    void set_view(wxStyledTextCtrl *stc)
+    {
+        m_stc = stc;
+    }
+
+    int SCI_METHOD Version() const override;
+    void SCI_METHOD SetErrorStatus(int status) override;
+    Sci_Position SCI_METHOD Length() const override;
+    void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position length) const override;
+    char SCI_METHOD StyleAt(Sci_Position position) const override;
+    Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override;
+    Sci_Position SCI_METHOD LineStart(Sci_Position line) const override;
+    int SCI_METHOD GetLevel(Sci_Position line) const override;
+    int SCI_METHOD SetLevel(Sci_Position line, int level) override;
+    int SCI_METHOD GetLineState(Sci_Position line) const override;
+    int SCI_METHOD SetLineState(Sci_Position line, int state) override;
+    void SCI_METHOD StartStyling(Sci_Position position, char mask) override;
+    bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override;
+    bool SCI_METHOD SetStyles(Sci_Position length, const char *styles) override;
+    void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
+    void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position length) override;
+    void SCI_METHOD ChangeLexerState(Sci_Position start, Sci_Position end) override;
+    int SCI_METHOD CodePage() const override;
+    bool SCI_METHOD IsDBCSLeadByte(char ch) const override;
+    const char *SCI_METHOD BufferPointer() override;
+    int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+
+private:
+    wxStyledTextCtrl *m_stc;
+};
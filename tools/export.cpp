@@ -0,0 +1,66 @@
+#include <formula/render.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+
+int usage()
+{
+    std::cerr << "Usage: formula-export --html|--ansi [input [output]]\n";
+    return 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        return usage();
+    }
+    const std::string format{argv[1]};
+    if (format != "--html" && format != "--ansi")
+    {
+        return usage();
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::istream *in = &std::cin;
+    std::ostream *out = &std::cout;
+    std::ifstream input;
+    std::ofstream output;
+    if (argc > 2)
+    {
+        input.open(argv[2], std::ios::binary);
+        if (!input)
+        {
+            std::cerr << "Couldn't open " << argv[2] << '\n';
+            return 1;
+        }
+        in = &input;
+    }
+    if (argc > 3)
+    {
+        output.open(argv[3], std::ios::binary);
+        if (!output)
+        {
+            std::cerr << "Couldn't create " << argv[3] << '\n';
+            return 1;
+        }
+        out = &output;
+    }
+
+    if (format == "--html")
+    {
+        formula::render_html(*in, *out);
+    }
+    else
+    {
+        formula::render_ansi(*in, *out);
+    }
+    out->flush();
+    return out->good() ? 0 : 1;
+}
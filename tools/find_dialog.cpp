@@ -0,0 +1,433 @@
+#include "find_dialog.h"
+
+#include <wx/stc/stc.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+
+// The document is read, and its matches counted, in chunks of this many bytes.
+constexpr std::size_t COUNT_CHUNK{256 * 1024};
+
+// Chunks handed to the worker at a time, so the next is ready when it finishes one.
+constexpr std::size_t MAX_OUTSTANDING{2};
+
+// In the order of the scope choice.
+constexpr formula::SearchScope SCOPES[]{
+    formula::SearchScope::EVERYTHING,
+    formula::SearchScope::IDENTIFIERS,
+    formula::SearchScope::SKIP_COMMENTS,
+    formula::SearchScope::FUNCTIONS,
+};
+
+} // namespace
+
+FindDialog::FindDialog(wxWindow *parent, wxStyledTextCtrl *stc, StyleText style_text) :
+    wxDialog(parent, wxID_ANY, "Find and Replace"),
+    m_stc(stc),
+    m_style_text(std::move(style_text))
+{
+    m_find = new wxTextCtrl(this, wxID_ANY);
+    m_replace = new wxTextCtrl(this, wxID_ANY);
+    const wxString scopes[]{"Everything", "Identifiers only", "Skip comments", "Functions only"};
+    m_scope = new wxChoice(this, wxID_ANY, wxDefaultPosition, wxDefaultSize, WXSIZEOF(scopes), scopes);
+    m_scope->SetSelection(0);
+    m_match_case = new wxCheckBox(this, wxID_ANY, "Match &case");
+    m_whole_word = new wxCheckBox(this, wxID_ANY, "&Whole word");
+    m_status = new wxStaticText(this, wxID_ANY, wxEmptyString);
+
+    wxFlexGridSizer *fields = new wxFlexGridSizer(2, wxSize(8, 8));
+    fields->AddGrowableCol(1);
+    fields->Add(new wxStaticText(this, wxID_ANY, "Fi&nd:"), wxSizerFlags().CenterVertical());
+    fields->Add(m_find, wxSizerFlags().Expand());
+    fields->Add(new wxStaticText(this, wxID_ANY, "Re&place:"), wxSizerFlags().CenterVertical());
+    fields->Add(m_replace, wxSizerFlags().Expand());
+    fields->Add(new wxStaticText(this, wxID_ANY, "&Search in:"), wxSizerFlags().CenterVertical());
+    fields->Add(m_scope, wxSizerFlags().Expand());
+    wxBoxSizer *left = new wxBoxSizer(wxVERTICAL);
+    left->Add(fields, wxSizerFlags().Expand());
+    left->Add(m_match_case, wxSizerFlags().Border(wxTOP));
+    left->Add(m_whole_word, wxSizerFlags().Border(wxTOP));
+    left->AddStretchSpacer();
+    left->Add(m_status, wxSizerFlags().Expand().Border(wxTOP));
+
+    wxButton *find_next = new wxButton(this, wxID_ANY, "&Find Next");
+    find_next->SetDefault();
+    wxButton *replace = new wxButton(this, wxID_ANY, "&Replace");
+    wxButton *replace_all = new wxButton(this, wxID_ANY, "Replace &All");
+    wxBoxSizer *buttons = new wxBoxSizer(wxVERTICAL);
+    buttons->Add(find_next, wxSizerFlags().Expand());
+    buttons->Add(replace, wxSizerFlags().Expand().Border(wxTOP));
+    buttons->Add(replace_all, wxSizerFlags().Expand().Border(wxTOP));
+    buttons->Add(new wxButton(this, wxID_CANCEL, "Close"), wxSizerFlags().Expand().Border(wxTOP));
+
+    wxBoxSizer *top = new wxBoxSizer(wxHORIZONTAL);
+    top->Add(left, wxSizerFlags(1).Expand().Border());
+    top->Add(buttons, wxSizerFlags().Border());
+    SetSizerAndFit(top);
+    SetEscapeId(wxID_CANCEL);
+
+    m_find->Bind(wxEVT_TEXT, &FindDialog::on_search_changed, this);
+    m_scope->Bind(wxEVT_CHOICE, &FindDialog::on_search_changed, this);
+    m_match_case->Bind(wxEVT_CHECKBOX, &FindDialog::on_search_changed, this);
+    m_whole_word->Bind(wxEVT_CHECKBOX, &FindDialog::on_search_changed, this);
+    find_next->Bind(wxEVT_BUTTON, &FindDialog::on_find_next, this);
+    replace->Bind(wxEVT_BUTTON, &FindDialog::on_replace, this);
+    replace_all->Bind(wxEVT_BUTTON, &FindDialog::on_replace_all, this);
+    Bind(wxEVT_BUTTON, [this](wxCommandEvent &) { Close(); }, wxID_CANCEL);
+    Bind(wxEVT_CLOSE_WINDOW, &FindDialog::on_close, this);
+    m_counter = std::thread([this] { count_work(); });
+}
+
+FindDialog::~FindDialog()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_counter.join();
+}
+
+void FindDialog::set_find_text(const wxString &text)
+{
+    m_find->ChangeValue(text);
+    m_find->SelectAll();
+    restart_count();
+}
+
+void FindDialog::document_modified(std::size_t position, std::size_t removed, std::size_t inserted)
+{
+    if (!m_chunks.empty())
+    {
+        // A match ending in the edit may start up to a match length before it, and the rest
+        // of the edited line may be restyled; the chunks holding any of that are merged into
+        // one to be counted again, and those after it move.
+        const std::size_t line_end = static_cast<std::size_t>(
+            m_stc->GetLineEndPosition(m_stc->LineFromPosition(static_cast<int>(position + inserted))));
+        const std::size_t low = position - std::min(position, m_counted_length > 0 ? m_counted_length - 1 : 0);
+        const std::size_t high = std::max(position + removed, line_end + removed - inserted);
+        const auto containing = [this](std::size_t at)
+        {
+            const auto after = std::upper_bound(m_chunks.begin(), m_chunks.end(), at,
+                [](std::size_t value, const Chunk &chunk) { return value < chunk.start; });
+            return static_cast<std::size_t>(std::max(after - m_chunks.begin(), std::ptrdiff_t{1}) - 1);
+        };
+        const std::size_t first = containing(low);
+        const std::size_t last = containing(high);
+        std::size_t length{};
+        for (std::size_t i = first; i <= last; ++i)
+        {
+            length += m_chunks[i].length;
+        }
+        length = length + inserted - removed;
+        for (std::size_t i = last + 1; i < m_chunks.size(); ++i)
+        {
+            m_chunks[i].start = m_chunks[i].start + inserted - removed;
+        }
+        std::vector<Chunk> pieces;
+        for (std::size_t offset = 0; offset < length; offset += COUNT_CHUNK)
+        {
+            pieces.push_back({m_chunks[first].start + offset, std::min(COUNT_CHUNK, length - offset)});
+        }
+        const auto begin = m_chunks.begin() + static_cast<std::ptrdiff_t>(first);
+        m_chunks.insert(m_chunks.erase(begin, begin + static_cast<std::ptrdiff_t>(last - first + 1)),
+            pieces.begin(), pieces.end());
+    }
+    // Counts of the old text still with the worker are dropped, and their chunks handed over again.
+    ++m_generation;
+    drop_jobs();
+    if (!m_recount_pending && IsShown())
+    {
+        m_recount_pending = true;
+        CallAfter(
+            [this]
+            {
+                m_recount_pending = false;
+                count_chunks();
+            });
+    }
+}
+
+formula::StyledSearch FindDialog::search() const
+{
+    formula::SearchOptions options;
+    options.scope = SCOPES[std::max(m_scope->GetSelection(), 0)];
+    options.match_case = m_match_case->GetValue();
+    options.whole_word = m_whole_word->GetValue();
+    const wxScopedCharBuffer needle = m_find->GetValue().utf8_str();
+    return formula::StyledSearch{std::string_view{needle.data(), needle.length()}, options};
+}
+
+// The text and styles of [start, end), styling whatever the lexer has not reached before end.
+FindDialog::Snapshot FindDialog::take(std::size_t start, std::size_t end)
+{
+    m_style_text(m_stc, static_cast<int>(end));
+    const wxMemoryBuffer styled = m_stc->GetStyledText(static_cast<int>(start), static_cast<int>(end));
+    const char *cells = static_cast<const char *>(styled.GetData());
+    Snapshot snapshot;
+    const std::size_t length = styled.GetDataLen() / 2;
+    snapshot.text.resize(length);
+    snapshot.styles.resize(length);
+    for (std::size_t i = 0; i < length; ++i)
+    {
+        snapshot.text[i] = cells[2 * i];
+        snapshot.styles[i] = cells[2 * i + 1];
+    }
+    return snapshot;
+}
+
+// The first match starting in [from, to), reading the document a chunk at a time, or npos.
+std::size_t FindDialog::find(const formula::StyledSearch &searcher, std::size_t from, std::size_t to)
+{
+    const auto length = static_cast<std::size_t>(m_stc->GetLength());
+    for (std::size_t start = from; start < to; start += COUNT_CHUNK)
+    {
+        // Read far enough past the chunk for a match starting in it.
+        const std::size_t end = std::min(start + COUNT_CHUNK, to);
+        const Snapshot chunk = take(start, std::min(end + searcher.length() - 1, length));
+        const std::size_t found = searcher.find(chunk.text, chunk.styles.data(), 0, end - start);
+        if (found != formula::StyledSearch::npos)
+        {
+            return start + found;
+        }
+    }
+    return formula::StyledSearch::npos;
+}
+
+// Selects the next match after the selection, wrapping around at the end of the document.
+bool FindDialog::find_next()
+{
+    const formula::StyledSearch searcher = search();
+    if (searcher.length() == 0)
+    {
+        return false;
+    }
+    const auto length = static_cast<std::size_t>(m_stc->GetLength());
+    const auto from = std::min(static_cast<std::size_t>(m_stc->GetSelectionEnd()), length);
+    std::size_t found = find(searcher, from, length);
+    if (found == formula::StyledSearch::npos)
+    {
+        found = find(searcher, 0, from);
+    }
+    if (found == formula::StyledSearch::npos)
+    {
+        wxBell();
+        return false;
+    }
+    m_stc->SetSelection(static_cast<int>(found), static_cast<int>(found + searcher.length()));
+    m_stc->EnsureCaretVisible();
+    return true;
+}
+
+// The search changed, so every chunk is counted again.
+void FindDialog::restart_count()
+{
+    ++m_generation;
+    drop_jobs();
+    for (Chunk &chunk : m_chunks)
+    {
+        chunk.counted = false;
+        chunk.queued = false;
+    }
+    count_chunks();
+}
+
+// Hands the worker the chunks still to be counted, as it has room for them, and shows the count.
+void FindDialog::count_chunks()
+{
+    const formula::StyledSearch searcher = search();
+    if (searcher.length() == 0)
+    {
+        m_status->SetLabel(wxEmptyString);
+        return;
+    }
+    m_counted_length = searcher.length();
+    const auto length = static_cast<std::size_t>(m_stc->GetLength());
+    if (m_chunks.empty())
+    {
+        for (std::size_t start = 0; start < length; start += COUNT_CHUNK)
+        {
+            m_chunks.push_back({start, std::min(COUNT_CHUNK, length - start)});
+        }
+    }
+
+    // A chunk is counted from where the last match of the one before it ends, once that is known;
+    // a count from anywhere else stands only if the same matches follow from there.
+    std::size_t count{};
+    bool done{true};
+    std::size_t from{};
+    bool from_known{true};
+    for (std::size_t i = 0; i < m_chunks.size(); ++i)
+    {
+        Chunk &chunk = m_chunks[i];
+        const Tally &tally = chunk.tally;
+        if (chunk.counted && from_known && tally.from != from && (tally.from > from || tally.first < from))
+        {
+            chunk.counted = false;
+        }
+        if (chunk.counted)
+        {
+            count += tally.count;
+            // With no match of its own, a chunk may lie wholly under a match from before it.
+            from = tally.count > 0 ? tally.overhang : from - std::min(from, chunk.length);
+            continue;
+        }
+        done = false;
+        const std::size_t job_from = from_known ? from : 0;
+        from_known = false;
+        if (chunk.queued || m_outstanding >= MAX_OUTSTANDING)
+        {
+            continue;
+        }
+        Snapshot text = take(chunk.start, std::min(chunk.start + chunk.length + searcher.length() - 1, length));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back({m_generation, i, job_from, chunk.length, searcher, std::move(text)});
+        }
+        m_wake.notify_one();
+        chunk.queued = true;
+        ++m_outstanding;
+    }
+    const unsigned long matches = static_cast<unsigned long>(count);
+    m_status->SetLabel(done ? wxString::Format("%lu matches", matches)
+                            : wxString::Format("%lu matches so far...", matches));
+}
+
+// A count from the worker; counts of text or a search that has since changed are dropped.
+void FindDialog::chunk_counted(unsigned generation, std::size_t chunk, const Tally &tally)
+{
+    --m_outstanding;
+    if (generation == m_generation)
+    {
+        m_chunks[chunk].tally = tally;
+        m_chunks[chunk].counted = true;
+        m_chunks[chunk].queued = false;
+    }
+    if (IsShown())
+    {
+        count_chunks();
+    }
+}
+
+// Drops the jobs the worker hasn't started on; the one it is counting is answered as usual.
+void FindDialog::drop_jobs()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_outstanding -= m_jobs.size();
+    m_jobs.clear();
+    for (Chunk &chunk : m_chunks)
+    {
+        chunk.queued = false;
+    }
+}
+
+void FindDialog::count_work()
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+        if (m_stop)
+        {
+            return;
+        }
+        CountJob job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+        lock.unlock();
+
+        const std::string_view text = job.text.text;
+        const char *styles = job.text.styles.data();
+        Tally tally{job.from};
+        std::size_t end = job.from;
+        for (std::size_t found = job.searcher.find(text, styles, job.from, job.length);
+             found != formula::StyledSearch::npos; found = job.searcher.find(text, styles, end, job.length))
+        {
+            if (tally.count++ == 0)
+            {
+                tally.first = found;
+            }
+            end = found + job.searcher.length();
+        }
+        tally.overhang = end - std::min(end, job.length);
+        CallAfter([this, generation = job.generation, chunk = job.chunk, tally]
+            { chunk_counted(generation, chunk, tally); });
+    }
+}
+
+void FindDialog::on_search_changed(wxCommandEvent & /*event*/)
+{
+    restart_count();
+}
+
+void FindDialog::on_find_next(wxCommandEvent & /*event*/)
+{
+    find_next();
+}
+
+// Replaces the selection if it is a match, then moves on to the next one.
+void FindDialog::on_replace(wxCommandEvent & /*event*/)
+{
+    const formula::StyledSearch searcher = search();
+    const int start = m_stc->GetSelectionStart();
+    const auto pos = static_cast<std::size_t>(start);
+    if (searcher.length() != 0 &&
+        static_cast<std::size_t>(m_stc->GetSelectionEnd() - start) == searcher.length() &&
+        find(searcher, pos, pos + 1) == pos)
+    {
+        m_stc->SetTargetRange(start, m_stc->GetSelectionEnd());
+        const int length = m_stc->ReplaceTarget(m_replace->GetValue());
+        m_stc->SetSelection(start, start + length);
+    }
+    find_next();
+}
+
+void FindDialog::on_replace_all(wxCommandEvent & /*event*/)
+{
+    const formula::StyledSearch searcher = search();
+    if (searcher.length() == 0)
+    {
+        return;
+    }
+    // Matches don't overlap, so one running into the next chunk moves on where that is searched from.
+    const auto length = static_cast<std::size_t>(m_stc->GetLength());
+    std::vector<std::size_t> positions;
+    std::size_t next{};
+    for (std::size_t start = 0; start < length; start += COUNT_CHUNK)
+    {
+        const std::size_t end = std::min(start + COUNT_CHUNK, length);
+        if (next >= end)
+        {
+            continue;
+        }
+        const Snapshot chunk = take(start, std::min(end + searcher.length() - 1, length));
+        for (std::size_t found = searcher.find(chunk.text, chunk.styles.data(), std::max(next, start) - start,
+                 end - start);
+             found != formula::StyledSearch::npos;
+             found = searcher.find(chunk.text, chunk.styles.data(), found + searcher.length(), end - start))
+        {
+            positions.push_back(start + found);
+            next = start + found + searcher.length();
+        }
+    }
+
+    // Replace from the end so the earlier positions stay valid.
+    const wxString replacement = m_replace->GetValue();
+    m_stc->BeginUndoAction();
+    for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+    {
+        m_stc->SetTargetRange(static_cast<int>(*it), static_cast<int>(*it + searcher.length()));
+        m_stc->ReplaceTarget(replacement);
+    }
+    m_stc->EndUndoAction();
+    wxLogStatus("Replaced %lu matches", static_cast<unsigned long>(positions.size()));
+}
+
+void FindDialog::on_close(wxCloseEvent & /*event*/)
+{
+    ++m_generation;
+    drop_jobs();
+    Hide();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <formula/search.h>
+
+#include <wx/wx.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class wxStyledTextCtrl;
+
+// A modeless find and replace dialog that can restrict matches to the text of
+// particular styles, such as identifiers or everything but comments.
+//
+// The document is read a chunk at a time, its text together with its style bytes,
+// and styled only as far as the chunk being read.  Matches are counted a chunk at
+// a time on a worker thread, posting progress back to the dialog, so typing in the
+// dialog stays responsive on large files.  Each chunk keeps its count, so an edit
+// has only the chunks it touches counted again.  A match is counted in the chunk
+// it starts in, and matches don't overlap, so a chunk is counted from where the
+// last match of the one before it ends.
+class FindDialog : public wxDialog
+{
+public:
+    // Styles the text of a view up to a position.
+    using StyleText = std::function<void(wxStyledTextCtrl *stc, int end)>;
+
+    FindDialog(wxWindow *parent, wxStyledTextCtrl *stc, StyleText style_text);
+    ~FindDialog() override;
+
+    // Views of the same document may come and go; search in the one last used.
+    void set_view(wxStyledTextCtrl *stc)
+    {
+        m_stc = stc;
+    }
+    void set_find_text(const wxString &text);
+
+    // removed bytes at position were replaced by inserted bytes.  The chunks touched are
+    // counted again once the current event, which may be one of many edits, has been handled.
+    void document_modified(std::size_t position, std::size_t removed, std::size_t inserted);
+
+private:
+    // Document text and its style bytes.
+    struct Snapshot
+    {
+        std::string text;
+        std::string styles;
+    };
+
+    // The matches found in a chunk, counting from offset from in it.
+    struct Tally
+    {
+        std::size_t from{};
+        std::size_t count{};
+        std::size_t first{formula::StyledSearch::npos}; // offset of the first match
+        std::size_t overhang{};                         // how far the last match runs past the chunk
+    };
+
+    // A piece of the document whose matches are counted together.
+    struct Chunk
+    {
+        std::size_t start{};
+        std::size_t length{};
+        Tally tally;
+        bool counted{};
+        bool queued{};
+    };
+
+    // Count the matches starting in [from, length) of text.
+    struct CountJob
+    {
+        unsigned generation;
+        std::size_t chunk;
+        std::size_t from;
+        std::size_t length;
+        formula::StyledSearch searcher;
+        Snapshot text;
+    };
+
+    formula::StyledSearch search() const;
+    Snapshot take(std::size_t start, std::size_t end);
+    std::size_t find(const formula::StyledSearch &searcher, std::size_t from, std::size_t to);
+    bool find_next();
+    void restart_count();
+    void count_chunks();
+    void chunk_counted(unsigned generation, std::size_t chunk, const Tally &tally);
+    void drop_jobs();
+    void count_work();
+    void on_search_changed(wxCommandEvent &event);
+    void on_find_next(wxCommandEvent &event);
+    void on_replace(wxCommandEvent &event);
+    void on_replace_all(wxCommandEvent &event);
+    void on_close(wxCloseEvent &event);
+
+    wxStyledTextCtrl *m_stc;
+    StyleText m_style_text;
+    wxTextCtrl *m_find{};
+    wxTextCtrl *m_replace{};
+    wxChoice *m_scope{};
+    wxCheckBox *m_match_case{};
+    wxCheckBox *m_whole_word{};
+    wxStaticText *m_status{};
+    std::vector<Chunk> m_chunks;     // the whole document, in order, once counting has started
+    std::size_t m_counted_length{}; // of the text the counts are for
+    unsigned m_generation{};
+    std::size_t m_outstanding{}; // jobs handed to the worker and not yet answered
+    bool m_recount_pending{};
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<CountJob> m_jobs;
+    bool m_stop{};
+    std::thread m_counter;
+};
@@ -1,12 +1,38 @@
+#include "find_dialog.h"
+#include "preview_panel.h"
+#include "session_recorder.h"
+
+#include <formula/checker.h>
+#include <formula/lexer.h>
 #include <formula/syntax.h>
+#include <formula/trace.h>
+#include <formula/vocabulary.h>
+
+#ifdef FORMULA_LEXER_STATIC
+#include "container_document.h"
+
+#include <ILexer.h>
+#endif
 
 #include <wx/dynlib.h>
+#include <wx/splitter.h>
 #include <wx/stc/stc.h>
+#include <wx/timer.h>
 #include <wx/wx.h>
 
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 enum class MarginIndex
 {
     LINE_NUMBER = 0,
+    PROBLEM = 1,
     FOLDING = 2,
 };
 inline int operator+(MarginIndex value)
@@ -14,41 +40,181 @@ inline int operator+(MarginIndex value)
     return static_cast<int>(value);
 }
 
+// Indicators set by the editor rather than the lexer.
+enum class EditorIndicator
+{
+    OCCURRENCE = wxSTC_INDIC_CONTAINER,
+    PROBLEM, // the value is one more than the index of the problem
+};
+inline int operator+(EditorIndicator value)
+{
+    return static_cast<int>(value);
+}
+
+enum class EditorMarker
+{
+    PROBLEM = 0,
+};
+inline int operator+(EditorMarker value)
+{
+    return static_cast<int>(value);
+}
+
+// The document is checked once typing has paused for this long.
+constexpr int CHECK_DELAY_MS{300};
+
+// Styling is done at most this much at a time.  Painting asks for no more, so a long line is styled in
+// pieces between other events; operations needing the whole document styled go on until they have it.
+constexpr int STYLE_CHUNK{64 * 1024};
+
 class ScintillaApp : public wxApp
 {
 public:
     virtual bool OnInit();
 };
 
+// What belongs to a document rather than to the frames showing it, shared by every frame opened on it
+// with New Window.
+struct SharedDocument
+{
+    std::vector<wxStyledTextCtrl *> views; // of every frame, in the order they were created
+    // Text skipped when styling jumped ahead to an entry, as [start, end) positions in order.
+    std::vector<std::pair<int, int>> unstyled;
+    // The identifier whose uses are highlighted, and the lines of each view, in the order of views,
+    // they are highlighted on.  The indicator belongs to the document, so it is shown in every view.
+    wxString highlighted;
+    std::vector<std::pair<int, int>> highlighted_lines;
+#ifdef FORMULA_LEXER_STATIC
+    SharedDocument() = default;
+    ~SharedDocument()
+    {
+        lexer->Release();
+    }
+    SharedDocument(const SharedDocument &) = delete;
+    SharedDocument &operator=(const SharedDocument &) = delete;
+
+    ILexer *lexer{formula::create_lexer()};
+    // The lexer matches parentheses in the document it last styled, so that lasts as long as the
+    // lexer.  It reads the text through the first view, and moves to another as that one's frame closes.
+    ContainerDocument document{nullptr};
+#endif
+};
+
+// All views in a frame, and any frames opened with New Window, share a single
+// Scintilla document through the document pointer.  The lexer and its styling
+// and fold levels belong to the document, a lexer linked in through SharedDocument,
+// so text is lexed once for every view; styles, margins and fold expansion belong
+// to each view.
 class ScintillaFrame : public wxFrame
 {
 public:
-    ScintillaFrame(const wxString &title);
+    // A frame on a new document, or with opener on the document of that frame.
+    ScintillaFrame(const wxString &title, const ScintillaFrame *opener = nullptr);
+    ~ScintillaFrame() override;
 
 private:
-    void set_style_font_color(formula::Syntax style, const wxFont &font, const char *color_name);
+    wxStyledTextCtrl *create_view(void *document);
+    void set_style_font_color(wxStyledTextCtrl *stc, formula::Syntax style, const wxFont &font, const char *color_name);
     void init_lexer();
-    void init_coloring();
-    void init_line_numbers();
-    void init_folding();
+    void *lexer_call(formula::LexerCall operation, void *pointer);
+    void index_entries();
+    void init_coloring(wxStyledTextCtrl *stc);
+    void init_line_numbers(wxStyledTextCtrl *stc);
+    void init_folding(wxStyledTextCtrl *stc);
+    void init_diagnostics(wxStyledTextCtrl *stc);
+    void init_completion(wxStyledTextCtrl *stc);
+#ifdef FORMULA_TRACING
+    void init_tracing(wxStyledTextCtrl *stc);
+#endif
+    wxStyledTextCtrl *current_view() const;
+    void show_completions(wxStyledTextCtrl *stc, bool explicit_request);
+    wxString identifier_at_caret(wxStyledTextCtrl *stc) const;
+    std::pair<int, int> visible_lines(wxStyledTextCtrl *stc) const;
+    std::vector<int> find_identifier(wxStyledTextCtrl *stc, const wxString &identifier, int first_line = 0,
+        int last_line = INT_MAX);
+    void highlight_occurrences(wxStyledTextCtrl *stc, bool refresh);
+    void highlight_paren(wxStyledTextCtrl *stc);
+    void colourise(wxStyledTextCtrl *stc, int start, int end);
+    void colourise_through(wxStyledTextCtrl *stc, int start, int end);
+    void style_through(wxStyledTextCtrl *stc, int end);
+    int entry_line_start(wxStyledTextCtrl *stc, int position);
+    void go_to_entry(wxStyledTextCtrl *stc, const formula::FormulaEntry &entry);
+    void style_visible(wxStyledTextCtrl *stc);
     void show_hide_line_numbers();
     void show_hide_folding();
+    void show_hide_preview();
+    void show_problems(unsigned generation, const std::vector<formula::Problem> &problems);
+    void split(wxSplitMode mode);
+    void stop_recording();
+    void on_open(wxCommandEvent &event);
+    void on_new_window(wxCommandEvent &event);
     void on_view_line_numbers(wxCommandEvent &event);
     void on_view_folding(wxCommandEvent &event);
+    void on_view_preview(wxCommandEvent &event);
+    void on_split_horizontal(wxCommandEvent &event);
+    void on_split_vertical(wxCommandEvent &event);
+    void on_unsplit(wxCommandEvent &event);
+    void on_record_session(wxCommandEvent &event);
+#ifdef FORMULA_TRACING
+    void on_record_trace(wxCommandEvent &event);
+    void on_paint(wxPaintEvent &event);
+    void on_painted(wxStyledTextEvent &event);
+#endif
+    void on_complete_identifier(wxCommandEvent &event);
+    void on_rename_identifier(wxCommandEvent &event);
+    void on_go_to_formula(wxCommandEvent &event);
+    void on_find(wxCommandEvent &event);
+    void on_char_added(wxStyledTextEvent &event);
     void on_margin_click(wxStyledTextEvent &event);
+    void on_update_ui(wxStyledTextEvent &event);
+    void on_modified(wxStyledTextEvent &event);
+    void on_check_timer(wxTimerEvent &event);
+    void on_dwell_start(wxStyledTextEvent &event);
+    void on_dwell_end(wxStyledTextEvent &event);
+#ifdef FORMULA_LEXER_STATIC
+    void on_style_needed(wxStyledTextEvent &event);
+#endif
     void on_exit(wxCommandEvent &event);
 
     wxMenuItem *m_view_lines{};
     wxMenuItem *m_view_folding{};
+    wxMenuItem *m_view_preview{};
+    wxMenuItem *m_record_session{};
+#ifdef FORMULA_TRACING
+    wxMenuItem *m_record_trace{};
+    formula::TraceLog::Clock::time_point m_paint_begin;
+#endif
+    wxSplitterWindow *m_preview_splitter{};
+    wxSplitterWindow *m_splitter{};
     wxStyledTextCtrl *m_stc{};
+    wxStyledTextCtrl *m_split_stc{};
+    std::vector<wxStyledTextCtrl *> m_views;
     int m_line_margin_width{};
     int m_folding_margin_width{20};
     bool m_show_lines{};
     bool m_show_folding{true};
+    bool m_show_preview{true};
+    std::unique_ptr<SessionRecorder> m_recorder;
+    FindDialog *m_find_dialog{};
+    PreviewPanel *m_preview{};
+    std::shared_ptr<SharedDocument> m_shared;
+    wxTimer m_check_timer{this};
+    unsigned m_check_generation{};
+    std::vector<formula::Problem> m_problems;
+    // Last, so the worker stops before anything it publishes to is destroyed.
+    formula::BackgroundChecker m_checker{[this](unsigned generation, std::vector<formula::Problem> problems)
+        { CallAfter([this, generation, problems] { show_problems(generation, problems); }); }};
 };
 
 wxIMPLEMENT_APP(ScintillaApp);
 
+// One log for every frame and the lexer of every document, so it outlives them all.
+formula::TraceLog &trace_log()
+{
+    static formula::TraceLog log;
+    return log;
+}
+
 bool ScintillaApp::OnInit()
 {
     ScintillaFrame *frame = new ScintillaFrame("Scintilla Editing Example");
@@ -56,92 +222,650 @@ bool ScintillaApp::OnInit()
     return true;
 }
 
-ScintillaFrame::ScintillaFrame(const wxString &title) :
+ScintillaFrame::ScintillaFrame(const wxString &title, const ScintillaFrame *opener) :
     wxFrame(nullptr, wxID_ANY, title, wxDefaultPosition, wxSize(800, 600))
 {
     wxMenuBar *menu_bar = new wxMenuBar;
     wxMenu *file = new wxMenu;
+    file->Append(wxID_OPEN, "&Open...\tCtrl-O", "Open");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_open, this, wxID_OPEN);
+    wxMenuItem *new_window = file->Append(wxID_ANY, "&New Window", "New window on this document");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_new_window, this, new_window->GetId());
+    file->AppendSeparator();
     file->Append(wxID_EXIT, "&Quit\tAlt-F4", "Quit");
     menu_bar->Append(file, "&File");
+    wxMenu *edit = new wxMenu;
+    wxMenuItem *complete = edit->Append(wxID_ANY, "&Complete Identifier\tCtrl+Space", "Complete identifier");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_complete_identifier, this, complete->GetId());
+    wxMenuItem *rename = edit->Append(wxID_ANY, "&Rename Identifier...\tF2", "Rename identifier");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_rename_identifier, this, rename->GetId());
+    wxMenuItem *go_to_formula = edit->Append(wxID_ANY, "&Go to Formula...\tCtrl+G", "Go to a formula by name");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_go_to_formula, this, go_to_formula->GetId());
+    edit->AppendSeparator();
+    edit->Append(wxID_FIND, "&Find and Replace...\tCtrl+F", "Find and replace");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_find, this, wxID_FIND);
+    menu_bar->Append(edit, "&Edit");
     wxMenu *view = new wxMenu;
     m_view_lines = view->Append(wxID_ANY, "&Line Numbers", "Line Numbers", wxITEM_CHECK);
     Bind(wxEVT_MENU, &ScintillaFrame::on_view_line_numbers, this, m_view_lines->GetId());
     m_view_folding = view->Append(wxID_ANY, "&Folding", "Folding", wxITEM_CHECK);
     Bind(wxEVT_MENU, &ScintillaFrame::on_view_folding, this, m_view_folding->GetId());
+    m_view_preview = view->Append(wxID_ANY, "&Preview", "Preview the formula at the caret", wxITEM_CHECK);
+    Bind(wxEVT_MENU, &ScintillaFrame::on_view_preview, this, m_view_preview->GetId());
+    view->AppendSeparator();
+    wxMenuItem *split_horizontal = view->Append(wxID_ANY, "Split &Horizontally", "Split Horizontally");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_split_horizontal, this, split_horizontal->GetId());
+    wxMenuItem *split_vertical = view->Append(wxID_ANY, "Split &Vertically", "Split Vertically");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_split_vertical, this, split_vertical->GetId());
+    wxMenuItem *unsplit = view->Append(wxID_ANY, "&Unsplit", "Unsplit");
+    Bind(wxEVT_MENU, &ScintillaFrame::on_unsplit, this, unsplit->GetId());
     menu_bar->Append(view, "&View");
+    wxMenu *tools = new wxMenu;
+    m_record_session = tools->Append(wxID_ANY, "&Record Edit Session...", "Record edits and lexing for bench-replay",
+        wxITEM_CHECK);
+    Bind(wxEVT_MENU, &ScintillaFrame::on_record_session, this, m_record_session->GetId());
+#ifdef FORMULA_TRACING
+    m_record_trace = tools->Append(wxID_ANY, "Record &Trace...", "Record a Chrome trace of lexing and painting",
+        wxITEM_CHECK);
+    Bind(wxEVT_MENU, &ScintillaFrame::on_record_trace, this, m_record_trace->GetId());
+#endif
+    menu_bar->Append(tools, "&Tools");
     wxFrameBase::SetMenuBar(menu_bar);
     Bind(wxEVT_MENU, &ScintillaFrame::on_exit, this, wxID_EXIT);
 
-    m_stc = new wxStyledTextCtrl(this, wxID_ANY);
-    init_lexer();
-    init_coloring();
-    init_line_numbers();
-    init_folding();
+    // The preview sits to the right of the editor views and keeps its width as the frame resizes.
+    m_preview_splitter = new wxSplitterWindow(this, wxID_ANY);
+    m_preview_splitter->SetMinimumPaneSize(20);
+    m_preview_splitter->SetSashGravity(1.0);
+    m_splitter = new wxSplitterWindow(m_preview_splitter, wxID_ANY);
+    m_splitter->SetMinimumPaneSize(20);
+    m_shared = opener != nullptr ? opener->m_shared : std::make_shared<SharedDocument>();
+    m_stc = create_view(opener != nullptr ? opener->m_stc->GetDocPointer() : nullptr);
+#ifdef FORMULA_LEXER_STATIC
+    if (opener == nullptr)
+    {
+        m_shared->document.set_view(m_stc);
+    }
+#endif
+    m_splitter->Initialize(m_stc);
+    m_preview = new PreviewPanel(m_preview_splitter, m_stc);
+    m_preview_splitter->Initialize(m_splitter);
+    // Every view sees each modification to the shared document; record it from one.
+    Bind(wxEVT_STC_MODIFIED, &ScintillaFrame::on_modified, this, m_stc->GetId());
+    Bind(wxEVT_TIMER, &ScintillaFrame::on_check_timer, this, m_check_timer.GetId());
+    if (opener == nullptr)
+    {
+        init_lexer();
+    }
+    lexer_call(formula::LexerCall::SET_TRACE_LOG, &trace_log());
+    show_hide_line_numbers();
+    show_hide_folding();
+    show_hide_preview();
+    m_check_timer.StartOnce(CHECK_DELAY_MS);
+}
+
+ScintillaFrame::~ScintillaFrame()
+{
+    stop_recording();
+    std::vector<wxStyledTextCtrl *> &views = m_shared->views;
+    views.erase(std::remove_if(views.begin(), views.end(),
+                    [this](wxStyledTextCtrl *stc)
+                    { return std::find(m_views.begin(), m_views.end(), stc) != m_views.end(); }),
+        views.end());
+    m_shared->highlighted_lines.clear();
+#ifdef FORMULA_LEXER_STATIC
+    // The lexer goes with the last frame on the document; until then it reads through another frame's view.
+    if (!views.empty())
+    {
+        m_shared->document.set_view(views.front());
+    }
+#endif
+}
+
+// Creates a view in the splitter; when document is non-null the view shares it
+// instead of creating a new one, so the lexer is not loaded or run again.
+wxStyledTextCtrl *ScintillaFrame::create_view(void *document)
+{
+    wxStyledTextCtrl *stc = new wxStyledTextCtrl(m_splitter, wxID_ANY);
+    if (document != nullptr)
+    {
+        stc->SetDocPointer(document);
+    }
+    init_coloring(stc);
+    init_line_numbers(stc);
+    init_folding(stc);
+    init_diagnostics(stc);
+    init_completion(stc);
+#ifdef FORMULA_TRACING
+    init_tracing(stc);
+#endif
+#ifdef FORMULA_LEXER_STATIC
+    Bind(wxEVT_STC_STYLENEEDED, &ScintillaFrame::on_style_needed, this, stc->GetId());
+#endif
+    m_views.push_back(stc);
+    m_shared->views.push_back(stc);
+    return stc;
 }
 
-void ScintillaFrame::set_style_font_color(formula::Syntax style, const wxFont &font, const char *color_name)
+void ScintillaFrame::set_style_font_color(
+    wxStyledTextCtrl *stc, formula::Syntax style, const wxFont &font, const char *color_name)
 {
-    m_stc->StyleSetFont(+style, font);
+    stc->StyleSetFont(+style, font);
     wxColour color;
     wxASSERT(wxFromString(color_name, &color));
-    m_stc->StyleSetForeground(+style, color);
+    stc->StyleSetForeground(+style, color);
 }
 
 void ScintillaFrame::init_lexer()
 {
+#ifdef FORMULA_LEXER_STATIC
+    // The lexer is linked in; style as a container lexer instead of loading the plug-in.
+    m_stc->SetLexer(wxSTC_LEX_CONTAINER);
+#else
     m_stc->LoadLexerLibrary(wxT("./formula-lexer") + wxDynamicLibrary::GetDllExt(wxDL_LIBRARY));
-    m_stc->SetLexerLanguage(wxT("id-formula"));
+    m_stc->SetLexerLanguage(formula::LEXER_NAME);
+#endif
+    lexer_call(formula::LexerCall::INDEX_IDENTIFIERS, nullptr);
+    index_entries();
+    colourise_through(m_stc, 0, m_stc->GetLength());
+}
+
+void *ScintillaFrame::lexer_call(formula::LexerCall operation, void *pointer)
+{
+#ifdef FORMULA_LEXER_STATIC
+    return m_shared->lexer->PrivateCall(+operation, pointer);
+#else
+    return m_stc->PrivateLexerCall(+operation, pointer);
+#endif
+}
+
+// Finds every entry in the text with a quick scan, so they can be listed before the
+// text is folded; folding keeps them up to date from then on.
+void ScintillaFrame::index_entries()
+{
+    formula::DocumentText text{m_stc->GetCharacterPointer(), static_cast<std::size_t>(m_stc->GetLength())};
+    lexer_call(formula::LexerCall::INDEX_ENTRIES, &text);
 }
 
-void ScintillaFrame::init_coloring()
+#ifdef FORMULA_TRACING
+void ScintillaFrame::init_tracing(wxStyledTextCtrl *stc)
+{
+    // Painting is timed from the paint event to the painted notification sent as it finishes.
+    stc->Bind(wxEVT_PAINT, &ScintillaFrame::on_paint, this);
+    Bind(wxEVT_STC_PAINTED, &ScintillaFrame::on_painted, this, stc->GetId());
+}
+#endif
+
+void ScintillaFrame::init_coloring(wxStyledTextCtrl *stc)
 {
     wxFont typewriter;
     typewriter.SetFamily(wxFONTFAMILY_TELETYPE);
     typewriter.SetPointSize(12);
-    set_style_font_color(formula::Syntax::NONE, typewriter, "black");
-    set_style_font_color(formula::Syntax::COMMENT, typewriter, "forest green");
-    set_style_font_color(formula::Syntax::KEYWORD, typewriter, "blue");
-    set_style_font_color(formula::Syntax::WHITESPACE, typewriter, "black");
-    set_style_font_color(formula::Syntax::FUNCTION, typewriter, "red");
-    set_style_font_color(formula::Syntax::IDENTIFIER, typewriter, "purple");
-    m_stc->Colourise(0, -1);
+    set_style_font_color(stc, formula::Syntax::NONE, typewriter, "black");
+    set_style_font_color(stc, formula::Syntax::COMMENT, typewriter, "forest green");
+    set_style_font_color(stc, formula::Syntax::KEYWORD, typewriter, "blue");
+    set_style_font_color(stc, formula::Syntax::WHITESPACE, typewriter, "black");
+    set_style_font_color(stc, formula::Syntax::FUNCTION, typewriter, "red");
+    set_style_font_color(stc, formula::Syntax::IDENTIFIER, typewriter, "purple");
+    // A parenthesis at the caret and its match are bold; one without a match is red.
+    stc->StyleSetFont(wxSTC_STYLE_BRACELIGHT, typewriter.Bold());
+    stc->StyleSetFont(wxSTC_STYLE_BRACEBAD, typewriter);
+    stc->StyleSetForeground(wxSTC_STYLE_BRACEBAD, *wxRED);
 }
 
-void ScintillaFrame::init_line_numbers()
+void ScintillaFrame::init_line_numbers(wxStyledTextCtrl *stc)
 {
-    m_stc->SetMarginType(+MarginIndex::LINE_NUMBER, wxSTC_MARGIN_NUMBER);
-    m_line_margin_width = m_stc->TextWidth(wxSTC_STYLE_LINENUMBER, "_99999");
-    show_hide_line_numbers();
+    stc->SetMarginType(+MarginIndex::LINE_NUMBER, wxSTC_MARGIN_NUMBER);
+    m_line_margin_width = stc->TextWidth(wxSTC_STYLE_LINENUMBER, "_99999");
 }
 
-void ScintillaFrame::init_folding()
+void ScintillaFrame::init_folding(wxStyledTextCtrl *stc)
 {
-    m_stc->SetMarginType(+MarginIndex::FOLDING, wxSTC_MARGIN_SYMBOL);
+    stc->SetMarginType(+MarginIndex::FOLDING, wxSTC_MARGIN_SYMBOL);
     for (int i = wxSTC_MARKNUM_FOLDEREND; i <= wxSTC_MARKNUM_FOLDEROPEN; ++i)
     {
-        m_stc->MarkerDefine(i, wxSTC_MARK_EMPTY);
+        stc->MarkerDefine(i, wxSTC_MARK_EMPTY);
+    }
+    stc->MarkerDefine(wxSTC_MARKNUM_FOLDEROPEN, wxSTC_MARK_ARROWDOWN);
+    stc->MarkerDefine(wxSTC_MARKNUM_FOLDER, wxSTC_MARK_ARROW);
+    stc->SetMarginMask(+MarginIndex::FOLDING, wxSTC_MASK_FOLDERS);
+    stc->SetMarginSensitive(+MarginIndex::FOLDING, true);
+    Bind(wxEVT_STC_MARGINCLICK, &ScintillaFrame::on_margin_click, this, stc->GetId());
+}
+
+void ScintillaFrame::init_diagnostics(wxStyledTextCtrl *stc)
+{
+    stc->IndicatorSetStyle(+formula::Indicator::STRUCTURE_ERROR, wxSTC_INDIC_SQUIGGLE);
+    stc->IndicatorSetForeground(+formula::Indicator::STRUCTURE_ERROR, *wxRED);
+    stc->IndicatorSetStyle(+EditorIndicator::OCCURRENCE, wxSTC_INDIC_ROUNDBOX);
+    stc->IndicatorSetForeground(+EditorIndicator::OCCURRENCE, wxColour(255, 160, 0));
+    stc->IndicatorSetStyle(+EditorIndicator::PROBLEM, wxSTC_INDIC_SQUIGGLE);
+    stc->IndicatorSetForeground(+EditorIndicator::PROBLEM, wxColour(255, 0, 255));
+    stc->MarkerDefine(+EditorMarker::PROBLEM, wxSTC_MARK_CIRCLE, *wxWHITE, *wxRED);
+    stc->SetMarginType(+MarginIndex::PROBLEM, wxSTC_MARGIN_SYMBOL);
+    stc->SetMarginMask(+MarginIndex::PROBLEM, 1 << +EditorMarker::PROBLEM);
+    stc->SetMarginWidth(+MarginIndex::PROBLEM, 16);
+    stc->SetMouseDwellTime(500);
+    Bind(wxEVT_STC_UPDATEUI, &ScintillaFrame::on_update_ui, this, stc->GetId());
+    Bind(wxEVT_STC_DWELLSTART, &ScintillaFrame::on_dwell_start, this, stc->GetId());
+    Bind(wxEVT_STC_DWELLEND, &ScintillaFrame::on_dwell_end, this, stc->GetId());
+}
+
+void ScintillaFrame::init_completion(wxStyledTextCtrl *stc)
+{
+    // The lexer indexes identifiers in lower case; formulas are case insensitive.
+    stc->AutoCompSetIgnoreCase(true);
+    stc->AutoCompSetAutoHide(true);
+    Bind(wxEVT_STC_CHARADDED, &ScintillaFrame::on_char_added, this, stc->GetId());
+}
+
+wxStyledTextCtrl *ScintillaFrame::current_view() const
+{
+    return m_split_stc != nullptr && m_split_stc->HasFocus() ? m_split_stc : m_stc;
+}
+
+// Shows the built-in functions and document identifiers that start with the word before the caret.
+// Typing only shows the list once a word is started; the menu command shows it anywhere.
+void ScintillaFrame::show_completions(wxStyledTextCtrl *stc, bool explicit_request)
+{
+    const int caret = stc->GetCurrentPos();
+    const int start = stc->WordStartPosition(caret, true);
+    if (start == caret && !explicit_request)
+    {
+        return;
+    }
+    const wxCharBuffer prefix = stc->GetTextRangeRaw(start, caret);
+    const char *words = static_cast<const char *>(
+        lexer_call(formula::LexerCall::COMPLETE_IDENTIFIER, const_cast<char *>(prefix.data())));
+    if (words == nullptr)
+    {
+        return;
+    }
+
+    // The word being typed was indexed when its line was last lexed; don't offer it back.
+    wxString list;
+    const wxString typed = wxString(prefix.data()).Lower();
+    for (const wxString &word : wxSplit(words, ' '))
+    {
+        if (word != typed)
+        {
+            list += list.empty() ? word : ' ' + word;
+        }
+    }
+    if (list.empty())
+    {
+        stc->AutoCompCancel();
+        return;
+    }
+    stc->AutoCompShow(caret - start, list);
+}
+
+wxString ScintillaFrame::identifier_at_caret(wxStyledTextCtrl *stc) const
+{
+    const int caret = stc->GetCurrentPos();
+    const int start = stc->WordStartPosition(caret, true);
+    const int end = stc->WordEndPosition(caret, true);
+    if (start == end || stc->GetStyleAt(start) != +formula::Syntax::IDENTIFIER)
+    {
+        return {};
+    }
+    return stc->GetTextRange(start, end).Lower();
+}
+
+// Positions of every use of identifier, from the lexer's occurrence index.  Lines not yet
+// lexed since an edit may be out of date, so each position is checked against the text.
+// The document lines in view, as [first, last).
+std::pair<int, int> ScintillaFrame::visible_lines(wxStyledTextCtrl *stc) const
+{
+    const int first_visible = stc->GetFirstVisibleLine();
+    return {stc->DocLineFromVisible(first_visible), stc->DocLineFromVisible(first_visible + stc->LinesOnScreen()) + 1};
+}
+
+// The uses of identifier on lines [first_line, last_line), in document order.  The index visits
+// only the lines asked for, so finding the uses in view costs the same however long the document.
+std::vector<int> ScintillaFrame::find_identifier(
+    wxStyledTextCtrl *stc, const wxString &identifier, int first_line, int last_line)
+{
+    std::vector<int> positions;
+    const wxScopedCharBuffer name = identifier.utf8_str();
+    formula::LineOccurrences lines{name.data(), static_cast<std::size_t>(first_line),
+        static_cast<std::size_t>(last_line)};
+    const auto *found = static_cast<const formula::IdentifierOccurrences *>(last_line == INT_MAX && first_line == 0
+            ? lexer_call(formula::LexerCall::FIND_OCCURRENCES, const_cast<char *>(name.data()))
+            : lexer_call(formula::LexerCall::FIND_LINE_OCCURRENCES, &lines));
+    if (found == nullptr)
+    {
+        return positions;
+    }
+    const int length = static_cast<int>(name.length());
+    for (std::size_t i = 0; i < found->count; ++i)
+    {
+        const int position = stc->PositionFromLine(static_cast<int>(found->items[i].line)) +
+            static_cast<int>(found->items[i].column);
+        if (position + length <= stc->GetLength() && stc->GetStyleAt(position) == +formula::Syntax::IDENTIFIER &&
+            stc->WordEndPosition(position, true) == position + length &&
+            stc->GetTextRange(position, position + length).Lower() == identifier)
+        {
+            positions.push_back(position);
+        }
+    }
+    return positions;
+}
+
+// Marks the uses of the identifier under the caret of the view being used on the lines in view in
+// every view of the document; refresh redoes it after the text or a view changed.  The indicator
+// belongs to the document, so every view shows what any of them marked.
+void ScintillaFrame::highlight_occurrences(wxStyledTextCtrl *stc, bool refresh)
+{
+    // Views without focus, such as the other half of a split, keep the identifier they are shown.
+    const wxString identifier = stc->HasFocus() ? identifier_at_caret(stc) : m_shared->highlighted;
+    std::vector<std::pair<int, int>> lines;
+    for (wxStyledTextCtrl *view : m_shared->views)
+    {
+        lines.push_back(view->IsShownOnScreen() ? visible_lines(view) : std::pair<int, int>{});
+    }
+    if (identifier == m_shared->highlighted && lines == m_shared->highlighted_lines && !refresh)
+    {
+        return;
+    }
+    m_shared->highlighted = identifier;
+    m_shared->highlighted_lines = lines;
+
+    // The indicator is stored as runs, so clearing visits each use marked before rather than the
+    // whole document, wherever edits since have moved them.
+    constexpr int indicator{+EditorIndicator::OCCURRENCE};
+    stc->SetIndicatorCurrent(indicator);
+    const int document_length = stc->GetLength();
+    for (int position = 0; position < document_length;)
+    {
+        const int end = stc->IndicatorEnd(indicator, position);
+        if (end <= position)
+        {
+            break;
+        }
+        if (stc->IndicatorValueAt(indicator, position) != 0)
+        {
+            stc->IndicatorClearRange(position, end - position);
+        }
+        position = end;
+    }
+    if (identifier.empty())
+    {
+        return;
+    }
+    const int length = static_cast<int>(identifier.utf8_str().length());
+    for (const auto &[first_line, last_line] : lines)
+    {
+        for (const int position : find_identifier(stc, identifier, first_line, last_line))
+        {
+            stc->IndicatorFillRange(position, length);
+        }
+    }
+}
+
+// Styles and folds [start, end) of the document.  Styling moves the end of the styled text
+// to end, so when that is before where it was, it is put back.
+void ScintillaFrame::colourise(wxStyledTextCtrl *stc, int start, int end)
+{
+    const int end_styled = stc->GetEndStyled();
+#ifdef FORMULA_LEXER_STATIC
+    const int init_style = start > 0 ? stc->GetStyleAt(start - 1) : +formula::Syntax::NONE;
+    m_shared->lexer->Lex(start, end - start, init_style, &m_shared->document);
+    m_shared->lexer->Fold(start, end - start, init_style, &m_shared->document);
+#else
+    stc->Colourise(start, end);
+#endif
+    if (stc->GetEndStyled() < end_styled)
+    {
+        stc->StartStyling(end_styled);
+    }
+}
+
+// Styles and folds [start, end) a chunk at a time, for operations that need all of it at once.
+void ScintillaFrame::colourise_through(wxStyledTextCtrl *stc, int start, int end)
+{
+    while (start < end)
+    {
+        const int chunk_end = std::min(end, start + STYLE_CHUNK);
+        colourise(stc, start, chunk_end);
+        start = chunk_end;
+    }
+}
+
+// Styles everything before end, the text skipped by Go to Formula included, for operations that need
+// the styles and indexes of all of it.
+void ScintillaFrame::style_through(wxStyledTextCtrl *stc, int end)
+{
+    std::vector<std::pair<int, int>> unstyled;
+    for (const auto &[start, stop] : m_shared->unstyled)
+    {
+        if (start < end)
+        {
+            colourise_through(stc, start, std::min(stop, end));
+        }
+        if (stop > end)
+        {
+            unstyled.emplace_back(std::max(start, end), stop);
+        }
+    }
+    m_shared->unstyled = std::move(unstyled);
+    colourise_through(stc, stc->GetEndStyled(), end);
+}
+
+// The start of the line holding the last entry to start at or before position, or 0 if none does.
+int ScintillaFrame::entry_line_start(wxStyledTextCtrl *stc, int position)
+{
+    const auto *entries = static_cast<const formula::FormulaEntries *>(
+        lexer_call(formula::LexerCall::LIST_ENTRIES, nullptr));
+    const formula::FormulaEntry *end = entries->items + entries->count;
+    const formula::FormulaEntry *after = std::upper_bound(entries->items, end, static_cast<std::size_t>(position),
+        [](std::size_t value, const formula::FormulaEntry &entry) { return value < entry.start; });
+    return after == entries->items
+        ? 0
+        : stc->PositionFromLine(stc->LineFromPosition(static_cast<int>((after - 1)->start)));
+}
+
+// Shows the entry at the top of the view.  When the entry is beyond the styled text, only the
+// entry is styled and the text skipped over is left until it is scrolled into view, or until an
+// operation needing the whole document styles it with style_through.
+void ScintillaFrame::go_to_entry(wxStyledTextCtrl *stc, const formula::FormulaEntry &entry)
+{
+    const int line = stc->LineFromPosition(static_cast<int>(entry.start));
+    const int start = stc->PositionFromLine(line);
+    // Style to the end of the line the entry ends on, as stopping part way along a line leaves the
+    // rest of it out of the indexes until it is styled.
+    const int end_line = stc->LineFromPosition(static_cast<int>(entry.end)) + 1;
+    const int end = end_line < stc->GetLineCount() ? stc->PositionFromLine(end_line) : stc->GetLength();
+    const int styled = stc->PositionFromLine(stc->LineFromPosition(stc->GetEndStyled()));
+    if (start > styled)
+    {
+        // Anything skipped before lies below the end of the styled text, so the ranges stay in order.
+        m_shared->unstyled.emplace_back(styled, start);
+        colourise(stc, start, end);
+    }
+    stc->EnsureVisible(line);
+    stc->GotoPos(static_cast<int>(entry.start));
+    stc->SetFirstVisibleLine(stc->VisibleFromDocLine(line));
+}
+
+// Styles the skipped text that is in view, starting from the line of the entry it is in.
+void ScintillaFrame::style_visible(wxStyledTextCtrl *stc)
+{
+    const auto [first_line, last_line] = visible_lines(stc);
+    const int visible_start = stc->PositionFromLine(first_line);
+    const int visible_end = last_line < stc->GetLineCount() ? stc->PositionFromLine(last_line) : stc->GetLength();
+    std::vector<std::pair<int, int>> unstyled;
+    for (const auto &[start, end] : m_shared->unstyled)
+    {
+        if (end <= visible_start || start >= visible_end)
+        {
+            unstyled.emplace_back(start, end);
+            continue;
+        }
+        const int style_start = std::max(start, entry_line_start(stc, std::max(start, visible_start)));
+        const int style_end = std::min(end, visible_end);
+        colourise(stc, style_start, style_end);
+        if (start < style_start)
+        {
+            unstyled.emplace_back(start, style_start);
+        }
+        if (style_end < end)
+        {
+            unstyled.emplace_back(style_end, end);
+        }
+    }
+    m_shared->unstyled = std::move(unstyled);
+}
+
+// Highlights the parenthesis at the caret, or else the one before it, and its match.  The lexer
+// finds the match from the line states, so it is found at once however far away it is.
+void ScintillaFrame::highlight_paren(wxStyledTextCtrl *stc)
+{
+    const auto is_paren = [stc](int position)
+    {
+        const int ch = stc->GetCharAt(position);
+        return (ch == '(' || ch == ')') && stc->GetStyleAt(position) != +formula::Syntax::COMMENT;
+    };
+    const int caret = stc->GetCurrentPos();
+    int position{wxSTC_INVALID_POSITION};
+    if (caret < stc->GetLength() && is_paren(caret))
+    {
+        position = caret;
+    }
+    else if (caret > 0 && is_paren(caret - 1))
+    {
+        position = caret - 1;
+    }
+    if (position == wxSTC_INVALID_POSITION)
+    {
+        stc->BraceHighlight(wxSTC_INVALID_POSITION, wxSTC_INVALID_POSITION);
+        return;
+    }
+    // Line states in text skipped by Go to Formula are out of date.
+    const int end_styled = m_shared->unstyled.empty() ? stc->GetEndStyled() : m_shared->unstyled.front().first;
+    formula::ParenMatch match{static_cast<std::size_t>(position), static_cast<std::size_t>(end_styled), 0};
+    if (lexer_call(formula::LexerCall::MATCH_PAREN, &match) != nullptr)
+    {
+        stc->BraceHighlight(position, static_cast<int>(match.match));
+    }
+    else
+    {
+        stc->BraceBadLight(position);
     }
-    m_stc->MarkerDefine(wxSTC_MARKNUM_FOLDEROPEN, wxSTC_MARK_ARROWDOWN);
-    m_stc->MarkerDefine(wxSTC_MARKNUM_FOLDER, wxSTC_MARK_ARROW);
-    m_stc->SetMarginMask(+MarginIndex::FOLDING, wxSTC_MASK_FOLDERS);
-    m_stc->SetMarginSensitive(+MarginIndex::FOLDING, true);
-    Bind(wxEVT_STC_MARGINCLICK, &ScintillaFrame::on_margin_click, this, m_stc->GetId());
-    show_hide_folding();
 }
 
 void ScintillaFrame::show_hide_line_numbers()
 {
-    m_stc->SetMarginWidth(+MarginIndex::LINE_NUMBER, m_show_lines ? m_line_margin_width : 0);
+    for (wxStyledTextCtrl *stc : m_views)
+    {
+        stc->SetMarginWidth(+MarginIndex::LINE_NUMBER, m_show_lines ? m_line_margin_width : 0);
+    }
     m_view_lines->Check(m_show_lines);
 }
 
 void ScintillaFrame::show_hide_folding()
 {
-    m_stc->SetProperty("fold", m_show_folding ? "1" : "0");
-    m_stc->SetMarginWidth(+MarginIndex::FOLDING, m_show_folding ? m_folding_margin_width : 0);
+    // Fold levels belong to the shared document and are kept for every frame on it, so this only
+    // shows or hides the margins of this frame's views.  Hidden lines can't be shown without the
+    // margin, so they are expanded.
+    for (wxStyledTextCtrl *stc : m_views)
+    {
+        stc->SetMarginWidth(+MarginIndex::FOLDING, m_show_folding ? m_folding_margin_width : 0);
+        if (!m_show_folding)
+        {
+            stc->FoldAll(wxSTC_FOLDACTION_EXPAND);
+        }
+    }
     m_view_folding->Check(m_show_folding);
 }
 
+void ScintillaFrame::show_hide_preview()
+{
+    if (m_show_preview && !m_preview_splitter->IsSplit())
+    {
+        m_preview_splitter->SplitVertically(m_splitter, m_preview, -250);
+    }
+    else if (!m_show_preview && m_preview_splitter->IsSplit())
+    {
+        m_preview_splitter->Unsplit(m_preview);
+    }
+    m_view_preview->Check(m_show_preview);
+}
+
+// Marks the problems the checker found, unless the document has changed since the
+// snapshot they were found in.  Indicators and markers belong to the shared
+// document, so every view shows them.
+void ScintillaFrame::show_problems(unsigned generation, const std::vector<formula::Problem> &problems)
+{
+    if (generation != m_check_generation || m_check_timer.IsRunning())
+    {
+        return;
+    }
+    m_problems = problems;
+    m_stc->SetIndicatorCurrent(+EditorIndicator::PROBLEM);
+    m_stc->IndicatorClearRange(0, m_stc->GetLength());
+    m_stc->MarkerDeleteAll(+EditorMarker::PROBLEM);
+    for (std::size_t i = 0; i < m_problems.size(); ++i)
+    {
+        const formula::Problem &problem = m_problems[i];
+        const int begin = static_cast<int>(problem.begin);
+        m_stc->SetIndicatorValue(static_cast<int>(i + 1));
+        m_stc->IndicatorFillRange(begin, std::max(1, static_cast<int>(problem.end - problem.begin)));
+        m_stc->MarkerAdd(m_stc->LineFromPosition(begin), +EditorMarker::PROBLEM);
+    }
+}
+
+void ScintillaFrame::split(wxSplitMode mode)
+{
+    if (m_split_stc == nullptr)
+    {
+        m_split_stc = create_view(m_stc->GetDocPointer());
+        show_hide_line_numbers();
+        show_hide_folding();
+    }
+    if (m_splitter->IsSplit())
+    {
+        m_splitter->Unsplit(m_split_stc);
+    }
+    m_split_stc->SetFirstVisibleLine(m_stc->GetFirstVisibleLine());
+    if (mode == wxSPLIT_HORIZONTAL)
+    {
+        m_splitter->SplitHorizontally(m_stc, m_split_stc);
+    }
+    else
+    {
+        m_splitter->SplitVertically(m_stc, m_split_stc);
+    }
+}
+
+void ScintillaFrame::stop_recording()
+{
+    if (m_recorder)
+    {
+        lexer_call(formula::LexerCall::SET_LEX_OBSERVER, nullptr);
+        m_recorder.reset();
+    }
+}
+
+void ScintillaFrame::on_open(wxCommandEvent &/*event*/)
+{
+    wxFileDialog dialog(this, "Open Formula File", wxEmptyString, wxEmptyString,
+        "Formula files (*.frm)|*.frm|All files (*.*)|*.*", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+    if (dialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    m_stc->LoadFile(dialog.GetPath());
+    m_shared->unstyled.clear();
+    index_entries();
+}
+
+void ScintillaFrame::on_new_window(wxCommandEvent &/*event*/)
+{
+    ScintillaFrame *frame = new ScintillaFrame(GetTitle(), this);
+    frame->Show(true);
+}
+
 void ScintillaFrame::on_view_line_numbers(wxCommandEvent &/*event*/)
 {
     m_show_lines = !m_show_lines;
@@ -154,10 +878,326 @@ void ScintillaFrame::on_view_folding(wxCommandEvent &/*event*/)
     show_hide_folding();
 }
 
+void ScintillaFrame::on_view_preview(wxCommandEvent &/*event*/)
+{
+    m_show_preview = !m_show_preview;
+    show_hide_preview();
+}
+
+void ScintillaFrame::on_split_horizontal(wxCommandEvent &/*event*/)
+{
+    split(wxSPLIT_HORIZONTAL);
+}
+
+void ScintillaFrame::on_split_vertical(wxCommandEvent &/*event*/)
+{
+    split(wxSPLIT_VERTICAL);
+}
+
+void ScintillaFrame::on_unsplit(wxCommandEvent &/*event*/)
+{
+    if (m_splitter->IsSplit())
+    {
+        m_splitter->Unsplit(m_split_stc);
+    }
+}
+
+void ScintillaFrame::on_record_session(wxCommandEvent &/*event*/)
+{
+    if (m_recorder)
+    {
+        stop_recording();
+        m_record_session->Check(false);
+        return;
+    }
+
+    wxFileDialog dialog(this, "Record Edit Session", wxEmptyString, "edits.session",
+        "Edit sessions (*.session)|*.session|All files (*.*)|*.*", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (dialog.ShowModal() != wxID_OK)
+    {
+        m_record_session->Check(false);
+        return;
+    }
+    auto recorder = std::make_unique<SessionRecorder>(
+        dialog.GetPath().ToStdString(), m_stc->GetCharacterPointer(), m_stc->GetLength());
+    if (!recorder->is_open())
+    {
+        wxLogError("Couldn't create %s", dialog.GetPath());
+        m_record_session->Check(false);
+        return;
+    }
+    m_recorder = std::move(recorder);
+    lexer_call(formula::LexerCall::SET_LEX_OBSERVER, m_recorder.get());
+    m_record_session->Check(true);
+}
+
+#ifdef FORMULA_TRACING
+void ScintillaFrame::on_record_trace(wxCommandEvent &/*event*/)
+{
+    formula::TraceLog &log = trace_log();
+    if (!log.enabled())
+    {
+        log.set_enabled(true);
+        m_record_trace->Check(true);
+        return;
+    }
+
+    log.set_enabled(false);
+    m_record_trace->Check(false);
+    wxFileDialog dialog(this, "Save Trace", wxEmptyString, "trace.json",
+        "Chrome traces (*.json)|*.json|All files (*.*)|*.*", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+    if (dialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    std::ofstream out(dialog.GetPath().ToStdString(), std::ios::binary);
+    log.write_chrome_trace(out);
+    if (!out)
+    {
+        wxLogError("Couldn't write %s", dialog.GetPath());
+    }
+}
+
+void ScintillaFrame::on_paint(wxPaintEvent &event)
+{
+    event.Skip();
+    m_paint_begin = formula::TraceLog::Clock::now();
+}
+
+void ScintillaFrame::on_painted(wxStyledTextEvent &/*event*/)
+{
+    trace_log().record("Paint", "editor", m_paint_begin, formula::TraceLog::Clock::now());
+}
+#endif
+
+void ScintillaFrame::on_complete_identifier(wxCommandEvent &/*event*/)
+{
+    show_completions(current_view(), true);
+}
+
+void ScintillaFrame::on_rename_identifier(wxCommandEvent &/*event*/)
+{
+    wxStyledTextCtrl *stc = current_view();
+    const wxString identifier = identifier_at_caret(stc);
+    if (identifier.empty())
+    {
+        wxLogStatus("The caret is not on an identifier");
+        return;
+    }
+    const wxString name = wxGetTextFromUser("Rename '" + identifier + "' to:", "Rename Identifier", identifier, this);
+    if (name.empty() || name.Lower() == identifier)
+    {
+        return;
+    }
+    if (!name.IsAscii() || std::isalpha(static_cast<unsigned char>(name[0].GetValue())) == 0 ||
+        !std::all_of(name.begin(), name.end(), [](wxUniChar ch) { return std::isalnum(ch.GetValue()) != 0; }))
+    {
+        wxLogError("'%s' is not an identifier", name);
+        return;
+    }
+    const std::string lowered{name.Lower().utf8_str().data()};
+    if (formula::is_keyword(lowered) || formula::is_builtin_function(lowered))
+    {
+        wxLogError("'%s' is a keyword or function name", name);
+        return;
+    }
+
+    // Lex whatever is still unstyled so every line of the document is indexed.
+    style_through(stc, stc->GetLength());
+    const std::vector<int> positions = find_identifier(stc, identifier);
+    const int length = static_cast<int>(identifier.utf8_str().length());
+    stc->BeginUndoAction();
+    for (auto it = positions.rbegin(); it != positions.rend(); ++it)
+    {
+        stc->SetTargetRange(*it, *it + length);
+        stc->ReplaceTarget(name);
+    }
+    stc->EndUndoAction();
+}
+
+void ScintillaFrame::on_go_to_formula(wxCommandEvent &/*event*/)
+{
+    const auto *entries = static_cast<const formula::FormulaEntries *>(
+        lexer_call(formula::LexerCall::LIST_ENTRIES, nullptr));
+    if (entries->count == 0)
+    {
+        wxLogStatus("There are no formulas");
+        return;
+    }
+    std::vector<wxString> names;
+    for (std::size_t i = 0; i < entries->count; ++i)
+    {
+        names.push_back(wxString::FromUTF8(entries->items[i].name));
+    }
+    std::sort(names.begin(), names.end(),
+        [](const wxString &lhs, const wxString &rhs) { return lhs.CmpNoCase(rhs) < 0; });
+    names.erase(std::unique(names.begin(), names.end(),
+                    [](const wxString &lhs, const wxString &rhs) { return lhs.CmpNoCase(rhs) == 0; }),
+        names.end());
+
+    // The entries may move while the dialog is shown, so look the chosen one up afterwards.
+    const wxString name =
+        wxGetSingleChoice("Formula:", "Go to Formula", wxArrayString(names.size(), names.data()), this);
+    if (name.empty())
+    {
+        return;
+    }
+    const wxScopedCharBuffer utf8 = name.utf8_str();
+    const auto *entry = static_cast<const formula::FormulaEntry *>(
+        lexer_call(formula::LexerCall::FIND_ENTRY, const_cast<char *>(utf8.data())));
+    if (entry != nullptr)
+    {
+        go_to_entry(current_view(), *entry);
+    }
+}
+
+void ScintillaFrame::on_find(wxCommandEvent &/*event*/)
+{
+    wxStyledTextCtrl *stc = current_view();
+    if (m_find_dialog == nullptr)
+    {
+        m_find_dialog = new FindDialog(this, stc,
+            [this](wxStyledTextCtrl *view, int end) { style_through(view, end); });
+    }
+    m_find_dialog->set_view(stc);
+    m_find_dialog->Show();
+    const wxString selected = stc->GetSelectedText();
+    if (!selected.empty() && !selected.Contains('\n'))
+    {
+        m_find_dialog->set_find_text(selected);
+    }
+    m_find_dialog->Raise();
+}
+
+void ScintillaFrame::on_char_added(wxStyledTextEvent &event)
+{
+    wxStyledTextCtrl *stc = static_cast<wxStyledTextCtrl *>(event.GetEventObject());
+    const int key = event.GetKey();
+    if (key < 0x80 && std::isalnum(key) != 0)
+    {
+        show_completions(stc, false);
+    }
+}
+
 void ScintillaFrame::on_margin_click(wxStyledTextEvent &event)
 {
-    m_stc->ToggleFold(m_stc->LineFromPosition(event.GetPosition()));
+    // Fold expansion is per view, so toggle the fold in the view that was clicked.
+    wxStyledTextCtrl *stc = static_cast<wxStyledTextCtrl *>(event.GetEventObject());
+    stc->ToggleFold(stc->LineFromPosition(event.GetPosition()));
+}
+
+void ScintillaFrame::on_update_ui(wxStyledTextEvent &event)
+{
+    FORMULA_TRACE_SCOPE(&trace_log(), "UpdateUI", "editor", "updated", event.GetUpdated());
+    wxStyledTextCtrl *stc = static_cast<wxStyledTextCtrl *>(event.GetEventObject());
+    if (!m_shared->unstyled.empty())
+    {
+        style_visible(stc);
+    }
+    highlight_occurrences(stc, (event.GetUpdated() & (wxSTC_UPDATE_CONTENT | wxSTC_UPDATE_V_SCROLL)) != 0);
+    highlight_paren(stc);
+    if (stc == current_view())
+    {
+        m_preview->caret_moved(stc->GetCurrentPos());
+    }
+}
+
+void ScintillaFrame::on_modified(wxStyledTextEvent &event)
+{
+    FORMULA_TRACE_SCOPE(&trace_log(), "Modified", "editor", "position", event.GetPosition(), "length",
+        event.GetLength());
+    event.Skip();
+    const bool inserted = (event.GetModificationType() & wxSTC_MOD_INSERTTEXT) != 0;
+    const bool deleted = (event.GetModificationType() & wxSTC_MOD_DELETETEXT) != 0;
+    const int position = event.GetPosition();
+    const int length = event.GetLength();
+    if (inserted || deleted)
+    {
+        m_preview->document_modified(position, deleted ? length : 0, inserted ? length : 0);
+        // Drop any check of the old text at once; a new one starts when typing pauses, and rechecks
+        // only the entries the edits since the last one touched.
+        m_checker.cancel();
+        m_checker.edited(static_cast<std::size_t>(position), deleted ? static_cast<std::size_t>(length) : 0,
+            inserted ? static_cast<std::size_t>(length) : 0);
+        m_check_timer.StartOnce(CHECK_DELAY_MS);
+    }
+    if (inserted || deleted)
+    {
+        // Everything after an edit is restyled in order, skipped text included.  Each frame on the
+        // document trims the shared ranges, the second time to no effect.
+        std::vector<std::pair<int, int>> &unstyled = m_shared->unstyled;
+        unstyled.erase(std::remove_if(unstyled.begin(), unstyled.end(),
+                           [position](const std::pair<int, int> &range) { return range.first >= position; }),
+            unstyled.end());
+        if (!unstyled.empty() && unstyled.back().second > position)
+        {
+            unstyled.back().second = position;
+        }
+    }
+    if (m_find_dialog != nullptr && (inserted || deleted))
+    {
+        m_find_dialog->document_modified(static_cast<std::size_t>(position),
+            deleted ? static_cast<std::size_t>(length) : 0, inserted ? static_cast<std::size_t>(length) : 0);
+    }
+    if (!m_recorder)
+    {
+        return;
+    }
+    if (inserted)
+    {
+        // Record the bytes in the document rather than the event's converted text.
+        const wxCharBuffer text = m_stc->GetTextRangeRaw(position, position + length);
+        m_recorder->inserted(position, text.data(), length);
+    }
+    else if (deleted)
+    {
+        m_recorder->deleted(position, length);
+    }
+}
+
+void ScintillaFrame::on_check_timer(wxTimerEvent &/*event*/)
+{
+    // The snapshot is taken once per pause in typing rather than on every edit.
+    m_check_generation =
+        m_checker.submit(std::string(m_stc->GetCharacterPointer(), static_cast<std::size_t>(m_stc->GetLength())));
+}
+
+void ScintillaFrame::on_dwell_start(wxStyledTextEvent &event)
+{
+    wxStyledTextCtrl *stc = static_cast<wxStyledTextCtrl *>(event.GetEventObject());
+    const int position = event.GetPosition();
+    if (position < 0)
+    {
+        return;
+    }
+    const int value = stc->IndicatorValueAt(+EditorIndicator::PROBLEM, position);
+    if (value > 0 && static_cast<std::size_t>(value) <= m_problems.size())
+    {
+        stc->CallTipShow(position, wxString::FromUTF8(m_problems[value - 1].message));
+    }
+}
+
+void ScintillaFrame::on_dwell_end(wxStyledTextEvent &event)
+{
+    static_cast<wxStyledTextCtrl *>(event.GetEventObject())->CallTipCancel();
+}
+
+#ifdef FORMULA_LEXER_STATIC
+void ScintillaFrame::on_style_needed(wxStyledTextEvent &event)
+{
+    wxStyledTextCtrl *stc = static_cast<wxStyledTextCtrl *>(event.GetEventObject());
+    // The lexer carries on from part way along a line, so styling needn't go back to the start of one.
+    const int start = stc->GetEndStyled();
+    const int end = std::min(event.GetPosition(), start + STYLE_CHUNK);
+    FORMULA_TRACE_SCOPE(&trace_log(), "StyleNeeded", "editor", "start", start, "length", end - start);
+    colourise(stc, start, end);
+    if (end < event.GetPosition())
+    {
+        // Repainting once pending events are handled asks for the rest of what is in view.
+        CallAfter([stc] { stc->Refresh(false); });
+    }
 }
+#endif
 
 void ScintillaFrame::on_exit(wxCommandEvent & /*event*/)
 {
@@ -0,0 +1,205 @@
+#include "preview_panel.h"
+
+#include <wx/dcbuffer.h>
+#include <wx/stc/stc.h>
+
+#include <algorithm>
+#include <exception>
+#include <string_view>
+#include <utility>
+
+namespace
+{
+
+constexpr int MAX_ITERATIONS{256};
+
+// Colours repeat every this many iterations.
+constexpr int PALETTE_PERIOD{64};
+
+// Pixels that never escape are black; the rest run from dark blue through orange.
+void colour(const std::vector<int> &iterations, std::vector<unsigned char> &rgb)
+{
+    rgb.resize(iterations.size() * 3);
+    for (std::size_t i = 0; i < iterations.size(); ++i)
+    {
+        unsigned char *pixel = &rgb[i * 3];
+        if (iterations[i] >= MAX_ITERATIONS)
+        {
+            std::fill(pixel, pixel + 3, static_cast<unsigned char>(0));
+            continue;
+        }
+        const double t = static_cast<double>(iterations[i] % PALETTE_PERIOD) / PALETTE_PERIOD;
+        const double s = 1.0 - t;
+        pixel[0] = static_cast<unsigned char>(9.0 * s * t * t * t * 255.0);
+        pixel[1] = static_cast<unsigned char>(15.0 * s * s * t * t * 255.0);
+        pixel[2] = static_cast<unsigned char>(8.5 * s * s * s * t * 255.0);
+    }
+}
+
+} // namespace
+
+PreviewPanel::PreviewPanel(wxWindow *parent, wxStyledTextCtrl *stc) :
+    wxPanel(parent, wxID_ANY),
+    m_stc(stc)
+{
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+    m_file.parse(std::string_view{m_stc->GetCharacterPointer(), static_cast<std::size_t>(m_stc->GetLength())});
+    Bind(wxEVT_PAINT, &PreviewPanel::on_paint, this);
+    Bind(wxEVT_SIZE, &PreviewPanel::on_size, this);
+}
+
+PreviewPanel::~PreviewPanel()
+{
+    stop();
+}
+
+void PreviewPanel::document_modified(int position, int removed, int inserted)
+{
+    // The image may be of text that just changed, so stop rendering it right away.
+    m_cancel = true;
+    const formula::TextChange edit{static_cast<std::size_t>(position), static_cast<std::size_t>(removed),
+        static_cast<std::size_t>(inserted)};
+    m_edit = m_edited ? formula::merge_changes(m_edit, edit) : edit;
+    m_edited = true;
+    schedule();
+}
+
+void PreviewPanel::caret_moved(int position)
+{
+    if (position != m_caret)
+    {
+        m_caret = position;
+        schedule();
+    }
+}
+
+void PreviewPanel::schedule()
+{
+    if (!m_update_pending)
+    {
+        m_update_pending = true;
+        CallAfter([this] { update(); });
+    }
+}
+
+void PreviewPanel::update()
+{
+    m_update_pending = false;
+    if (m_edited)
+    {
+        // The range pointer moves the gap to its start rather than to the end of the document,
+        // so reading from the entry being edited costs the distance to it, not the whole text.
+        const int start = static_cast<int>(m_file.reparse_start(m_edit.position));
+        const int length = m_stc->GetLength() - start;
+        const std::string_view text{m_stc->GetRangePointer(start, length), static_cast<std::size_t>(length)};
+        m_file.update(text, static_cast<std::size_t>(start), m_edit.position, m_edit.removed, m_edit.inserted);
+        m_edited = false;
+    }
+    const formula::Entry *entry = m_file.find(m_caret);
+    if (entry == nullptr)
+    {
+        stop();
+        m_source.clear();
+        m_bitmap = wxBitmap();
+        m_message = "No formula at the caret";
+        Refresh(false);
+        return;
+    }
+
+    // A render of the same entry at the same size is still good unless an edit elsewhere cancelled it.
+    const wxCharBuffer entry_text =
+        m_stc->GetTextRangeRaw(static_cast<int>(entry->begin), static_cast<int>(entry->end));
+    std::string source{entry_text.data(), entry_text.length()};
+    if (source == m_source && GetClientSize() == m_size && (m_finished || !m_cancel))
+    {
+        return;
+    }
+    stop();
+    m_source = std::move(source);
+    m_size = GetClientSize();
+    try
+    {
+        start(formula::compile(formula::parse_entry(m_source, 0), m_source));
+        m_message.clear();
+    }
+    catch (const std::exception &e)
+    {
+        // Keep showing the last image while the formula is being typed.
+        m_message = e.what();
+    }
+    Refresh(false);
+}
+
+void PreviewPanel::start(formula::Program program)
+{
+    if (m_size.x <= 0 || m_size.y <= 0)
+    {
+        return;
+    }
+    // Show at least the square from -2 - 2i to 2 + 2i, whatever the panel's shape.
+    formula::Viewport viewport;
+    viewport.pixels_wide = m_size.x;
+    viewport.pixels_high = m_size.y;
+    viewport.width = 4.0 * std::max(1.0, static_cast<double>(m_size.x) / m_size.y);
+
+    const unsigned generation = ++m_generation;
+    m_cancel = false;
+    m_finished = false;
+    m_render = std::thread(
+        [this, generation, viewport, program = std::move(program)]
+        {
+            std::vector<int> iterations;
+            std::vector<unsigned char> rgb;
+            m_finished = m_renderer.render(program, viewport, MAX_ITERATIONS, iterations, m_cancel,
+                [&](int /*step*/)
+                {
+                    colour(iterations, rgb);
+                    CallAfter([this, generation, viewport, rgb]
+                        { show_pass(generation, viewport.pixels_wide, viewport.pixels_high, rgb); });
+                });
+        });
+}
+
+void PreviewPanel::stop()
+{
+    if (m_render.joinable())
+    {
+        m_cancel = true;
+        m_render.join();
+    }
+}
+
+void PreviewPanel::show_pass(unsigned generation, int width, int height, const std::vector<unsigned char> &rgb)
+{
+    // Passes of a render that has since been replaced may still be queued.
+    if (generation != m_generation)
+    {
+        return;
+    }
+    wxImage image(width, height, false);
+    std::copy(rgb.begin(), rgb.end(), image.GetData());
+    m_bitmap = wxBitmap(image);
+    Refresh(false);
+}
+
+void PreviewPanel::on_paint(wxPaintEvent &/*event*/)
+{
+    wxAutoBufferedPaintDC dc(this);
+    dc.SetBackground(*wxBLACK_BRUSH);
+    dc.Clear();
+    if (m_bitmap.IsOk())
+    {
+        dc.DrawBitmap(m_bitmap, 0, 0);
+    }
+    if (!m_message.empty())
+    {
+        dc.SetTextForeground(*wxWHITE);
+        dc.DrawText(m_message, 4, 4);
+    }
+}
+
+void PreviewPanel::on_size(wxSizeEvent &event)
+{
+    event.Skip();
+    schedule();
+}
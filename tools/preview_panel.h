@@ -0,0 +1,59 @@
+#pragma once
+
+#include <formula/bytecode.h>
+#include <formula/parser.h>
+#include <formula/thread_pool.h>
+#include <formula/tile_renderer.h>
+
+#include <wx/wx.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+class wxStyledTextCtrl;
+
+// Shows an escape-time image of the formula under the caret next to the editor.
+//
+// The entry at the caret is compiled on the UI thread and rendered on a thread
+// pool, coarse to fine, by a render thread that posts each finished pass back to
+// the panel.  Any change to the document cancels the render at once; a new one
+// starts after the edits of the current event have been handled.
+class PreviewPanel : public wxPanel
+{
+public:
+    PreviewPanel(wxWindow *parent, wxStyledTextCtrl *stc);
+    ~PreviewPanel() override;
+
+    // removed bytes at position were replaced by inserted bytes.  The edits of an event are
+    // reparsed together once it has been handled, reading the text from the first entry they touch.
+    void document_modified(int position, int removed, int inserted);
+    void caret_moved(int position);
+
+private:
+    void schedule();
+    void update();
+    void start(formula::Program program);
+    void stop();
+    void show_pass(unsigned generation, int width, int height, const std::vector<unsigned char> &rgb);
+    void on_paint(wxPaintEvent &event);
+    void on_size(wxSizeEvent &event);
+
+    wxStyledTextCtrl *m_stc;
+    formula::FormulaFile m_file;
+    formula::TextChange m_edit; // since the entries were last reparsed
+    bool m_edited{};
+    formula::ThreadPool m_pool;
+    formula::TileRenderer m_renderer{m_pool};
+    std::thread m_render;
+    std::atomic<bool> m_cancel{};
+    std::atomic<bool> m_finished{};
+    unsigned m_generation{};
+    bool m_update_pending{};
+    int m_caret{};
+    std::string m_source; // the entry being shown
+    wxSize m_size;
+    wxBitmap m_bitmap;
+    wxString m_message;
+};
@@ -0,0 +1,28 @@
+#include "session_recorder.h"
+
+SessionRecorder::SessionRecorder(const std::string &path, const char *text, std::size_t length) :
+    m_out(path, std::ios::binary),
+    m_writer(m_out)
+{
+    m_writer.text(text, length);
+}
+
+void SessionRecorder::inserted(std::size_t position, const char *text, std::size_t length)
+{
+    m_writer.insert(position, text, length);
+}
+
+void SessionRecorder::deleted(std::size_t position, std::size_t length)
+{
+    m_writer.erase(position, length);
+}
+
+void SessionRecorder::lex(std::size_t start, std::ptrdiff_t length, int init_style)
+{
+    m_writer.lex(start, length, init_style);
+}
+
+void SessionRecorder::fold(std::size_t start, std::ptrdiff_t length, int init_style)
+{
+    m_writer.fold(start, length, init_style);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <formula/edit_session.h>
+#include <formula/lexer.h>
+
+#include <fstream>
+#include <string>
+
+// Logs the modifications made to a document and the ranges the lexer is asked to
+// style and fold, so the session can be replayed against the lexer by bench-replay.
+class SessionRecorder : public formula::LexObserver
+{
+public:
+    SessionRecorder(const std::string &path, const char *text, std::size_t length);
+    ~SessionRecorder() override = default;
+
+    bool is_open() const
+    {
+        return m_out.is_open() && m_out.good();
+    }
+
+    void inserted(std::size_t position, const char *text, std::size_t length);
+    void deleted(std::size_t position, std::size_t length);
+
+    void lex(std::size_t start, std::ptrdiff_t length, int init_style) override;
+    void fold(std::size_t start, std::ptrdiff_t length, int init_style) override;
+
+private:
+    std::ofstream m_out;
+    formula::EditSessionWriter m_writer;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace formula
+{
+
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    unsigned thread; // numbered in the order threads first recorded
+    std::int64_t begin; // nanoseconds since the log was created
+    std::int64_t duration;
+    const char *arg_names[2]; // nullptr for an argument that isn't there
+    std::int64_t arg_values[2];
+};
+
+// Timed events from any number of threads, written out as Chrome trace JSON for
+// chrome://tracing or Perfetto.
+//
+// Each thread records into a ring buffer of its own, so recording takes no lock
+// once a thread has its buffer: the event is copied in and the write count
+// published with a release store.  When a buffer is full the oldest events are
+// overwritten.  Names and categories must be string literals or otherwise outlive
+// the log.
+class TraceLog
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t DEFAULT_EVENTS_PER_THREAD{1 << 16};
+
+    explicit TraceLog(std::size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD);
+    TraceLog(const TraceLog &) = delete;
+    TraceLog &operator=(const TraceLog &) = delete;
+    ~TraceLog();
+
+    // Recording is off until enabled; a disabled log ignores everything it's given.
+    void set_enabled(bool enabled)
+    {
+        m_enabled.store(enabled, std::memory_order_relaxed);
+    }
+    bool enabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    void record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+        const char *arg0 = nullptr, std::int64_t value0 = 0, const char *arg1 = nullptr, std::int64_t value1 = 0);
+
+    // The events still held, in the order each thread recorded them.  Events being
+    // overwritten while this runs are left out; disable the log first for a
+    // consistent picture.
+    std::vector<TraceEvent> events() const;
+
+    // A JSON object with a traceEvents array of complete ("X") events, one thread
+    // id for each thread that recorded.
+    void write_chrome_trace(std::ostream &out) const;
+
+private:
+    struct Buffer
+    {
+        Buffer(std::size_t capacity, unsigned thread);
+
+        std::unique_ptr<TraceEvent[]> events;
+        std::size_t capacity;
+        unsigned thread;
+        std::thread::id owner;
+        std::atomic<std::uint64_t> written{};
+    };
+
+    Buffer &buffer();
+    void copy_events(const Buffer &buffer, std::vector<TraceEvent> &events) const;
+
+    const std::uint64_t m_id;
+    const std::size_t m_capacity;
+    const Clock::time_point m_epoch{Clock::now()};
+    std::atomic<bool> m_enabled{};
+    mutable std::mutex m_mutex; // guards m_buffers, not their contents
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+
+// Records the time from its construction to its destruction, when log is enabled.
+class TraceScope
+{
+public:
+    TraceScope(TraceLog *log, const char *name, const char *category, const char *arg0 = nullptr,
+        std::int64_t value0 = 0, const char *arg1 = nullptr, std::int64_t value1 = 0) :
+        m_log(log != nullptr && log->enabled() ? log : nullptr),
+        m_name(name),
+        m_category(category),
+        m_arg_names{arg0, arg1},
+        m_arg_values{value0, value1}
+    {
+        if (m_log != nullptr)
+        {
+            m_begin = TraceLog::Clock::now();
+        }
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+    ~TraceScope()
+    {
+        if (m_log != nullptr)
+        {
+            m_log->record(m_name, m_category, m_begin, TraceLog::Clock::now(), m_arg_names[0], m_arg_values[0],
+                m_arg_names[1], m_arg_values[1]);
+        }
+    }
+
+private:
+    TraceLog *m_log;
+    const char *m_name;
+    const char *m_category;
+    const char *m_arg_names[2];
+    std::int64_t m_arg_values[2];
+    TraceLog::Clock::time_point m_begin;
+};
+
+} // namespace formula
+
+// Traces the rest of the enclosing block into a TraceLog *, which may be null.
+// Compiled out entirely unless the build is configured with ENABLE_TRACING.
+#ifdef FORMULA_TRACING
+#define FORMULA_TRACE_CONCAT_(a, b) a##b
+#define FORMULA_TRACE_CONCAT(a, b) FORMULA_TRACE_CONCAT_(a, b)
+#define FORMULA_TRACE_SCOPE(log, ...) \
+    const ::formula::TraceScope FORMULA_TRACE_CONCAT(formula_trace_scope_, __LINE__)(log, __VA_ARGS__)
+#else
+#define FORMULA_TRACE_SCOPE(log, ...) static_cast<void>(0)
+#endif
@@ -0,0 +1,177 @@
+#include <formula/trace.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+
+namespace formula
+{
+
+namespace
+{
+
+std::atomic<std::uint64_t> s_next_log_id{1};
+
+// The buffer this thread last recorded into, and the log it belongs to; logs are
+// told apart by id, as a new log may be created where an old one was.
+struct ThreadBuffer
+{
+    std::uint64_t log{};
+    void *buffer{};
+    std::thread::id thread{std::this_thread::get_id()};
+};
+
+thread_local ThreadBuffer t_buffer;
+
+std::int64_t nanoseconds(TraceLog::Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+void write_string(std::ostream &out, const char *text)
+{
+    out << '"';
+    for (; *text != '\0'; ++text)
+    {
+        const auto ch = static_cast<unsigned char>(*text);
+        if (ch == '"' || ch == '\\')
+        {
+            out << '\\' << *text;
+        }
+        else if (ch < ' ')
+        {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch) << std::dec
+                << std::setfill(' ');
+        }
+        else
+        {
+            out << *text;
+        }
+    }
+    out << '"';
+}
+
+// Microseconds, the unit of Chrome trace timestamps, to the nanosecond.
+void write_microseconds(std::ostream &out, std::int64_t value)
+{
+    out << value / 1000 << '.' << std::setw(3) << std::setfill('0') << value % 1000 << std::setfill(' ');
+}
+
+} // namespace
+
+TraceLog::Buffer::Buffer(std::size_t capacity, unsigned thread) :
+    events(std::make_unique<TraceEvent[]>(capacity)),
+    capacity(capacity),
+    thread(thread)
+{
+}
+
+TraceLog::TraceLog(std::size_t events_per_thread) :
+    m_id(s_next_log_id++),
+    m_capacity(std::max<std::size_t>(events_per_thread, 1))
+{
+}
+
+TraceLog::~TraceLog() = default;
+
+TraceLog::Buffer &TraceLog::buffer()
+{
+    if (t_buffer.log == m_id)
+    {
+        return *static_cast<Buffer *>(t_buffer.buffer);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = std::find_if(m_buffers.begin(), m_buffers.end(),
+        [](const std::unique_ptr<Buffer> &buffer) { return buffer->owner == t_buffer.thread; });
+    Buffer *buffer;
+    if (it != m_buffers.end())
+    {
+        buffer = it->get();
+    }
+    else
+    {
+        m_buffers.push_back(std::make_unique<Buffer>(m_capacity, static_cast<unsigned>(m_buffers.size())));
+        buffer = m_buffers.back().get();
+        buffer->owner = t_buffer.thread;
+    }
+    t_buffer.log = m_id;
+    t_buffer.buffer = buffer;
+    return *buffer;
+}
+
+void TraceLog::record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+    const char *arg0, std::int64_t value0, const char *arg1, std::int64_t value1)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    Buffer &target = buffer();
+    // Only this thread writes to its buffer, so the count needs no read-modify-write.
+    const std::uint64_t written = target.written.load(std::memory_order_relaxed);
+    target.events[written % target.capacity] = TraceEvent{name, category, target.thread, nanoseconds(begin - m_epoch),
+        nanoseconds(end - begin), {arg0, arg1}, {value0, value1}};
+    target.written.store(written + 1, std::memory_order_release);
+}
+
+void TraceLog::copy_events(const Buffer &buffer, std::vector<TraceEvent> &events) const
+{
+    const std::uint64_t written = buffer.written.load(std::memory_order_acquire);
+    const std::uint64_t first = written > buffer.capacity ? written - buffer.capacity : 0;
+    const std::size_t start = events.size();
+    for (std::uint64_t i = first; i < written; ++i)
+    {
+        events.push_back(buffer.events[i % buffer.capacity]);
+    }
+    // Leave out any the recording thread overwrote while they were being copied.
+    const std::uint64_t now_written = buffer.written.load(std::memory_order_acquire);
+    const std::uint64_t overwritten = now_written > buffer.capacity + first ? now_written - buffer.capacity - first : 0;
+    events.erase(events.begin() + static_cast<std::ptrdiff_t>(start),
+        events.begin() + static_cast<std::ptrdiff_t>(start + std::min<std::uint64_t>(overwritten, written - first)));
+}
+
+std::vector<TraceEvent> TraceLog::events() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<TraceEvent> result;
+    for (const std::unique_ptr<Buffer> &buffer : m_buffers)
+    {
+        copy_events(*buffer, result);
+    }
+    return result;
+}
+
+void TraceLog::write_chrome_trace(std::ostream &out) const
+{
+    const std::vector<TraceEvent> all = events();
+    out << "{\"traceEvents\":[";
+    const char *separator = "\n";
+    for (const TraceEvent &event : all)
+    {
+        out << separator << "{\"name\":";
+        write_string(out, event.name);
+        out << ",\"cat\":";
+        write_string(out, event.category);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":";
+        write_microseconds(out, event.begin);
+        out << ",\"dur\":";
+        write_microseconds(out, event.duration);
+        if (event.arg_names[0] != nullptr)
+        {
+            out << ",\"args\":{";
+            for (int i = 0; i < 2 && event.arg_names[i] != nullptr; ++i)
+            {
+                out << (i == 0 ? "" : ",");
+                write_string(out, event.arg_names[i]);
+                out << ':' << event.arg_values[i];
+            }
+            out << '}';
+        }
+        out << '}';
+        separator = ",\n";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} // namespace formula